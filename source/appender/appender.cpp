@@ -0,0 +1,121 @@
+#include <string.h>
+#include <iostream>
+#include "appender.h"
+#include "../buffers/buffers.h"
+#include "../page/page.h"
+#include "../logger/logger.h"
+
+ResultAppender::ResultAppender(uint64_t fileId, const std::vector< std::vector< std::string > >& columns){
+    mFileId = fileId;
+    mColumns = columns;
+    mRowSize = getRowSize(columns);
+    mSlotted = isVariableLength(columns);
+}
+
+bool ResultAppender::open(){
+    mPageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+
+    if(!readPage(mPageBuffer.get(), mFileId, 0)){
+        Logger::logError("Error in reading metadata of file "+std::to_string(mFileId));
+        return false;
+    }
+    memcpy(&mTotBytes, mPageBuffer.get(), sizeof(mTotBytes));
+    memcpy(&mTotPages, mPageBuffer.get() + sizeof(mTotBytes), sizeof(mTotPages));
+    memcpy(&mNextId, mPageBuffer.get() + sizeof(mTotBytes) + sizeof(mTotPages), sizeof(mNextId));
+
+    // Rows are appended to the last page
+    memset(mPageBuffer.get(), 0, PAGE_SIZE);
+    if(mTotPages == 0){
+        mTotPages = 1;
+    } else if(!readPage(mPageBuffer.get(), mFileId, mTotPages)){
+        Logger::logError("Error in reading page "+std::to_string(mTotPages)+" of file "+std::to_string(mFileId));
+        return false;
+    }
+    memcpy(&mPageBytes, mPageBuffer.get(), sizeof(mPageBytes));
+
+    mOpen = true;
+    return true;
+}
+
+bool ResultAppender::flushPage(){
+    if(!writeToPage(mPageBuffer.get(), mFileId, mTotPages)){
+        Logger::logError("Error in writing page "+std::to_string(mTotPages)+" of file "+std::to_string(mFileId));
+        return false;
+    }
+    return true;
+}
+
+bool ResultAppender::append(const std::string& row, bool keepId){
+    std::string record = row;
+    if(!keepId){
+        memcpy(&record[0], &mNextId, sizeof(mNextId));
+    }
+
+    if(mSlotted){
+        record = encodeRow(mFileId, record, mColumns);
+        if(insertIntoSlottedPage(mPageBuffer.get(), record.c_str(), record.length()) == -1){
+            // We need a new page
+            if(!flushPage()){
+                return false;
+            }
+            memset(mPageBuffer.get(), 0, PAGE_SIZE);
+            mTotPages++;
+            if(insertIntoSlottedPage(mPageBuffer.get(), record.c_str(), record.length()) == -1){
+                Logger::logError("Row doesn't fit in a page");
+                return false;
+            }
+        }
+    } else {
+        if(mPageBytes + mRowSize + sizeof(mPageBytes) > PAGE_SIZE){
+            // We need a new page
+            if(!flushPage()){
+                return false;
+            }
+            memset(mPageBuffer.get(), 0, PAGE_SIZE);
+            mTotPages++;
+            mPageBytes = 0;
+        }
+        memcpy(mPageBuffer.get() + sizeof(mPageBytes) + mPageBytes, record.c_str(), mRowSize);
+        mPageBytes += mRowSize;
+        memcpy(mPageBuffer.get(), &mPageBytes, sizeof(mPageBytes));
+    }
+
+    mNextId++;
+    mTotBytes += record.length();
+    return true;
+}
+
+bool ResultAppender::close(){
+    if(!mOpen){
+        return true;
+    }
+    mOpen = false;
+
+    if(!flushPage()){
+        return false;
+    }
+
+    // Page 0 also stores the table string, so only the counters are replaced
+    if(!readPage(mPageBuffer.get(), mFileId, 0)){
+        Logger::logError("Error in reading metadata of file "+std::to_string(mFileId));
+        return false;
+    }
+    memcpy(mPageBuffer.get(), &mTotBytes, sizeof(mTotBytes));
+    memcpy(mPageBuffer.get() + sizeof(mTotBytes), &mTotPages, sizeof(mTotPages));
+    memcpy(mPageBuffer.get() + sizeof(mTotBytes) + sizeof(mTotPages), &mNextId, sizeof(mNextId));
+    if(!writeToPage(mPageBuffer.get(), mFileId, 0)){
+        Logger::logError("Error in writing metadata of file "+std::to_string(mFileId));
+        return false;
+    }
+
+    if(DEBUG == true){
+        std::cout << "Appended to file " << mFileId << ". Tot Bytes: " << mTotBytes << " Tot Pages: " << mTotPages << " Next ID: " << mNextId << std::endl;
+    }
+
+    mPageBuffer.reset();
+    return true;
+}
+
+ResultAppender::~ResultAppender(){
+    close();
+}
@@ -0,0 +1,59 @@
+#ifndef APPENDER_H
+#define APPENDER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+/**
+ * @brief Appends rows to a table or query file without probing pages for empty positions.
+ * The page being filled is kept in memory and written only when it is full. Metadata
+ * (total bytes, total pages and next ID) is written once by close.
+ * Meant for files only written through the appender (query results, spill files).
+ */
+class ResultAppender {
+    uint64_t mFileId;
+    std::vector< std::vector< std::string > > mColumns;
+    uint32_t mRowSize;
+    bool mSlotted;
+
+    uint64_t mTotBytes = 0;
+    uint64_t mTotPages = 0;
+    uint64_t mNextId = 1;
+
+    std::unique_ptr<char[]> mPageBuffer;
+    // Bytes of rows in the current page of a fixed width file
+    uint32_t mPageBytes = 0;
+    bool mOpen = false;
+
+    bool flushPage();
+public:
+    ResultAppender(uint64_t fileId, const std::vector< std::vector< std::string > >& columns);
+
+    /**
+     * @brief Continue after the rows already stored in the file
+     *
+     * @return true on success
+     * @return false if the metadata of the file couldn't be read
+     */
+    bool open();
+
+    /**
+     * @brief Append a decoded row (see getColumnOffsets). The ID of the row is replaced by the next ID of the file
+     *
+     * @param keepId keep the (non zero) ID of the row instead. Used by spill files
+     */
+    bool append(const std::string& row, bool keepId = false);
+
+    /**
+     * @brief Write the current page and the metadata of the file
+     */
+    bool close();
+
+    uint64_t getTotBytes(){ return mTotBytes; }
+    uint64_t getTotPages(){ return mTotPages; }
+    ~ResultAppender();
+};
+
+#endif // APPENDER_H
@@ -0,0 +1,226 @@
+#include <string.h>
+#include <iostream>
+#include <iomanip>
+#include "batch.h"
+#include "../page/page.h"
+#include "../logger/logger.h"
+
+void initBatch(Batch& batch, const std::vector< std::vector< std::string > >& columns){
+    batch.ids.clear();
+    batch.selection.clear();
+    batch.size = 0;
+    batch.columns.resize(columns.size());
+    for(int i=0; i<columns.size(); i++){
+        ColumnVector& column = batch.columns[i];
+        column.type = columns[i][1];
+        column.kind = getTypeFromString(columns[i][1]);
+        column.ints.clear();
+        column.floats.clear();
+        column.fields.clear();
+    }
+}
+
+void decodePageIntoBatch(Batch& batch, const char PAGE[], const std::vector< std::pair< uint32_t, uint32_t > >& rows, uint32_t begin, uint32_t end, const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& projection){
+    uint32_t count = end - begin;
+    uint32_t first = batch.size;
+
+    batch.ids.resize(first + count);
+    for(uint32_t i=0; i<count; i++){
+        memcpy(&batch.ids[first + i], PAGE + rows[begin + i].first, sizeof(uint64_t));
+    }
+
+    // Fixed width rows have the same column offsets, so each column is a strided copy
+    std::vector< uint32_t > offsets;
+    uint32_t offset = sizeof(uint64_t);
+    for(int j=0; j<columns.size(); j++){
+        offsets.push_back(offset);
+        offset += getTypeSize(columns[j][1]);
+    }
+
+    for(int j=0; j<projection.size(); j++){
+        ColumnVector& column = batch.columns[j];
+        uint32_t size = getTypeSize(column.type);
+        offset = offsets[projection[j]];
+        switch(column.kind){
+            case TYPE::INT:
+                column.ints.resize(first + count);
+                for(uint32_t i=0; i<count; i++){
+                    memcpy(&column.ints[first + i], PAGE + rows[begin + i].first + offset, sizeof(int64_t));
+                }
+                break;
+            case TYPE::FLOAT:
+                column.floats.resize(first + count);
+                for(uint32_t i=0; i<count; i++){
+                    memcpy(&column.floats[first + i], PAGE + rows[begin + i].first + offset, sizeof(double));
+                }
+                break;
+            default:
+                for(uint32_t i=0; i<count; i++){
+                    column.fields.emplace_back(PAGE + rows[begin + i].first + offset, size);
+                }
+                break;
+        }
+    }
+
+    for(uint32_t i=0; i<count; i++){
+        batch.selection.push_back(first + i);
+    }
+    batch.size += count;
+}
+
+void appendRowToBatch(Batch& batch, const std::string& row, const std::vector< std::vector< std::string > >& columns){
+    std::vector< uint32_t > offsets = getColumnOffsets(row.c_str(), columns);
+
+    uint64_t id;
+    memcpy(&id, row.c_str(), sizeof(id));
+    batch.ids.push_back(id);
+
+    for(int j=0; j<columns.size(); j++){
+        ColumnVector& column = batch.columns[j];
+        if(column.kind == TYPE::INT){
+            int64_t value;
+            memcpy(&value, row.c_str() + offsets[j], sizeof(value));
+            column.ints.push_back(value);
+        } else if(column.kind == TYPE::FLOAT){
+            double value;
+            memcpy(&value, row.c_str() + offsets[j], sizeof(value));
+            column.floats.push_back(value);
+        } else {
+            column.fields.push_back(row.substr(offsets[j], offsets[j+1] - offsets[j]));
+        }
+    }
+
+    batch.selection.push_back(batch.size);
+    batch.size++;
+}
+
+/**
+ * @brief Keep the selected rows for which keep(row) is true
+ */
+template<typename Predicate>
+void refineSelection(Batch& batch, Predicate keep){
+    uint32_t selected = 0;
+    for(uint32_t i=0; i<batch.selection.size(); i++){
+        uint32_t row = batch.selection[i];
+        if(keep(row)){
+            batch.selection[selected++] = row;
+        }
+    }
+    batch.selection.resize(selected);
+}
+
+template<typename T>
+void filterValues(Batch& batch, const std::vector< T >& values, T value, COMPARISON operation){
+    switch(operation){
+        case COMPARISON::EQUAL:
+            refineSelection(batch, [&](uint32_t row){ return values[row] == value; });
+            break;
+        case COMPARISON::GREATER:
+            refineSelection(batch, [&](uint32_t row){ return values[row] > value; });
+            break;
+        case COMPARISON::LESS:
+            refineSelection(batch, [&](uint32_t row){ return values[row] < value; });
+            break;
+        case COMPARISON::G_EQUAL:
+            refineSelection(batch, [&](uint32_t row){ return values[row] >= value; });
+            break;
+        case COMPARISON::L_EQUAL:
+            refineSelection(batch, [&](uint32_t row){ return values[row] <= value; });
+            break;
+        default:
+            batch.selection.clear();
+            break;
+    }
+}
+
+bool filterBatch(Batch& batch, const condition& cond, uint32_t column){
+    const ColumnVector& values = batch.columns[column];
+
+    if(batch.selection.empty()){
+        return true;
+    }
+
+    if(!matchType(cond.value, values.type)){
+        return false;
+    }
+
+    if(values.kind == TYPE::INT){
+        filterValues(batch, values.ints, (int64_t)std::stoll(cond.value), cond.operation);
+        return true;
+    } else if(values.kind == TYPE::FLOAT){
+        filterValues(batch, values.floats, std::stod(cond.value), cond.operation);
+        return true;
+    }
+
+    // Other types keep the comparison semantics of getCompResult
+    bool valid = true;
+    refineSelection(batch, [&](uint32_t row){
+        std::string lVal = getValueFromBytes(values.fields[row].c_str(), values.type, 0, values.fields[row].size());
+        COMPARISON compResult = getCompResult(lVal, cond.value, values.type);
+        if(compResult == COMPARISON::INVALID){
+            valid = false;
+            return false;
+        }
+        return isComparisonValid(cond.operation, compResult);
+    });
+    return valid;
+}
+
+void hashBatch(const Batch& batch, const std::vector< uint32_t >& columns, std::vector< uint64_t >& hashes){
+    hashes.assign(batch.selection.size(), 0);
+
+    for(int j=0; j<columns.size(); j++){
+        const ColumnVector& column = batch.columns[columns[j]];
+        for(uint32_t i=0; i<batch.selection.size(); i++){
+            uint32_t row = batch.selection[i];
+            uint64_t hash;
+            if(column.kind == TYPE::INT){
+                hash = mixHash(column.ints[row]);
+            } else if(column.kind == TYPE::FLOAT){
+                // -0.0 and 0.0 are equal
+                double value = column.floats[row] == 0 ? 0 : column.floats[row];
+                uint64_t bits;
+                memcpy(&bits, &value, sizeof(bits));
+                hash = mixHash(bits);
+            } else {
+                hash = std::hash<std::string>{}(column.fields[row]);
+            }
+            hashes[i] = mixHash(hashes[i] ^ (hash + 0x9e3779b97f4a7c15ULL));
+        }
+    }
+}
+
+std::string gatherRow(const Batch& batch, uint32_t row){
+    std::string bytes(reinterpret_cast<const char*>(&batch.ids[row]), sizeof(uint64_t));
+    for(int j=0; j<batch.columns.size(); j++){
+        const ColumnVector& column = batch.columns[j];
+        if(column.kind == TYPE::INT){
+            bytes.append(reinterpret_cast<const char*>(&column.ints[row]), sizeof(int64_t));
+        } else if(column.kind == TYPE::FLOAT){
+            bytes.append(reinterpret_cast<const char*>(&column.floats[row]), sizeof(double));
+        } else {
+            bytes += column.fields[row];
+        }
+    }
+    return bytes;
+}
+
+std::string getBatchValue(const Batch& batch, uint32_t column, uint32_t row){
+    const ColumnVector& values = batch.columns[column];
+    if(values.kind == TYPE::INT){
+        return std::to_string(values.ints[row]);
+    } else if(values.kind == TYPE::FLOAT){
+        return std::to_string(values.floats[row]);
+    }
+    return getValueFromBytes(values.fields[row].c_str(), values.type, 0, values.fields[row].size());
+}
+
+void printBatch(const Batch& batch){
+    std::ostream& output = Logger::getOutput();
+    for(uint32_t i=0; i<batch.selection.size(); i++){
+        for(int j=0; j<batch.columns.size(); j++){
+            output << std::setw(20) << getBatchValue(batch, j, batch.selection[i]);
+        }
+        output << '\n';
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../type/type.h"
+#include "../condition/condition.h"
+
+/**
+ * @brief Number of rows exchanged between operators in vectorized execution
+ */
+const uint32_t BATCH_SIZE = 1024;
+
+/**
+ * @brief Values of one column for every row of a batch. int and float values are decoded
+ * into typed arrays. Other types keep the bytes of the field (as in decoded rows)
+ */
+struct ColumnVector {
+    std::string type;
+    TYPE kind;
+    std::vector< int64_t > ints;
+    std::vector< double > floats;
+    std::vector< std::string > fields;
+};
+
+/**
+ * @brief Batch of rows held column wise. Only rows listed in the selection vector are
+ * part of the result. The selection vector is kept in increasing order.
+ */
+struct Batch {
+    std::vector< uint64_t > ids;
+    std::vector< ColumnVector > columns;
+    std::vector< uint32_t > selection;
+    uint32_t size = 0;
+};
+
+/**
+ * @brief Prepare an empty batch for rows with these columns. Memory of previous batches is reused
+ */
+void initBatch(Batch& batch, const std::vector< std::vector< std::string > >& columns);
+
+/**
+ * @brief Decode fixed width rows of a page into the batch, one column at a time
+ *
+ * @param PAGE page buffer
+ * @param rows (offset, length) of the rows to decode (see getRowsOfPage)
+ * @param begin first entry of rows to decode
+ * @param end entry after the last one to decode
+ * @param columns columns of the rows
+ * @param projection column of the rows decoded into every column of the batch
+ */
+void decodePageIntoBatch(Batch& batch, const char PAGE[], const std::vector< std::pair< uint32_t, uint32_t > >& rows, uint32_t begin, uint32_t end, const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& projection);
+
+/**
+ * @brief Append a decoded row (see getColumnOffsets) to the batch and select it
+ */
+void appendRowToBatch(Batch& batch, const std::string& row, const std::vector< std::vector< std::string > >& columns);
+
+/**
+ * @brief Remove rows not satisfying a condition from the selection vector
+ *
+ * @param column index of the column on the LHS of the condition
+ * @return true on success
+ * @return false if the value of the condition doesn't match the type of the column
+ */
+bool filterBatch(Batch& batch, const condition& cond, uint32_t column);
+
+/**
+ * @brief Finalizer of splitmix64. Spreads the bits of a hash value
+ */
+inline uint64_t mixHash(uint64_t value){
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+/**
+ * @brief Hash the given columns of every selected row. hashes[i] belongs to selection[i]
+ */
+void hashBatch(const Batch& batch, const std::vector< uint32_t >& columns, std::vector< uint64_t >& hashes);
+
+/**
+ * @brief Build the decoded row of a row of the batch
+ */
+std::string gatherRow(const Batch& batch, uint32_t row);
+
+/**
+ * @brief Get the printable value of a column of a row of the batch (same format as getValueFromBytes)
+ */
+std::string getBatchValue(const Batch& batch, uint32_t column, uint32_t row);
+
+/**
+ * @brief Print the selected rows of the batch
+ */
+void printBatch(const Batch& batch);
+
+#endif // BATCH_H
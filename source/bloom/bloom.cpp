@@ -0,0 +1,52 @@
+#include "bloom.h"
+
+/**
+ * @brief Bits of the filter per expected key. Gives about 0.5% false positives
+ */
+const uint64_t BLOOM_BITS_PER_KEY = 16;
+
+/**
+ * @brief Odd multipliers picking an independent bit per word (as in split block Bloom filters)
+ */
+const uint32_t BLOOM_SALTS[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+BloomFilter::BloomFilter(uint64_t expectedKeys){
+    uint64_t numBlocks = 1;
+    while(numBlocks * BLOCK_WORDS * 64 < expectedKeys * BLOOM_BITS_PER_KEY){
+        numBlocks <<= 1;
+    }
+    mBlockMask = numBlocks - 1;
+    mBlocks.assign(numBlocks, Block());
+}
+
+void BloomFilter::getMasks(uint64_t hash, uint64_t masks[BLOCK_WORDS]){
+    // The low half of the hash picks the bits, the high half picks the block
+    uint32_t key = (uint32_t)hash;
+    for(uint32_t i=0; i<BLOCK_WORDS; i++){
+        masks[i] = (uint64_t)1 << ((key * BLOOM_SALTS[i]) >> 26);
+    }
+}
+
+void BloomFilter::insert(uint64_t hash){
+    uint64_t masks[BLOCK_WORDS];
+    getMasks(hash, masks);
+    Block& block = mBlocks[(hash >> 32) & mBlockMask];
+    for(uint32_t i=0; i<BLOCK_WORDS; i++){
+        block.words[i] |= masks[i];
+    }
+}
+
+bool BloomFilter::mayContain(uint64_t hash) const {
+    uint64_t masks[BLOCK_WORDS];
+    getMasks(hash, masks);
+    const Block& block = mBlocks[(hash >> 32) & mBlockMask];
+    // No early exit, so all words are checked at once
+    uint64_t missing = 0;
+    for(uint32_t i=0; i<BLOCK_WORDS; i++){
+        missing |= masks[i] & ~block.words[i];
+    }
+    return missing == 0;
+}
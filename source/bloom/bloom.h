@@ -0,0 +1,43 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Blocked Bloom filter on 64 bit hash values. Every key sets one bit in each of the
+ * 8 words of a single cache line sized block, so a lookup touches one cache line and checks
+ * the words with straight line code the compiler can vectorize.
+ * There are no false negatives. False positives depend on the bits per key.
+ */
+class BloomFilter {
+    static const uint32_t BLOCK_WORDS = 8;
+
+    struct alignas(64) Block {
+        uint64_t words[BLOCK_WORDS];
+    };
+
+    std::vector< Block > mBlocks;
+    uint64_t mBlockMask;
+
+    /**
+     * @brief Bit of every word of the block set by a hash value
+     */
+    static void getMasks(uint64_t hash, uint64_t masks[BLOCK_WORDS]);
+public:
+    /**
+     * @param expectedKeys number of keys to be inserted. Used to size the filter
+     */
+    BloomFilter(uint64_t expectedKeys);
+    void insert(uint64_t hash);
+
+    /**
+     * @return true if the hash value may have been inserted
+     * @return false if it definitely wasn't
+     */
+    bool mayContain(uint64_t hash) const;
+
+    uint64_t getBytes() const { return mBlocks.size() * sizeof(Block); }
+};
+
+#endif // BLOOM_H
@@ -1,56 +1,66 @@
 #include <string.h>
+#include <algorithm>
 #include "../database/database.h"
 #include "buffers.h"
 #include "../properties.h"
 #include "../logger/logger.h"
+#include "../temp/temp.h"
 
 // File system calls
 #include <fcntl.h>
 #include <unistd.h>
 
-char WRITE_BUFFER[PAGE_SIZE+1];
-char READ_BUFFER[PAGE_SIZE+1];
-
-char TABLE_METADATA_PAGE_BUFFER_A[PAGE_SIZE+1];
-char TABLE_METADATA_PAGE_BUFFER_B[PAGE_SIZE+1];
-char TABLE_METADATA_PAGE_BUFFER_C[PAGE_SIZE+1];
-
-char CURRENT_TABLE_PAGE_BUFFER_A[PAGE_SIZE+1];
-char CURRENT_TABLE_PAGE_BUFFER_B[PAGE_SIZE+1];
-char CURRENT_TABLE_PAGE_BUFFER_C[PAGE_SIZE+1];
-
-uint64_t QUERY_TIMESTAMPS[PAGE_SIZE / sizeof(uint64_t)];
-uint32_t QUERY_TIMESTAMP_PTR = 0;
+std::string getFilePath(uint64_t fileId){
+    if(TempFiles::isTempFile(fileId)){
+        // Query and spill files (and their overflow pages) live in the session directory
+        return TempFiles::getFilePath(fileId);
+    }
 
-char WORKBUFFER_A[PAGE_SIZE+1];
-char WORKBUFFER_B[PAGE_SIZE+1];
-char WORKBUFFER_C[PAGE_SIZE+1];
-char WORKBUFFER_D[PAGE_SIZE+1];
+    // Files of a database carry its number, so that pages of any database can be read by any thread
+    std::string dbName = Database::getDatabaseName(fileId);
+    fileId = Database::getLocalId(fileId);
+    if(fileId & OVERFLOW_FILE_FLAG){
+        // Overflow pages of a table
+        return DATABASE_DIRECTORY + dbName + "/data/overflow__"+std::to_string(fileId ^ OVERFLOW_FILE_FLAG);
+    } else if(fileId == 0){
+        // Table metadata file
+        return DATABASE_DIRECTORY + dbName + "/tables";
+    } else {
+        // Table data file
+        return DATABASE_DIRECTORY + dbName + "/data/table__"+std::to_string(fileId);
+    }
+}
 
 int getFileDesriptor(uint64_t fileId, uint64_t pageNumber, int flags, mode_t mode){
     if(pageNumber >= ((uint64_t)1 << LOG_MAX_PAGES)){
         Logger::logError("Page number "+std::to_string(pageNumber)+" too large");
         return -1;
     }
-    if(!Database::isDatabaseChosen()){
+    if(!TempFiles::isTempFile(fileId) && Database::getDatabaseName(fileId) == "NUL"){
         Logger::logError("Database not chosen");
         return -1;
     }
-    std::string dbName = Database::getCurrentDatabase();
 
-    if(fileId == 0){
-        // Table metadata file
-        return open((DATABASE_DIRECTORY + dbName + "/tables").c_str(), flags, mode);
-    } else if(fileId < ((uint64_t)1 << LOG_MAX_TABLES)) {
-        // Table data file
-        return open((DATABASE_DIRECTORY + dbName + "/data/table__"+std::to_string(fileId)).c_str(), flags, mode);
-    } else {
-        //Query data file
-        return open((DATABASE_DIRECTORY + dbName + "/data/query__"+std::to_string(fileId)).c_str(), flags, mode);
+    return open(getFilePath(fileId).c_str(), flags, mode);
+}
+
+bool fileExists(uint64_t fileId){
+    if(TempFiles::isInMemory(fileId)){
+        return true;
     }
+    int fd = getFileDesriptor(fileId, 0, O_RDONLY, 0);
+    if(fd < 0){
+        return false;
+    }
+    close(fd);
+    return true;
 }
 
 uint32_t readPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber){
+    uint32_t totRead;
+    if(TempFiles::isTempFile(fileId) && TempFiles::readPage(BUFFER, fileId, pageNumber, totRead)){
+        return totRead;
+    }
 
     int fd = getFileDesriptor(fileId, pageNumber, O_RDONLY, 0);
 
@@ -61,7 +71,7 @@ uint32_t readPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber){
     }
 
     lseek(fd, pageNumber*PAGE_SIZE, SEEK_SET);
-    uint32_t totRead = readFromFile(fd,BUFFER);
+    totRead = readFromFile(fd,BUFFER);
     close(fd);
 
     if(totRead == -1){
@@ -72,6 +82,9 @@ uint32_t readPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber){
 }
 
 bool writeToPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber, int additionalFlags, mode_t mode){
+    if(TempFiles::isTempFile(fileId) && TempFiles::writePage(BUFFER, fileId, pageNumber, additionalFlags & O_CREAT, additionalFlags & O_TRUNC)){
+        return true;
+    }
 
     int fd = getFileDesriptor(fileId, pageNumber, O_WRONLY | additionalFlags, mode);
 
@@ -92,7 +105,29 @@ bool writeToPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber, int additi
     return true;
 }
 
+void deleteFile(uint64_t fileId){
+    if(TempFiles::isTempFile(fileId)){
+        TempFiles::forget(fileId);
+        unlink(TempFiles::getFilePath(fileId).c_str());
+        if(!(fileId & OVERFLOW_FILE_FLAG)){
+            TempFiles::forget(fileId | OVERFLOW_FILE_FLAG);
+            unlink(TempFiles::getFilePath(fileId | OVERFLOW_FILE_FLAG).c_str());
+        }
+        return;
+    }
+    if(Database::getDatabaseName(fileId) == "NUL"){
+        return;
+    }
+    unlink(getFilePath(fileId).c_str());
+    if(!(fileId & OVERFLOW_FILE_FLAG)){
+        unlink(getFilePath(fileId | OVERFLOW_FILE_FLAG).c_str());
+    }
+}
+
 void truncateFile(uint64_t fileId, uint64_t numPages){
+    if(TempFiles::isTempFile(fileId) && TempFiles::truncate(fileId, numPages)){
+        return;
+    }
     int fd = getFileDesriptor(fileId, 0, O_WRONLY, 0);
 
     if(fd < 0){
@@ -102,15 +137,17 @@ void truncateFile(uint64_t fileId, uint64_t numPages){
     }
 
     ftruncate(fd, numPages*PAGE_SIZE);
+    close(fd);
 }
 
+// Pages are read and written in place, so that threads with buffers of their own can do it at once
 int32_t writeToFile(int fd, char BUFFER[], int totWrite){
-    memcpy(WRITE_BUFFER, BUFFER, totWrite);
-    return write(fd, WRITE_BUFFER, totWrite);
+    return write(fd, BUFFER, totWrite);
 }
 
 int32_t readFromFile(int fd, char BUFFER[], int totRead){
-    int32_t bytesRead = read(fd, READ_BUFFER, totRead);
-    memcpy(BUFFER, READ_BUFFER, totRead);
+    int32_t bytesRead = read(fd, BUFFER, totRead);
+    // Bytes past the end of the file read as zeros
+    memset(BUFFER + std::max(bytesRead, 0), 0, totRead - std::max(bytesRead, 0));
     return bytesRead;
 }
\ No newline at end of file
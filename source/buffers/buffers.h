@@ -1,27 +1,14 @@
 #include "../properties.h"
 
-extern char WRITE_BUFFER[];
-extern char READ_BUFFER[];
-
-// Metadata buffers A and B are for tables being read. C is for table being written.
-extern char TABLE_METADATA_PAGE_BUFFER_A[];
-extern char TABLE_METADATA_PAGE_BUFFER_B[];
-extern char TABLE_METADATA_PAGE_BUFFER_C[];
-
-// Current table page buffers A and B are for tables being read. C is for table being written.
-extern char CURRENT_TABLE_PAGE_BUFFER_A[];
-extern char CURRENT_TABLE_PAGE_BUFFER_B[];
-extern char CURRENT_TABLE_PAGE_BUFFER_C[];
-
-extern char WORKBUFFER_A[];
-extern char WORKBUFFER_B[];
-extern char WORKBUFFER_C[];
-extern char WORKBUFFER_D[];
-
 /**
  * @note For now, metadata files don't use these functions. metadata files are and read directly because of smaller expected size.
  */
 
+bool fileExists(uint64_t fileId);
+/**
+ * @brief Remove the file and its overflow file
+ */
+void deleteFile(uint64_t fileId);
 uint32_t readPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber);
 bool writeToPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber, int additionalFlags = 0, mode_t mode = 0);
 void truncateFile(uint64_t fileId, uint64_t numPages);
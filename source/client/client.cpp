@@ -0,0 +1,77 @@
+#include <string.h>
+#include "client.h"
+#include "../logger/logger.h"
+
+// Socket calls
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+
+Client::~Client(){
+    close();
+}
+
+bool Client::connect(const std::string& socketPath){
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if(socketPath.length() >= sizeof(address.sun_path)){
+        Logger::logError("Socket path " + socketPath + " is too long");
+        return false;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    close();
+    mFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(mFd < 0 || ::connect(mFd, (sockaddr*)&address, sizeof(address)) < 0){
+        Logger::logError("Unable to connect to the server on " + socketPath + ": " + strerror(errno));
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool Client::send(const std::string& statements){
+    uint64_t sent = 0;
+    while(sent < statements.length()){
+        ssize_t written = ::send(mFd, statements.c_str() + sent, statements.length() - sent, MSG_NOSIGNAL);
+        if(written < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        sent += written;
+    }
+    return true;
+}
+
+bool Client::receive(std::string& output){
+    char buffer[4096];
+    uint64_t end;
+    while((end = mReceived.find('\0')) == std::string::npos){
+        ssize_t bytesRead = recv(mFd, buffer, sizeof(buffer), 0);
+        if(bytesRead < 0 && errno == EINTR){
+            continue;
+        }
+        if(bytesRead <= 0){
+            return false;
+        }
+        mReceived.append(buffer, bytesRead);
+    }
+    output = mReceived.substr(0, end);
+    mReceived.erase(0, end + 1);
+    return true;
+}
+
+bool Client::execute(const std::string& statement, std::string& output){
+    return send(statement + ";") && receive(output);
+}
+
+void Client::close(){
+    if(mFd >= 0){
+        ::close(mFd);
+        mFd = -1;
+    }
+    mReceived.clear();
+}
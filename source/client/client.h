@@ -0,0 +1,44 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <string>
+
+/**
+ * @brief Connection to a server (see Server) over its Unix domain socket. Statements are sent like at the
+ * prompt, and the server answers every one with its output followed by a '\0' byte
+ */
+class Client {
+    int mFd = -1;
+    // Bytes received past the end of the last output read
+    std::string mReceived;
+public:
+    ~Client();
+
+    /**
+     * @brief Connect to the server listening on the socket
+     *
+     * @return false if no server listens on it
+     */
+    bool connect(const std::string& socketPath);
+
+    /**
+     * @brief Send statements, each ending with ;. Their outputs are read by receive, in order
+     */
+    bool send(const std::string& statements);
+
+    /**
+     * @brief Wait for the output of the next statement sent
+     *
+     * @return false if the connection was closed
+     */
+    bool receive(std::string& output);
+
+    /**
+     * @brief Run a statement (without the ;) and wait for its output
+     */
+    bool execute(const std::string& statement, std::string& output);
+
+    void close();
+};
+
+#endif // CLIENT_H
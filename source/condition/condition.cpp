@@ -1,5 +1,7 @@
+#include <map>
 #include "condition.h"
 #include "../type/type.h"
+#include "../page/page.h"
 #include <vector>
 
 bool isComparisonValid(COMPARISON expected, COMPARISON obtained){
@@ -73,6 +75,14 @@ COMPARISON getCompResult(std::string lVal, std::string rVal, std::string type){
                 }
             }
             return COMPARISON::EQUAL;
+        case TYPE::VARCHAR:
+            // Compare without the enclosing quotes
+            if(lVal.compare(1, lVal.size()-2, rVal, 1, rVal.size()-2) > 0){
+                return COMPARISON::GREATER;
+            } else if(lVal.compare(1, lVal.size()-2, rVal, 1, rVal.size()-2) < 0){
+                return COMPARISON::LESS;
+            }
+            return COMPARISON::EQUAL;
         default:
             return COMPARISON::INVALID;
     }
@@ -112,4 +122,36 @@ condition getCondition(const std::vector< std::string >& currentComparison){
     } else {
         return condition("",COMPARISON::INVALID,"");
     }
-}
\ No newline at end of file
+}
+
+int verifyConditions(const char rowBuffer[], const std::vector< std::vector< std::string > >& columns,const std::vector<condition>& conditions, uint32_t rowSize){
+
+    std::map<std::string, uint32_t> indices;
+    for(int i=0; i<columns.size(); i++){
+        indices[columns[i][0]] = i;
+    }
+
+    // Offsets depend on the row when there are varchar columns
+    std::vector< uint32_t > offsets = getColumnOffsets(rowBuffer, columns);
+
+    for(int i=0; i<conditions.size(); i++){
+        if(indices.find(conditions[i].columnName) == indices.end()){
+            return -1;
+        }
+        std::string lVal;
+        uint32_t index = indices[conditions[i].columnName];
+        std::string type = columns[index][1];
+
+        lVal = getValueFromBytes(rowBuffer, type, offsets[index], offsets[index + 1]);
+
+        COMPARISON compResult = getCompResult(lVal ,conditions[i].value, type);
+        if(compResult == COMPARISON::INVALID){
+            return -1;
+        }
+
+        if(!isComparisonValid(conditions[i].operation, compResult)){
+            return 0;
+        }
+    }
+    return 1;
+}
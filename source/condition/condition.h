@@ -2,6 +2,7 @@
 #define CONDITION_H
 
 #include <string>
+#include <vector>
 
 enum class COMPARISON {
     EQUAL,
@@ -30,4 +31,11 @@ struct condition {
 
 condition getCondition(const std::vector< std::string >& currentComparison);
 
+/**
+ * @brief Check a decoded row against conditions
+ *
+ * @return int 1 if all conditions hold, 0 if one of them doesn't, -1 if a condition is invalid
+ */
+int verifyConditions(const char rowBuffer[], const std::vector< std::vector< std::string > >& columns,const std::vector<condition>& conditions, uint32_t rowSize);
+
 #endif // CONDITION_H
\ No newline at end of file
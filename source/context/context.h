@@ -0,0 +1,62 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include "../properties.h"
+#include "../mvcc/mvcc.h"
+
+/**
+ * @brief Statement kept by a session under a name (see prepare), run with values for its parameters by execute
+ */
+struct PreparedStatement {
+    std::vector< std::string > tokens;
+    // Parameters $1 to $parameters, replaced by the values given to execute
+    uint32_t parameters = 0;
+};
+
+/**
+ * @brief State of a client kept between its statements. Statements run in a transaction of their own
+ * unless begin opened one, which stays open until commit or rollback.
+ * The statements of a session run one at a time, though not always on the same thread
+ */
+struct Session {
+    Transaction transaction;
+    // Snapshot the statements of the open transaction read at
+    Snapshot snapshot;
+    bool inTransaction = false;
+    // Set once a statement of the open transaction failed and rolled it back
+    bool aborted = false;
+    // Current database of the session (see Database::getCurrentDatabaseNumber)
+    uint64_t database = 0;
+    std::map< std::string, PreparedStatement > preparedStatements;
+    // Set by exit. The client is done
+    bool closed = false;
+};
+
+/**
+ * @brief Working memory of a statement: pages of the tables it reads and writes and scratch pages.
+ * processCommand creates one for every statement and passes it down to the functions using the pages,
+ * so that statements don't share buffers and can run at the same time in one process.
+ * Operators of the executor and workers of the pool keep buffers of their own
+ */
+struct ExecutionContext {
+    // Transaction of the statement (kept by its session) and the snapshot its reads see
+    Transaction* transaction = nullptr;
+    Snapshot snapshot;
+    // Set unless the statement runs in a transaction opened by begin
+    bool autocommit = true;
+
+    // Metadata page and current page of the table being read
+    char metadataPage[PAGE_SIZE+1] = {};
+    char tablePage[PAGE_SIZE+1] = {};
+    // Metadata page and current page of the table being written
+    char writeMetadataPage[PAGE_SIZE+1] = {};
+    char writeTablePage[PAGE_SIZE+1] = {};
+    // Rows being built and pages of the table metadata file
+    char workBufferA[PAGE_SIZE+1] = {};
+    char workBufferB[PAGE_SIZE+1] = {};
+};
+
+#endif // CONTEXT_H
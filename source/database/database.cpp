@@ -3,22 +3,63 @@
 #include <map>
 #include <string.h>
 #include <algorithm>
+#include <mutex>
+#include <atomic>
 #include "database.h"
 #include "../properties.h"
 #include "../logger/logger.h"
 #include "../buffers/buffers.h"
+#include "../context/context.h"
+#include "../lock/lock.h"
 
 // File system calls
 #include <fcntl.h>
 #include <unistd.h>
 
 bool validateDatabaseName(const std::string& name);
-void saveDatabase(const std::string &dbName);
+void saveDatabase(ExecutionContext& context, const std::string &dbName);
 // bool loadTables(const std::string& dbName);
 
-static std::string CURRENT_DATABASE = "NUL";
+/**
+ * @brief Names of the databases used by the process, by number. Entries below DATABASE_COUNT are never changed,
+ * so that paths of files are found without locks
+ */
+static std::string DATABASE_NAMES[MAX_DATABASES] = {"NUL"};
+static std::atomic<uint64_t> DATABASE_COUNT(1);
+static std::mutex DATABASE_NAMES_MUTEX;
+
+// Database of the statement the thread runs
+static thread_local uint64_t CURRENT_DATABASE = 0;
+
+/**
+ * @brief Number of the database with the given name, given to it the first time it is used. 0 if there is no room left
+ */
+uint64_t getDatabaseNumber(const std::string& dbName){
+    std::lock_guard<std::mutex> lock(DATABASE_NAMES_MUTEX);
+    uint64_t count = DATABASE_COUNT.load(std::memory_order_relaxed);
+    for(uint64_t i=1; i<count; i++){
+        if(DATABASE_NAMES[i] == dbName){
+            return i;
+        }
+    }
+    if(count == MAX_DATABASES){
+        return 0;
+    }
+    DATABASE_NAMES[count] = dbName;
+    DATABASE_COUNT.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+/**
+ * @brief Read a page of the table metadata file, latched so that tables created by other sessions are seen whole
+ */
+bool readCatalogPage(char PAGE[], uint64_t pageNumber){
+    uint64_t catalogId = Database::getCatalogId();
+    PageLatchGuard latch(catalogId, pageNumber, false);
+    return readPage(PAGE, catalogId, pageNumber);
+}
 
-void Database::createDatabase(const std::vector<std::string>& tokens){
+void Database::createDatabase(ExecutionContext& context, const std::vector<std::string>& tokens){
     if(tokens.size()!=3){
         Logger::logError("Instruction has incorrect number of arguments");
         return;
@@ -36,7 +77,7 @@ void Database::createDatabase(const std::vector<std::string>& tokens){
         return;
     }
 
-    saveDatabase(dbName);
+    saveDatabase(context, dbName);
 
 }
 
@@ -53,21 +94,50 @@ void Database::useDatabase(const std::vector<std::string>& tokens){
         return;
     }
 
-    CURRENT_DATABASE = dbName;
+    uint64_t databaseNumber = getDatabaseNumber(dbName);
+    if(!databaseNumber){
+        Logger::logError("Too many databases used by the process. At most "+std::to_string(MAX_DATABASES - 1)+" can be used");
+        return;
+    }
+    CURRENT_DATABASE = databaseNumber;
 
     Logger::logSuccess("current database: "+dbName);
 
 }
 
 std::string Database::getCurrentDatabase(){
-    return CURRENT_DATABASE;
+    return DATABASE_NAMES[CURRENT_DATABASE];
 }
 
 bool Database::isDatabaseChosen(){
-    return (CURRENT_DATABASE!="NUL");
+    return (CURRENT_DATABASE!=0);
+}
+
+uint64_t Database::getCurrentDatabaseNumber(){
+    return CURRENT_DATABASE;
+}
+
+void Database::setCurrentDatabase(uint64_t databaseNumber){
+    CURRENT_DATABASE = databaseNumber;
+}
+
+uint64_t Database::getCatalogId(){
+    return CURRENT_DATABASE << DATABASE_ID_SHIFT;
+}
+
+std::string Database::getDatabaseName(uint64_t fileId){
+    uint64_t databaseNumber = fileId >> DATABASE_ID_SHIFT;
+    if(databaseNumber >= DATABASE_COUNT.load(std::memory_order_acquire)){
+        return DATABASE_NAMES[0];
+    }
+    return DATABASE_NAMES[databaseNumber];
+}
+
+uint64_t Database::getLocalId(uint64_t fileId){
+    return fileId & (((uint64_t)1 << DATABASE_ID_SHIFT) - 1);
 }
 
-uint64_t Database::getTableId(const std::string& tableName){
+uint64_t Database::getTableId(ExecutionContext& context, const std::string& tableName){
 
     if(!Database::isDatabaseChosen()){
         return 0;
@@ -75,22 +145,22 @@ uint64_t Database::getTableId(const std::string& tableName){
 
     uint64_t currentPage = 1;
 
-    while(readPage(WORKBUFFER_A, 0, currentPage)){
+    while(readCatalogPage(context.workBufferA, currentPage)){
 
         uint32_t latestLineStart = 0;
 
-        for(int i=0;i<PAGE_SIZE && WORKBUFFER_A[i] != (char)0;i++){
-            if(WORKBUFFER_A[i] == '<') {
+        for(int i=0;i<PAGE_SIZE && context.workBufferA[i] != (char)0;i++){
+            if(context.workBufferA[i] == '<') {
                 std::string idString;
 
                 int32_t lastSpace = latestLineStart;
                 bool matched = true;
                 for(int j=latestLineStart; j<i; j++){
-                    if(WORKBUFFER_A[j]==' '){
+                    if(context.workBufferA[j]==' '){
                         lastSpace = j + 1;
                         break;
                     } else {
-                        idString += WORKBUFFER_A[j];
+                        idString += context.workBufferA[j];
                     }
                 }
 
@@ -99,7 +169,7 @@ uint64_t Database::getTableId(const std::string& tableName){
                 }
 
                 for(int j=lastSpace; j<i; j++){
-                    if(tableName[j - lastSpace] != WORKBUFFER_A[j]){
+                    if(tableName[j - lastSpace] != context.workBufferA[j]){
                         matched = false;
                         break;
                     }
@@ -109,7 +179,7 @@ uint64_t Database::getTableId(const std::string& tableName){
                     if(DEBUG == true){
                         std::cout << "Match found: " << idString << " " << idString.length() << " " << (int)idString[0] << " " << (int)idString[1] << std::endl;
                     }
-                    return std::stoll(idString);
+                    return getCatalogId() | std::stoll(idString);
                 }
 
                 latestLineStart = i+1;
@@ -121,7 +191,7 @@ uint64_t Database::getTableId(const std::string& tableName){
     return 0;
 }
 
-std::string Database::getTableName(uint64_t tableId){
+std::string Database::getTableName(ExecutionContext& context, uint64_t tableId){
     
     std::string tableName;
 
@@ -131,30 +201,30 @@ std::string Database::getTableName(uint64_t tableId){
 
     uint64_t currentPage = 1;
 
-    while(readPage(WORKBUFFER_A, 0, currentPage)){
+    while(readCatalogPage(context.workBufferA, currentPage)){
 
         uint32_t latestLineStart = 0;
 
-        for(int i=0;i<PAGE_SIZE && WORKBUFFER_A[i] != (char)0;i++){
-            if(WORKBUFFER_A[i] == '<') {
+        for(int i=0;i<PAGE_SIZE && context.workBufferA[i] != (char)0;i++){
+            if(context.workBufferA[i] == '<') {
                 std::string idString;
 
                 int32_t lastSpace = latestLineStart;
                 bool matched = true;
                 for(int j=latestLineStart; j<i; j++){
-                    if(WORKBUFFER_A[j]==' '){
+                    if(context.workBufferA[j]==' '){
                         lastSpace = j + 1;
                         break;
                     } else {
-                        idString += WORKBUFFER_A[j];
+                        idString += context.workBufferA[j];
                     }
                 }
 
                 for(int j=lastSpace; j<i; j++){
-                    tableName += WORKBUFFER_A[j];
+                    tableName += context.workBufferA[j];
                 }
 
-                if(std::stoll(idString) != tableId){
+                if((getCatalogId() | std::stoll(idString)) != tableId){
                     tableName.clear();
                     matched = false;
                 }
@@ -175,7 +245,7 @@ std::string Database::getTableName(uint64_t tableId){
     return tableName;
 }
 
-const std::vector< std::vector< std::string > > Database::getColumnsOfTable(uint64_t tableId){
+const std::vector< std::vector< std::string > > Database::getColumnsOfTable(uint64_t tableId, char PAGE[]){
     
     std::vector< std::vector <std::string > > columns;
 
@@ -186,8 +256,8 @@ const std::vector< std::vector< std::string > > Database::getColumnsOfTable(uint
     if(!tableId){
         return columns;
     }
-    memset(WORKBUFFER_A, 0, PAGE_SIZE);
-    if(!readPage(WORKBUFFER_A, tableId, 0)){
+    memset(PAGE, 0, PAGE_SIZE);
+    if(!readPage(PAGE, tableId, 0)){
         return columns;
     }
 
@@ -196,28 +266,28 @@ const std::vector< std::vector< std::string > > Database::getColumnsOfTable(uint
     uint32_t lastSpace = dataStart;
 
     for(int i=dataStart; i < PAGE_SIZE; i++){
-        if(WORKBUFFER_A[i] == '<'){
+        if(PAGE[i] == '<'){
             // process columns
             std::vector< std::string > currentColumn;
             std::string word;
             for(int j=lastSpace; j<i; j++){
-                if(WORKBUFFER_A[j] == '$'){
+                if(PAGE[j] == '$'){
                     //Column end
                     currentColumn.push_back(word);
                     columns.push_back(currentColumn);
                     currentColumn.clear();
                     word = "";
-                } else if(WORKBUFFER_A[j] == ' '){
+                } else if(PAGE[j] == ' '){
                     if(word.size()){
                         currentColumn.push_back(word);
                         word = "";
                     }
                 } else {
-                    word+=WORKBUFFER_A[j];
+                    word+=PAGE[j];
                 }
             }
             return columns;
-        } else if(WORKBUFFER_A[i] == ' '){
+        } else if(PAGE[i] == ' '){
             if(numSpaces == 0){
                 lastSpace = i+1;
                 numSpaces++;
@@ -232,9 +302,13 @@ const std::vector< std::vector< std::string > > Database::getColumnsOfTable(uint
 
 }
 
-const std::vector< std::vector< std::string > > Database::getColumnsOfTable(const std::string& tableName){
-    uint64_t tableId = getTableId(tableName);
-    return getColumnsOfTable(tableId);
+const std::vector< std::vector< std::string > > Database::getColumnsOfTable(ExecutionContext& context, uint64_t tableId){
+    return getColumnsOfTable(tableId, context.workBufferA);
+}
+
+const std::vector< std::vector< std::string > > Database::getColumnsOfTable(ExecutionContext& context, const std::string& tableName){
+    uint64_t tableId = getTableId(context, tableName);
+    return getColumnsOfTable(context, tableId);
 }
 
 bool validateDatabaseName(const std::string& name){
@@ -255,7 +329,7 @@ bool validateDatabaseName(const std::string& name){
     return true;
 }
 
-void saveDatabase(const std::string &dbName){
+void saveDatabase(ExecutionContext& context, const std::string &dbName){
 	try {
 		std::filesystem::create_directories(DATABASE_DIRECTORY+dbName);
 		std::filesystem::create_directories(DATABASE_DIRECTORY+dbName+"/data"); // To store database data
@@ -276,14 +350,14 @@ void saveDatabase(const std::string &dbName){
         uint64_t nextTableId = 1;
         uint64_t totPages = 1;
 
-        memset(WORKBUFFER_A, 0, PAGE_SIZE);
-        memcpy(WORKBUFFER_A ,&nextTableId, sizeof(nextTableId));
-        memcpy(WORKBUFFER_A + sizeof(nextTableId),&totPages, sizeof(totPages));
-        writeToFile(fd, WORKBUFFER_A);
+        memset(context.workBufferA, 0, PAGE_SIZE);
+        memcpy(context.workBufferA ,&nextTableId, sizeof(nextTableId));
+        memcpy(context.workBufferA + sizeof(nextTableId),&totPages, sizeof(totPages));
+        writeToFile(fd, context.workBufferA);
 
         lseek(fd,PAGE_SIZE,SEEK_SET);
-        memset(WORKBUFFER_A, 0, PAGE_SIZE);
-        writeToFile(fd, WORKBUFFER_A);
+        memset(context.workBufferA, 0, PAGE_SIZE);
+        writeToFile(fd, context.workBufferA);
 
 		close(fd);
 
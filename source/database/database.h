@@ -2,6 +2,10 @@
 #define DATABASE_H
 
 #include <vector>
+#include <string>
+#include <cstdint>
+
+struct ExecutionContext;
 
 class Database {
 public:
@@ -10,7 +14,7 @@ public:
      * 
      * @param name name of the database
      */
-    static void createDatabase(const std::vector<std::string>& tokens);
+    static void createDatabase(ExecutionContext& context, const std::vector<std::string>& tokens);
 
     /**
      * @brief Change current database to requested database
@@ -34,13 +38,47 @@ public:
      */
     static bool isDatabaseChosen();
 
-    static uint64_t getTableId(const std::string& tableName);
+    /**
+     * @brief Number the process gave the current database of the thread. 0 if none is chosen
+     */
+    static uint64_t getCurrentDatabaseNumber();
+
+    /**
+     * @brief Make the database with the given number (see getCurrentDatabaseNumber) the current database of the thread.
+     * Sessions keep theirs between statements, which can run on different threads
+     */
+    static void setCurrentDatabase(uint64_t databaseNumber);
 
-    static std::string getTableName(uint64_t tableId);
+    /**
+     * @brief ID of the table metadata file of the current database. IDs of its tables are this ID with the table ID added
+     */
+    static uint64_t getCatalogId();
+
+    /**
+     * @brief Name of the database the file belongs to (see DATABASE_ID_SHIFT). "NUL" for files of no database
+     */
+    static std::string getDatabaseName(uint64_t fileId);
+
+    /**
+     * @brief ID of the file within its database, as stored in the table metadata file
+     */
+    static uint64_t getLocalId(uint64_t fileId);
+
+    /**
+     * @brief ID of the table in the current database, with the number of the database (see getCatalogId). 0 if it doesn't exist
+     */
+    static uint64_t getTableId(ExecutionContext& context, const std::string& tableName);
+
+    static std::string getTableName(ExecutionContext& context, uint64_t tableId);
+
+    /**
+     * @brief Get the columns of a table (or temporary file) from its metadata page, read into PAGE
+     */
+    static const std::vector< std::vector< std::string > > getColumnsOfTable(uint64_t tableId, char PAGE[]);
 
-    static const std::vector< std::vector< std::string > > getColumnsOfTable(uint64_t tableId);
+    static const std::vector< std::vector< std::string > > getColumnsOfTable(ExecutionContext& context, uint64_t tableId);
 
-    static const std::vector< std::vector< std::string > > getColumnsOfTable(const std::string& tableName);
+    static const std::vector< std::vector< std::string > > getColumnsOfTable(ExecutionContext& context, const std::string& tableName);
 
     // /**
     //  * @brief Saves table info (name to column mapping) to currentTables map
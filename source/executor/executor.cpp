@@ -0,0 +1,2961 @@
+#include <string.h>
+#include <iomanip>
+#include <algorithm>
+#include "executor.h"
+#include "../database/database.h"
+#include "../buffers/buffers.h"
+#include "../page/page.h"
+#include "../type/type.h"
+#include "../logger/logger.h"
+#include "../formatter/formatter.h"
+#include "../spill/spill.h"
+#include "../stats/stats.h"
+#include "../parallel/parallel.h"
+
+const uint32_t LOG_JOIN_PARTITIONS = 4;
+const uint32_t JOIN_PARTITIONS = 1 << LOG_JOIN_PARTITIONS;
+/**
+ * @brief Spilled join partitions are partitioned again at most this many times.
+ * Deeper partitions (skewed keys) are joined in chunks of build rows
+ */
+const uint32_t MAX_JOIN_PARTITION_LEVEL = 3;
+/**
+ * @brief Rows of an aggregation are partitioned at most this many times. Deeper partitions keep every group in memory
+ */
+const uint32_t MAX_AGGREGATE_PARTITION_LEVEL = 3;
+/**
+ * @brief Morsels a parallel scan hands to every worker in a wave. More balance the work better,
+ * fewer keep less of the filtered rows in memory
+ */
+const uint32_t MORSELS_PER_WORKER = 4;
+/**
+ * @brief Sorts of fewer rows compare key prefixes instead of radix sorting them
+ */
+const uint32_t RADIX_SORT_MIN_ROWS = 1024;
+
+inline uint64_t hashJoinKey(const std::string& key){
+    return mixHash(std::hash<std::string>{}(key));
+}
+
+/**
+ * @brief Append the value of a key column of a decoded row to a hash join key
+ */
+void appendKeyValue(std::string& key, const char* row, const std::vector< uint32_t >& offsets, const std::vector< std::vector< std::string > >& columns, uint32_t index){
+    TYPE type = getTypeFromString(columns[index][1]);
+    if(type == TYPE::INT){
+        key.append(row + offsets[index], sizeof(int64_t));
+    } else if(type == TYPE::FLOAT){
+        // -0.0 and 0.0 are equal
+        double value;
+        memcpy(&value, row + offsets[index], sizeof(value));
+        if(value == 0){
+            value = 0;
+        }
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    } else {
+        // Printable values, so that string[N] keys of different lengths can match
+        std::string value = getValueFromBytes(row, columns[index][1], offsets[index], offsets[index+1]);
+        uint32_t length = value.length();
+        key.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        key += value;
+    }
+}
+
+/**
+ * @brief Partitions use the top bits of the hash. Hash table slots use the bottom bits
+ */
+inline uint32_t getPartition(uint64_t hash, uint32_t level){
+    return (hash >> (64 - (level + 1)*LOG_JOIN_PARTITIONS)) & (JOIN_PARTITIONS - 1);
+}
+
+/**
+ * @brief Approximate memory used by a build row of a join (row, key and bookkeeping)
+ */
+inline uint64_t getRowMemory(const Row& row){
+    return sizeof(Row) + 2*row.bytes.size() + 64;
+}
+
+int32_t Operator::findColumn(const std::string& name){
+    for(int i=0; i<mColumns.size(); i++){
+        if(mColumns[i][0] == name){
+            return i;
+        }
+    }
+    if(mTableName.length() && name.length() > mTableName.length()+1 && name.substr(0, mTableName.length()+1) == mTableName + "."){
+        return findColumn(name.substr(mTableName.length()+1));
+    }
+    return -1;
+}
+
+bool Operator::nextBatch(Batch& batch){
+    initBatch(batch, mColumns);
+    Row row;
+    while(batch.size < BATCH_SIZE && next(row)){
+        appendRowToBatch(batch, row.bytes, mColumns);
+    }
+    return batch.size > 0;
+}
+
+ScanOperator::ScanOperator(uint64_t fileId, const std::string& tableName){
+    mFileId = fileId;
+    mTableName = tableName;
+    std::unique_ptr<char[]> metadataBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    mTableColumns = Database::getColumnsOfTable(fileId, metadataBuffer.get());
+    mColumns = mTableColumns;
+    mRowSize = getRowSize(mColumns);
+    mSlotted = isVariableLength(mColumns);
+    for(uint32_t i=0; i<mTableColumns.size(); i++){
+        mProjection.push_back(i);
+    }
+}
+
+ScanOperator::ScanOperator(const ScanOperator& scan, uint64_t firstPage, uint64_t lastPage){
+    mFileId = scan.mFileId;
+    mTableName = scan.mTableName;
+    mColumns = scan.mColumns;
+    mTableColumns = scan.mTableColumns;
+    mRowSize = scan.mRowSize;
+    mSlotted = scan.mSlotted;
+    mProjection = scan.mProjection;
+    mLocator = scan.mLocator;
+    mProjected = scan.mProjected;
+    mBloomFilter = scan.mBloomFilter;
+    mBloomColumns = scan.mBloomColumns;
+    mBloomTableColumns = scan.mBloomTableColumns;
+    mFirstPage = firstPage;
+    mLastPage = lastPage;
+    mSnapshot = scan.mSnapshot;
+}
+
+void ScanOperator::setProjection(const std::vector< uint32_t >& projection, bool locator){
+    mProjection = projection;
+    mLocator = locator;
+    mProjected = locator || projection.size() != mTableColumns.size();
+    mColumns.clear();
+    for(int i=0; i<mProjection.size(); i++){
+        mColumns.push_back(mTableColumns[mProjection[i]]);
+        mProjected = mProjected || mProjection[i] != i;
+    }
+    if(mLocator){
+        mColumns.push_back({LOCATOR_COLUMN, "int"});
+    }
+}
+
+bool ScanOperator::open(){
+    mPageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    mRows.clear();
+    mRowIndex = 0;
+    mBloomRejected = 0;
+    if(mLastPage){
+        // Page range of a parallel scan
+        mTotPages = mLastPage;
+        mCurrentPage = mFirstPage - 1;
+        return true;
+    }
+
+    if(!readVisiblePage(mPageBuffer.get(), mFileId, 0, mSnapshot)){
+        Logger::logError("Error in reading table metadata");
+        mFailed = true;
+        return false;
+    }
+    memcpy(&mTotPages, mPageBuffer.get() + sizeof(uint64_t), sizeof(mTotPages));
+    mCurrentPage = 0;
+    return true;
+}
+
+bool ScanOperator::loadNextPage(){
+    if(mCurrentPage >= mTotPages){
+        return false;
+    }
+    mCurrentPage++;
+    if(!readVisiblePage(mPageBuffer.get(), mFileId, mCurrentPage, mSnapshot)){
+        Logger::logError("Error in reading page "+std::to_string(mCurrentPage));
+        mFailed = true;
+        return false;
+    }
+    mRows = getRowsOfPage(mPageBuffer.get(), mRowSize, mSlotted);
+    mRowIndex = 0;
+    return true;
+}
+
+bool ScanOperator::passesBloomFilter(const char* row, const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& keyColumns){
+    std::vector< uint32_t > offsets = getColumnOffsets(row, columns);
+    std::string key;
+    for(int i=0; i<keyColumns.size(); i++){
+        appendKeyValue(key, row, offsets, columns, keyColumns[i]);
+    }
+    if(mBloomFilter->mayContain(hashJoinKey(key))){
+        return true;
+    }
+    mBloomRejected++;
+    return false;
+}
+
+std::string ScanOperator::decodeRecord(uint32_t rowIndex){
+    const char* record = mPageBuffer.get() + mRows[rowIndex].first;
+    if(!mProjected){
+        return decodeRow(mFileId, record, mRows[rowIndex].second, mColumns);
+    }
+    std::string row = decodeColumns(mFileId, record, mTableColumns, mProjection);
+    if(mLocator){
+        int64_t locator = mCurrentPage*PAGE_SIZE + mRows[rowIndex].first;
+        row.append(reinterpret_cast<const char*>(&locator), sizeof(locator));
+    }
+    return row;
+}
+
+void ScanOperator::appendLocators(Batch& batch, const std::vector< std::pair< uint32_t, uint32_t > >& rows, uint32_t begin, uint32_t end){
+    if(!mLocator){
+        return;
+    }
+    std::vector< int64_t >& locators = batch.columns.back().ints;
+    for(uint32_t i=begin; i<end; i++){
+        locators.push_back(mCurrentPage*PAGE_SIZE + rows[i].first);
+    }
+}
+
+bool ScanOperator::next(Row& row){
+    while(true){
+        while(mRowIndex >= mRows.size()){
+            if(!loadNextPage()){
+                return false;
+            }
+        }
+
+        uint32_t rowIndex = mRowIndex++;
+        if(mSlotted){
+            row.bytes = decodeRecord(rowIndex);
+            if(!mBloomFilter || passesBloomFilter(row.bytes.c_str(), mColumns, mBloomColumns)){
+                return true;
+            }
+        } else if(!mBloomFilter || passesBloomFilter(mPageBuffer.get() + mRows[rowIndex].first, mTableColumns, mBloomTableColumns)){
+            // Fixed width records are already in the decoded format, so keys are checked before decoding
+            row.bytes = decodeRecord(rowIndex);
+            return true;
+        }
+    }
+}
+
+bool ScanOperator::nextBatch(Batch& batch){
+    initBatch(batch, mColumns);
+    while(batch.size < BATCH_SIZE){
+        if(mRowIndex >= mRows.size()){
+            if(!loadNextPage()){
+                break;
+            }
+            continue;
+        }
+
+        if(mBloomFilter){
+            // Only rows passing the filter are decoded
+            std::vector< std::pair< uint32_t, uint32_t > > passing;
+            for(; mRowIndex < mRows.size() && batch.size + passing.size() < BATCH_SIZE; mRowIndex++){
+                if(mSlotted){
+                    std::string row = decodeRecord(mRowIndex);
+                    if(passesBloomFilter(row.c_str(), mColumns, mBloomColumns)){
+                        appendRowToBatch(batch, row, mColumns);
+                    }
+                } else if(passesBloomFilter(mPageBuffer.get() + mRows[mRowIndex].first, mTableColumns, mBloomTableColumns)){
+                    passing.push_back(mRows[mRowIndex]);
+                }
+            }
+            decodePageIntoBatch(batch, mPageBuffer.get(), passing, 0, passing.size(), mTableColumns, mProjection);
+            appendLocators(batch, passing, 0, passing.size());
+            continue;
+        }
+
+        uint32_t end = std::min((uint32_t)mRows.size(), mRowIndex + (BATCH_SIZE - batch.size));
+        if(mSlotted){
+            for(uint32_t i=mRowIndex; i<end; i++){
+                appendRowToBatch(batch, decodeRecord(i), mColumns);
+            }
+        } else {
+            decodePageIntoBatch(batch, mPageBuffer.get(), mRows, mRowIndex, end, mTableColumns, mProjection);
+            appendLocators(batch, mRows, mRowIndex, end);
+        }
+        mRowIndex = end;
+    }
+    return batch.size > 0 && !mFailed;
+}
+
+void ScanOperator::close(){
+    if(DEBUG == true && mBloomFilter){
+        std::cout << "Bloom filter skipped " << mBloomRejected << " rows of file " << mFileId << std::endl;
+    }
+    mPageBuffer.reset();
+}
+
+uint64_t ScanOperator::estimateRows(){
+    std::unique_ptr<char[]> metadataBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    if(!readVisiblePage(metadataBuffer.get(), mFileId, 0, mSnapshot)){
+        return 0;
+    }
+    TableStats stats;
+    if(readTableStats(metadataBuffer.get(), stats)){
+        return stats.rowCount;
+    }
+    uint64_t totBytes;
+    memcpy(&totBytes, metadataBuffer.get(), sizeof(totBytes));
+    // Records of slotted pages can be shorter than the row size, so this can be low for them
+    return totBytes / mRowSize;
+}
+
+uint64_t ScanOperator::getPageCount(){
+    std::unique_ptr<char[]> metadataBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    if(!readVisiblePage(metadataBuffer.get(), mFileId, 0, mSnapshot)){
+        return 0;
+    }
+    uint64_t totPages;
+    memcpy(&totPages, metadataBuffer.get() + sizeof(uint64_t), sizeof(totPages));
+    return totPages;
+}
+
+bool ScanOperator::pushBloomFilter(std::shared_ptr<const BloomFilter> filter, const std::vector< uint32_t >& columns){
+    mBloomFilter = filter;
+    mBloomColumns = columns;
+    mBloomTableColumns.clear();
+    for(int i=0; i<columns.size(); i++){
+        mBloomTableColumns.push_back(mProjection[columns[i]]);
+    }
+    return true;
+}
+
+SharedScan::SharedScan(uint64_t fileId, uint32_t consumers, const std::vector< uint32_t >& projection, bool locator, const Snapshot* snapshot) : mScan(fileId, ""){
+    mProjection = projection;
+    mLocator = locator;
+    mScan.setProjection(mProjection, mLocator);
+    mScan.setSnapshot(snapshot);
+    mPositions.assign(consumers, 0);
+    mClosed.assign(consumers, false);
+    mOwnScans.resize(consumers);
+}
+
+void SharedScan::trimRows(){
+    // Rows before the slowest consumer still reading the shared rows are dropped
+    uint64_t slowest = mFirstRow + mRows.size();
+    for(int i=0; i<mPositions.size(); i++){
+        if(!mClosed[i] && !mOwnScans[i]){
+            slowest = std::min(slowest, mPositions[i]);
+        }
+    }
+    while(mFirstRow < slowest){
+        mRowsBytes -= getRowMemory(mRows.front());
+        mRows.pop_front();
+        mFirstRow++;
+    }
+}
+
+bool SharedScan::next(uint32_t consumer, Row& row){
+    if(mClosed[consumer]){
+        return false;
+    }
+
+    if(mOwnScans[consumer]){
+        return mOwnScans[consumer]->next(row);
+    }
+
+    uint64_t& position = mPositions[consumer];
+    if(position < mFirstRow + mRows.size()){
+        row = mRows[position - mFirstRow];
+        position++;
+        if(position == mFirstRow + 1){
+            trimRows();
+        }
+        return true;
+    }
+
+    // The consumer is ahead of the others. Read the next row of the table
+    if(mEnded){
+        return false;
+    }
+    if(!mOpen){
+        if(!mScan.open()){
+            mEnded = true;
+            return false;
+        }
+        mOpen = true;
+    }
+    if(!mScan.next(row)){
+        mScan.close();
+        mEnded = true;
+        return false;
+    }
+    position++;
+
+    bool needed = false;
+    for(int i=0; i<mPositions.size(); i++){
+        needed = needed || (!mClosed[i] && !mOwnScans[i] && mPositions[i] < position);
+    }
+    if(!needed){
+        trimRows();
+        mFirstRow++;
+        return true;
+    }
+    mRows.push_back(row);
+    mRowsBytes += getRowMemory(row);
+
+    if(mRowsBytes > SHARED_SCAN_MEMORY_BUDGET){
+        // Consumers behind this one scan the table themselves
+        for(int i=0; i<mPositions.size(); i++){
+            if(mClosed[i] || mOwnScans[i] || mPositions[i] >= position){
+                continue;
+            }
+            mOwnScans[i] = std::make_unique<ScanOperator>(mScan.getFileId(), "");
+            mOwnScans[i]->setProjection(mProjection, mLocator);
+            mOwnScans[i]->setSnapshot(mScan.getSnapshot());
+            if(!mOwnScans[i]->open()){
+                return false;
+            }
+            Row skipped;
+            for(uint64_t j=0; j<mPositions[i] && mOwnScans[i]->next(skipped); j++);
+
+            if(DEBUG == true){
+                std::cout << "Shared scan of file " << mScan.getFileId() << " split after " << position << " rows" << std::endl;
+            }
+        }
+        trimRows();
+    }
+    return true;
+}
+
+void SharedScan::close(uint32_t consumer){
+    mClosed[consumer] = true;
+    if(mOwnScans[consumer]){
+        mOwnScans[consumer]->close();
+    }
+    trimRows();
+    for(int i=0; i<mClosed.size(); i++){
+        if(!mClosed[i]){
+            return;
+        }
+    }
+    if(mOpen && !mEnded){
+        mScan.close();
+    }
+    mEnded = true;
+}
+
+bool SharedScan::failed(){
+    for(int i=0; i<mOwnScans.size(); i++){
+        if(mOwnScans[i] && mOwnScans[i]->failed()){
+            return true;
+        }
+    }
+    return mScan.failed();
+}
+
+SharedScanOperator::SharedScanOperator(std::shared_ptr<SharedScan> scan, uint32_t consumer, const std::string& tableName){
+    mScan = scan;
+    mConsumer = consumer;
+    mTableName = tableName;
+    mColumns = mScan->getColumns();
+}
+
+FilterOperator::FilterOperator(std::unique_ptr<Operator> child, const std::vector< condition >& conditions){
+    mChild = std::move(child);
+    mColumns = mChild->getColumns();
+    mTableName = mChild->getTableName();
+    mConditions = conditions;
+
+    // Use the column names of the child so that table.column can be used in conditions
+    for(int i=0; i<mConditions.size(); i++){
+        int32_t index = mChild->findColumn(mConditions[i].columnName);
+        if(index >= 0){
+            mConditions[i].columnName = mColumns[index][0];
+        }
+        mConditionColumns.push_back(index);
+    }
+}
+
+bool FilterOperator::open(){
+    return mChild->open();
+}
+
+bool FilterOperator::next(Row& row){
+    while(mChild->next(row)){
+        int check = verifyConditions(row.bytes.c_str(), mColumns, mConditions, 0);
+        if(check == 1){
+            return true;
+        } else if(check == -1){
+            Logger::logError("Comparisons not in correct format");
+            mFailed = true;
+            return false;
+        }
+    }
+    return false;
+}
+
+bool FilterOperator::nextBatch(Batch& batch){
+    while(mChild->nextBatch(batch)){
+        for(int i=0; i<mConditions.size() && !batch.selection.empty(); i++){
+            if(mConditionColumns[i] < 0 || !filterBatch(batch, mConditions[i], mConditionColumns[i])){
+                Logger::logError("Comparisons not in correct format");
+                mFailed = true;
+                return false;
+            }
+        }
+        if(!batch.selection.empty()){
+            return true;
+        }
+    }
+    return false;
+}
+
+void FilterOperator::close(){
+    mChild->close();
+}
+
+double getSelectivity(COMPARISON operation){
+    return operation == COMPARISON::EQUAL ? 0.1 : 1.0/3;
+}
+
+uint64_t FilterOperator::estimateRows(){
+    double rows = mChild->estimateRows();
+    for(int i=0; i<mConditions.size(); i++){
+        rows *= getSelectivity(mConditions[i].operation);
+    }
+    return (uint64_t)rows;
+}
+
+ParallelScanOperator::ParallelScanOperator(std::unique_ptr<ScanOperator> scan, const std::vector< condition >& conditions, bool preserveOrder){
+    mScan = std::move(scan);
+    mColumns = mScan->getColumns();
+    mTableName = mScan->getTableName();
+    mConditions = conditions;
+    mPreserveOrder = preserveOrder;
+
+    // Use the column names of the scan so that table.column can be used in conditions
+    for(int i=0; i<mConditions.size(); i++){
+        int32_t index = mScan->findColumn(mConditions[i].columnName);
+        if(index >= 0){
+            mConditions[i].columnName = mColumns[index][0];
+        }
+        mConditionColumns.push_back(index);
+    }
+}
+
+bool ParallelScanOperator::open(){
+    std::unique_ptr<char[]> metadataBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    if(!readVisiblePage(metadataBuffer.get(), mScan->getFileId(), 0, mScan->getSnapshot())){
+        Logger::logError("Error in reading table metadata");
+        mFailed = true;
+        return false;
+    }
+    memcpy(&mTotPages, metadataBuffer.get() + sizeof(uint64_t), sizeof(mTotPages));
+    mMorselCount = (mTotPages + MORSEL_PAGES - 1) / MORSEL_PAGES;
+    mNextMorsel = 0;
+    mBloomRejected = 0;
+    mOutputs.clear();
+    mOutput = 0;
+    mOutputBatch = 0;
+    mBatch.selection.clear();
+    mBatchRow = 0;
+    mOpen = true;
+    return true;
+}
+
+bool ParallelScanOperator::runWave(){
+    WorkerPool& pool = WorkerPool::getPool();
+    uint32_t workers = pool.getWorkerCount();
+    uint64_t firstMorsel = mNextMorsel;
+    uint64_t morsels = std::min(mMorselCount - firstMorsel, (uint64_t)workers * MORSELS_PER_WORKER);
+    mNextMorsel += morsels;
+
+    mOutputs.clear();
+    mOutputs.resize(mPreserveOrder ? morsels : workers);
+    mOutput = 0;
+    mOutputBatch = 0;
+
+    // Workers only write to state of their own (or of their morsel)
+    std::vector< uint64_t > rejected(workers, 0);
+    bool succeeded = pool.parallelFor(morsels, [&](uint64_t task, uint32_t worker){
+        uint64_t morsel = firstMorsel + task;
+        ScanOperator scan(*mScan, morsel*MORSEL_PAGES + 1, std::min(mTotPages, (morsel + 1)*MORSEL_PAGES));
+        std::vector< Batch >& output = mOutputs[mPreserveOrder ? task : worker];
+        if(!scan.open()){
+            return false;
+        }
+
+        Batch batch;
+        while(scan.nextBatch(batch)){
+            for(int i=0; i<mConditions.size() && !batch.selection.empty(); i++){
+                if(mConditionColumns[i] < 0 || !filterBatch(batch, mConditions[i], mConditionColumns[i])){
+                    Logger::logError("Comparisons not in correct format");
+                    return false;
+                }
+            }
+            if(!batch.selection.empty()){
+                output.push_back(std::move(batch));
+            }
+        }
+        rejected[worker] += scan.getBloomRejected();
+        return !scan.failed();
+    });
+
+    for(uint32_t i=0; i<workers; i++){
+        mBloomRejected += rejected[i];
+    }
+    mFailed = mFailed || !succeeded;
+    return !mFailed;
+}
+
+bool ParallelScanOperator::produceParallel(const std::function< bool(Batch& batch, uint32_t worker) >& consume){
+    WorkerPool& pool = WorkerPool::getPool();
+    uint32_t workers = pool.getWorkerCount();
+    uint64_t firstMorsel = mNextMorsel;
+    mNextMorsel = mMorselCount;
+
+    std::vector< uint64_t > rejected(workers, 0);
+    std::atomic<bool> scanFailed{false};
+    bool succeeded = pool.parallelFor(mMorselCount - firstMorsel, [&](uint64_t task, uint32_t worker){
+        uint64_t morsel = firstMorsel + task;
+        ScanOperator scan(*mScan, morsel*MORSEL_PAGES + 1, std::min(mTotPages, (morsel + 1)*MORSEL_PAGES));
+        if(!scan.open()){
+            scanFailed = true;
+            return false;
+        }
+
+        Batch batch;
+        while(scan.nextBatch(batch)){
+            for(int i=0; i<mConditions.size() && !batch.selection.empty(); i++){
+                if(mConditionColumns[i] < 0 || !filterBatch(batch, mConditions[i], mConditionColumns[i])){
+                    Logger::logError("Comparisons not in correct format");
+                    scanFailed = true;
+                    return false;
+                }
+            }
+            if(!batch.selection.empty() && !consume(batch, worker)){
+                return false;
+            }
+        }
+        rejected[worker] += scan.getBloomRejected();
+        scanFailed = scanFailed || scan.failed();
+        return !scan.failed();
+    });
+
+    for(uint32_t i=0; i<workers; i++){
+        mBloomRejected += rejected[i];
+    }
+    mFailed = mFailed || scanFailed;
+    return succeeded;
+}
+
+bool ParallelScanOperator::nextOutputBatch(Batch& batch){
+    while(true){
+        for(; mOutput < mOutputs.size(); mOutput++, mOutputBatch = 0){
+            if(mOutputBatch < mOutputs[mOutput].size()){
+                batch = std::move(mOutputs[mOutput][mOutputBatch++]);
+                return true;
+            }
+        }
+        if(mFailed || mNextMorsel >= mMorselCount || !runWave()){
+            return false;
+        }
+    }
+}
+
+bool ParallelScanOperator::next(Row& row){
+    while(mBatchRow >= mBatch.selection.size()){
+        if(!nextOutputBatch(mBatch)){
+            return false;
+        }
+        mBatchRow = 0;
+    }
+    row.bytes = gatherRow(mBatch, mBatch.selection[mBatchRow++]);
+    return true;
+}
+
+bool ParallelScanOperator::nextBatch(Batch& batch){
+    return nextOutputBatch(batch);
+}
+
+void ParallelScanOperator::close(){
+    if(!mOpen){
+        return;
+    }
+    mOpen = false;
+    if(DEBUG == true && mScan->hasBloomFilter()){
+        std::cout << "Bloom filter skipped " << mBloomRejected << " rows of file " << mScan->getFileId() << std::endl;
+    }
+    if(DEBUG == true){
+        std::cout << "Scanned " << mTotPages << " pages of file " << mScan->getFileId() << " in " << mMorselCount << " morsels" << std::endl;
+    }
+    mOutputs.clear();
+    mBatch = Batch();
+}
+
+uint64_t ParallelScanOperator::estimateRows(){
+    double rows = mScan->estimateRows();
+    for(int i=0; i<mConditions.size(); i++){
+        rows *= getSelectivity(mConditions[i].operation);
+    }
+    return (uint64_t)rows;
+}
+
+ProjectOperator::ProjectOperator(std::unique_ptr<Operator> child, const std::vector< uint32_t >& projection){
+    mChild = std::move(child);
+    mTableName = mChild->getTableName();
+    for(int i=0; i<projection.size(); i++){
+        mProjection.push_back(projection[i]);
+        mExpressions.push_back(nullptr);
+        mColumns.push_back(mChild->getColumns()[projection[i]]);
+    }
+}
+
+ProjectOperator::ProjectOperator(std::unique_ptr<Operator> child, std::vector< std::unique_ptr<Expression> > expressions, const std::vector< std::string >& names){
+    mChild = std::move(child);
+    mTableName = mChild->getTableName();
+    for(int i=0; i<expressions.size(); i++){
+        if(expressions[i]->kind == EXPRESSION::COLUMN){
+            // Columns are copied without evaluating anything
+            mProjection.push_back(expressions[i]->column);
+            mExpressions.push_back(nullptr);
+        } else {
+            mProjection.push_back(-1);
+            mExpressions.push_back(std::move(expressions[i]));
+        }
+        std::string type = mProjection[i] >= 0 ? mChild->getColumns()[mProjection[i]][1] : mExpressions[i]->type;
+        mColumns.push_back({names[i], type});
+    }
+}
+
+bool ProjectOperator::next(Row& row){
+    Row childRow;
+    if(!mChild->next(childRow)){
+        return false;
+    }
+    std::vector< uint32_t > offsets = getColumnOffsets(childRow.bytes.c_str(), mChild->getColumns());
+    row.bytes.assign(childRow.bytes, 0, sizeof(uint64_t));
+    for(int i=0; i<mProjection.size(); i++){
+        int32_t index = mProjection[i];
+        if(index >= 0){
+            row.bytes.append(childRow.bytes, offsets[index], offsets[index+1] - offsets[index]);
+            continue;
+        }
+
+        bool valid;
+        if(getTypeFromString(mExpressions[i]->type) == TYPE::INT){
+            int64_t value;
+            valid = evaluateInt(*mExpressions[i], childRow.bytes.c_str(), offsets, value);
+            row.bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        } else {
+            double value;
+            valid = evaluateFloat(*mExpressions[i], childRow.bytes.c_str(), offsets, value);
+            row.bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+        if(!valid){
+            Logger::logError("Division by zero");
+            mFailed = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ProjectOperator::projectBatch(Batch& childBatch, Batch& batch){
+    batch.columns.resize(mColumns.size());
+    for(int i=0; i<mProjection.size(); i++){
+        if(mProjection[i] < 0 && !evaluateBatch(*mExpressions[i], childBatch, batch.columns[i])){
+            return false;
+        }
+    }
+
+    // Child columns used once are swapped instead of copied, so that their memory is reused by the next batches
+    std::vector< uint32_t > uses(childBatch.columns.size(), 0);
+    for(int i=0; i<mProjection.size(); i++){
+        if(mProjection[i] >= 0){
+            uses[mProjection[i]]++;
+        }
+    }
+    for(int i=0; i<mProjection.size(); i++){
+        int32_t index = mProjection[i];
+        if(index < 0){
+            continue;
+        }
+        if(--uses[index] == 0){
+            std::swap(batch.columns[i], childBatch.columns[index]);
+        } else {
+            batch.columns[i] = childBatch.columns[index];
+        }
+    }
+
+    batch.ids.swap(childBatch.ids);
+    batch.selection.swap(childBatch.selection);
+    batch.size = childBatch.size;
+    return true;
+}
+
+bool ProjectOperator::nextBatch(Batch& batch){
+    if(!mChild->nextBatch(mChildBatch)){
+        return false;
+    }
+    if(!projectBatch(mChildBatch, batch)){
+        Logger::logError("Division by zero");
+        mFailed = true;
+        return false;
+    }
+    return true;
+}
+
+bool ProjectOperator::produceParallel(const std::function< bool(Batch& batch, uint32_t worker) >& consume){
+    // Projected batches of every worker
+    std::vector< Batch > batches(WorkerPool::getPool().getWorkerCount());
+    std::atomic<bool> divided{false};
+    bool produced = mChild->produceParallel([&](Batch& childBatch, uint32_t worker){
+        if(!projectBatch(childBatch, batches[worker])){
+            // Logged once, by the first worker dividing by zero
+            if(!divided.exchange(true)){
+                Logger::logError("Division by zero");
+            }
+            return false;
+        }
+        return consume(batches[worker], worker);
+    });
+    mFailed = mFailed || divided;
+    return produced;
+}
+
+MaterializeOperator::MaterializeOperator(std::unique_ptr<Operator> child, const std::vector< DeferredColumns >& deferred, const Snapshot* snapshot){
+    mChild = std::move(child);
+    mSnapshot = snapshot;
+    mColumns = mChild->getColumns();
+    mTableName = mChild->getTableName();
+
+    std::unique_ptr<char[]> metadataBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    for(int i=0; i<deferred.size(); i++){
+        int32_t locatorColumn = mChild->findColumn(deferred[i].tableName + "." + LOCATOR_COLUMN);
+        if(locatorColumn < 0){
+            continue;
+        }
+
+        Source source;
+        source.fileId = deferred[i].fileId;
+        source.tableColumns = Database::getColumnsOfTable(source.fileId, metadataBuffer.get());
+        source.locatorColumn = locatorColumn;
+        for(int j=0; j<deferred[i].columns.size(); j++){
+            const std::vector< std::string >& column = source.tableColumns[deferred[i].columns[j]];
+            // Scans shared by several names of a table can already read the column
+            if(mChild->findColumn(deferred[i].tableName + "." + column[0]) >= 0){
+                continue;
+            }
+            source.columns.push_back(deferred[i].columns[j]);
+            mColumns.push_back(column);
+            if(mTableName.empty()){
+                mColumns.back()[0] = deferred[i].tableName + "." + column[0];
+            }
+        }
+        source.slotted = isVariableLength(source.tableColumns);
+        std::vector< uint32_t > offsets;
+        uint32_t offset = sizeof(uint64_t);
+        for(int j=0; j<source.tableColumns.size(); j++){
+            offsets.push_back(offset);
+            offset += getTypeSize(source.tableColumns[j][1]);
+        }
+        for(int j=0; j<source.columns.size(); j++){
+            source.offsets.push_back(offsets[source.columns[j]]);
+            source.sizes.push_back(getTypeSize(source.tableColumns[source.columns[j]][1]));
+        }
+        if(source.columns.size()){
+            mSources.push_back(source);
+        }
+    }
+}
+
+const char* MaterializeOperator::getPage(uint64_t fileId, uint64_t pageNumber){
+    PageKey key(fileId, pageNumber);
+    // Rows of one table page usually follow each other
+    if(mLastPage && mPageOrder.front() == key){
+        return mLastPage;
+    }
+    auto page = mPages.find(key);
+    if(page != mPages.end()){
+        mPageOrder.splice(mPageOrder.begin(), mPageOrder, page->second.second);
+        mLastPage = page->second.first.get();
+        return mLastPage;
+    }
+
+    std::unique_ptr<char[]> buffer;
+    if(mPages.size() >= std::max((uint64_t)1, MATERIALIZE_MEMORY_BUDGET / PAGE_SIZE)){
+        // Reuse the buffer of the least recently used page
+        auto evicted = mPages.find(mPageOrder.back());
+        buffer = std::move(evicted->second.first);
+        mPages.erase(evicted);
+        mPageOrder.pop_back();
+    } else {
+        buffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    }
+
+    mLastPage = nullptr;
+    if(!readVisiblePage(buffer.get(), fileId, pageNumber, mSnapshot)){
+        Logger::logError("Error in reading page "+std::to_string(pageNumber)+" of file "+std::to_string(fileId));
+        return nullptr;
+    }
+    mPageReads++;
+
+    mPageOrder.push_front(key);
+    mLastPage = buffer.get();
+    mPages[key] = std::make_pair(std::move(buffer), mPageOrder.begin());
+    return mLastPage;
+}
+
+const char* MaterializeOperator::getRecord(const Source& source, int64_t locator){
+    const char* page = getPage(source.fileId, locator / PAGE_SIZE);
+    if(!page){
+        mFailed = true;
+        return nullptr;
+    }
+    return page + locator % PAGE_SIZE;
+}
+
+bool MaterializeOperator::next(Row& row){
+    if(!mChild->next(row)){
+        return false;
+    }
+
+    std::vector< uint32_t > offsets = getColumnOffsets(row.bytes.c_str(), mChild->getColumns());
+    std::string values;
+    for(int i=0; i<mSources.size(); i++){
+        const Source& source = mSources[i];
+        int64_t locator;
+        memcpy(&locator, row.bytes.c_str() + offsets[source.locatorColumn], sizeof(locator));
+
+        const char* record = getRecord(source, locator);
+        if(!record){
+            return false;
+        }
+        if(source.slotted){
+            std::string decoded = decodeColumns(source.fileId, record, source.tableColumns, source.columns);
+            values.append(decoded, sizeof(uint64_t), std::string::npos);
+            continue;
+        }
+        for(int j=0; j<source.columns.size(); j++){
+            values.append(record + source.offsets[j], source.sizes[j]);
+        }
+    }
+    row.bytes += values;
+    return true;
+}
+
+bool MaterializeOperator::nextBatch(Batch& batch){
+    if(!mChild->nextBatch(batch)){
+        return false;
+    }
+
+    uint32_t column = mChild->getColumns().size();
+    batch.columns.resize(mColumns.size());
+    for(int i=0; i<mSources.size(); i++){
+        const Source& source = mSources[i];
+        // Copied since columns are added to the batch
+        std::vector< int64_t > locators = batch.columns[source.locatorColumn].ints;
+
+        for(int j=0; j<source.columns.size(); j++){
+            ColumnVector& values = batch.columns[column + j];
+            values.type = mColumns[column + j][1];
+            values.kind = getTypeFromString(values.type);
+            if(values.kind == TYPE::INT){
+                values.ints.resize(batch.size);
+            } else if(values.kind == TYPE::FLOAT){
+                values.floats.resize(batch.size);
+            } else {
+                values.fields.resize(batch.size);
+            }
+        }
+
+        for(uint32_t k=0; k<batch.selection.size(); k++){
+            uint32_t row = batch.selection[k];
+            const char* record = getRecord(source, locators[row]);
+            if(!record){
+                return false;
+            }
+
+            std::string decoded;
+            std::vector< uint32_t > decodedOffsets;
+            const std::vector< uint32_t >* offsets = &source.offsets;
+            if(source.slotted){
+                decoded = decodeColumns(source.fileId, record, source.tableColumns, source.columns);
+                record = decoded.c_str();
+                std::vector< std::vector< std::string > > columns(mColumns.begin() + column, mColumns.begin() + column + source.columns.size());
+                decodedOffsets = getColumnOffsets(record, columns);
+                offsets = &decodedOffsets;
+            }
+
+            for(int j=0; j<source.columns.size(); j++){
+                ColumnVector& values = batch.columns[column + j];
+                uint32_t offset = (*offsets)[j];
+                if(values.kind == TYPE::INT){
+                    memcpy(&values.ints[row], record + offset, sizeof(int64_t));
+                } else if(values.kind == TYPE::FLOAT){
+                    memcpy(&values.floats[row], record + offset, sizeof(double));
+                } else if(source.slotted){
+                    values.fields[row].assign(record + offset, (*offsets)[j+1] - offset);
+                } else {
+                    values.fields[row].assign(record + offset, source.sizes[j]);
+                }
+            }
+        }
+        column += source.columns.size();
+    }
+    return true;
+}
+
+void MaterializeOperator::close(){
+    if(DEBUG == true){
+        std::cout << "Late materialization read " << mPageReads << " pages" << std::endl;
+    }
+    mPages.clear();
+    mPageOrder.clear();
+    mLastPage = nullptr;
+    mChild->close();
+}
+
+int compareSortValues(const SortValue& lValue, const SortValue& rValue, TYPE type){
+    if(type == TYPE::INT){
+        return (lValue.intValue > rValue.intValue) - (lValue.intValue < rValue.intValue);
+    } else if(type == TYPE::FLOAT){
+        return (lValue.floatValue > rValue.floatValue) - (lValue.floatValue < rValue.floatValue);
+    }
+    int result = lValue.stringValue.compare(rValue.stringValue);
+    return (result > 0) - (result < 0);
+}
+
+SortValue getSortValue(const Row& row, const std::vector< uint32_t >& offsets, const std::vector< std::vector< std::string > >& columns, uint32_t index){
+    SortValue value;
+    TYPE type = getTypeFromString(columns[index][1]);
+    if(type == TYPE::INT){
+        memcpy(&value.intValue, row.bytes.c_str() + offsets[index], sizeof(value.intValue));
+    } else if(type == TYPE::FLOAT){
+        memcpy(&value.floatValue, row.bytes.c_str() + offsets[index], sizeof(value.floatValue));
+    } else {
+        // Compare without the enclosing quotes
+        value.stringValue = getValueFromBytes(row.bytes.c_str(), columns[index][1], offsets[index], offsets[index+1]);
+        value.stringValue = value.stringValue.substr(1, value.stringValue.length() - 2);
+    }
+    return value;
+}
+
+/**
+ * @brief Append bytes to a normalized sort key. Bytes of descending columns are inverted, which reverses their order
+ */
+void appendKeyBytes(std::string& key, const unsigned char* bytes, uint32_t length, bool descending){
+    for(uint32_t i=0; i<length; i++){
+        key += (char)(descending ? ~bytes[i] : bytes[i]);
+    }
+}
+
+void appendIntKey(std::string& key, int64_t value, bool descending){
+    // Flipping the sign bit puts negative values first. Bytes are big endian
+    uint64_t bits = (uint64_t)value ^ (1ULL << 63);
+    unsigned char bytes[sizeof(bits)];
+    for(int i=0; i<sizeof(bits); i++){
+        bytes[i] = bits >> (56 - 8*i);
+    }
+    appendKeyBytes(key, bytes, sizeof(bits), descending);
+}
+
+void appendFloatKey(std::string& key, double value, bool descending){
+    // -0.0 and 0.0 are equal. Negative values have every bit flipped, other values the sign bit
+    if(value == 0){
+        value = 0;
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = (bits >> 63) ? ~bits : bits ^ (1ULL << 63);
+    unsigned char bytes[sizeof(bits)];
+    for(int i=0; i<sizeof(bits); i++){
+        bytes[i] = bits >> (56 - 8*i);
+    }
+    appendKeyBytes(key, bytes, sizeof(bits), descending);
+}
+
+void appendStringKey(std::string& key, const std::string& value, bool descending){
+    // 0 bytes are escaped as 0 255 and the value ends with 0 0, so a value sorts before its extensions
+    std::string bytes;
+    for(int i=0; i<value.length(); i++){
+        bytes += value[i];
+        if(value[i] == 0){
+            bytes += (char)255;
+        }
+    }
+    bytes.append(2, 0);
+    appendKeyBytes(key, reinterpret_cast<const unsigned char*>(bytes.c_str()), bytes.length(), descending);
+}
+
+/**
+ * @brief First 8 bytes of a normalized sort key as a big endian integer. Shorter keys are padded with 0 bytes
+ */
+inline uint64_t getKeyPrefix(const std::string& key){
+    uint64_t prefix = 0;
+    for(int i=0; i<sizeof(prefix); i++){
+        prefix = (prefix << 8) | (i < key.length() ? (unsigned char)key[i] : 0);
+    }
+    return prefix;
+}
+
+SortOperator::SortOperator(std::unique_ptr<Operator> child, const std::vector< uint32_t >& sortColumns, const std::vector< bool >& descending){
+    mChild = std::move(child);
+    mColumns = mChild->getColumns();
+    mTableName = mChild->getTableName();
+    mSortColumns = sortColumns;
+    mDescending = descending;
+    for(int i=0; i<mSortColumns.size(); i++){
+        mSortTypes.push_back(getTypeFromString(mColumns[mSortColumns[i]][1]));
+    }
+}
+
+void SortOperator::getSortKey(const Row& row, std::string& key){
+    std::vector< uint32_t > offsets = getColumnOffsets(row.bytes.c_str(), mColumns);
+    key.clear();
+    for(int i=0; i<mSortColumns.size(); i++){
+        const char* value = row.bytes.c_str() + offsets[mSortColumns[i]];
+        if(mSortTypes[i] == TYPE::INT){
+            int64_t intValue;
+            memcpy(&intValue, value, sizeof(intValue));
+            appendIntKey(key, intValue, mDescending[i]);
+        } else if(mSortTypes[i] == TYPE::FLOAT){
+            double floatValue;
+            memcpy(&floatValue, value, sizeof(floatValue));
+            appendFloatKey(key, floatValue, mDescending[i]);
+        } else {
+            // Compare without the enclosing quotes
+            std::string stringValue = getValueFromBytes(row.bytes.c_str(), mColumns[mSortColumns[i]][1], offsets[mSortColumns[i]], offsets[mSortColumns[i]+1]);
+            appendStringKey(key, stringValue.substr(1, stringValue.length() - 2), mDescending[i]);
+        }
+    }
+}
+
+void SortOperator::getBatchSortKey(const Batch& batch, uint32_t row, std::string& key){
+    key.clear();
+    for(int i=0; i<mSortColumns.size(); i++){
+        const ColumnVector& column = batch.columns[mSortColumns[i]];
+        if(column.kind == TYPE::INT){
+            appendIntKey(key, column.ints[row], mDescending[i]);
+        } else if(column.kind == TYPE::FLOAT){
+            appendFloatKey(key, column.floats[row], mDescending[i]);
+        } else {
+            std::string stringValue = getValueFromBytes(column.fields[row].c_str(), column.type, 0, column.fields[row].size());
+            appendStringKey(key, stringValue.substr(1, stringValue.length() - 2), mDescending[i]);
+        }
+    }
+}
+
+bool SortOperator::rowBefore(const SortedRow& lRow, const SortedRow& rRow){
+    int result = lRow.key.compare(rRow.key);
+    return result < 0 || (result == 0 && lRow.sequence < rRow.sequence);
+}
+
+bool SortOperator::dropsRow(const SortedRow& sortedRow){
+    // Once the heap is full a row has to come before the last kept row to be kept
+    if(mHeap && mRows.size() == mLimit && (mLimit == 0 || !rowBefore(sortedRow, mRows.front()))){
+        mDropped++;
+        return true;
+    }
+    return false;
+}
+
+bool SortOperator::addRow(SortedRow& sortedRow){
+    auto before = [&](const SortedRow& lRow, const SortedRow& rRow){
+        return rowBefore(lRow, rRow);
+    };
+
+    if(mHeap && mRows.size() == mLimit){
+        std::pop_heap(mRows.begin(), mRows.end(), before);
+        mRowsBytes -= getRowMemory(mRows.back().row) + mRows.back().key.capacity() + sizeof(SortEntry);
+        mRows.pop_back();
+        mDropped++;
+    }
+
+    mRowsBytes += getRowMemory(sortedRow.row) + sortedRow.key.capacity() + sizeof(SortEntry);
+    mRows.push_back(std::move(sortedRow));
+    if(mHeap){
+        std::push_heap(mRows.begin(), mRows.end(), before);
+    }
+
+    if(mRowsBytes > SORT_MEMORY_BUDGET){
+        // The kept rows don't fit in memory. They are sorted as usual instead, the limit is applied when producing rows
+        mHeap = false;
+        return writeRun();
+    }
+    return true;
+}
+
+/**
+ * @brief Stable least significant digit radix sort of sort entries on their key prefix
+ */
+template<typename Entry>
+void radixSortPrefixes(std::vector< Entry >& entries){
+    std::vector< Entry > buffer(entries.size());
+    for(int shift=0; shift<64; shift+=8){
+        uint64_t counts[256] = {0};
+        for(int i=0; i<entries.size(); i++){
+            counts[(entries[i].prefix >> shift) & 255]++;
+        }
+        // A byte shared by every entry doesn't reorder them
+        if(counts[(entries[0].prefix >> shift) & 255] == entries.size()){
+            continue;
+        }
+        uint64_t position = 0;
+        for(int b=0; b<256; b++){
+            uint64_t count = counts[b];
+            counts[b] = position;
+            position += count;
+        }
+        for(int i=0; i<entries.size(); i++){
+            buffer[counts[(entries[i].prefix >> shift) & 255]++] = entries[i];
+        }
+        entries.swap(buffer);
+    }
+}
+
+void SortOperator::sortRows(){
+    mOrder.resize(mRows.size());
+    for(uint32_t i=0; i<mRows.size(); i++){
+        mOrder[i].prefix = getKeyPrefix(mRows[i].key);
+        mOrder[i].row = i;
+    }
+
+    auto before = [&](const SortEntry& lEntry, const SortEntry& rEntry){
+        if(lEntry.prefix != rEntry.prefix){
+            return lEntry.prefix < rEntry.prefix;
+        }
+        return rowBefore(mRows[lEntry.row], mRows[rEntry.row]);
+    };
+
+    // Rows of a top-N heap aren't in input order, so the radix sort wouldn't be stable for them
+    if(mHeap || mRows.size() < RADIX_SORT_MIN_ROWS){
+        std::sort(mOrder.begin(), mOrder.end(), before);
+        return;
+    }
+
+    // Rows with the same prefix stay in input order. Only longer keys need another look
+    radixSortPrefixes(mOrder);
+    for(uint32_t i=0; i<mOrder.size(); ){
+        uint32_t j = i + 1;
+        while(j < mOrder.size() && mOrder[j].prefix == mOrder[i].prefix){
+            j++;
+        }
+        if(j - i > 1 && mRows[mOrder[i].row].key.length() > sizeof(uint64_t)){
+            std::sort(mOrder.begin() + i, mOrder.begin() + j, before);
+        }
+        i = j;
+    }
+}
+
+bool SortOperator::writeRun(){
+    sortRows();
+
+    uint64_t fileId = createSpillFile(mColumns);
+    if(!fileId){
+        return false;
+    }
+    mRunFiles.push_back(fileId);
+
+    ResultAppender appender(fileId, mColumns);
+    if(!appender.open()){
+        return false;
+    }
+    for(int i=0; i<mOrder.size(); i++){
+        if(!appender.append(mRows[mOrder[i].row].row.bytes, true)){
+            return false;
+        }
+    }
+    if(!appender.close()){
+        return false;
+    }
+
+    if(DEBUG == true){
+        std::cout << "Wrote sorted run of " << mRows.size() << " rows to file " << fileId << std::endl;
+    }
+
+    std::vector< SortedRow >().swap(mRows);
+    std::vector< SortEntry >().swap(mOrder);
+    mRowsBytes = 0;
+    return true;
+}
+
+bool SortOperator::runBefore(uint32_t lRun, uint32_t rRun){
+    // Ended runs lose against every run
+    if(mRunEnded[lRun] || mRunEnded[rRun]){
+        return !mRunEnded[lRun] && (mRunEnded[rRun] || lRun < rRun);
+    }
+    int result = mRunHeads[lRun].key.compare(mRunHeads[rRun].key);
+    // Earlier runs hold earlier rows, which keeps the sort stable
+    return result < 0 || (result == 0 && lRun < rRun);
+}
+
+bool SortOperator::advanceRun(uint32_t run){
+    Row row;
+    if(!mRuns[run]->next(row)){
+        mRunEnded[run] = true;
+        mRuns[run]->close();
+        return !mRuns[run]->failed();
+    }
+    getSortKey(row, mRunHeads[run].key);
+    mRunHeads[run].row = std::move(row);
+    return true;
+}
+
+bool SortOperator::startMerge(const std::vector< uint64_t >& runFiles){
+    uint32_t runs = runFiles.size();
+    mRuns.clear();
+    mRunHeads.assign(runs, SortedRow());
+    mRunEnded.assign(runs, false);
+    for(uint32_t i=0; i<runs; i++){
+        mRuns.push_back(std::make_unique<ScanOperator>(runFiles[i], ""));
+        if(!mRuns[i]->open() || !advanceRun(i)){
+            return false;
+        }
+    }
+
+    // Play the tournament bottom up. winners[n] is the winner at node n
+    std::vector< uint32_t > winners(2*runs);
+    mLosers.assign(runs, 0);
+    for(uint32_t i=0; i<runs; i++){
+        winners[runs + i] = i;
+    }
+    for(uint32_t n=runs-1; n>=1; n--){
+        uint32_t lRun = winners[2*n], rRun = winners[2*n+1];
+        bool left = runBefore(lRun, rRun);
+        winners[n] = left ? lRun : rRun;
+        mLosers[n] = left ? rRun : lRun;
+    }
+    mLosers[0] = runs > 1 ? winners[1] : 0;
+    return true;
+}
+
+bool SortOperator::nextMerged(Row& row){
+    if(mRuns.empty()){
+        return false;
+    }
+    uint32_t winner = mLosers[0];
+    if(mRunEnded[winner]){
+        return false;
+    }
+    row = std::move(mRunHeads[winner].row);
+    if(!advanceRun(winner)){
+        mFailed = true;
+        return false;
+    }
+
+    // Replay the matches on the path of the run to the root
+    for(uint32_t n=(mRuns.size() + winner)/2; n>=1; n/=2){
+        if(runBefore(mLosers[n], winner)){
+            std::swap(mLosers[n], winner);
+        }
+    }
+    mLosers[0] = winner;
+    return true;
+}
+
+void SortOperator::closeMerge(){
+    for(int i=0; i<mRuns.size(); i++){
+        mRuns[i]->close();
+    }
+    mRuns.clear();
+    mRunHeads.clear();
+    mRunEnded.clear();
+    mLosers.clear();
+}
+
+bool SortOperator::mergeRuns(const std::vector< uint64_t >& runFiles, uint64_t fileId){
+    ResultAppender appender(fileId, mColumns);
+    bool merged = startMerge(runFiles) && appender.open();
+    Row row;
+    uint64_t rows = 0;
+    while(merged && nextMerged(row)){
+        merged = appender.append(row.bytes, true);
+        rows++;
+    }
+    merged = merged && !mFailed && appender.close();
+    closeMerge();
+    for(int i=0; i<runFiles.size(); i++){
+        deleteSpillFile(runFiles[i]);
+    }
+
+    if(DEBUG == true && merged){
+        std::cout << "Merged " << runFiles.size() << " sorted runs into a run of " << rows << " rows" << std::endl;
+    }
+    return merged;
+}
+
+bool SortOperator::mergeRunPass(){
+    // Consecutive runs are merged together, so earlier runs still hold earlier rows (stable sort)
+    std::vector< uint64_t > runFiles;
+    runFiles.swap(mRunFiles);
+    for(uint32_t first=0; first<runFiles.size(); first+=SORT_MERGE_FAN_IN){
+        uint32_t last = std::min(first + SORT_MERGE_FAN_IN, (uint32_t)runFiles.size());
+        if(last - first == 1){
+            mRunFiles.push_back(runFiles[first]);
+            continue;
+        }
+        uint64_t fileId = createSpillFile(mColumns);
+        if(fileId){
+            mRunFiles.push_back(fileId);
+        }
+        if(!fileId || !mergeRuns(std::vector< uint64_t >(runFiles.begin() + first, runFiles.begin() + last), fileId)){
+            // Runs not merged yet are deleted by close
+            mRunFiles.insert(mRunFiles.end(), runFiles.begin() + (fileId ? last : first), runFiles.end());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SortOperator::open(){
+    if(!mChild->open()){
+        mFailed = true;
+        return false;
+    }
+
+    mRows.clear();
+    mOrder.clear();
+    mRowsBytes = 0;
+    mNextRow = 0;
+    mProduced = 0;
+    mRunFiles.clear();
+    closeMerge();
+    mHeap = mTopN;
+    mDropped = 0;
+
+    SortedRow sortedRow;
+    sortedRow.sequence = 0;
+    if(VECTORIZED_EXECUTION){
+        // Rows dropped by a top-N sort are never gathered from the batch
+        Batch batch;
+        while(mChild->nextBatch(batch)){
+            for(uint32_t i=0; i<batch.selection.size(); i++, sortedRow.sequence++){
+                getBatchSortKey(batch, batch.selection[i], sortedRow.key);
+                if(dropsRow(sortedRow)){
+                    continue;
+                }
+                sortedRow.row.bytes = gatherRow(batch, batch.selection[i]);
+                if(!addRow(sortedRow)){
+                    mFailed = true;
+                    return false;
+                }
+            }
+        }
+    } else {
+        Row row;
+        for(; mChild->next(row); sortedRow.sequence++){
+            getSortKey(row, sortedRow.key);
+            if(dropsRow(sortedRow)){
+                continue;
+            }
+            sortedRow.row = std::move(row);
+            if(!addRow(sortedRow)){
+                mFailed = true;
+                return false;
+            }
+        }
+    }
+    mChild->close();
+    if(mChild->failed()){
+        return false;
+    }
+
+    if(DEBUG == true && mTopN){
+        std::cout << "Top-N sort kept " << mRows.size() << " rows and dropped " << mDropped << std::endl;
+    }
+
+    if(mRunFiles.empty()){
+        sortRows();
+        return true;
+    }
+
+    // Remaining rows form the last run. Runs are merged while producing rows
+    if(mRows.size() && !writeRun()){
+        mFailed = true;
+        return false;
+    }
+    while(mRunFiles.size() > SORT_MERGE_FAN_IN){
+        if(!mergeRunPass()){
+            mFailed = true;
+            return false;
+        }
+    }
+    if(!startMerge(mRunFiles)){
+        mFailed = true;
+        return false;
+    }
+    return true;
+}
+
+bool SortOperator::next(Row& row){
+    if(mTopN && mProduced >= mLimit){
+        return false;
+    }
+    mProduced++;
+
+    if(mRunFiles.empty()){
+        if(mNextRow >= mOrder.size()){
+            return false;
+        }
+        row = std::move(mRows[mOrder[mNextRow++].row].row);
+        return true;
+    }
+    return nextMerged(row);
+}
+
+void SortOperator::close(){
+    mChild->close();
+    closeMerge();
+    for(int i=0; i<mRunFiles.size(); i++){
+        deleteSpillFile(mRunFiles[i]);
+    }
+    mRunFiles.clear();
+    std::vector< SortedRow >().swap(mRows);
+    std::vector< SortEntry >().swap(mOrder);
+}
+
+LimitOperator::LimitOperator(std::unique_ptr<Operator> child, uint64_t limit, uint64_t offset){
+    mChild = std::move(child);
+    mColumns = mChild->getColumns();
+    mTableName = mChild->getTableName();
+    mLimit = limit;
+    mOffset = offset;
+}
+
+bool LimitOperator::open(){
+    mSkipped = 0;
+    mProduced = 0;
+    if(!mChild->open()){
+        mFailed = true;
+        return false;
+    }
+    return true;
+}
+
+bool LimitOperator::next(Row& row){
+    while(mProduced < mLimit){
+        if(!mChild->next(row)){
+            return false;
+        }
+        if(mSkipped < mOffset){
+            mSkipped++;
+            continue;
+        }
+        mProduced++;
+        return true;
+    }
+    return false;
+}
+
+bool LimitOperator::nextBatch(Batch& batch){
+    if(mProduced >= mLimit || !mChild->nextBatch(batch)){
+        return false;
+    }
+
+    uint64_t skip = std::min(mOffset - mSkipped, (uint64_t)batch.selection.size());
+    uint64_t keep = std::min(mLimit - mProduced, batch.selection.size() - skip);
+    if(skip){
+        batch.selection.erase(batch.selection.begin(), batch.selection.begin() + skip);
+    }
+    batch.selection.resize(keep);
+    mSkipped += skip;
+    mProduced += keep;
+    return true;
+}
+
+uint64_t LimitOperator::estimateRows(){
+    uint64_t rows = mChild->estimateRows();
+    return rows > mOffset ? std::min(rows - mOffset, mLimit) : 0;
+}
+
+ValuesOperator::ValuesOperator(const std::vector< std::vector< std::string > >& columns, const std::vector< std::string >& rows){
+    mColumns = columns;
+    mRows = rows;
+}
+
+bool ValuesOperator::open(){
+    mNextRow = 0;
+    return true;
+}
+
+bool ValuesOperator::next(Row& row){
+    if(mNextRow >= mRows.size()){
+        return false;
+    }
+    row.bytes = mRows[mNextRow++];
+    return true;
+}
+
+AggregateOperator::AggregateOperator(std::unique_ptr<Operator> child, const std::vector< uint32_t >& groupColumns, const std::vector< AggregateFunction >& aggregates){
+    mChild = std::move(child);
+    mChildColumns = mChild->getColumns();
+    mTableName = mChild->getTableName();
+    mGroupColumns = groupColumns;
+    mAggregates = aggregates;
+
+    for(int i=0; i<mGroupColumns.size(); i++){
+        mColumns.push_back(mChildColumns[mGroupColumns[i]]);
+    }
+    for(int i=0; i<mAggregates.size(); i++){
+        const AggregateFunction& aggregate = mAggregates[i];
+        std::string type = aggregate.column >= 0 ? mChildColumns[aggregate.column][1] : "int";
+        mAggregateTypes.push_back(getTypeFromString(type));
+        mStringAggregates = mStringAggregates || (mAggregateTypes.back() != TYPE::INT && mAggregateTypes.back() != TYPE::FLOAT);
+        if(aggregate.function == AGGREGATE::COUNT){
+            type = "int";
+        } else if(aggregate.function == AGGREGATE::AVG){
+            type = "float";
+        }
+        mColumns.push_back({aggregate.name, type});
+    }
+}
+
+void AggregateOperator::clearGroups(GroupTable& table, bool indexed){
+    table.keyBytes.clear();
+    table.keyOffsets.assign(1, 0);
+    table.hashes.clear();
+    table.states.clear();
+    table.stringStates.clear();
+    table.slotMask = indexed ? 15 : 0;
+    table.slots.assign(indexed ? table.slotMask + 1 : 0, -1);
+    table.bytes = 0;
+}
+
+void AggregateOperator::getGroupKey(const Batch& batch, uint32_t row, std::string& key){
+    // -0.0 and 0.0 are in the same group
+    key.clear();
+    for(int j=0; j<mGroupColumns.size(); j++){
+        const ColumnVector& column = batch.columns[mGroupColumns[j]];
+        if(column.kind == TYPE::INT){
+            key.append(reinterpret_cast<const char*>(&column.ints[row]), sizeof(int64_t));
+        } else if(column.kind == TYPE::FLOAT){
+            double value = column.floats[row] == 0 ? 0 : column.floats[row];
+            key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        } else {
+            key += column.fields[row];
+        }
+    }
+}
+
+int64_t AggregateOperator::findGroup(const GroupTable& table, const char* key, uint64_t length, uint64_t hash){
+    for(uint64_t slot = hash & table.slotMask; table.slots[slot] != -1; slot = (slot + 1) & table.slotMask){
+        int32_t group = table.slots[slot];
+        if(table.hashes[group] == hash && table.keyOffsets[group + 1] - table.keyOffsets[group] == length && memcmp(&table.keyBytes[table.keyOffsets[group]], key, length) == 0){
+            return group;
+        }
+    }
+    return -1;
+}
+
+uint32_t AggregateOperator::addGroup(GroupTable& table, const char* key, uint64_t length, uint64_t hash){
+    uint32_t group = table.hashes.size();
+    table.keyBytes.append(key, length);
+    table.keyOffsets.push_back(table.keyBytes.size());
+    table.hashes.push_back(hash);
+    table.states.resize(table.states.size() + mAggregates.size(), {0, 0, 0});
+    table.bytes += length + sizeof(uint64_t) + sizeof(hash) + mAggregates.size()*sizeof(AggregateState) + 2*sizeof(int32_t);
+    if(mStringAggregates){
+        table.stringStates.resize(table.states.size());
+        table.bytes += mAggregates.size()*sizeof(std::string);
+    }
+    if(table.slots.empty()){
+        return group;
+    }
+
+    // At most half of the slots are used
+    if(2*table.hashes.size() > table.slots.size()){
+        table.slotMask = 2*table.slots.size() - 1;
+        table.slots.assign(table.slotMask + 1, -1);
+        for(uint32_t i=0; i<group; i++){
+            uint64_t slot = table.hashes[i] & table.slotMask;
+            while(table.slots[slot] != -1){
+                slot = (slot + 1) & table.slotMask;
+            }
+            table.slots[slot] = i;
+        }
+    }
+    uint64_t slot = hash & table.slotMask;
+    while(table.slots[slot] != -1){
+        slot = (slot + 1) & table.slotMask;
+    }
+    table.slots[slot] = group;
+    return group;
+}
+
+/**
+ * @brief Compare values of a string column (printable values, so padding doesn't matter)
+ */
+int compareStringValues(const std::string& lValue, const std::string& rValue, const std::string& type){
+    std::string lString = getValueFromBytes(lValue.c_str(), type, 0, lValue.size());
+    std::string rString = getValueFromBytes(rValue.c_str(), type, 0, rValue.size());
+    return lString.compare(rString);
+}
+
+void AggregateOperator::updateGroup(GroupTable& table, uint32_t group, const Batch& batch, uint32_t row){
+    AggregateState* states = &table.states[group*mAggregates.size()];
+    for(int i=0; i<mAggregates.size(); i++){
+        const AggregateFunction& aggregate = mAggregates[i];
+        AggregateState& state = states[i];
+        state.count++;
+        if(aggregate.function == AGGREGATE::COUNT){
+            continue;
+        }
+
+        const ColumnVector& column = batch.columns[aggregate.column];
+        bool first = state.count == 1;
+        switch(mAggregateTypes[i]){
+            case TYPE::INT: {
+                int64_t value = column.ints[row];
+                if(aggregate.function == AGGREGATE::SUM){
+                    state.intValue = (int64_t)((uint64_t)state.intValue + (uint64_t)value);
+                } else if(aggregate.function == AGGREGATE::AVG){
+                    state.floatValue += value;
+                } else if(first || (aggregate.function == AGGREGATE::MIN ? value < state.intValue : value > state.intValue)){
+                    state.intValue = value;
+                }
+                break;
+            }
+            case TYPE::FLOAT: {
+                double value = column.floats[row];
+                if(aggregate.function == AGGREGATE::SUM || aggregate.function == AGGREGATE::AVG){
+                    state.floatValue += value;
+                } else if(first || (aggregate.function == AGGREGATE::MIN ? value < state.floatValue : value > state.floatValue)){
+                    state.floatValue = value;
+                }
+                break;
+            }
+            default: {
+                // min and max of other types
+                std::string& value = table.stringStates[group*mAggregates.size() + i];
+                int result = first ? 0 : compareStringValues(column.fields[row], value, column.type);
+                if(first || (aggregate.function == AGGREGATE::MIN ? result < 0 : result > 0)){
+                    table.bytes += column.fields[row].size();
+                    value = column.fields[row];
+                }
+                break;
+            }
+        }
+    }
+}
+
+void AggregateOperator::mergeGroup(GroupTable& table, uint32_t group, const GroupTable& from, uint32_t fromGroup){
+    AggregateState* states = &table.states[group*mAggregates.size()];
+    const AggregateState* fromStates = &from.states[fromGroup*mAggregates.size()];
+    for(int i=0; i<mAggregates.size(); i++){
+        AGGREGATE function = mAggregates[i].function;
+        AggregateState& state = states[i];
+        const AggregateState& fromState = fromStates[i];
+        if(fromState.count == 0){
+            continue;
+        }
+        bool first = state.count == 0;
+        state.count += fromState.count;
+        if(function == AGGREGATE::COUNT){
+            continue;
+        }
+
+        switch(mAggregateTypes[i]){
+            case TYPE::INT:
+                if(function == AGGREGATE::SUM){
+                    state.intValue = (int64_t)((uint64_t)state.intValue + (uint64_t)fromState.intValue);
+                } else if(function == AGGREGATE::AVG){
+                    state.floatValue += fromState.floatValue;
+                } else if(first || (function == AGGREGATE::MIN ? fromState.intValue < state.intValue : fromState.intValue > state.intValue)){
+                    state.intValue = fromState.intValue;
+                }
+                break;
+            case TYPE::FLOAT:
+                if(function == AGGREGATE::SUM || function == AGGREGATE::AVG){
+                    state.floatValue += fromState.floatValue;
+                } else if(first || (function == AGGREGATE::MIN ? fromState.floatValue < state.floatValue : fromState.floatValue > state.floatValue)){
+                    state.floatValue = fromState.floatValue;
+                }
+                break;
+            default: {
+                std::string& value = table.stringStates[group*mAggregates.size() + i];
+                const std::string& fromValue = from.stringStates[fromGroup*mAggregates.size() + i];
+                int result = first ? 0 : compareStringValues(fromValue, value, mChildColumns[mAggregates[i].column][1]);
+                if(first || (function == AGGREGATE::MIN ? result < 0 : result > 0)){
+                    table.bytes += fromValue.size();
+                    value = fromValue;
+                }
+                break;
+            }
+        }
+    }
+}
+
+bool AggregateOperator::aggregate(Operator& input, uint32_t level){
+    mTables.resize(1);
+    mNextTable = 0;
+    mNextGroup = 0;
+    GroupTable& groups = mTables[0];
+    clearGroups(groups);
+
+    // Set once the groups don't fit in memory. Partitions hold rows of groups not in the table
+    bool spilling = false;
+    std::vector< uint64_t > spillFiles;
+    std::vector< std::unique_ptr<ResultAppender> > spills;
+
+    Batch batch;
+    std::string key;
+    bool pulled;
+    while((pulled = VECTORIZED_EXECUTION ? input.nextBatch(batch) : input.Operator::nextBatch(batch))){
+        for(uint32_t i=0; i<batch.selection.size(); i++){
+            uint32_t row = batch.selection[i];
+            getGroupKey(batch, row, key);
+            uint64_t hash = hashJoinKey(key);
+
+            int64_t group = findGroup(groups, key.data(), key.length(), hash);
+            if(group < 0 && spilling){
+                if(!spills[getPartition(hash, level)]->append(gatherRow(batch, row))){
+                    mFailed = true;
+                }
+                continue;
+            }
+            if(group < 0){
+                group = addGroup(groups, key.data(), key.length(), hash);
+            }
+            updateGroup(groups, group, batch, row);
+
+            if(!spilling && groups.bytes > AGGREGATE_MEMORY_BUDGET && level < MAX_AGGREGATE_PARTITION_LEVEL){
+                spilling = true;
+                for(uint32_t p=0; p<JOIN_PARTITIONS; p++){
+                    uint64_t fileId = createSpillFile(mChildColumns);
+                    if(!fileId){
+                        mFailed = true;
+                        break;
+                    }
+                    spillFiles.push_back(fileId);
+                    spills.push_back(std::make_unique<ResultAppender>(fileId, mChildColumns));
+                    if(!spills.back()->open()){
+                        mFailed = true;
+                    }
+                }
+                if(DEBUG == true){
+                    std::cout << "Aggregation spills rows of new groups after " << groups.size() << " groups" << std::endl;
+                }
+            }
+        }
+        if(mFailed){
+            break;
+        }
+    }
+
+    for(uint32_t p=0; p<spills.size(); p++){
+        if(!spills[p]->close()){
+            mFailed = true;
+        }
+        if(mFailed || spills[p]->getTotBytes() == 0){
+            deleteSpillFile(spillFiles[p]);
+        } else {
+            mPendingPartitions.push_back({spillFiles[p], level + 1});
+        }
+    }
+    return !mFailed && !input.failed();
+}
+
+bool AggregateOperator::aggregateParallel(bool& fits){
+    WorkerPool& pool = WorkerPool::getPool();
+    uint32_t workers = pool.getWorkerCount();
+    fits = true;
+
+    // Groups of a worker: pre-aggregated ones and runs of every partition
+    struct WorkerGroups {
+        GroupTable groups;
+        std::vector< GroupTable > runs;
+        std::string key;
+    };
+    std::vector< WorkerGroups > workerGroups(workers);
+    for(uint32_t w=0; w<workers; w++){
+        clearGroups(workerGroups[w].groups);
+        workerGroups[w].runs.resize(JOIN_PARTITIONS);
+        for(uint32_t p=0; p<JOIN_PARTITIONS; p++){
+            clearGroups(workerGroups[w].runs[p], false);
+        }
+    }
+
+    // Bytes of the runs of every worker
+    std::atomic<uint64_t> runBytes{0};
+    auto flush = [&](WorkerGroups& state){
+        GroupTable& groups = state.groups;
+        uint64_t bytes = 0;
+        for(uint32_t g=0; g<groups.size(); g++){
+            GroupTable& run = state.runs[getPartition(groups.hashes[g], 0)];
+            uint64_t before = run.bytes;
+            uint32_t group = addGroup(run, &groups.keyBytes[groups.keyOffsets[g]], groups.keyOffsets[g + 1] - groups.keyOffsets[g], groups.hashes[g]);
+            mergeGroup(run, group, groups, g);
+            bytes += run.bytes - before;
+        }
+        clearGroups(groups);
+        return (runBytes += bytes) <= AGGREGATE_MEMORY_BUDGET;
+    };
+
+    bool produced = mChild->produceParallel([&](Batch& batch, uint32_t worker){
+        WorkerGroups& state = workerGroups[worker];
+        for(uint32_t i=0; i<batch.selection.size(); i++){
+            uint32_t row = batch.selection[i];
+            getGroupKey(batch, row, state.key);
+            uint64_t hash = hashJoinKey(state.key);
+
+            int64_t group = findGroup(state.groups, state.key.data(), state.key.length(), hash);
+            if(group < 0){
+                if(state.groups.size() >= PREAGGREGATE_GROUPS && !flush(state)){
+                    return false;
+                }
+                group = addGroup(state.groups, state.key.data(), state.key.length(), hash);
+            }
+            updateGroup(state.groups, group, batch, row);
+        }
+        return true;
+    });
+    if(mChild->failed()){
+        return false;
+    }
+    if(produced){
+        produced = pool.parallelFor(workers, [&](uint64_t task, uint32_t worker){
+            return flush(workerGroups[task]);
+        });
+    }
+    if(!produced){
+        // Too many groups to keep in memory
+        fits = false;
+        return true;
+    }
+
+    // Every partition is merged into a table of its own, so workers don't share any
+    mTables.assign(JOIN_PARTITIONS, GroupTable());
+    mNextTable = 0;
+    mNextGroup = 0;
+    pool.parallelFor(JOIN_PARTITIONS, [&](uint64_t partition, uint32_t worker){
+        GroupTable& merged = mTables[partition];
+        clearGroups(merged);
+        for(uint32_t w=0; w<workers; w++){
+            GroupTable& run = workerGroups[w].runs[partition];
+            for(uint32_t g=0; g<run.size(); g++){
+                const char* key = &run.keyBytes[run.keyOffsets[g]];
+                uint64_t length = run.keyOffsets[g + 1] - run.keyOffsets[g];
+                int64_t group = findGroup(merged, key, length, run.hashes[g]);
+                if(group < 0){
+                    group = addGroup(merged, key, length, run.hashes[g]);
+                }
+                mergeGroup(merged, group, run, g);
+            }
+            run = GroupTable();
+        }
+        return true;
+    });
+
+    if(DEBUG == true){
+        uint64_t groups = 0;
+        for(uint32_t p=0; p<mTables.size(); p++){
+            groups += mTables[p].size();
+        }
+        std::cout << "Aggregated " << groups << " groups on " << workers << " workers" << std::endl;
+    }
+    return true;
+}
+
+bool AggregateOperator::open(){
+    mPendingPartitions.clear();
+    mProducedGroups = 0;
+    if(!mChild->open()){
+        mFailed = true;
+        return false;
+    }
+
+    bool fits = false;
+    bool aggregated = true;
+    if(mChild->isParallel() && WorkerPool::getPool().getWorkerCount() > 1){
+        aggregated = aggregateParallel(fits);
+        if(aggregated && !fits){
+            // Aggregated again by one thread, which can spill groups
+            if(DEBUG == true){
+                std::cout << "Parallel aggregation exceeded the memory budget" << std::endl;
+            }
+            mChild->close();
+            aggregated = mChild->open();
+        }
+    }
+    if(aggregated && !fits){
+        aggregated = aggregate(*mChild, 0);
+    }
+    mChild->close();
+    if(!aggregated){
+        mFailed = true;
+        return false;
+    }
+
+    // Aggregates of no rows. Counts and sums are 0, while min, max and avg have no value without NULLs
+    bool empty = true;
+    for(uint32_t i=0; i<mTables.size(); i++){
+        empty = empty && mTables[i].size() == 0;
+    }
+    if(mGroupColumns.empty() && empty){
+        for(int i=0; i<mAggregates.size(); i++){
+            AGGREGATE function = mAggregates[i].function;
+            if(function == AGGREGATE::MIN || function == AGGREGATE::MAX || function == AGGREGATE::AVG){
+                std::string functionName = function == AGGREGATE::MIN ? "min" : (function == AGGREGATE::MAX ? "max" : "avg");
+                Logger::logError(functionName + " of no rows has no value");
+                mFailed = true;
+                return false;
+            }
+        }
+        addGroup(mTables[0], "", 0, hashJoinKey(""));
+    }
+    return true;
+}
+
+bool AggregateOperator::nextGroup(const GroupTable*& table, uint32_t& group){
+    while(mNextTable < mTables.size() && mNextGroup >= mTables[mNextTable].size()){
+        mNextTable++;
+        mNextGroup = 0;
+    }
+    while(mNextTable >= mTables.size()){
+        if(mPendingPartitions.empty() || mFailed){
+            return false;
+        }
+        SpilledPartition partition = mPendingPartitions.back();
+        mPendingPartitions.pop_back();
+
+        ScanOperator scan(partition.fileId, "");
+        bool aggregated = scan.open() && aggregate(scan, partition.level);
+        scan.close();
+        deleteSpillFile(partition.fileId);
+        if(!aggregated){
+            mFailed = true;
+            return false;
+        }
+        if(mTables[0].size() == 0){
+            mNextTable = mTables.size();
+        }
+    }
+    table = &mTables[mNextTable];
+    group = mNextGroup++;
+    mProducedGroups++;
+    return true;
+}
+
+std::string AggregateOperator::getStringValue(const GroupTable& table, uint32_t group, uint32_t aggregate){
+    if(table.states[group*mAggregates.size() + aggregate].count){
+        return table.stringStates[group*mAggregates.size() + aggregate];
+    }
+    // Empty value of the type. Varchar values start with their length
+    const std::string& type = mColumns[mGroupColumns.size() + aggregate][1];
+    return std::string(mAggregateTypes[aggregate] == TYPE::VARCHAR ? sizeof(uint32_t) : getTypeSize(type), 0);
+}
+
+bool AggregateOperator::next(Row& row){
+    const GroupTable* table;
+    uint32_t group;
+    if(!nextGroup(table, group)){
+        return false;
+    }
+    uint64_t id = mProducedGroups;
+    row.bytes.assign(reinterpret_cast<const char*>(&id), sizeof(id));
+    row.bytes.append(table->keyBytes, table->keyOffsets[group], table->keyOffsets[group + 1] - table->keyOffsets[group]);
+
+    const AggregateState* states = &table->states[group*mAggregates.size()];
+    for(int i=0; i<mAggregates.size(); i++){
+        const AggregateState& state = states[i];
+        AGGREGATE function = mAggregates[i].function;
+        if(function == AGGREGATE::COUNT){
+            int64_t count = state.count;
+            row.bytes.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        } else if(function == AGGREGATE::AVG){
+            double average = state.count ? state.floatValue / state.count : 0;
+            row.bytes.append(reinterpret_cast<const char*>(&average), sizeof(average));
+        } else if(mAggregateTypes[i] == TYPE::INT){
+            row.bytes.append(reinterpret_cast<const char*>(&state.intValue), sizeof(state.intValue));
+        } else if(mAggregateTypes[i] == TYPE::FLOAT){
+            row.bytes.append(reinterpret_cast<const char*>(&state.floatValue), sizeof(state.floatValue));
+        } else {
+            row.bytes += getStringValue(*table, group, i);
+        }
+    }
+    return true;
+}
+
+bool AggregateOperator::nextBatch(Batch& batch){
+    initBatch(batch, mColumns);
+    const GroupTable* table;
+    uint32_t group;
+    while(batch.size < BATCH_SIZE && nextGroup(table, group)){
+        batch.ids.push_back(mProducedGroups);
+
+        // Group columns are decoded from the key
+        const char* key = table->keyBytes.c_str() + table->keyOffsets[group];
+        for(int j=0; j<mGroupColumns.size(); j++){
+            ColumnVector& column = batch.columns[j];
+            if(column.kind == TYPE::INT){
+                int64_t value;
+                memcpy(&value, key, sizeof(value));
+                column.ints.push_back(value);
+                key += sizeof(value);
+            } else if(column.kind == TYPE::FLOAT){
+                double value;
+                memcpy(&value, key, sizeof(value));
+                column.floats.push_back(value);
+                key += sizeof(value);
+            } else {
+                uint32_t size = getTypeSize(column.type);
+                if(column.kind == TYPE::VARCHAR){
+                    memcpy(&size, key, sizeof(size));
+                    size += sizeof(size);
+                }
+                column.fields.emplace_back(key, size);
+                key += size;
+            }
+        }
+
+        const AggregateState* states = &table->states[group*mAggregates.size()];
+        for(int i=0; i<mAggregates.size(); i++){
+            const AggregateState& state = states[i];
+            ColumnVector& column = batch.columns[mGroupColumns.size() + i];
+            AGGREGATE function = mAggregates[i].function;
+            if(function == AGGREGATE::COUNT){
+                column.ints.push_back(state.count);
+            } else if(function == AGGREGATE::AVG){
+                column.floats.push_back(state.count ? state.floatValue / state.count : 0);
+            } else if(column.kind == TYPE::INT){
+                column.ints.push_back(state.intValue);
+            } else if(column.kind == TYPE::FLOAT){
+                column.floats.push_back(state.floatValue);
+            } else {
+                column.fields.push_back(getStringValue(*table, group, i));
+            }
+        }
+
+        batch.selection.push_back(batch.size);
+        batch.size++;
+    }
+    return batch.size > 0;
+}
+
+void AggregateOperator::close(){
+    mChild->close();
+    for(int i=0; i<mPendingPartitions.size(); i++){
+        deleteSpillFile(mPendingPartitions[i].fileId);
+    }
+    mPendingPartitions.clear();
+    mTables.clear();
+}
+
+uint64_t AggregateOperator::estimateRows(){
+    return mGroupColumns.empty() ? 1 : mChild->estimateRows();
+}
+
+JoinOperator::JoinOperator(std::unique_ptr<Operator> child, std::unique_ptr<Operator> build, const std::vector< condition >& conditions){
+    mChild = std::move(child);
+    mBuild = std::move(build);
+    mConditions = conditions;
+
+    // Getting columns of resulting table
+    for(auto u: mChild->getColumns()){
+        mColumns.push_back(u);
+        if(mChild->getTableName().length()){
+            mColumns[mColumns.size() - 1][0] = mChild->getTableName()+"."+u[0];
+        }
+    }
+
+    for(auto u: mBuild->getColumns()){
+        mColumns.push_back(u);
+        if(mBuild->getTableName().length()){
+            mColumns[mColumns.size() - 1][0] = mBuild->getTableName()+"."+u[0];
+        }
+    }
+
+    for(int i=0; i<mConditions.size(); i++){
+        mLeftIndices.push_back(mChild->findColumn(mConditions[i].columnName));
+        mRightIndices.push_back(mBuild->findColumn(mConditions[i].value));
+
+        // Values of different types are compared as values of the right column, which can't be hashed
+        TYPE leftType = getTypeFromString(mChild->getColumns()[mLeftIndices[i]][1]);
+        TYPE rightType = getTypeFromString(mBuild->getColumns()[mRightIndices[i]][1]);
+        if(mConditions[i].operation == COMPARISON::EQUAL && leftType == rightType){
+            mKeyConditions.push_back(i);
+        } else {
+            mResidualConditions.push_back(i);
+        }
+    }
+
+    mMerge = chooseMergeConditions();
+    if(mMerge){
+        // Inputs already in sweep order aren't sorted again
+        if(mDescending || mChild->getSortColumn() != mSweepColumn){
+            mChild = std::make_unique<SortOperator>(std::move(mChild), std::vector< uint32_t >{mSweepColumn}, std::vector< bool >{mDescending});
+        }
+        uint32_t startColumn = mRightIndices[mStartCondition];
+        if(mDescending || mBuild->getSortColumn() != startColumn){
+            mBuild = std::make_unique<SortOperator>(std::move(mBuild), std::vector< uint32_t >{startColumn}, std::vector< bool >{mDescending});
+        }
+    }
+}
+
+bool JoinOperator::chooseMergeConditions(){
+    // Equality on inputs already sorted on the key columns
+    for(int i=0; i<mKeyConditions.size(); i++){
+        uint32_t conditionIndex = mKeyConditions[i];
+        if(mChild->getSortColumn() == mLeftIndices[conditionIndex] && mBuild->getSortColumn() == mRightIndices[conditionIndex]){
+            mSweepColumn = mLeftIndices[conditionIndex];
+            mStartCondition = mEndCondition = conditionIndex;
+            mStartOperation = COMPARISON::G_EQUAL;
+            mEndOperation = COMPARISON::L_EQUAL;
+            for(int j=0; j<mKeyConditions.size(); j++){
+                if(j != i){
+                    mResidualConditions.push_back(mKeyConditions[j]);
+                }
+            }
+            mKeyConditions.clear();
+            mSweepType = getTypeFromString(mColumns[mSweepColumn][1]);
+            return true;
+        }
+    }
+
+    if(mKeyConditions.size()){
+        return false;
+    }
+
+    // Range conditions between int or float columns of the same type
+    auto isRange = [&](uint32_t conditionIndex){
+        COMPARISON operation = mConditions[conditionIndex].operation;
+        if(operation == COMPARISON::EQUAL || operation == COMPARISON::INVALID || operation == COMPARISON::ASSIGNMENT){
+            return false;
+        }
+        TYPE leftType = getTypeFromString(mChild->getColumns()[mLeftIndices[conditionIndex]][1]);
+        TYPE rightType = getTypeFromString(mBuild->getColumns()[mRightIndices[conditionIndex]][1]);
+        return leftType == rightType && (leftType == TYPE::INT || leftType == TYPE::FLOAT);
+    };
+
+    int32_t first = -1;
+    for(int i=0; i<mResidualConditions.size() && first == -1; i++){
+        if(isRange(mResidualConditions[i])){
+            first = mResidualConditions[i];
+        }
+    }
+    if(first == -1){
+        return false;
+    }
+    mSweepColumn = mLeftIndices[first];
+    mSweepType = getTypeFromString(mChild->getColumns()[mSweepColumn][1]);
+
+    // In ascending order, child > table (or >=) is a start bound and child < table (or <=) an end bound
+    auto isLowerBound = [&](uint32_t conditionIndex){
+        COMPARISON operation = mConditions[conditionIndex].operation;
+        return operation == COMPARISON::GREATER || operation == COMPARISON::G_EQUAL;
+    };
+    int32_t lower = -1, upper = -1;
+    for(int i=0; i<mResidualConditions.size(); i++){
+        uint32_t conditionIndex = mResidualConditions[i];
+        if(!isRange(conditionIndex) || mLeftIndices[conditionIndex] != mSweepColumn){
+            continue;
+        }
+        if(isLowerBound(conditionIndex)){
+            if(lower == -1){
+                lower = conditionIndex;
+            }
+        } else if(upper == -1){
+            upper = conditionIndex;
+        }
+    }
+
+    // Without a lower bound, sweeping in descending order makes the upper bound the start bound
+    mDescending = (lower == -1);
+    mStartCondition = mDescending ? upper : lower;
+    mEndCondition = mDescending ? lower : upper;
+    mStartOperation = mConditions[mStartCondition].operation;
+    if(mEndCondition != -1){
+        mEndOperation = mConditions[mEndCondition].operation;
+    }
+
+    std::vector< uint32_t > residualConditions;
+    for(int i=0; i<mResidualConditions.size(); i++){
+        if(mResidualConditions[i] != mStartCondition && mResidualConditions[i] != mEndCondition){
+            residualConditions.push_back(mResidualConditions[i]);
+        }
+    }
+    mResidualConditions = residualConditions;
+    return true;
+}
+
+bool JoinOperator::sweepAccepts(COMPARISON operation, const SortValue& probeValue, const SortValue& value){
+    int result = compareSortValues(probeValue, value, mSweepType);
+    switch(operation){
+        case COMPARISON::GREATER:
+            return result > 0;
+        case COMPARISON::G_EQUAL:
+            return result >= 0;
+        case COMPARISON::LESS:
+            return result < 0;
+        case COMPARISON::L_EQUAL:
+            return result <= 0;
+        case COMPARISON::EQUAL:
+            return result == 0;
+        default:
+            return false;
+    }
+}
+
+bool JoinOperator::activeRowAfter(const ActiveRow& lRow, const ActiveRow& rRow){
+    // The heap top is the first row to be evicted
+    int result = compareSortValues(lRow.end, rRow.end, mSweepType);
+    return mDescending ? result < 0 : result > 0;
+}
+
+bool JoinOperator::fetchPendingRow(){
+    mHasPendingRow = mBuild->next(mPendingRow);
+    if(mHasPendingRow){
+        std::vector< uint32_t > offsets = getColumnOffsets(mPendingRow.bytes.c_str(), mBuild->getColumns());
+        mPendingStart = getSortValue(mPendingRow, offsets, mBuild->getColumns(), mRightIndices[mStartCondition]);
+    }
+    return !mBuild->failed();
+}
+
+bool JoinOperator::nextMerge(Row& row){
+    auto after = [&](const ActiveRow& lRow, const ActiveRow& rRow){ return activeRowAfter(lRow, rRow); };
+
+    while(true){
+        if(!mHasProbeRow){
+            if(!mChild->next(mProbeRow)){
+                return false;
+            }
+            std::vector< uint32_t > offsets = getColumnOffsets(mProbeRow.bytes.c_str(), mChild->getColumns());
+            SortValue probeValue = getSortValue(mProbeRow, offsets, mChild->getColumns(), mSweepColumn);
+            mProbeValues = getJoinValues(mProbeRow, mChild->getColumns(), mLeftIndices, mResidualConditions);
+
+            // Table rows whose start bound is passed become active
+            while(mHasPendingRow && sweepAccepts(mStartOperation, probeValue, mPendingStart)){
+                ActiveRow activeRow;
+                activeRow.values = getJoinValues(mPendingRow, mBuild->getColumns(), mRightIndices, mResidualConditions);
+                if(mEndCondition != -1){
+                    std::vector< uint32_t > buildOffsets = getColumnOffsets(mPendingRow.bytes.c_str(), mBuild->getColumns());
+                    activeRow.end = getSortValue(mPendingRow, buildOffsets, mBuild->getColumns(), mRightIndices[mEndCondition]);
+                }
+                activeRow.row = std::move(mPendingRow);
+                mActiveRows.push_back(std::move(activeRow));
+                if(mEndCondition != -1){
+                    std::push_heap(mActiveRows.begin(), mActiveRows.end(), after);
+                }
+                if(!fetchPendingRow()){
+                    mFailed = true;
+                    return false;
+                }
+            }
+
+            // Table rows whose end bound is passed can't match this or any later child row
+            while(mEndCondition != -1 && mActiveRows.size() && !sweepAccepts(mEndOperation, probeValue, mActiveRows.front().end)){
+                std::pop_heap(mActiveRows.begin(), mActiveRows.end(), after);
+                mActiveRows.pop_back();
+            }
+
+            mCandidate = 0;
+            mHasProbeRow = true;
+        }
+
+        while(mCandidate < mActiveRows.size()){
+            const ActiveRow& activeRow = mActiveRows[mCandidate++];
+
+            bool failed = false;
+            bool matched = matchesResidual(activeRow.values, failed);
+            if(failed){
+                Logger::logError("Error in checking conditions");
+                mFailed = true;
+                return false;
+            }
+            if(matched){
+                row.bytes = mProbeRow.bytes + activeRow.row.bytes.substr(sizeof(uint64_t));
+                return true;
+            }
+        }
+
+        mHasProbeRow = false;
+    }
+}
+
+std::vector< std::string > JoinOperator::getJoinValues(const Row& row, const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& indices, const std::vector< uint32_t >& conditions){
+    std::vector< uint32_t > offsets = getColumnOffsets(row.bytes.c_str(), columns);
+    std::vector< std::string > values;
+    for(int i=0; i<conditions.size(); i++){
+        uint32_t index = indices[conditions[i]];
+        values.push_back(getValueFromBytes(row.bytes.c_str(), columns[index][1], offsets[index], offsets[index+1]));
+    }
+    return values;
+}
+
+std::string JoinOperator::getJoinKey(const Row& row, const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& indices){
+    std::vector< uint32_t > offsets = getColumnOffsets(row.bytes.c_str(), columns);
+    std::string key;
+    for(int i=0; i<mKeyConditions.size(); i++){
+        appendKeyValue(key, row.bytes.c_str(), offsets, columns, indices[mKeyConditions[i]]);
+    }
+    return key;
+}
+
+int64_t JoinOperator::findKey(const std::string& key, uint64_t hash){
+    for(uint64_t slot = hash & mSlotMask; mSlots[slot] != -1; slot = (slot + 1) & mSlotMask){
+        int32_t row = mSlots[slot];
+        if(mBuildHashes[row] == hash && mBuildKeys[row] == key){
+            return row;
+        }
+    }
+    return -1;
+}
+
+bool JoinOperator::matchesResidual(const std::vector< std::string >& buildValues, bool& failed){
+    const std::vector< std::string >& leftValues = mBuildLeft ? buildValues : mProbeValues;
+    const std::vector< std::string >& rightValues = mBuildLeft ? mProbeValues : buildValues;
+
+    for(int i=0; i<mResidualConditions.size(); i++){
+        uint32_t conditionIndex = mResidualConditions[i];
+        std::string type = mBuild->getColumns()[mRightIndices[conditionIndex]][1];
+        COMPARISON compResult = getCompResult(leftValues[i], rightValues[i], type);
+        if(compResult == COMPARISON::INVALID){
+            failed = true;
+            return false;
+        }
+        if(!isComparisonValid(mConditions[conditionIndex].operation, compResult)){
+            return false;
+        }
+    }
+    return true;
+}
+
+void JoinOperator::clearBuildRows(){
+    mBuildRows.clear();
+    mBuildValues.clear();
+    mBuildKeys.clear();
+    mBuildHashes.clear();
+    mNextRow.clear();
+    mSlots.clear();
+    mBuildBytes = 0;
+}
+
+void JoinOperator::addBuildRow(Row& row){
+    const std::vector< uint32_t >& buildIndices = mBuildLeft ? mLeftIndices : mRightIndices;
+    const std::vector< std::vector< std::string > >& columns = mBuildInput->getColumns();
+
+    mBuildValues.push_back(getJoinValues(row, columns, buildIndices, mResidualConditions));
+    if(mKeyConditions.size()){
+        mBuildKeys.push_back(getJoinKey(row, columns, buildIndices));
+        mBuildHashes.push_back(hashJoinKey(mBuildKeys.back()));
+    }
+    mBuildBytes += getRowMemory(row);
+    mBuildRows.push_back(std::move(row));
+}
+
+void JoinOperator::buildHashTable(){
+    // At most half of the slots are used
+    uint64_t numSlots = 16;
+    while(numSlots < 2*mBuildRows.size()){
+        numSlots <<= 1;
+    }
+    mSlotMask = numSlots - 1;
+    mSlots.assign(numSlots, -1);
+    mNextRow.assign(mBuildRows.size(), -1);
+
+    // Rows are inserted in reverse so that chains keep the order of the build input
+    for(int64_t i=(int64_t)mBuildRows.size()-1; i>=0; i--){
+        uint64_t slot = mBuildHashes[i] & mSlotMask;
+        while(mSlots[slot] != -1 && (mBuildHashes[mSlots[slot]] != mBuildHashes[i] || mBuildKeys[mSlots[slot]] != mBuildKeys[i])){
+            slot = (slot + 1) & mSlotMask;
+        }
+        mNextRow[i] = mSlots[slot];
+        mSlots[slot] = i;
+    }
+}
+
+bool JoinOperator::partitionBuildInput(){
+    mPartitioned = true;
+
+    std::vector< std::vector< Row > > partitionRows(JOIN_PARTITIONS);
+    std::vector< uint64_t > partitionBytes(JOIN_PARTITIONS, 0);
+    std::vector< std::unique_ptr<ResultAppender> > buildSpills(JOIN_PARTITIONS);
+    mSpilledBuildFiles.assign(JOIN_PARTITIONS, 0);
+    uint64_t totBytes = 0;
+
+    auto addRow = [&](Row& row, uint64_t hash) -> bool {
+        uint32_t partition = getPartition(hash, 0);
+        if(buildSpills[partition]){
+            return buildSpills[partition]->append(row.bytes, true);
+        }
+
+        partitionBytes[partition] += getRowMemory(row);
+        totBytes += getRowMemory(row);
+        partitionRows[partition].push_back(std::move(row));
+
+        while(totBytes > JOIN_MEMORY_BUDGET){
+            // Spill the largest partition still in memory
+            uint32_t largest = 0;
+            for(uint32_t i=1; i<JOIN_PARTITIONS; i++){
+                if(partitionBytes[i] > partitionBytes[largest]){
+                    largest = i;
+                }
+            }
+
+            uint64_t fileId = createSpillFile(mBuildInput->getColumns());
+            if(!fileId){
+                return false;
+            }
+            mSpillFiles.push_back(fileId);
+            mSpilledBuildFiles[largest] = fileId;
+            buildSpills[largest] = std::make_unique<ResultAppender>(fileId, mBuildInput->getColumns());
+            if(!buildSpills[largest]->open()){
+                return false;
+            }
+            for(int i=0; i<partitionRows[largest].size(); i++){
+                if(!buildSpills[largest]->append(partitionRows[largest][i].bytes, true)){
+                    return false;
+                }
+            }
+            std::vector< Row >().swap(partitionRows[largest]);
+            totBytes -= partitionBytes[largest];
+            partitionBytes[largest] = 0;
+
+            if(DEBUG == true){
+                std::cout << "Spilled join partition " << largest << " to file " << fileId << std::endl;
+            }
+        }
+        return true;
+    };
+
+    // Rows read before the budget was exceeded
+    std::vector< Row > bufferedRows;
+    std::vector< uint64_t > bufferedHashes;
+    bufferedRows.swap(mBuildRows);
+    bufferedHashes.swap(mBuildHashes);
+    clearBuildRows();
+    for(int i=0; i<bufferedRows.size(); i++){
+        if(!addRow(bufferedRows[i], bufferedHashes[i])){
+            return false;
+        }
+    }
+    std::vector< Row >().swap(bufferedRows);
+
+    const std::vector< uint32_t >& buildIndices = mBuildLeft ? mLeftIndices : mRightIndices;
+    Row row;
+    while(mBuildInput->next(row)){
+        uint64_t hash = hashJoinKey(getJoinKey(row, mBuildInput->getColumns(), buildIndices));
+        if(mBloomFilter){
+            mBloomFilter->insert(hash);
+        }
+        if(!addRow(row, hash)){
+            return false;
+        }
+    }
+
+    mProbeSpills.clear();
+    mProbeSpills.resize(JOIN_PARTITIONS);
+    mSpilledProbeFiles.assign(JOIN_PARTITIONS, 0);
+    for(uint32_t i=0; i<JOIN_PARTITIONS; i++){
+        if(!buildSpills[i]){
+            // Partitions left in memory form the hash table
+            for(int j=0; j<partitionRows[i].size(); j++){
+                addBuildRow(partitionRows[i][j]);
+            }
+            continue;
+        }
+
+        if(!buildSpills[i]->close()){
+            return false;
+        }
+
+        // Probe rows of spilled partitions are written next to them
+        uint64_t fileId = createSpillFile(mProbeInput->getColumns());
+        if(!fileId){
+            return false;
+        }
+        mSpillFiles.push_back(fileId);
+        mSpilledProbeFiles[i] = fileId;
+        mProbeSpills[i] = std::make_unique<ResultAppender>(fileId, mProbeInput->getColumns());
+        if(!mProbeSpills[i]->open()){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool JoinOperator::repartition(const SpilledPartition& partition){
+    uint32_t level = partition.level + 1;
+    std::vector< std::unique_ptr<ResultAppender> > buildSpills(JOIN_PARTITIONS);
+    std::vector< std::unique_ptr<ResultAppender> > probeSpills(JOIN_PARTITIONS);
+    std::vector< SpilledPartition > partitions(JOIN_PARTITIONS, {0, 0, level, 0});
+
+    // Splits the rows of a file. Rows of partitions without a build file are dropped
+    auto split = [&](uint64_t sourceFile, bool build) -> bool {
+        const std::vector< uint32_t >& indices = (build == mBuildLeft) ? mLeftIndices : mRightIndices;
+        std::vector< std::unique_ptr<ResultAppender> >& spills = build ? buildSpills : probeSpills;
+
+        ScanOperator source(sourceFile, "");
+        if(!source.open()){
+            return false;
+        }
+        Row row;
+        while(source.next(row)){
+            uint32_t index = getPartition(hashJoinKey(getJoinKey(row, source.getColumns(), indices)), level);
+            if(!build && !buildSpills[index]){
+                continue;
+            }
+            if(!spills[index]){
+                uint64_t fileId = createSpillFile(source.getColumns());
+                if(!fileId){
+                    return false;
+                }
+                mSpillFiles.push_back(fileId);
+                (build ? partitions[index].buildFile : partitions[index].probeFile) = fileId;
+                spills[index] = std::make_unique<ResultAppender>(fileId, source.getColumns());
+                if(!spills[index]->open()){
+                    return false;
+                }
+            }
+            if(!spills[index]->append(row.bytes, true)){
+                return false;
+            }
+        }
+        source.close();
+        return !source.failed();
+    };
+
+    if(!split(partition.buildFile, true) || !split(partition.probeFile, false)){
+        return false;
+    }
+
+    for(uint32_t i=0; i<JOIN_PARTITIONS; i++){
+        if(buildSpills[i] && !buildSpills[i]->close()){
+            return false;
+        }
+        if(probeSpills[i] && !probeSpills[i]->close()){
+            return false;
+        }
+        if(partitions[i].buildFile && partitions[i].probeFile){
+            mPendingPartitions.push_back(partitions[i]);
+        } else if(partitions[i].buildFile){
+            // No probe rows can match
+            removeSpillFile(partitions[i].buildFile);
+        }
+    }
+
+    removeSpillFile(partition.buildFile);
+    removeSpillFile(partition.probeFile);
+
+    if(DEBUG == true){
+        std::cout << "Partitioned join spill files " << partition.buildFile << " and " << partition.probeFile << " at level " << level << std::endl;
+    }
+    return true;
+}
+
+bool JoinOperator::startNextPartition(){
+    if(mJoiningPartition){
+        mPartitionProbe->close();
+        mPartitionProbe.reset();
+        // The original probe input has ended, so it produces no more rows
+        mProbeInput = mBuildLeft ? mBuild.get() : mChild.get();
+        mJoiningPartition = false;
+        if(mPendingChunks){
+            // Join the next chunk of build rows with the same probe rows
+            mPendingPartitions.push_back(mCurrentPartition);
+        } else {
+            removeSpillFile(mCurrentPartition.buildFile);
+            removeSpillFile(mCurrentPartition.probeFile);
+        }
+    }
+
+    if(mProbeSpills.size()){
+        // The probe input ended. Spilled partitions can be joined now
+        for(uint32_t i=0; i<JOIN_PARTITIONS; i++){
+            if(!mProbeSpills[i]){
+                continue;
+            }
+            if(!mProbeSpills[i]->close()){
+                mFailed = true;
+                return false;
+            }
+            mPendingPartitions.push_back({mSpilledBuildFiles[i], mSpilledProbeFiles[i], 0, 0});
+        }
+        mProbeSpills.clear();
+    }
+
+    while(mPendingPartitions.size()){
+        SpilledPartition partition = mPendingPartitions.back();
+        mPendingPartitions.pop_back();
+
+        std::unique_ptr<Operator> probe = std::make_unique<ScanOperator>(partition.probeFile, "");
+        if(probe->estimateRows() == 0){
+            removeSpillFile(partition.buildFile);
+            removeSpillFile(partition.probeFile);
+            continue;
+        }
+
+        // Load build rows until the budget is exceeded
+        clearBuildRows();
+        ScanOperator buildScan(partition.buildFile, "");
+        if(!buildScan.open()){
+            mFailed = true;
+            return false;
+        }
+        Row row;
+        uint64_t rowsSeen = 0;
+        bool complete = true;
+        while(buildScan.next(row)){
+            if(rowsSeen++ < partition.buildRowsDone){
+                continue;
+            }
+            if(mBuildBytes > JOIN_MEMORY_BUDGET){
+                complete = false;
+                break;
+            }
+            addBuildRow(row);
+        }
+        buildScan.close();
+        if(buildScan.failed()){
+            mFailed = true;
+            return false;
+        }
+
+        if(!complete && partition.buildRowsDone == 0 && partition.level < MAX_JOIN_PARTITION_LEVEL){
+            clearBuildRows();
+            if(!repartition(partition)){
+                mFailed = true;
+                return false;
+            }
+            continue;
+        }
+
+        if(DEBUG == true){
+            std::cout << "Joining spilled partition with " << mBuildRows.size() << " build rows" << (complete ? "" : " (chunk)") << std::endl;
+        }
+
+        buildHashTable();
+        mCurrentPartition = partition;
+        mCurrentPartition.buildRowsDone += mBuildRows.size();
+        mPendingChunks = !complete;
+
+        mPartitionProbe = std::move(probe);
+        if(!mPartitionProbe->open()){
+            mFailed = true;
+            return false;
+        }
+        mProbeInput = mPartitionProbe.get();
+        mJoiningPartition = true;
+        return true;
+    }
+
+    return false;
+}
+
+void JoinOperator::removeSpillFile(uint64_t fileId){
+    deleteSpillFile(fileId);
+    mSpillFiles.erase(std::remove(mSpillFiles.begin(), mSpillFiles.end(), fileId), mSpillFiles.end());
+}
+
+bool JoinOperator::open(){
+    if(mMerge){
+        mBuildLeft = false;
+        if(!mChild->open() || !mBuild->open()){
+            mFailed = true;
+            return false;
+        }
+        mActiveRows.clear();
+        mHasProbeRow = false;
+        if(!fetchPendingRow()){
+            mFailed = true;
+            return false;
+        }
+        if(DEBUG == true){
+            std::cout << "Sort-merge join on " << mColumns[mSweepColumn][0] << (mDescending ? " (descending)" : "") << std::endl;
+        }
+        return true;
+    }
+
+    // The hash table is built on the smaller input. Nested loops keep the table as the inner input
+    mBuildLeft = mKeyConditions.size() && mChild->estimateRows() < mBuild->estimateRows();
+    mBuildInput = mBuildLeft ? mChild.get() : mBuild.get();
+    mProbeInput = mBuildLeft ? mBuild.get() : mChild.get();
+
+    if(!mChild->open() || !mBuild->open()){
+        mFailed = true;
+        return false;
+    }
+
+    // Materialize the build side
+    clearBuildRows();
+    mPartitioned = false;
+    mJoiningPartition = false;
+    mPendingPartitions.clear();
+    mBloomFilter.reset();
+    mBloomPushed = false;
+    if(JOIN_BLOOM_FILTERS && mKeyConditions.size()){
+        mBloomFilter = std::make_shared<BloomFilter>(mBuildInput->estimateRows());
+    }
+    Row row;
+    while(mBuildInput->next(row)){
+        addBuildRow(row);
+        if(mBloomFilter){
+            mBloomFilter->insert(mBuildHashes.back());
+        }
+        if(mKeyConditions.size() && mBuildBytes > JOIN_MEMORY_BUDGET){
+            if(!partitionBuildInput()){
+                Logger::logError("Error in partitioning join input");
+                mFailed = true;
+                return false;
+            }
+            break;
+        }
+    }
+    mBuildInput->close();
+
+    if(mBuildInput->failed()){
+        return false;
+    }
+
+    if(mKeyConditions.size()){
+        buildHashTable();
+    }
+
+    if(mBloomFilter){
+        const std::vector< uint32_t >& probeIndices = mBuildLeft ? mRightIndices : mLeftIndices;
+        std::vector< uint32_t > probeKeyColumns;
+        for(int i=0; i<mKeyConditions.size(); i++){
+            probeKeyColumns.push_back(probeIndices[mKeyConditions[i]]);
+        }
+        mBloomPushed = mProbeInput->pushBloomFilter(mBloomFilter, probeKeyColumns);
+    }
+
+    if(DEBUG == true){
+        std::cout << "Build side rows: " << mBuildRows.size() << (mKeyConditions.size() ? " (hash join)" : " (nested loop join)") << (mPartitioned ? " (partitioned)" : "") << std::endl;
+    }
+
+    mHasProbeRow = false;
+    return true;
+}
+
+bool JoinOperator::next(Row& row){
+    if(mMerge){
+        return nextMerge(row);
+    }
+
+    const std::vector< uint32_t >& probeIndices = mBuildLeft ? mRightIndices : mLeftIndices;
+
+    while(true){
+        if(!mHasProbeRow){
+            if(!mProbeInput->next(mProbeRow)){
+                if(mProbeInput->failed() || !startNextPartition()){
+                    return false;
+                }
+                continue;
+            }
+            mProbeValues = getJoinValues(mProbeRow, mProbeInput->getColumns(), probeIndices, mResidualConditions);
+            if(mKeyConditions.size()){
+                std::string key = getJoinKey(mProbeRow, mProbeInput->getColumns(), probeIndices);
+                uint64_t hash = hashJoinKey(key);
+                if(mBloomFilter && !mBloomPushed && !mBloomFilter->mayContain(hash)){
+                    continue;
+                }
+                uint32_t partition = getPartition(hash, 0);
+                if(mProbeSpills.size() && mProbeSpills[partition]){
+                    // The build rows of this key were spilled
+                    if(!mProbeSpills[partition]->append(mProbeRow.bytes, true)){
+                        mFailed = true;
+                        return false;
+                    }
+                    continue;
+                }
+                mCandidate = findKey(key, hash);
+            } else {
+                mCandidate = mBuildRows.size() ? 0 : -1;
+            }
+            mHasProbeRow = true;
+        }
+
+        while(mCandidate != -1){
+            int64_t current = mCandidate;
+            if(mKeyConditions.size()){
+                mCandidate = mNextRow[current];
+            } else {
+                mCandidate = (current + 1 < mBuildRows.size()) ? current + 1 : -1;
+            }
+
+            bool failed = false;
+            bool matched = matchesResidual(mBuildValues[current], failed);
+            if(failed){
+                Logger::logError("Error in checking conditions");
+                mFailed = true;
+                return false;
+            }
+
+            if(matched){
+                const Row& buildRow = mBuildRows[current];
+                if(mBuildLeft){
+                    row.bytes = buildRow.bytes + mProbeRow.bytes.substr(sizeof(uint64_t));
+                } else {
+                    row.bytes = mProbeRow.bytes + buildRow.bytes.substr(sizeof(uint64_t));
+                }
+                return true;
+            }
+        }
+
+        mHasProbeRow = false;
+    }
+}
+
+void JoinOperator::close(){
+    if(mMerge){
+        mChild->close();
+        mBuild->close();
+        mActiveRows.clear();
+        return;
+    }
+
+    (mBuildLeft ? mBuild : mChild)->close();
+    if(mPartitionProbe){
+        mPartitionProbe->close();
+        mPartitionProbe.reset();
+    }
+    mProbeSpills.clear();
+    mPendingPartitions.clear();
+    mJoiningPartition = false;
+    mBloomFilter.reset();
+    while(mSpillFiles.size()){
+        removeSpillFile(mSpillFiles.back());
+    }
+    clearBuildRows();
+}
+
+uint64_t JoinOperator::estimateRows(){
+    if(mHasEstimate){
+        return mEstimatedRows;
+    }
+    return std::max(mChild->estimateRows(), mBuild->estimateRows());
+}
+
+void printQuery(Operator& root){
+
+    const std::vector< std::vector< std::string > >& columns = root.getColumns();
+    std::ostream& output = Logger::getOutput();
+
+    output << Formatter::bold_on;
+    for(int i=0; i < columns.size(); i++){
+        output << std::setw(20) << columns[i][0];
+    }
+    output << Formatter::off << '\n';
+
+    if(!root.open()){
+        return;
+    }
+
+    if(VECTORIZED_EXECUTION){
+        Batch batch;
+        while(root.nextBatch(batch)){
+            printBatch(batch);
+        }
+    } else {
+        Row row;
+        while(root.next(row)){
+            std::vector< uint32_t > offsets = getColumnOffsets(row.bytes.c_str(), columns);
+            for(int j=0; j<columns.size();j++){
+                std::string printVal = getValueFromBytes(row.bytes.c_str(), columns[j][1], offsets[j], offsets[j+1]);
+                output << std::setw(20) << printVal ;
+            }
+            output << '\n';
+        }
+    }
+
+    root.close();
+
+    if(root.failed()){
+        Logger::logError("Error in executing query");
+    }
+}
@@ -0,0 +1,819 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <deque>
+#include <list>
+#include <map>
+#include <functional>
+#include <cstdint>
+#include "../condition/condition.h"
+#include "../batch/batch.h"
+#include "../appender/appender.h"
+#include "../bloom/bloom.h"
+#include "../expression/expression.h"
+#include "../mvcc/mvcc.h"
+
+/**
+ * @brief Rows flow between operators in memory in the decoded row format:
+ * 8 byte ID followed by the column values (see getColumnOffsets)
+ */
+struct Row {
+    std::string bytes;
+};
+
+/**
+ * @brief Name of the int column a scan adds for late materialization: position of the record
+ * in the table file (page number * PAGE_SIZE + offset in the page)
+ */
+const std::string LOCATOR_COLUMN = "#locator";
+
+/**
+ * @brief Pull based query operator. Parents call open once, then next until it returns false, then close.
+ */
+class Operator {
+protected:
+    std::vector< std::vector< std::string > > mColumns;
+    // Name used to qualify unqualified column names. Empty once columns are qualified (after a join)
+    std::string mTableName;
+    bool mFailed = false;
+public:
+    virtual bool open() = 0;
+
+    /**
+     * @brief Produce the next row
+     *
+     * @param row row to be filled
+     * @return true if a row was produced
+     * @return false if there are no more rows or an error occurred (see failed)
+     */
+    virtual bool next(Row& row) = 0;
+
+    /**
+     * @brief Produce the next batch of rows (vectorized execution). Operators without a
+     * batch implementation fill the batch by calling next
+     *
+     * @return true if the batch has at least one row (the selection vector may still be empty)
+     * @return false if there are no more rows or an error occurred (see failed)
+     */
+    virtual bool nextBatch(Batch& batch);
+    virtual void close() = 0;
+    virtual bool failed(){ return mFailed; }
+
+    /**
+     * @brief Rough number of rows produced. Used to pick the build side of joins
+     */
+    virtual uint64_t estimateRows() = 0;
+
+    /**
+     * @brief Column the rows are produced in ascending order of
+     *
+     * @return int32_t index of the column, -1 if the order is unknown
+     */
+    virtual int32_t getSortColumn(){ return -1; }
+
+    /**
+     * @brief Drop rows whose key isn't in the Bloom filter as early as possible (semi-join reduction)
+     *
+     * @param columns key columns, hashed like the keys of the hash join
+     * @return true if the operator drops the rows
+     * @return false if the filter can't be pushed down and the caller has to check it
+     */
+    virtual bool pushBloomFilter(std::shared_ptr<const BloomFilter> filter, const std::vector< uint32_t >& columns){ return false; }
+
+    /**
+     * @brief True if the operator can push its batches to consumers on the workers of the WorkerPool (see produceParallel)
+     */
+    virtual bool isParallel(){ return false; }
+
+    /**
+     * @brief Produce every row, called after open instead of next and nextBatch. Batches are handed to
+     * consume by the worker that produced them, in no particular order, so consume keeps state per worker
+     *
+     * @param consume called with every batch. Returning false stops the workers
+     * @return false if the operator isn't parallel, an error occurred (see failed) or consume returned false
+     */
+    virtual bool produceParallel(const std::function< bool(Batch& batch, uint32_t worker) >& consume){ return false; }
+
+    const std::vector< std::vector< std::string > >& getColumns(){ return mColumns; }
+    const std::string& getTableName(){ return mTableName; }
+
+    /**
+     * @brief Find a column by its name. Accepts table.column for unqualified columns
+     *
+     * @return int32_t index of the column, -1 if it doesn't exist
+     */
+    int32_t findColumn(const std::string& name);
+
+    virtual ~Operator() {}
+};
+
+class ScanOperator : public Operator {
+    uint64_t mFileId;
+    uint32_t mRowSize;
+    bool mSlotted;
+    // Columns of the table. mColumns has the produced columns
+    std::vector< std::vector< std::string > > mTableColumns;
+    // Column of the table produced in every column (the locator column excluded)
+    std::vector< uint32_t > mProjection;
+    bool mLocator = false;
+    // False if every column of the table is produced in order without a locator
+    bool mProjected = false;
+    uint64_t mTotPages = 0;
+    uint64_t mCurrentPage = 0;
+    // Pages read by a scan of a page range (see the range constructor). 0 for the whole table
+    uint64_t mFirstPage = 0;
+    uint64_t mLastPage = 0;
+    // Version of the table pages are read at (see setSnapshot)
+    const Snapshot* mSnapshot = nullptr;
+    std::unique_ptr<char[]> mPageBuffer;
+    // Non empty rows of the current page
+    std::vector< std::pair< uint32_t, uint32_t > > mRows;
+    uint32_t mRowIndex = 0;
+
+    // Rows with a key not in the filter are skipped before they are decoded
+    std::shared_ptr<const BloomFilter> mBloomFilter;
+    std::vector< uint32_t > mBloomColumns;
+    std::vector< uint32_t > mBloomTableColumns;
+    uint64_t mBloomRejected = 0;
+
+    bool loadNextPage();
+    bool passesBloomFilter(const char* row, const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& keyColumns);
+    std::string decodeRecord(uint32_t rowIndex);
+    void appendLocators(Batch& batch, const std::vector< std::pair< uint32_t, uint32_t > >& rows, uint32_t begin, uint32_t end);
+public:
+    ScanOperator(uint64_t fileId, const std::string& tableName);
+
+    /**
+     * @brief Scan of the pages firstPage to lastPage of the table of scan, with its projection and
+     * Bloom filter. Doesn't read the table metadata, so ranges can be scanned by several threads
+     */
+    ScanOperator(const ScanOperator& scan, uint64_t firstPage, uint64_t lastPage);
+
+    /**
+     * @brief Produce only some columns of the table. Called before open
+     *
+     * @param projection columns of the table in the order they are produced
+     * @param locator also produce LOCATOR_COLUMN (last), so that other columns can be read later (see MaterializeOperator)
+     */
+    void setProjection(const std::vector< uint32_t >& projection, bool locator);
+    const std::vector< uint32_t >& getProjection(){ return mProjection; }
+    bool hasLocator(){ return mLocator; }
+
+    /**
+     * @brief Read the pages as the snapshot sees them. Scans without a snapshot (temporary files) read the current pages
+     */
+    void setSnapshot(const Snapshot* snapshot){ mSnapshot = snapshot; }
+    const Snapshot* getSnapshot(){ return mSnapshot; }
+
+    bool open() override;
+    bool next(Row& row) override;
+    bool nextBatch(Batch& batch) override;
+    void close() override;
+    uint64_t estimateRows() override;
+    bool pushBloomFilter(std::shared_ptr<const BloomFilter> filter, const std::vector< uint32_t >& columns) override;
+    uint64_t getFileId(){ return mFileId; }
+
+    /**
+     * @brief Pages of the table, read from its metadata. 0 if it can't be read
+     */
+    uint64_t getPageCount();
+    bool hasBloomFilter(){ return mBloomFilter != nullptr; }
+    uint64_t getBloomRejected(){ return mBloomRejected; }
+};
+
+/**
+ * @brief Scan of a table with conditions, run by the workers of the WorkerPool (morsel driven).
+ * The pages are split in morsels of MORSEL_PAGES pages. Morsels are scanned and filtered in waves
+ * of a few morsels per worker, every worker decoding into batches of its own. The batches left
+ * after the conditions are produced once the wave ends, in the order of the table (preserveOrder)
+ * or worker by worker.
+ */
+class ParallelScanOperator : public Operator {
+    // Scans of the morsels are copied from it (see the range constructor of ScanOperator)
+    std::unique_ptr<ScanOperator> mScan;
+    std::vector< condition > mConditions;
+    std::vector< int32_t > mConditionColumns;
+    bool mPreserveOrder;
+
+    uint64_t mTotPages = 0;
+    uint64_t mNextMorsel = 0;
+    uint64_t mMorselCount = 0;
+    uint64_t mBloomRejected = 0;
+    bool mOpen = false;
+
+    // Batches of the wave by morsel (preserveOrder) or by worker, and the next one to produce
+    std::vector< std::vector< Batch > > mOutputs;
+    uint32_t mOutput = 0;
+    uint32_t mOutputBatch = 0;
+    // Batch rows are produced from by next
+    Batch mBatch;
+    uint32_t mBatchRow = 0;
+
+    bool runWave();
+    bool nextOutputBatch(Batch& batch);
+public:
+    /**
+     * @param scan scan of the table. Its projection is kept, so it is set before
+     * @param conditions conditions on the columns of the scan, as for FilterOperator
+     * @param preserveOrder produce the rows in the order of the table
+     */
+    ParallelScanOperator(std::unique_ptr<ScanOperator> scan, const std::vector< condition >& conditions, bool preserveOrder);
+    bool open() override;
+    bool next(Row& row) override;
+    bool nextBatch(Batch& batch) override;
+    void close() override;
+    uint64_t estimateRows() override;
+    bool pushBloomFilter(std::shared_ptr<const BloomFilter> filter, const std::vector< uint32_t >& columns) override { return mScan->pushBloomFilter(filter, columns); }
+    bool isParallel() override { return true; }
+
+    /**
+     * @brief Scan and filter every morsel in one go. Filtered batches go to consume without being buffered
+     */
+    bool produceParallel(const std::function< bool(Batch& batch, uint32_t worker) >& consume) override;
+    uint64_t getFileId(){ return mScan->getFileId(); }
+};
+
+/**
+ * @brief One scan of a table feeding several operators (self-joins). The table is read once:
+ * rows are kept in memory until every consumer has read them. A consumer falling behind by more
+ * than SHARED_SCAN_MEMORY_BUDGET bytes of rows reads the rest of the table with a scan of its own.
+ */
+class SharedScan {
+    ScanOperator mScan;
+    std::vector< uint32_t > mProjection;
+    bool mLocator;
+    bool mOpen = false;
+    bool mEnded = false;
+    // Rows not read by every consumer yet. mRows[0] is row mFirstRow of the table
+    std::deque< Row > mRows;
+    uint64_t mFirstRow = 0;
+    uint64_t mRowsBytes = 0;
+    // Next row and state of every consumer
+    std::vector< uint64_t > mPositions;
+    std::vector< bool > mClosed;
+    std::vector< std::unique_ptr<ScanOperator> > mOwnScans;
+
+    void trimRows();
+public:
+    /**
+     * @param projection columns of the table read for every consumer (see ScanOperator::setProjection)
+     * @param snapshot snapshot the table is read at (see ScanOperator::setSnapshot)
+     */
+    SharedScan(uint64_t fileId, uint32_t consumers, const std::vector< uint32_t >& projection, bool locator, const Snapshot* snapshot);
+    bool next(uint32_t consumer, Row& row);
+    void close(uint32_t consumer);
+    bool failed();
+    uint64_t estimateRows(){ return mScan.estimateRows(); }
+    const std::vector< std::vector< std::string > >& getColumns(){ return mScan.getColumns(); }
+};
+
+/**
+ * @brief Rows of a SharedScan read by one consumer
+ */
+class SharedScanOperator : public Operator {
+    std::shared_ptr<SharedScan> mScan;
+    uint32_t mConsumer;
+public:
+    SharedScanOperator(std::shared_ptr<SharedScan> scan, uint32_t consumer, const std::string& tableName);
+    bool open() override { return true; }
+    bool next(Row& row) override { return mScan->next(mConsumer, row); }
+    void close() override { mScan->close(mConsumer); }
+    uint64_t estimateRows() override { return mScan->estimateRows(); }
+    bool failed() override { return mScan->failed(); }
+};
+
+/**
+ * @brief Rough fraction of rows satisfying a comparison. Used for row estimates
+ */
+double getSelectivity(COMPARISON operation);
+
+class FilterOperator : public Operator {
+    std::unique_ptr<Operator> mChild;
+    std::vector< condition > mConditions;
+    // Column of every condition. -1 if the column doesn't exist
+    std::vector< int32_t > mConditionColumns;
+public:
+    FilterOperator(std::unique_ptr<Operator> child, const std::vector< condition >& conditions);
+    bool open() override;
+    bool next(Row& row) override;
+    bool nextBatch(Batch& batch) override;
+    void close() override;
+    uint64_t estimateRows() override;
+    int32_t getSortColumn() override { return mChild->getSortColumn(); }
+    bool pushBloomFilter(std::shared_ptr<const BloomFilter> filter, const std::vector< uint32_t >& columns) override { return mChild->pushBloomFilter(filter, columns); }
+    bool failed() override { return mFailed || mChild->failed(); }
+};
+
+/**
+ * @brief Produces the given columns of the child rows in the given order, or the values of
+ * expressions on them (select list). The ID of the child row is kept
+ */
+class ProjectOperator : public Operator {
+    std::unique_ptr<Operator> mChild;
+    // Column of the child copied to every column. -1 for columns computed by an expression
+    std::vector< int32_t > mProjection;
+    std::vector< std::unique_ptr<Expression> > mExpressions;
+    Batch mChildBatch;
+
+    /**
+     * @brief Project a batch of the child. Its columns are moved to the projected batch
+     *
+     * @return false if an expression divided by zero
+     */
+    bool projectBatch(Batch& childBatch, Batch& batch);
+public:
+    ProjectOperator(std::unique_ptr<Operator> child, const std::vector< uint32_t >& projection);
+
+    /**
+     * @param expressions expressions bound to the columns of the child (see bindExpression)
+     * @param names names of the produced columns
+     */
+    ProjectOperator(std::unique_ptr<Operator> child, std::vector< std::unique_ptr<Expression> > expressions, const std::vector< std::string >& names);
+    bool open() override { return mChild->open(); }
+    bool next(Row& row) override;
+    bool nextBatch(Batch& batch) override;
+    void close() override { mChild->close(); }
+    uint64_t estimateRows() override { return mChild->estimateRows(); }
+    bool failed() override { return mFailed || mChild->failed(); }
+    bool isParallel() override { return mChild->isParallel(); }
+    bool produceParallel(const std::function< bool(Batch& batch, uint32_t worker) >& consume) override;
+};
+
+/**
+ * @brief Columns of a table of a query not read by its scan. They are read by row locator
+ * once rows have passed the filters and joins (late materialization)
+ */
+struct DeferredColumns {
+    uint64_t fileId;
+    // Name (or alias) of the table in the query
+    std::string tableName;
+    std::vector< uint32_t > columns;
+};
+
+/**
+ * @brief Appends deferred columns to the child rows. Scans of the tables produce LOCATOR_COLUMN,
+ * which gives the record to decode the columns from. Table pages are cached (least recently used
+ * pages are dropped past MATERIALIZE_MEMORY_BUDGET), since locators of joined rows aren't in order
+ */
+class MaterializeOperator : public Operator {
+    struct Source {
+        uint64_t fileId;
+        std::vector< std::vector< std::string > > tableColumns;
+        std::vector< uint32_t > columns;
+        uint32_t locatorColumn;
+        // Offsets of the columns in fixed width records. Slotted records are decoded instead
+        bool slotted;
+        std::vector< uint32_t > offsets;
+        std::vector< uint32_t > sizes;
+    };
+
+    std::unique_ptr<Operator> mChild;
+    std::vector< Source > mSources;
+
+    typedef std::pair< uint64_t, uint64_t > PageKey;
+    // Cached pages by (file, page number). mPageOrder has the most recently used page first
+    std::list< PageKey > mPageOrder;
+    std::map< PageKey, std::pair< std::unique_ptr<char[]>, std::list< PageKey >::iterator > > mPages;
+    // Page at the front of mPageOrder
+    const char* mLastPage = nullptr;
+    uint64_t mPageReads = 0;
+    const Snapshot* mSnapshot;
+
+    const char* getPage(uint64_t fileId, uint64_t pageNumber);
+    const char* getRecord(const Source& source, int64_t locator);
+public:
+    /**
+     * @param snapshot snapshot the rows of the child were read at
+     */
+    MaterializeOperator(std::unique_ptr<Operator> child, const std::vector< DeferredColumns >& deferred, const Snapshot* snapshot);
+    bool open() override { return mChild->open(); }
+    bool next(Row& row) override;
+    bool nextBatch(Batch& batch) override;
+    void close() override;
+    uint64_t estimateRows() override { return mChild->estimateRows(); }
+    int32_t getSortColumn() override { return mChild->getSortColumn(); }
+    bool failed() override { return mFailed || mChild->failed(); }
+};
+
+/**
+ * @brief Value of a sort column. Only the member matching the column type is used
+ */
+struct SortValue {
+    int64_t intValue = 0;
+    double floatValue = 0;
+    std::string stringValue;
+};
+
+/**
+ * @brief Sorts the rows of the child on normalized keys: the sort columns encoded so that
+ * comparing two keys with memcmp orders their rows. Rows are sorted in memory until
+ * SORT_MEMORY_BUDGET is exceeded. The sort orders entries holding the first 8 bytes of the key
+ * and the position of the row (radix sort on the prefix for many rows), so most comparisons
+ * don't leave the entry array. Larger inputs are written in sorted runs to spill files and
+ * merged with a loser tree, at most SORT_MERGE_FAN_IN runs at a time (in several passes for
+ * more runs). The sort is stable.
+ *
+ * With a limit (top-N) only the first rows are kept, in a bounded max heap on the sort key,
+ * so rows past the limit are dropped as they arrive instead of being sorted or spilled.
+ */
+class SortOperator : public Operator {
+    struct SortedRow {
+        Row row;
+        std::string key;
+        // Position of the row in the child. Ties are broken by it to keep the sort stable
+        uint64_t sequence = 0;
+    };
+
+    /**
+     * @brief Row of mRows in the in-memory sort, with the first 8 bytes of its key (big endian)
+     */
+    struct SortEntry {
+        uint64_t prefix;
+        uint32_t row;
+    };
+
+    std::unique_ptr<Operator> mChild;
+    std::vector< uint32_t > mSortColumns;
+    std::vector< bool > mDescending;
+    std::vector< TYPE > mSortTypes;
+
+    std::vector< SortedRow > mRows;
+    // Rows of mRows in sorted order
+    std::vector< SortEntry > mOrder;
+    uint64_t mRowsBytes = 0;
+    uint64_t mNextRow = 0;
+
+    // Rows kept by a top-N sort. mRows is a max heap while the child is read
+    bool mTopN = false;
+    uint64_t mLimit = 0;
+    uint64_t mProduced = 0;
+    // False once a top-N sort gives up the heap because the kept rows don't fit in memory
+    bool mHeap = false;
+    uint64_t mDropped = 0;
+
+    // Sorted runs, in the order they were written
+    std::vector< uint64_t > mRunFiles;
+    // Runs being merged and their first row not produced yet
+    std::vector< std::unique_ptr<Operator> > mRuns;
+    std::vector< SortedRow > mRunHeads;
+    std::vector< bool > mRunEnded;
+    // Loser tree of the merge. mLosers[0] is the run with the next row, mLosers[n] the run that lost
+    // at internal node n. Runs are the leaves: run r is node mRuns.size() + r
+    std::vector< uint32_t > mLosers;
+
+    void getSortKey(const Row& row, std::string& key);
+    void getBatchSortKey(const Batch& batch, uint32_t row, std::string& key);
+    bool rowBefore(const SortedRow& lRow, const SortedRow& rRow);
+    bool dropsRow(const SortedRow& sortedRow);
+    bool addRow(SortedRow& sortedRow);
+    void sortRows();
+    bool writeRun();
+
+    bool runBefore(uint32_t lRun, uint32_t rRun);
+    bool advanceRun(uint32_t run);
+    bool startMerge(const std::vector< uint64_t >& runFiles);
+    bool nextMerged(Row& row);
+    void closeMerge();
+    bool mergeRuns(const std::vector< uint64_t >& runFiles, uint64_t fileId);
+    bool mergeRunPass();
+public:
+    SortOperator(std::unique_ptr<Operator> child, const std::vector< uint32_t >& sortColumns, const std::vector< bool >& descending);
+
+    /**
+     * @brief Produce only the first rows (top-N). Called before open
+     */
+    void setLimit(uint64_t rows){ mTopN = true; mLimit = rows; }
+    bool open() override;
+    bool next(Row& row) override;
+    void close() override;
+    uint64_t estimateRows() override { return mChild->estimateRows(); }
+    int32_t getSortColumn() override { return mDescending[0] ? -1 : mSortColumns[0]; }
+    bool failed() override { return mFailed || mChild->failed(); }
+};
+
+/**
+ * @brief Skips the first offset rows of the child and produces at most limit rows after them.
+ * The child isn't pulled once the limit is met, so scans and joins below stop reading
+ */
+class LimitOperator : public Operator {
+    std::unique_ptr<Operator> mChild;
+    uint64_t mLimit;
+    uint64_t mOffset;
+    // Rows skipped and produced so far
+    uint64_t mSkipped = 0;
+    uint64_t mProduced = 0;
+public:
+    LimitOperator(std::unique_ptr<Operator> child, uint64_t limit, uint64_t offset);
+    bool open() override;
+    bool next(Row& row) override;
+    bool nextBatch(Batch& batch) override;
+    void close() override { mChild->close(); }
+    uint64_t estimateRows() override;
+    int32_t getSortColumn() override { return mChild->getSortColumn(); }
+    bool failed() override { return mFailed || mChild->failed(); }
+};
+
+/**
+ * @brief Produces rows given by the planner, e.g. aggregates answered from table statistics
+ */
+class ValuesOperator : public Operator {
+    std::vector< std::string > mRows;
+    uint64_t mNextRow = 0;
+public:
+    /**
+     * @param rows rows in the decoded row format (see getColumnOffsets)
+     */
+    ValuesOperator(const std::vector< std::vector< std::string > >& columns, const std::vector< std::string >& rows);
+    bool open() override;
+    bool next(Row& row) override;
+    void close() override {}
+    uint64_t estimateRows() override { return mRows.size(); }
+};
+
+enum class AGGREGATE {
+    COUNT,
+    SUM,
+    MIN,
+    MAX,
+    AVG
+};
+
+/**
+ * @brief Aggregate function of a column of the rows being grouped
+ */
+struct AggregateFunction {
+    AGGREGATE function;
+    // Column the function reads. -1 for count(*)
+    int32_t column;
+    // Name of the produced column
+    std::string name;
+};
+
+/**
+ * @brief Groups the rows of the child on the group columns and produces one row per group: the group
+ * columns followed by the aggregates. Without group columns every row is in one group, which is
+ * produced even for no rows: counts and sums of no rows are 0, while min, max and avg fail the query.
+ *
+ * Groups are found through a flat open addressing table on the group key (values of the group
+ * columns in the decoded row format). The aggregate states of all groups are stored inline in one
+ * array. Once the groups take more than AGGREGATE_MEMORY_BUDGET, rows of groups not in the table
+ * are written to spill files partitioned by key hash. Rows of groups in the table still update them.
+ * Every partition is aggregated on its own after the groups in memory are produced.
+ *
+ * Parallel children (see Operator::produceParallel) are aggregated by the workers of the WorkerPool
+ * (see aggregateParallel). Groups are then produced partition by partition.
+ */
+class AggregateOperator : public Operator {
+    /**
+     * @brief State of an aggregate of a group. count is the number of values, so min and max know if they are set
+     */
+    struct AggregateState {
+        int64_t intValue;
+        double floatValue;
+        uint64_t count;
+    };
+
+    struct SpilledPartition {
+        uint64_t fileId;
+        uint32_t level;
+    };
+
+    /**
+     * @brief Groups with their keys (values of the group columns in the decoded row format) and aggregate states
+     */
+    struct GroupTable {
+        // Keys back to back in the order groups were added. The key of group g ends where the key of g+1 starts
+        std::string keyBytes;
+        std::vector< uint64_t > keyOffsets;
+        std::vector< uint64_t > hashes;
+        // mAggregates.size() states per group
+        std::vector< AggregateState > states;
+        // Values of min and max of string columns, indexed like states. Empty if no aggregate reads one
+        std::vector< std::string > stringStates;
+        // Flat open addressing table storing the group of every key. -1 marks an empty slot.
+        // Empty for tables groups are only appended to (runs of pre-aggregated groups)
+        std::vector< int32_t > slots;
+        uint64_t slotMask = 0;
+        uint64_t bytes = 0;
+
+        uint32_t size() const { return hashes.size(); }
+    };
+
+    std::unique_ptr<Operator> mChild;
+    std::vector< uint32_t > mGroupColumns;
+    std::vector< AggregateFunction > mAggregates;
+    // Type of the column every aggregate reads
+    std::vector< TYPE > mAggregateTypes;
+    std::vector< std::vector< std::string > > mChildColumns;
+    bool mStringAggregates = false;
+
+    // Groups to produce: one table, or one per partition after a parallel aggregation
+    std::vector< GroupTable > mTables;
+    uint32_t mNextTable = 0;
+    uint64_t mNextGroup = 0;
+    uint64_t mProducedGroups = 0;
+
+    // Spill files of the partitions to aggregate after the groups in memory
+    std::vector< SpilledPartition > mPendingPartitions;
+
+    /**
+     * @param indexed groups are looked up by key. Otherwise they are only appended
+     */
+    void clearGroups(GroupTable& table, bool indexed = true);
+    void getGroupKey(const Batch& batch, uint32_t row, std::string& key);
+    int64_t findGroup(const GroupTable& table, const char* key, uint64_t length, uint64_t hash);
+
+    /**
+     * @brief Add a group with empty aggregate states
+     */
+    uint32_t addGroup(GroupTable& table, const char* key, uint64_t length, uint64_t hash);
+    void updateGroup(GroupTable& table, uint32_t group, const Batch& batch, uint32_t row);
+
+    /**
+     * @brief Combine the aggregate states of a group of another table into a group
+     */
+    void mergeGroup(GroupTable& table, uint32_t group, const GroupTable& from, uint32_t fromGroup);
+    bool aggregate(Operator& input, uint32_t level);
+
+    /**
+     * @brief Aggregate the batches of a parallel child (see Operator::produceParallel). Every worker groups
+     * its rows in a table of at most PREAGGREGATE_GROUPS groups. Once full, its groups are moved to runs
+     * radix partitioned by key hash. Partitions are then merged by the workers, one table per partition
+     *
+     * @param fits set to false if the runs outgrew AGGREGATE_MEMORY_BUDGET. The rows are then aggregated by aggregate
+     * @return false on errors
+     */
+    bool aggregateParallel(bool& fits);
+
+    /**
+     * @brief Next group to produce. Spilled partitions are aggregated once the groups in memory are produced
+     */
+    bool nextGroup(const GroupTable*& table, uint32_t& group);
+
+    /**
+     * @brief Value of a min or max of a string column in the decoded row format
+     */
+    std::string getStringValue(const GroupTable& table, uint32_t group, uint32_t aggregate);
+public:
+    AggregateOperator(std::unique_ptr<Operator> child, const std::vector< uint32_t >& groupColumns, const std::vector< AggregateFunction >& aggregates);
+    bool open() override;
+    bool next(Row& row) override;
+    bool nextBatch(Batch& batch) override;
+    void close() override;
+    uint64_t estimateRows() override;
+    bool failed() override { return mFailed || mChild->failed(); }
+};
+
+/**
+ * @brief Joins rows of the child (left input) with rows of a table (right input).
+ * Equality conditions between columns of the same type form the key of an in-memory hash
+ * table built on the smaller input (by estimateRows). The other input probes it. Without
+ * such conditions every pair of rows is checked (nested loop).
+ *
+ * Build inputs larger than JOIN_MEMORY_BUDGET are partitioned by key hash (hybrid hash join).
+ * Partitions are kept in memory until the budget is exceeded, then the largest ones are
+ * written to spill files along with their probe rows. Spilled partition pairs are joined
+ * after the probe input ends, partitioning them again if they still don't fit. Partitions of
+ * a single skewed key are joined in chunks of build rows.
+ *
+ * A Bloom filter on the build keys is pushed into the probe input (JOIN_BLOOM_FILTERS), so
+ * probe rows without a partner are dropped by the scan before they are decoded, probed or spilled.
+ *
+ * Range conditions (<, <=, >, >=) between int or float columns are joined by sort-merge
+ * instead of the nested loop: both inputs are sorted (SortOperator) and the table rows are
+ * swept with band semantics. A table row becomes active once a child value passes its start
+ * bound and is evicted (min heap on the end bound) once the child values pass its end bound.
+ * Equality conditions take this path too when both inputs are already sorted on them.
+ */
+class JoinOperator : public Operator {
+    /**
+     * @brief Build and probe rows of a spilled partition
+     */
+    struct SpilledPartition {
+        uint64_t buildFile;
+        uint64_t probeFile;
+        uint32_t level;
+        // Build rows already joined (partitions joined in chunks)
+        uint64_t buildRowsDone;
+    };
+
+    std::unique_ptr<Operator> mChild;
+    std::unique_ptr<Operator> mBuild;
+    // Conditions with a child column on the LHS and a build column on the RHS
+    std::vector< condition > mConditions;
+    std::vector< uint32_t > mLeftIndices;
+    std::vector< uint32_t > mRightIndices;
+    // Conditions used as the hash key and conditions checked for every candidate pair
+    std::vector< uint32_t > mKeyConditions;
+    std::vector< uint32_t > mResidualConditions;
+
+    // True if the hash table is built on the child instead of the table
+    bool mBuildLeft = false;
+    Operator* mBuildInput = nullptr;
+    Operator* mProbeInput = nullptr;
+
+    std::vector< Row > mBuildRows;
+    // Values of the residual condition columns of every build row
+    std::vector< std::vector< std::string > > mBuildValues;
+    std::vector< std::string > mBuildKeys;
+    std::vector< uint64_t > mBuildHashes;
+    uint64_t mBuildBytes = 0;
+    // Next build row with the same key. -1 ends the chain
+    std::vector< int32_t > mNextRow;
+    // Flat open addressing table storing the first build row of every key. -1 marks an empty slot
+    std::vector< int32_t > mSlots;
+    uint64_t mSlotMask = 0;
+
+    // Partitioning of the original inputs. Probe rows of spilled partitions are written to mProbeSpills
+    bool mPartitioned = false;
+    std::vector< uint64_t > mSpilledBuildFiles;
+    std::vector< std::unique_ptr<ResultAppender> > mProbeSpills;
+    std::vector< uint64_t > mSpilledProbeFiles;
+    // Spilled partitions waiting to be joined and the one being joined
+    std::vector< SpilledPartition > mPendingPartitions;
+    bool mJoiningPartition = false;
+    SpilledPartition mCurrentPartition;
+    // True if build rows of the current partition are left for another chunk
+    bool mPendingChunks = false;
+    std::unique_ptr<Operator> mPartitionProbe;
+    // Every spill file not deleted yet
+    std::vector< uint64_t > mSpillFiles;
+
+    // Output rows estimated by the join planner. Without it the larger input size is used
+    uint64_t mEstimatedRows = 0;
+    bool mHasEstimate = false;
+
+    // Filter on the keys of the build input. Checked here when the probe input doesn't accept it
+    std::shared_ptr<BloomFilter> mBloomFilter;
+    bool mBloomPushed = false;
+
+    /**
+     * @brief Table row of the sort-merge sweep that can match the current child rows
+     */
+    struct ActiveRow {
+        Row row;
+        std::vector< std::string > values;
+        SortValue end;
+    };
+
+    // Sort-merge strategy. The child is sorted on mSweepColumn, the table on the right column of the start condition
+    bool mMerge = false;
+    // Sweep from the largest to the smallest child value (used when there is no start condition)
+    bool mDescending = false;
+    uint32_t mSweepColumn = 0;
+    TYPE mSweepType;
+    // Condition bounding table rows from below (start) and above (end) in sweep order. -1 if there is none
+    int32_t mStartCondition = -1;
+    int32_t mEndCondition = -1;
+    COMPARISON mStartOperation;
+    COMPARISON mEndOperation;
+    std::vector< ActiveRow > mActiveRows;
+    Row mPendingRow;
+    SortValue mPendingStart;
+    bool mHasPendingRow = false;
+
+    Row mProbeRow;
+    std::vector< std::string > mProbeValues;
+    bool mHasProbeRow = false;
+    // Next build row to check against the probe row
+    int64_t mCandidate = -1;
+
+    std::vector< std::string > getJoinValues(const Row& row, const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& indices, const std::vector< uint32_t >& conditions);
+    std::string getJoinKey(const Row& row, const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& indices);
+    int64_t findKey(const std::string& key, uint64_t hash);
+    bool matchesResidual(const std::vector< std::string >& buildValues, bool& failed);
+
+    void clearBuildRows();
+    void addBuildRow(Row& row);
+    void buildHashTable();
+    bool partitionBuildInput();
+    bool repartition(const SpilledPartition& partition);
+    bool startNextPartition();
+    void removeSpillFile(uint64_t fileId);
+
+    bool chooseMergeConditions();
+    bool sweepAccepts(COMPARISON operation, const SortValue& probeValue, const SortValue& value);
+    bool activeRowAfter(const ActiveRow& lRow, const ActiveRow& rRow);
+    bool fetchPendingRow();
+    bool nextMerge(Row& row);
+public:
+    JoinOperator(std::unique_ptr<Operator> child, std::unique_ptr<Operator> build, const std::vector< condition >& conditions);
+    bool open() override;
+    bool next(Row& row) override;
+    void close() override;
+    uint64_t estimateRows() override;
+    void setEstimatedRows(uint64_t rows){ mEstimatedRows = rows; mHasEstimate = true; }
+    int32_t getSortColumn() override { return (mMerge && !mDescending) ? mSweepColumn : -1; }
+    bool failed() override { return mFailed || mChild->failed() || mBuild->failed(); }
+};
+
+/**
+ * @brief Runs the pipeline and prints every row as soon as it is produced.
+ * Batches are pulled instead of rows when VECTORIZED_EXECUTION is set
+ */
+void printQuery(Operator& root);
+
+#endif // EXECUTOR_H
@@ -0,0 +1,443 @@
+#include <string.h>
+#include "expression.h"
+#include "../logger/logger.h"
+
+/**
+ * @brief Recursive descent parser of expressions. Binary operators are left associative,
+ * * and / bind tighter than + and -
+ */
+class ExpressionParser {
+    const std::string& mText;
+    uint32_t mPosition = 0;
+
+    void skipSpaces(){
+        while(mPosition < mText.length() && (mText[mPosition] == ' ' || mText[mPosition] == '\n')){
+            mPosition++;
+        }
+    }
+
+    bool isNameCharacter(char c){
+        return (c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c == '_';
+    }
+
+    std::unique_ptr<Expression> makeOperation(EXPRESSION kind, std::unique_ptr<Expression> lhs, std::unique_ptr<Expression> rhs){
+        std::unique_ptr<Expression> expression = std::make_unique<Expression>();
+        expression->kind = kind;
+        expression->operands.push_back(std::move(lhs));
+        if(rhs){
+            expression->operands.push_back(std::move(rhs));
+        }
+        return expression;
+    }
+
+    std::unique_ptr<Expression> parsePrimary(){
+        skipSpaces();
+        if(mPosition >= mText.length()){
+            return nullptr;
+        }
+
+        char c = mText[mPosition];
+        if(c == '('){
+            mPosition++;
+            std::unique_ptr<Expression> expression = parseSum();
+            skipSpaces();
+            if(!expression || mPosition >= mText.length() || mText[mPosition] != ')'){
+                return nullptr;
+            }
+            mPosition++;
+            return expression;
+        }
+
+        std::unique_ptr<Expression> expression = std::make_unique<Expression>();
+        uint32_t start = mPosition;
+        if(c >= '0' && c <= '9'){
+            bool fraction = false;
+            while(mPosition < mText.length() && ((mText[mPosition]>='0' && mText[mPosition]<='9') || (mText[mPosition] == '.' && !fraction))){
+                fraction = fraction || mText[mPosition] == '.';
+                mPosition++;
+            }
+            std::string literal = mText.substr(start, mPosition - start);
+            if(fraction){
+                expression->kind = EXPRESSION::FLOAT;
+                expression->floatValue = std::stod(literal);
+            } else {
+                // Larger literals don't fit in an int
+                if(literal.length() > 18){
+                    return nullptr;
+                }
+                expression->kind = EXPRESSION::INT;
+                expression->intValue = std::stoll(literal);
+            }
+            return expression;
+        }
+
+        if(!isNameCharacter(c)){
+            return nullptr;
+        }
+        // column or table.column
+        bool qualified = false;
+        while(mPosition < mText.length() && (isNameCharacter(mText[mPosition]) || (mText[mPosition] == '.' && !qualified))){
+            qualified = qualified || mText[mPosition] == '.';
+            mPosition++;
+        }
+        expression->kind = EXPRESSION::COLUMN;
+        expression->name = mText.substr(start, mPosition - start);
+        if(expression->name.back() == '.'){
+            return nullptr;
+        }
+
+        // function(argument). count also takes *
+        skipSpaces();
+        if(mPosition >= mText.length() || mText[mPosition] != '(' || !isAggregateFunction(expression->name)){
+            return expression;
+        }
+        mPosition++;
+        expression->kind = EXPRESSION::AGGREGATE;
+        skipSpaces();
+        if(expression->name == "count" && mPosition < mText.length() && mText[mPosition] == '*'){
+            mPosition++;
+        } else {
+            std::unique_ptr<Expression> argument = parseSum();
+            if(!argument){
+                return nullptr;
+            }
+            expression->operands.push_back(std::move(argument));
+        }
+        skipSpaces();
+        if(mPosition >= mText.length() || mText[mPosition] != ')'){
+            return nullptr;
+        }
+        mPosition++;
+        return expression;
+    }
+
+    std::unique_ptr<Expression> parseUnary(){
+        skipSpaces();
+        if(mPosition < mText.length() && mText[mPosition] == '-'){
+            mPosition++;
+            std::unique_ptr<Expression> operand = parseUnary();
+            if(!operand){
+                return nullptr;
+            }
+            return makeOperation(EXPRESSION::NEGATE, std::move(operand), nullptr);
+        }
+        return parsePrimary();
+    }
+
+    std::unique_ptr<Expression> parseProduct(){
+        std::unique_ptr<Expression> expression = parseUnary();
+        while(expression){
+            skipSpaces();
+            if(mPosition >= mText.length() || (mText[mPosition] != '*' && mText[mPosition] != '/')){
+                break;
+            }
+            EXPRESSION kind = mText[mPosition] == '*' ? EXPRESSION::MULTIPLY : EXPRESSION::DIVIDE;
+            mPosition++;
+            std::unique_ptr<Expression> rhs = parseUnary();
+            if(!rhs){
+                return nullptr;
+            }
+            expression = makeOperation(kind, std::move(expression), std::move(rhs));
+        }
+        return expression;
+    }
+
+    std::unique_ptr<Expression> parseSum(){
+        std::unique_ptr<Expression> expression = parseProduct();
+        while(expression){
+            skipSpaces();
+            if(mPosition >= mText.length() || (mText[mPosition] != '+' && mText[mPosition] != '-')){
+                break;
+            }
+            EXPRESSION kind = mText[mPosition] == '+' ? EXPRESSION::ADD : EXPRESSION::SUBTRACT;
+            mPosition++;
+            std::unique_ptr<Expression> rhs = parseProduct();
+            if(!rhs){
+                return nullptr;
+            }
+            expression = makeOperation(kind, std::move(expression), std::move(rhs));
+        }
+        return expression;
+    }
+public:
+    ExpressionParser(const std::string& text) : mText(text) {}
+
+    std::unique_ptr<Expression> parse(){
+        std::unique_ptr<Expression> expression = parseSum();
+        skipSpaces();
+        if(mPosition < mText.length()){
+            return nullptr;
+        }
+        return expression;
+    }
+};
+
+std::unique_ptr<Expression> parseExpression(const std::string& text){
+    std::unique_ptr<Expression> expression = ExpressionParser(text).parse();
+    if(!expression){
+        Logger::logError("Invalid expression "+text);
+    }
+    return expression;
+}
+
+bool isAggregateFunction(const std::string& name){
+    return name == "count" || name == "sum" || name == "min" || name == "max" || name == "avg";
+}
+
+bool hasAggregate(const Expression& expression){
+    if(expression.kind == EXPRESSION::AGGREGATE){
+        return true;
+    }
+    for(int i=0; i<expression.operands.size(); i++){
+        if(hasAggregate(*expression.operands[i])){
+            return true;
+        }
+    }
+    return false;
+}
+
+void getExpressionColumns(const Expression& expression, std::vector< std::string >& names){
+    if(expression.kind == EXPRESSION::COLUMN){
+        names.push_back(expression.name);
+    }
+    for(int i=0; i<expression.operands.size(); i++){
+        getExpressionColumns(*expression.operands[i], names);
+    }
+}
+
+bool bindExpression(Expression& expression, const std::vector< std::vector< std::string > >& columns, const std::function< int32_t(const std::string&) >& findColumn){
+    switch(expression.kind){
+        case EXPRESSION::COLUMN:
+            expression.column = findColumn(expression.name);
+            if(expression.column < 0){
+                Logger::logError("Column "+expression.name+" doesn't exist");
+                return false;
+            }
+            expression.type = columns[expression.column][1];
+            return true;
+        case EXPRESSION::INT:
+            expression.type = "int";
+            return true;
+        case EXPRESSION::FLOAT:
+            expression.type = "float";
+            return true;
+        case EXPRESSION::AGGREGATE:
+            // Aggregates are replaced by columns of the groups, so this one is inside another aggregate
+            Logger::logError("Aggregate function "+expression.name+" can't be used inside another aggregate function");
+            return false;
+        default:
+            break;
+    }
+
+    expression.type = "int";
+    for(int i=0; i<expression.operands.size(); i++){
+        Expression& operand = *expression.operands[i];
+        if(!bindExpression(operand, columns, findColumn)){
+            return false;
+        }
+        TYPE type = getTypeFromString(operand.type);
+        if(type != TYPE::INT && type != TYPE::FLOAT){
+            Logger::logError("Only int and float columns can be used in arithmetic. "+operand.name+" is "+operand.type);
+            return false;
+        }
+        if(type == TYPE::FLOAT){
+            expression.type = "float";
+        }
+    }
+    return true;
+}
+
+// Integer arithmetic wraps around on overflow
+inline int64_t wrapAdd(int64_t lhs, int64_t rhs){ return (int64_t)((uint64_t)lhs + (uint64_t)rhs); }
+inline int64_t wrapSubtract(int64_t lhs, int64_t rhs){ return (int64_t)((uint64_t)lhs - (uint64_t)rhs); }
+inline int64_t wrapMultiply(int64_t lhs, int64_t rhs){ return (int64_t)((uint64_t)lhs * (uint64_t)rhs); }
+
+inline bool divide(int64_t lhs, int64_t rhs, int64_t& result){
+    if(rhs == 0){
+        return false;
+    }
+    // INT64_MIN / -1 overflows
+    result = rhs == -1 ? wrapSubtract(0, lhs) : lhs / rhs;
+    return true;
+}
+
+bool evaluateInt(const Expression& expression, const char row[], const std::vector< uint32_t >& offsets, int64_t& result){
+    int64_t lhs = 0, rhs = 0;
+    switch(expression.kind){
+        case EXPRESSION::COLUMN:
+            memcpy(&result, row + offsets[expression.column], sizeof(result));
+            return true;
+        case EXPRESSION::INT:
+            result = expression.intValue;
+            return true;
+        case EXPRESSION::NEGATE:
+            if(!evaluateInt(*expression.operands[0], row, offsets, lhs)){
+                return false;
+            }
+            result = wrapSubtract(0, lhs);
+            return true;
+        default:
+            break;
+    }
+
+    if(!evaluateInt(*expression.operands[0], row, offsets, lhs) || !evaluateInt(*expression.operands[1], row, offsets, rhs)){
+        return false;
+    }
+    switch(expression.kind){
+        case EXPRESSION::ADD:
+            result = wrapAdd(lhs, rhs);
+            return true;
+        case EXPRESSION::SUBTRACT:
+            result = wrapSubtract(lhs, rhs);
+            return true;
+        case EXPRESSION::MULTIPLY:
+            result = wrapMultiply(lhs, rhs);
+            return true;
+        default:
+            return divide(lhs, rhs, result);
+    }
+}
+
+bool evaluateFloat(const Expression& expression, const char row[], const std::vector< uint32_t >& offsets, double& result){
+    if(getTypeFromString(expression.type) == TYPE::INT){
+        int64_t value;
+        if(!evaluateInt(expression, row, offsets, value)){
+            return false;
+        }
+        result = value;
+        return true;
+    }
+
+    double lhs = 0, rhs = 0;
+    switch(expression.kind){
+        case EXPRESSION::COLUMN:
+            memcpy(&result, row + offsets[expression.column], sizeof(result));
+            return true;
+        case EXPRESSION::FLOAT:
+            result = expression.floatValue;
+            return true;
+        case EXPRESSION::NEGATE:
+            if(!evaluateFloat(*expression.operands[0], row, offsets, lhs)){
+                return false;
+            }
+            result = -lhs;
+            return true;
+        default:
+            break;
+    }
+
+    if(!evaluateFloat(*expression.operands[0], row, offsets, lhs) || !evaluateFloat(*expression.operands[1], row, offsets, rhs)){
+        return false;
+    }
+    switch(expression.kind){
+        case EXPRESSION::ADD:
+            result = lhs + rhs;
+            break;
+        case EXPRESSION::SUBTRACT:
+            result = lhs - rhs;
+            break;
+        case EXPRESSION::MULTIPLY:
+            result = lhs * rhs;
+            break;
+        default:
+            result = lhs / rhs;
+            break;
+    }
+    return true;
+}
+
+/**
+ * @brief Values of an int or float operand for the selected rows, converted to T
+ */
+template<typename T>
+bool getOperandValues(const Expression& expression, const Batch& batch, std::vector< T >& values){
+    ColumnVector operand;
+    if(!evaluateBatch(expression, batch, operand)){
+        return false;
+    }
+    values.resize(batch.size);
+    for(uint32_t i=0; i<batch.selection.size(); i++){
+        uint32_t row = batch.selection[i];
+        values[row] = operand.kind == TYPE::INT ? (T)operand.ints[row] : (T)operand.floats[row];
+    }
+    return true;
+}
+
+template<typename T, typename Operation>
+bool applyOperation(const Expression& expression, const Batch& batch, std::vector< T >& values, Operation operation){
+    std::vector< T > lhs, rhs;
+    if(!getOperandValues(*expression.operands[0], batch, lhs) || !getOperandValues(*expression.operands[1], batch, rhs)){
+        return false;
+    }
+    values.resize(batch.size);
+    for(uint32_t i=0; i<batch.selection.size(); i++){
+        uint32_t row = batch.selection[i];
+        if(!operation(lhs[row], rhs[row], values[row])){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool evaluateBatch(const Expression& expression, const Batch& batch, ColumnVector& result){
+    result.type = expression.type;
+    result.kind = getTypeFromString(expression.type);
+    result.ints.clear();
+    result.floats.clear();
+    result.fields.clear();
+
+    switch(expression.kind){
+        case EXPRESSION::COLUMN:
+            result.ints = batch.columns[expression.column].ints;
+            result.floats = batch.columns[expression.column].floats;
+            return true;
+        case EXPRESSION::INT:
+            result.ints.assign(batch.size, expression.intValue);
+            return true;
+        case EXPRESSION::FLOAT:
+            result.floats.assign(batch.size, expression.floatValue);
+            return true;
+        default:
+            break;
+    }
+
+    if(result.kind == TYPE::INT){
+        switch(expression.kind){
+            case EXPRESSION::NEGATE:
+                if(!getOperandValues(*expression.operands[0], batch, result.ints)){
+                    return false;
+                }
+                for(uint32_t i=0; i<batch.selection.size(); i++){
+                    result.ints[batch.selection[i]] = wrapSubtract(0, result.ints[batch.selection[i]]);
+                }
+                return true;
+            case EXPRESSION::ADD:
+                return applyOperation(expression, batch, result.ints, [](int64_t lhs, int64_t rhs, int64_t& value){ value = wrapAdd(lhs, rhs); return true; });
+            case EXPRESSION::SUBTRACT:
+                return applyOperation(expression, batch, result.ints, [](int64_t lhs, int64_t rhs, int64_t& value){ value = wrapSubtract(lhs, rhs); return true; });
+            case EXPRESSION::MULTIPLY:
+                return applyOperation(expression, batch, result.ints, [](int64_t lhs, int64_t rhs, int64_t& value){ value = wrapMultiply(lhs, rhs); return true; });
+            default:
+                return applyOperation(expression, batch, result.ints, divide);
+        }
+    }
+
+    switch(expression.kind){
+        case EXPRESSION::NEGATE:
+            if(!getOperandValues(*expression.operands[0], batch, result.floats)){
+                return false;
+            }
+            for(uint32_t i=0; i<batch.selection.size(); i++){
+                result.floats[batch.selection[i]] = -result.floats[batch.selection[i]];
+            }
+            return true;
+        case EXPRESSION::ADD:
+            return applyOperation(expression, batch, result.floats, [](double lhs, double rhs, double& value){ value = lhs + rhs; return true; });
+        case EXPRESSION::SUBTRACT:
+            return applyOperation(expression, batch, result.floats, [](double lhs, double rhs, double& value){ value = lhs - rhs; return true; });
+        case EXPRESSION::MULTIPLY:
+            return applyOperation(expression, batch, result.floats, [](double lhs, double rhs, double& value){ value = lhs * rhs; return true; });
+        default:
+            return applyOperation(expression, batch, result.floats, [](double lhs, double rhs, double& value){ value = lhs / rhs; return true; });
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include "../type/type.h"
+#include "../batch/batch.h"
+
+enum class EXPRESSION {
+    COLUMN,
+    INT,
+    FLOAT,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    NEGATE,
+    AGGREGATE
+};
+
+/**
+ * @brief Expression of a select list: a column, or arithmetic (+ - * /) on int and float
+ * columns and literals. int operands give an int result (division truncates), float ones a float result.
+ * Aggregate functions (count, sum, min, max, avg) of a column or expression are computed by
+ * grouping rows and replaced by columns of the groups before the expression is bound
+ */
+struct Expression {
+    EXPRESSION kind;
+    // Column name (COLUMN) and the column of the input it is bound to. Function name for AGGREGATE
+    std::string name;
+    int32_t column = -1;
+    int64_t intValue = 0;
+    double floatValue = 0;
+    // Type of the result, set by bindExpression. Columns keep their type
+    std::string type;
+    std::vector< std::unique_ptr<Expression> > operands;
+};
+
+/**
+ * @brief Parse an expression, e.g. a.price * (1 - discount) / 100
+ *
+ * @return std::unique_ptr<Expression> nullptr on syntax errors
+ */
+std::unique_ptr<Expression> parseExpression(const std::string& text);
+
+/**
+ * @brief Whether the name is an aggregate function (count, sum, min, max, avg)
+ */
+bool isAggregateFunction(const std::string& name);
+
+/**
+ * @brief Whether an expression uses an aggregate function
+ */
+bool hasAggregate(const Expression& expression);
+
+/**
+ * @brief Names of the columns an expression reads
+ */
+void getExpressionColumns(const Expression& expression, std::vector< std::string >& names);
+
+/**
+ * @brief Resolve the columns of an expression and compute its type
+ *
+ * @param columns columns of the input rows
+ * @param findColumn index of a column by name, -1 if it doesn't exist
+ * @return false if a column doesn't exist or isn't a number where arithmetic needs one
+ */
+bool bindExpression(Expression& expression, const std::vector< std::vector< std::string > >& columns, const std::function< int32_t(const std::string&) >& findColumn);
+
+/**
+ * @brief Evaluate a bound int or float expression on a decoded row (see getColumnOffsets)
+ *
+ * @return false on integer division by zero
+ */
+bool evaluateInt(const Expression& expression, const char row[], const std::vector< uint32_t >& offsets, int64_t& result);
+bool evaluateFloat(const Expression& expression, const char row[], const std::vector< uint32_t >& offsets, double& result);
+
+/**
+ * @brief Evaluate a bound int or float expression on the selected rows of a batch. Values of
+ * other rows are left unset
+ *
+ * @param result column of the expression, indexed like the columns of the batch
+ * @return false on integer division by zero
+ */
+bool evaluateBatch(const Expression& expression, const Batch& batch, ColumnVector& result);
+
+#endif // EXPRESSION_H
@@ -0,0 +1,123 @@
+#include <string.h>
+#include <iostream>
+#include <thread>
+#include "ingest.h"
+#include "../properties.h"
+
+InsertBatches& InsertBatches::getManager(){
+    static InsertBatches batches;
+    return batches;
+}
+
+InsertBatches::TableBatches& InsertBatches::getTable(uint64_t fileId){
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::unique_ptr<TableBatches>& table = mTables[fileId];
+    if(!table){
+        table = std::make_unique<TableBatches>();
+        table->current = std::make_shared<Batch>();
+        table->current->data.reset(new char[INSERT_BATCH_BYTES]);
+    }
+    return *table;
+}
+
+bool InsertBatches::fits(const std::string& record, const std::string& row){
+    return 2*sizeof(uint32_t) + record.length() + row.length() <= INSERT_BATCH_BYTES;
+}
+
+void InsertBatches::close(TableBatches& table, const std::shared_ptr<Batch>& batch, uint64_t end){
+    batch->end = end;
+    std::shared_ptr<Batch> next = std::make_shared<Batch>();
+    next->data.reset(new char[INSERT_BATCH_BYTES]);
+    next->sequence = batch->sequence + 1;
+    std::atomic_store(&table.current, next);
+}
+
+bool InsertBatches::insert(uint64_t fileId, const std::string& record, const std::string& row, const std::function< bool() >& appendAlone,
+    const std::function< bool(std::vector< std::string >& records, const std::vector< std::string >& rows) >& appendBatch){
+    TableBatches& table = getTable(fileId);
+    struct SessionCount {
+        std::atomic<uint32_t>& sessions;
+        ~SessionCount(){ sessions--; }
+    } count{table.sessions};
+    if(table.sessions++ == 0){
+        return appendAlone();
+    }
+
+    uint32_t recordLength = record.length();
+    uint32_t rowLength = row.length();
+    uint64_t size = 2*sizeof(uint32_t) + recordLength + rowLength;
+
+    std::shared_ptr<Batch> batch;
+    uint64_t offset;
+    while(true){
+        batch = std::atomic_load(&table.current);
+        offset = batch->reserved.fetch_add(size);
+        if(offset + size <= INSERT_BATCH_BYTES){
+            break;
+        }
+        if(offset <= INSERT_BATCH_BYTES){
+            // Only the reservation crossing the end of the batch gets here
+            close(table, batch, offset);
+            continue;
+        }
+        // Closed by another session, which opens the next batch right after
+        while(std::atomic_load(&table.current) == batch){
+            std::this_thread::yield();
+        }
+    }
+
+    char* entry = batch->data.get() + offset;
+    memcpy(entry, &recordLength, sizeof(recordLength));
+    memcpy(entry + sizeof(recordLength), &rowLength, sizeof(rowLength));
+    memcpy(entry + 2*sizeof(uint32_t), record.c_str(), recordLength);
+    memcpy(entry + 2*sizeof(uint32_t) + recordLength, row.c_str(), rowLength);
+    batch->written += size;
+
+    if(offset){
+        std::unique_lock<std::mutex> lock(table.mutex);
+        table.published.wait(lock, [&](){ return batch->published; });
+        return batch->succeeded;
+    }
+
+    // The session reserving the start of the batch appends it once the batch before is appended
+    {
+        std::unique_lock<std::mutex> lock(table.mutex);
+        table.published.wait(lock, [&](){ return table.appended == batch->sequence; });
+    }
+    uint64_t end = batch->reserved.fetch_add(INSERT_BATCH_BYTES + 1);
+    if(end <= INSERT_BATCH_BYTES){
+        close(table, batch, end);
+    }
+    while(batch->end == UINT64_MAX){
+        std::this_thread::yield();
+    }
+    end = batch->end;
+    // Sessions still copying their rows are between their reservation and the add to written
+    while(batch->written < end){
+        std::this_thread::yield();
+    }
+
+    std::vector< std::string > records;
+    std::vector< std::string > rows;
+    for(uint64_t i=0; i<end;){
+        entry = batch->data.get() + i;
+        memcpy(&recordLength, entry, sizeof(recordLength));
+        memcpy(&rowLength, entry + sizeof(recordLength), sizeof(rowLength));
+        records.push_back(std::string(entry + 2*sizeof(uint32_t), recordLength));
+        rows.push_back(std::string(entry + 2*sizeof(uint32_t) + recordLength, rowLength));
+        i += 2*sizeof(uint32_t) + recordLength + rowLength;
+    }
+
+    bool succeeded = appendBatch(records, rows);
+    if(DEBUG == true && records.size() > 1){
+        std::cout << "Appended " << records.size() << " rows of concurrent inserts in one transaction" << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(table.mutex);
+        batch->published = true;
+        batch->succeeded = succeeded;
+        table.appended++;
+    }
+    table.published.notify_all();
+    return succeeded;
+}
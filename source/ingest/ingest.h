@@ -0,0 +1,83 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+/**
+ * @brief Rows of inserts into a table running at the same time, appended to the table together (group commit).
+ *
+ * Every insert transaction changes the metadata page and the last page of its table, so inserts of
+ * different sessions would wait for each other's commits. Instead, sessions reserve room for their rows in
+ * the open batch of the table with an atomic add on its cursor and copy them in without locks. The
+ * session reserving the start of a batch appends it in a transaction of its own once the batch before
+ * is appended, taking a block of row IDs from the metadata page and writing every page once. Rows
+ * arriving meanwhile fill the next batch, so batches grow with the number of sessions inserting.
+ * Sessions return once their batch committed, so their next statements see their rows. A session
+ * inserting while no other one inserts into the table appends its row itself, without a batch.
+ */
+class InsertBatches {
+    struct Batch {
+        // Bytes reserved. Past INSERT_BATCH_BYTES, the batch is closed
+        std::atomic<uint64_t> reserved{0};
+        // Bytes copied in
+        std::atomic<uint64_t> written{0};
+        // Bytes of rows in the batch, set by the session closing it
+        std::atomic<uint64_t> end{UINT64_MAX};
+        // Batches of the table opened before this one. Batches are appended in that order
+        uint64_t sequence = 0;
+        bool published = false;
+        bool succeeded = false;
+        // Rows as (length of encoded record, length of row, record, row)
+        std::unique_ptr<char[]> data;
+    };
+
+    struct TableBatches {
+        // Sessions inserting into the table
+        std::atomic<uint32_t> sessions{0};
+        std::shared_ptr<Batch> current;
+        // Batches appended so far. The next batch fills while one is appended, then waits for its turn
+        uint64_t appended = 0;
+        std::mutex mutex;
+        std::condition_variable published;
+    };
+
+    std::mutex mMutex;
+    std::map< uint64_t, std::unique_ptr<TableBatches> > mTables;
+
+    TableBatches& getTable(uint64_t fileId);
+
+    /**
+     * @brief Close a batch at the given end and open the next one. Called by the session whose reservation crossed its end
+     */
+    void close(TableBatches& table, const std::shared_ptr<Batch>& batch, uint64_t end);
+public:
+    static InsertBatches& getManager();
+
+    /**
+     * @brief Whether a row fits in a batch. Larger rows are inserted on their own
+     */
+    static bool fits(const std::string& record, const std::string& row);
+
+    /**
+     * @brief Add a row to the open batch of the table and wait until the batch is appended
+     *
+     * @param record encoded record. Its ID is set when the batch is appended
+     * @param row decoded row, for the statistics of the table
+     * @param appendAlone appends the row in the transaction of the statement, if no other session inserts into the table
+     * @param appendBatch appends the records and rows of a batch in a transaction of its own and commits it.
+     * Run by one of the sessions of the batch
+     * @return true if the row was appended
+     */
+    bool insert(uint64_t fileId, const std::string& record, const std::string& row, const std::function< bool() >& appendAlone,
+        const std::function< bool(std::vector< std::string >& records, const std::vector< std::string >& rows) >& appendBatch);
+};
+
+#endif // INGEST_H
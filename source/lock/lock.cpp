@@ -0,0 +1,227 @@
+#include <thread>
+#include <chrono>
+#include "lock.h"
+#include "../properties.h"
+
+/**
+ * @brief Whether a mode can be granted while another statement holds the table in a mode (indexed by LOCK_MODE)
+ */
+const bool LOCK_COMPATIBILITY[4][4] = {
+    // IS     IX     S      X
+    { true,  true,  true,  false }, // IS
+    { true,  true,  false, false }, // IX
+    { true,  false, true,  false }, // S
+    { false, false, false, false }  // X
+};
+
+bool PageLatch::tryLockShared(){
+    int32_t state = mState.load();
+    while(state >= 0){
+        if(mState.compare_exchange_weak(state, state + 1)){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PageLatch::tryLockExclusive(){
+    int32_t state = 0;
+    return mState.compare_exchange_strong(state, -1);
+}
+
+void PageLatch::wakeParked(){
+    // The state was released before mParked is read, and parked threads count themselves before checking
+    // the state again, so one of the two sees the other
+    if(mParked > 0){
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReleased.notify_all();
+    }
+}
+
+bool PageLatch::lockShared(){
+    for(uint32_t i=0; i<LATCH_SPINS; i++){
+        if(tryLockShared()){
+            return false;
+        }
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mParked++;
+    mReleased.wait(lock, [&](){ return tryLockShared(); });
+    mParked--;
+    return true;
+}
+
+bool PageLatch::lockExclusive(){
+    for(uint32_t i=0; i<LATCH_SPINS; i++){
+        if(tryLockExclusive()){
+            return false;
+        }
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mParked++;
+    mReleased.wait(lock, [&](){ return tryLockExclusive(); });
+    mParked--;
+    return true;
+}
+
+void PageLatch::unlockShared(){
+    if(mState.fetch_sub(1) == 1){
+        wakeParked();
+    }
+}
+
+void PageLatch::unlockExclusive(){
+    mState.store(0);
+    wakeParked();
+}
+
+LockManager& LockManager::getManager(){
+    static LockManager manager;
+    return manager;
+}
+
+bool LockManager::isCompatible(const TableEntry& entry, LOCK_MODE mode){
+    for(int i=0; i<4; i++){
+        if(entry.granted[i] > 0 && !LOCK_COMPATIBILITY[(int)mode][i]){
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t LockManager::getShard(uint64_t fileId, uint64_t pageNumber){
+    // Consecutive pages of a table go to different shards
+    return (fileId * 31 + pageNumber) % LATCH_SHARDS;
+}
+
+void LockManager::lockTable(uint64_t tableId, LOCK_MODE mode){
+    std::unique_lock<std::mutex> lock(mTableMutex);
+    TableEntry& entry = mTables[tableId];
+
+    if(!isCompatible(entry, mode)){
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        entry.waiting++;
+        entry.released.wait(lock, [&](){ return isCompatible(entry, mode); });
+        entry.waiting--;
+
+        mTableWaits++;
+        mTableWaitNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    entry.granted[(int)mode]++;
+}
+
+void LockManager::unlockTable(uint64_t tableId, LOCK_MODE mode){
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    std::map< uint64_t, TableEntry >::iterator it = mTables.find(tableId);
+    if(it == mTables.end() || it->second.granted[(int)mode] == 0){
+        return;
+    }
+
+    TableEntry& entry = it->second;
+    entry.granted[(int)mode]--;
+    if(entry.waiting > 0){
+        entry.released.notify_all();
+    } else if(entry.granted[0] + entry.granted[1] + entry.granted[2] + entry.granted[3] == 0){
+        mTables.erase(it);
+    }
+}
+
+void LockManager::latchPage(uint64_t fileId, uint64_t pageNumber, bool exclusive){
+    uint32_t shard = getShard(fileId, pageNumber);
+    PageLatch* latch;
+    {
+        std::lock_guard<std::mutex> lock(mLatchMutexes[shard]);
+        LatchEntry& entry = mLatches[shard][std::make_pair(fileId, pageNumber)];
+        entry.users++;
+        latch = &entry.latch;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool parked = exclusive ? latch->lockExclusive() : latch->lockShared();
+    if(parked){
+        mLatchWaits++;
+        mLatchWaitNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+void LockManager::unlatchPage(uint64_t fileId, uint64_t pageNumber, bool exclusive){
+    uint32_t shard = getShard(fileId, pageNumber);
+    std::lock_guard<std::mutex> lock(mLatchMutexes[shard]);
+    std::map< std::pair< uint64_t, uint64_t >, LatchEntry >::iterator it = mLatches[shard].find(std::make_pair(fileId, pageNumber));
+    if(it == mLatches[shard].end()){
+        return;
+    }
+
+    if(exclusive){
+        it->second.latch.unlockExclusive();
+    } else {
+        it->second.latch.unlockShared();
+    }
+    if(--it->second.users == 0){
+        mLatches[shard].erase(it);
+    }
+}
+
+LockStats LockManager::getStats(){
+    LockStats stats;
+    stats.tableWaits = mTableWaits;
+    stats.tableWaitNanos = mTableWaitNanos;
+    stats.latchWaits = mLatchWaits;
+    stats.latchWaitNanos = mLatchWaitNanos;
+    return stats;
+}
+
+void TableLocks::add(uint64_t tableId, LOCK_MODE mode){
+    std::map< uint64_t, LOCK_MODE >::iterator it = mRequests.find(tableId);
+    if(it == mRequests.end()){
+        mRequests[tableId] = mode;
+        return;
+    }
+
+    LOCK_MODE held = it->second;
+    if(held == mode || mode == LOCK_MODE::INTENTION_SHARED){
+        return;
+    }
+    if(held == LOCK_MODE::INTENTION_SHARED){
+        it->second = mode;
+    } else {
+        // Any other pair of different modes (IX and S, or one of them and X) only fits in EXCLUSIVE
+        it->second = LOCK_MODE::EXCLUSIVE;
+    }
+}
+
+void TableLocks::lock(){
+    if(mLocked){
+        return;
+    }
+    for(std::map< uint64_t, LOCK_MODE >::iterator it = mRequests.begin(); it != mRequests.end(); it++){
+        LockManager::getManager().lockTable(it->first, it->second);
+    }
+    mLocked = true;
+}
+
+void TableLocks::unlock(){
+    if(!mLocked){
+        return;
+    }
+    for(std::map< uint64_t, LOCK_MODE >::reverse_iterator it = mRequests.rbegin(); it != mRequests.rend(); it++){
+        LockManager::getManager().unlockTable(it->first, it->second);
+    }
+    mLocked = false;
+}
+
+TableLocks::~TableLocks(){
+    unlock();
+}
+
+PageLatchGuard::PageLatchGuard(uint64_t fileId, uint64_t pageNumber, bool exclusive) : mFileId(fileId), mPageNumber(pageNumber), mExclusive(exclusive) {
+    LockManager::getManager().latchPage(fileId, pageNumber, exclusive);
+}
+
+PageLatchGuard::~PageLatchGuard(){
+    LockManager::getManager().unlatchPage(mFileId, mPageNumber, mExclusive);
+}
@@ -0,0 +1,150 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+/**
+ * @brief Modes of table locks. Intention modes announce locks on pages of the table: writers
+ * changing rows take INTENTION_EXCLUSIVE and latch every page they change, so that writers to
+ * different pages of a table run at the same time. SHARED and EXCLUSIVE cover the whole table
+ *
+ * Compatibility (a mode can be granted with the modes held by other statements):
+ *       IS  IX  S   X
+ *   IS  y   y   y   n
+ *   IX  y   y   n   n
+ *   S   y   n   y   n
+ *   X   n   n   n   n
+ */
+enum class LOCK_MODE {
+    INTENTION_SHARED,
+    INTENTION_EXCLUSIVE,
+    SHARED,
+    EXCLUSIVE
+};
+
+/**
+ * @brief Waits for locks and latches since the start of the process
+ */
+struct LockStats {
+    uint64_t tableWaits = 0;
+    uint64_t tableWaitNanos = 0;
+    // Latches acquired after parking (spinning didn't get them)
+    uint64_t latchWaits = 0;
+    uint64_t latchWaitNanos = 0;
+};
+
+/**
+ * @brief Short duration shared/exclusive latch of a page, held while the page is read or changed.
+ * Threads spin a few times before parking on a condition variable, since latches are mostly
+ * released within the time of a page read
+ */
+class PageLatch {
+    // Number of shared holders, -1 if held exclusively
+    std::atomic<int32_t> mState{0};
+    std::atomic<uint32_t> mParked{0};
+    std::mutex mMutex;
+    std::condition_variable mReleased;
+
+    bool tryLockShared();
+    bool tryLockExclusive();
+    void wakeParked();
+public:
+    /**
+     * @return true if the thread had to park
+     */
+    bool lockShared();
+    bool lockExclusive();
+    void unlockShared();
+    void unlockExclusive();
+};
+
+/**
+ * @brief Table locks and page latches of the process, shared by every session.
+ *
+ * Deadlocks are avoided by ordering instead of being detected: a statement takes all its table
+ * locks before any latch, in ascending order of table ID (see TableLocks), and holds them until it
+ * ends. Latches held at the same time are taken in ascending order of (file ID, page number) and
+ * no latch is held while waiting for a table lock.
+ */
+class LockManager {
+    struct TableEntry {
+        // Statements holding the table in every mode (indexed by LOCK_MODE)
+        uint32_t granted[4] = {0, 0, 0, 0};
+        uint32_t waiting = 0;
+        std::condition_variable released;
+    };
+
+    struct LatchEntry {
+        PageLatch latch;
+        // Threads holding or waiting for the latch. The entry is removed when none are left
+        uint32_t users = 0;
+    };
+
+    std::mutex mTableMutex;
+    std::map< uint64_t, TableEntry > mTables;
+
+    // Latches exist while they are used. Pages are spread over shards so that latching doesn't go through one mutex
+    static const uint32_t LATCH_SHARDS = 64;
+    std::mutex mLatchMutexes[LATCH_SHARDS];
+    std::map< std::pair< uint64_t, uint64_t >, LatchEntry > mLatches[LATCH_SHARDS];
+
+    std::atomic<uint64_t> mTableWaits{0};
+    std::atomic<uint64_t> mTableWaitNanos{0};
+    std::atomic<uint64_t> mLatchWaits{0};
+    std::atomic<uint64_t> mLatchWaitNanos{0};
+
+    bool isCompatible(const TableEntry& entry, LOCK_MODE mode);
+    uint32_t getShard(uint64_t fileId, uint64_t pageNumber);
+public:
+    static LockManager& getManager();
+
+    /**
+     * @brief Lock a table, waiting until the mode is compatible with the locks of other statements
+     */
+    void lockTable(uint64_t tableId, LOCK_MODE mode);
+    void unlockTable(uint64_t tableId, LOCK_MODE mode);
+
+    void latchPage(uint64_t fileId, uint64_t pageNumber, bool exclusive);
+    void unlatchPage(uint64_t fileId, uint64_t pageNumber, bool exclusive);
+
+    LockStats getStats();
+};
+
+/**
+ * @brief Table locks of a statement, taken together in ascending order of table ID and released when destroyed
+ */
+class TableLocks {
+    // Strongest mode requested for every table
+    std::map< uint64_t, LOCK_MODE > mRequests;
+    bool mLocked = false;
+public:
+    /**
+     * @brief Request a lock. Requests are only taken by lock
+     */
+    void add(uint64_t tableId, LOCK_MODE mode);
+    void lock();
+    void unlock();
+    ~TableLocks();
+};
+
+/**
+ * @brief Latch of a page held until the guard is destroyed
+ */
+class PageLatchGuard {
+    uint64_t mFileId;
+    uint64_t mPageNumber;
+    bool mExclusive;
+public:
+    PageLatchGuard(uint64_t fileId, uint64_t pageNumber, bool exclusive);
+    PageLatchGuard(const PageLatchGuard&) = delete;
+    PageLatchGuard& operator=(const PageLatchGuard&) = delete;
+    ~PageLatchGuard();
+};
+
+#endif // LOCK_H
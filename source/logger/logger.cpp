@@ -2,14 +2,25 @@
 #include "../formatter/formatter.h"
 #include "logger.h"
 
+// Output of the client the thread runs a statement for
+thread_local std::ostream* OUTPUT = &std::cout;
+
 void Logger::logSuccess(std::string successString){
-    std::cout << Formatter::bold_green_on << "Success: " << Formatter::off << successString << std::endl;
+    getOutput() << Formatter::bold_green_on << "Success: " << Formatter::off << successString << std::endl;
 }
 
 void Logger::logError(std::string errorString){
-    std::cout << Formatter::bold_red_on << "ERROR: " << Formatter::off << errorString << std::endl;
+    getOutput() << Formatter::bold_red_on << "ERROR: " << Formatter::off << errorString << std::endl;
 }
 
 void Logger::logDebug(std::string debugString){
     std::cout << "DEBUG: " << debugString << std::endl;
-}
\ No newline at end of file
+}
+
+std::ostream& Logger::getOutput(){
+    return *OUTPUT;
+}
+
+void Logger::setOutput(std::ostream* output){
+    OUTPUT = output ? output : &std::cout;
+}
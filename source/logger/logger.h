@@ -2,12 +2,23 @@
 #define LOGGER_H
 
 #include <string>
+#include <ostream>
 
 class Logger {
 public:
     static void logSuccess(std::string successString);
     static void logError(std::string errorString);
     static void logDebug(std::string debugString);
+
+    /**
+     * @brief Stream the client of the statement run by the thread reads (results, successes and errors). std::cout by default
+     */
+    static std::ostream& getOutput();
+
+    /**
+     * @brief Send the output of the thread to the given stream, or back to std::cout if null
+     */
+    static void setOutput(std::ostream* output);
 };
 
-#endif // LOGGER_H
\ No newline at end of file
+#endif // LOGGER_H
@@ -4,13 +4,20 @@
 #include "properties.h"
 #include "parse/parse.h"
 #include "formatter/formatter.h"
+#include "temp/temp.h"
+#include "server/server.h"
 
 bool PROG_RUNNING = true;
 
-int main(){
+int main(int argc, char** argv){
 
-    // Speed up cin/cout
-    std::ios_base::sync_with_stdio(false);
+    // penguin --server [socket path] serves clients over a Unix domain socket instead of reading statements from the terminal
+    bool serverMode = argc > 1 && std::string(argv[1]) == "--server";
+
+    // Speed up cin/cout. Threads of the server print to cout at once, which needs it synchronized
+    if(!serverMode){
+        std::ios_base::sync_with_stdio(false);
+    }
 
     std::cout << Formatter::bold_on << "Penguin DB " << Formatter::off << "Version " << VERSION << "\n" << std::endl;
 
@@ -22,11 +29,27 @@ int main(){
         std::filesystem::create_directories(QUERY_DIRECTORY);
     }
 
-    while(PROG_RUNNING){
+    TempFiles::init();
+
+    if(serverMode){
+        Server server(argc > 2 ? argv[2] : SERVER_SOCKET_PATH);
+        bool served = server.run();
+        TempFiles::shutdown();
+        return served ? 0 : 1;
+    }
+
+    Session session;
+    while(!session.closed){
         std::cout << Formatter::bold_on << "penguin_db > " << Formatter::off;
         std::string command;
         getline(std::cin, command, ';');
         
-        processCommand(command);
+        TempFiles::beginStatement();
+        processCommand(command, session);
+
+        // Query results and spill files don't outlive the statement
+        TempFiles::endStatement();
     }
-}
\ No newline at end of file
+
+    TempFiles::shutdown();
+}
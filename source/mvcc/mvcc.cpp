@@ -0,0 +1,430 @@
+#include <string.h>
+#include "mvcc.h"
+#include "../properties.h"
+#include "../buffers/buffers.h"
+#include "../page/page.h"
+#include "../lock/lock.h"
+#include "../temp/temp.h"
+#include "../logger/logger.h"
+
+TransactionManager& TransactionManager::getManager(){
+    static TransactionManager manager;
+    return manager;
+}
+
+void TransactionManager::begin(Transaction& transaction){
+    std::lock_guard<std::mutex> lock(mMutex);
+    transaction = Transaction();
+    transaction.id = mNextId++;
+    mActive.insert(transaction.id);
+}
+
+bool TransactionManager::commit(Transaction& transaction){
+    if(!isSerializable(transaction)){
+        Logger::logError("Rows changed by transaction " + std::to_string(transaction.id) + " were changed by a transaction committed after its snapshot. It can't be serialized");
+        rollback(transaction);
+        return false;
+    }
+    uint64_t bufferedPages = transaction.bufferedPages;
+    if(!writePages(transaction)){
+        rollback(transaction);
+        return false;
+    }
+    if(DEBUG == true && bufferedPages){
+        std::cout << "Transaction " << transaction.id << " wrote " << bufferedPages << " pages at commit" << std::endl;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(mActive.erase(transaction.id) == 0){
+            return true;
+        }
+        if(transaction.pages.size() || transaction.releasedChains.size()){
+            uint64_t timestamp = ++mClock;
+            mCommitTimestamps[transaction.id] = timestamp;
+            mCommitted.push_back({transaction.id, timestamp, transaction.pages, transaction.releasedChains});
+        }
+        transaction.pages.clear();
+        transaction.writtenChains.clear();
+        transaction.releasedChains.clear();
+        transaction.matchedPages.clear();
+    }
+    mReleased.notify_all();
+    collectGarbage();
+    return true;
+}
+
+bool TransactionManager::isSerializable(const Transaction& transaction){
+    // getWriter checked the pages before they were changed, and other writers wait for them since. This catches
+    // writers that got a page committed in between anyway
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(std::set< std::pair< uint64_t, uint64_t > >::const_iterator page = transaction.matchedPages.begin(); page != transaction.matchedPages.end(); page++){
+        std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(*page);
+        if(it == mVersions.end()){
+            continue;
+        }
+        for(int i=0; i<it->second.size(); i++){
+            std::map< uint64_t, uint64_t >::iterator timestamp = mCommitTimestamps.find(it->second[i].writer);
+            if(timestamp != mCommitTimestamps.end() && timestamp->second > transaction.snapshotTimestamp){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void TransactionManager::rollback(Transaction& transaction){
+    undo(transaction);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mActive.erase(transaction.id);
+    }
+    mReleased.notify_all();
+    waitForConflict(transaction);
+}
+
+void TransactionManager::waitForConflict(Transaction& transaction){
+    std::unique_lock<std::mutex> lock(mMutex);
+    if(!transaction.conflictWriter){
+        return;
+    }
+    uint64_t writer = transaction.conflictWriter;
+    mReleased.wait(lock, [&](){ return findWriter(transaction.id, transaction.conflictPage) != writer; });
+    transaction.conflictWriter = 0;
+}
+
+void TransactionManager::undo(Transaction& transaction){
+    std::unique_ptr<char[]> pageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+
+    // Other writers wait for these pages, so no one changed them since. Files of pages still
+    // buffered hold the images already
+    for(int i=transaction.pages.size()-1; i>=0; i--){
+        std::pair< uint64_t, uint64_t > page = transaction.pages[i];
+        PageLatchGuard latch(page.first, page.second, true);
+        bool written;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(page);
+            if(it == mVersions.end() || it->second.back().writer != transaction.id){
+                continue;
+            }
+            written = !it->second.back().current;
+            memcpy(pageBuffer.get(), it->second.back().image.get(), PAGE_SIZE);
+            it->second.pop_back();
+            if(it->second.empty()){
+                mVersions.erase(it);
+            }
+            mVersionCount--;
+        }
+        if(written){
+            writeToPage(pageBuffer.get(), page.first, page.second);
+        }
+    }
+
+    // Chains written by the transaction were only referenced by its own versions of the pages
+    for(int i=0; i<transaction.writtenChains.size(); i++){
+        uint64_t fileId = transaction.writtenChains[i].first;
+        PageLatchGuard overflowLatch(fileId | OVERFLOW_FILE_FLAG, 0, true);
+        freeOverflowChain(fileId, transaction.writtenChains[i].second);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        transaction.pages.clear();
+        transaction.bufferedPages = 0;
+        transaction.writtenChains.clear();
+        transaction.releasedChains.clear();
+        transaction.matchedPages.clear();
+    }
+    mReleased.notify_all();
+}
+
+bool TransactionManager::writePages(Transaction& transaction){
+    // Readers of other transactions take the images before the changes until it commits,
+    // so the pages can be written in any order
+    for(int i=0; i<transaction.pages.size() && transaction.bufferedPages; i++){
+        std::pair< uint64_t, uint64_t > page = transaction.pages[i];
+        PageLatchGuard latch(page.first, page.second, true);
+        std::unique_ptr<char[]> current;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(page);
+            if(it == mVersions.end() || it->second.back().writer != transaction.id || !it->second.back().current){
+                continue;
+            }
+            current = std::move(it->second.back().current);
+            transaction.bufferedPages--;
+        }
+        if(!writeToPage(current.get(), page.first, page.second)){
+            Logger::logError("Unable to write changed page of a transaction");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TransactionManager::limitBufferedPages(Transaction& transaction){
+    if(transaction.bufferedPages*PAGE_SIZE <= TRANSACTION_MEMORY_BUDGET){
+        return true;
+    }
+    if(DEBUG == true){
+        std::cout << "Transaction " << transaction.id << " writes " << transaction.bufferedPages << " buffered pages before it commits" << std::endl;
+    }
+    return writePages(transaction);
+}
+
+void TransactionManager::collectGarbage(){
+    std::vector< std::pair< uint64_t, uint64_t > > chains;
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        uint64_t horizon = mSnapshots.empty() ? mClock : *mSnapshots.begin();
+        while(!mCommitted.empty() && mCommitted.front().timestamp <= horizon){
+            CommittedWrites& writes = mCommitted.front();
+            // Versions of earlier commits were dropped already, so the writer has the oldest version of its pages
+            for(int i=0; i<writes.pages.size(); i++){
+                std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(writes.pages[i]);
+                if(it == mVersions.end()){
+                    continue;
+                }
+                std::deque< PageVersion >& versions = it->second;
+                for(std::deque< PageVersion >::iterator version = versions.begin(); version != versions.end(); version++){
+                    if(version->writer == writes.transaction){
+                        versions.erase(version);
+                        mVersionCount--;
+                        dropped++;
+                        break;
+                    }
+                }
+                if(versions.empty()){
+                    mVersions.erase(it);
+                }
+            }
+            chains.insert(chains.end(), writes.releasedChains.begin(), writes.releasedChains.end());
+            mCommitTimestamps.erase(writes.transaction);
+            mCommitted.pop_front();
+        }
+    }
+
+    for(int i=0; i<chains.size(); i++){
+        PageLatchGuard overflowLatch(chains[i].first | OVERFLOW_FILE_FLAG, 0, true);
+        freeOverflowChain(chains[i].first, chains[i].second);
+    }
+
+    if(DEBUG == true && (dropped || chains.size())){
+        std::cout << "Dropped " << dropped << " page versions and " << chains.size() << " overflow chains no snapshot reads" << std::endl;
+    }
+}
+
+Snapshot TransactionManager::takeSnapshot(const Transaction& transaction){
+    std::lock_guard<std::mutex> lock(mMutex);
+    Snapshot snapshot;
+    snapshot.transaction = transaction.id;
+    snapshot.timestamp = mClock;
+    mSnapshots.insert(snapshot.timestamp);
+    return snapshot;
+}
+
+void TransactionManager::releaseSnapshot(const Snapshot& snapshot){
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::multiset< uint64_t >::iterator it = mSnapshots.find(snapshot.timestamp);
+        if(it == mSnapshots.end()){
+            return;
+        }
+        mSnapshots.erase(it);
+    }
+    collectGarbage();
+}
+
+bool TransactionManager::isVisible(uint64_t writer, const Snapshot& snapshot){
+    if(writer == snapshot.transaction){
+        return true;
+    }
+    std::map< uint64_t, uint64_t >::iterator it = mCommitTimestamps.find(writer);
+    return it != mCommitTimestamps.end() && it->second <= snapshot.timestamp;
+}
+
+uint64_t TransactionManager::findWriter(uint64_t transaction, const std::pair< uint64_t, uint64_t >& page){
+    std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(page);
+    if(it == mVersions.end() || it->second.empty()){
+        return 0;
+    }
+    uint64_t writer = it->second.back().writer;
+    if(writer == transaction || mCommitTimestamps.find(writer) != mCommitTimestamps.end()){
+        return 0;
+    }
+    return writer;
+}
+
+uint64_t TransactionManager::getWriter(const Transaction& transaction, uint64_t fileId, uint64_t pageNumber, const Snapshot* snapshot){
+    if(mVersionCount == 0){
+        return 0;
+    }
+    std::pair< uint64_t, uint64_t > page(fileId, pageNumber);
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint64_t writer = findWriter(transaction.id, page);
+    if(writer || !snapshot){
+        return writer;
+    }
+
+    // Versions are in commit order, so only the newest one can be invisible to the snapshot. Versions
+    // committed after a snapshot in use are kept, so a dropped chain was committed before it
+    std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(page);
+    if(it == mVersions.end() || isVisible(it->second.back().writer, *snapshot)){
+        return 0;
+    }
+    return it->second.back().writer;
+}
+
+void TransactionManager::addVersion(Transaction& transaction, uint64_t fileId, uint64_t pageNumber, const char image[], const Snapshot* snapshot){
+    std::pair< uint64_t, uint64_t > page(fileId, pageNumber);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(snapshot){
+        transaction.matchedPages.insert(page);
+        transaction.snapshotTimestamp = snapshot->timestamp;
+    }
+    std::deque< PageVersion >& versions = mVersions[page];
+    if(!versions.empty() && versions.back().writer == transaction.id){
+        return;
+    }
+
+    PageVersion version;
+    version.writer = transaction.id;
+    version.image = std::make_unique<char[]>(PAGE_SIZE + 1);
+    memcpy(version.image.get(), image, PAGE_SIZE);
+    versions.push_back(std::move(version));
+    mVersionCount++;
+    transaction.pages.push_back(page);
+}
+
+uint32_t TransactionManager::readPage(const Transaction& transaction, char BUFFER[], uint64_t fileId, uint64_t pageNumber){
+    if(mVersionCount){
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(std::make_pair(fileId, pageNumber));
+        if(it != mVersions.end() && it->second.back().writer == transaction.id && it->second.back().current){
+            memcpy(BUFFER, it->second.back().current.get(), PAGE_SIZE);
+            return PAGE_SIZE;
+        }
+    }
+    return ::readPage(BUFFER, fileId, pageNumber);
+}
+
+bool TransactionManager::writePage(Transaction& transaction, const char BUFFER[], uint64_t fileId, uint64_t pageNumber){
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(std::make_pair(fileId, pageNumber));
+    if(it == mVersions.end() || it->second.back().writer != transaction.id){
+        Logger::logError("Page written without a version of the transaction");
+        return false;
+    }
+    PageVersion& version = it->second.back();
+    if(!version.current){
+        version.current = std::make_unique<char[]>(PAGE_SIZE + 1);
+        transaction.bufferedPages++;
+    }
+    memcpy(version.current.get(), BUFFER, PAGE_SIZE);
+    return true;
+}
+
+bool TransactionManager::applyVersions(char PAGE[], uint64_t fileId, uint64_t pageNumber, const Snapshot& snapshot){
+    // Versions are added under an exclusive latch of the page, so none can appear while the page is latched
+    if(mVersionCount == 0){
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > >::iterator it = mVersions.find(std::make_pair(fileId, pageNumber));
+    if(it == mVersions.end()){
+        return false;
+    }
+
+    // Only the transaction reading has its changes buffered. Others wrote theirs before they committed
+    std::deque< PageVersion >& versions = it->second;
+    if(versions.back().writer == snapshot.transaction){
+        if(!versions.back().current){
+            return false;
+        }
+        memcpy(PAGE, versions.back().current.get(), PAGE_SIZE);
+        return true;
+    }
+
+    // Once a writer is visible, the older ones committed before it are too
+    bool replaced = false;
+    for(std::deque< PageVersion >::reverse_iterator version = versions.rbegin(); version != versions.rend(); version++){
+        if(isVisible(version->writer, snapshot)){
+            break;
+        }
+        memcpy(PAGE, version->image.get(), PAGE_SIZE);
+        replaced = true;
+    }
+    return replaced;
+}
+
+bool TransactionManager::waitForWriter(Transaction& transaction, uint64_t fileId, uint64_t pageNumber, uint64_t writer, bool restartAfterCommit){
+    std::pair< uint64_t, uint64_t > page(fileId, pageNumber);
+    std::unique_lock<std::mutex> lock(mMutex);
+    if(transaction.id < writer){
+        mReleased.wait(lock, [&](){ return findWriter(transaction.id, page) != writer; });
+        // Writers losing a conflict undo their changes and stay active
+        if(!restartAfterCommit || mActive.find(writer) != mActive.end()){
+            return true;
+        }
+    }
+    transaction.conflictWriter = writer;
+    transaction.conflictPage = page;
+    return false;
+}
+
+void TransactionManager::addWrittenChains(Transaction& transaction, uint64_t fileId, const std::vector< uint64_t >& firstPages){
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(int i=0; i<firstPages.size(); i++){
+        transaction.writtenChains.push_back(std::make_pair(fileId, firstPages[i]));
+    }
+}
+
+void TransactionManager::addReleasedChains(Transaction& transaction, uint64_t fileId, const std::vector< uint64_t >& firstPages){
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(int i=0; i<firstPages.size(); i++){
+        transaction.releasedChains.push_back(std::make_pair(fileId, firstPages[i]));
+    }
+}
+
+bool TransactionManager::retryOnConflict(Transaction& transaction, const std::function< bool() >& statement, Snapshot* snapshot){
+    while(!statement()){
+        uint64_t writer;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            writer = transaction.conflictWriter;
+        }
+        if(!writer){
+            return false;
+        }
+
+        if(DEBUG == true){
+            std::cout << "Transaction " << transaction.id << " conflicts with transaction " << writer << " and runs its statement again" << std::endl;
+        }
+        undo(transaction);
+        waitForConflict(transaction);
+        if(snapshot){
+            releaseSnapshot(*snapshot);
+            *snapshot = takeSnapshot(transaction);
+        }
+    }
+    return true;
+}
+
+uint64_t TransactionManager::getVersionCount(){
+    return mVersionCount;
+}
+
+uint32_t readVisiblePage(char BUFFER[], uint64_t fileId, uint64_t pageNumber, const Snapshot* snapshot){
+    if(!snapshot || TempFiles::isTempFile(fileId)){
+        return readPage(BUFFER, fileId, pageNumber);
+    }
+    PageLatchGuard latch(fileId, pageNumber, false);
+    uint32_t totRead = readPage(BUFFER, fileId, pageNumber);
+    // Pages added by a transaction aren't in the file until it commits
+    if(TransactionManager::getManager().applyVersions(BUFFER, fileId, pageNumber, *snapshot)){
+        return PAGE_SIZE;
+    }
+    return totRead;
+}
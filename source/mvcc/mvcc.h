@@ -0,0 +1,231 @@
+#ifndef MVCC_H
+#define MVCC_H
+
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+/**
+ * @brief Point in the commit order a statement reads at. It sees the changes of transactions committed
+ * at or before timestamp, and the changes of its own transaction
+ */
+struct Snapshot {
+    uint64_t transaction = 0;
+    uint64_t timestamp = 0;
+};
+
+/**
+ * @brief Changes of a transaction, kept in the session running it.
+ * Pages and overflow chains are given as (file ID, page number)
+ */
+struct Transaction {
+    uint64_t id = 0;
+    // Pages the transaction has a version of, in the order they were first changed
+    std::vector< std::pair< uint64_t, uint64_t > > pages;
+    // Changed pages kept in memory instead of their files
+    uint64_t bufferedPages = 0;
+    // Overflow chains the transaction wrote. They are freed if it rolls back
+    std::vector< std::pair< uint64_t, uint64_t > > writtenChains;
+    // Overflow chains of replaced and deleted values. They are freed once no snapshot can read them
+    std::vector< std::pair< uint64_t, uint64_t > > releasedChains;
+    // Pages updates and deletes changed after matching their rows at the snapshot with the given timestamp.
+    // Commit fails if another transaction committed one of them after the snapshot
+    std::set< std::pair< uint64_t, uint64_t > > matchedPages;
+    uint64_t snapshotTimestamp = 0;
+    // Page of an older writer the transaction lost a write conflict on (see TransactionManager::waitForWriter)
+    uint64_t conflictWriter = 0;
+    std::pair< uint64_t, uint64_t > conflictPage;
+};
+
+/**
+ * @brief Transactions and versions of table pages (multiversion concurrency control).
+ *
+ * Records of every format live in slotted or fixed width pages, so versions are kept per page instead
+ * of per row: the first time a transaction changes a page, the image of the page before the change is
+ * added to the version chain of the page. A page has at most one uncommitted writer, so chains are in
+ * commit order. Reads take the current image and replace it with older ones while their writers are
+ * invisible to the snapshot, so they never wait for writers beyond the latch of a page.
+ *
+ * Writers wait for each other by age (wait-die): a transaction finding a page changed by a younger
+ * uncommitted one waits until it ends, while a younger one rolls its changes back and runs its
+ * statement again once the older one released the page. Waiting transactions are never waited for
+ * by younger ones, so there are no deadlocks. Nothing is waited for while a latch is held.
+ *
+ * Updates and deletes match rows as the snapshot of their statement sees them (snapshot isolation).
+ * Changing a page whose newest version committed after that snapshot would overwrite changes the
+ * snapshot doesn't see, so the first committer wins: the statement fails like after losing a write
+ * conflict. A statement in a transaction of its own runs again with a new snapshot, a transaction
+ * opened by begin is rolled back.
+ *
+ * Changed pages stay in the versions of their writer until it commits, so that a transaction of
+ * many statements writes every page once. Until then the files hold the images before the changes,
+ * and rolling back drops the versions. Transactions buffering more than TRANSACTION_MEMORY_BUDGET
+ * bytes write their pages between statements, and their rollbacks write the images back.
+ *
+ * Page images and overflow chains of replaced values are dropped once every snapshot in use sees
+ * the transaction that replaced them.
+ */
+class TransactionManager {
+    struct PageVersion {
+        uint64_t writer;
+        // The page before the writer changed it
+        std::unique_ptr<char[]> image;
+        // The page as changed by the writer, until it is written to the file
+        std::unique_ptr<char[]> current;
+    };
+
+    struct CommittedWrites {
+        uint64_t transaction;
+        uint64_t timestamp;
+        std::vector< std::pair< uint64_t, uint64_t > > pages;
+        std::vector< std::pair< uint64_t, uint64_t > > releasedChains;
+    };
+
+    std::mutex mMutex;
+    // Notified when a transaction commits or rolls back its changes
+    std::condition_variable mReleased;
+    uint64_t mNextId = 1;
+    uint64_t mClock = 0;
+    std::set< uint64_t > mActive;
+    // Commit timestamps of transactions with versions still kept
+    std::map< uint64_t, uint64_t > mCommitTimestamps;
+    // Timestamps of the snapshots in use
+    std::multiset< uint64_t > mSnapshots;
+    // Version chains of pages, oldest first
+    std::map< std::pair< uint64_t, uint64_t >, std::deque< PageVersion > > mVersions;
+    std::atomic<uint64_t> mVersionCount{0};
+    // Writes of committed transactions in commit order, until every snapshot sees them
+    std::deque< CommittedWrites > mCommitted;
+
+    bool isVisible(uint64_t writer, const Snapshot& snapshot);
+    /**
+     * @brief Uncommitted transaction other than the given one with a version of the page, 0 if none. Called with mMutex held
+     */
+    uint64_t findWriter(uint64_t transaction, const std::pair< uint64_t, uint64_t >& page);
+
+    /**
+     * @brief Whether no other transaction committed a version of the matched pages of the transaction after its snapshot
+     */
+    bool isSerializable(const Transaction& transaction);
+
+    /**
+     * @brief Put back the pages changed by the transaction and free the overflow chains it wrote. It stays active
+     */
+    void undo(Transaction& transaction);
+
+    /**
+     * @brief Wait until the older writer the transaction lost a write conflict to released the page, if it lost one
+     */
+    void waitForConflict(Transaction& transaction);
+
+    /**
+     * @brief Write the pages buffered by the transaction to their files. Called without latches
+     */
+    bool writePages(Transaction& transaction);
+
+    /**
+     * @brief Drop the versions and free the chains no snapshot in use can read. Called without latches
+     */
+    void collectGarbage();
+public:
+    static TransactionManager& getManager();
+
+    void begin(Transaction& transaction);
+    /**
+     * @brief Write the pages of the transaction and make its changes visible. It is rolled back if a page can't be written,
+     * or if another transaction committed a page it matched rows of after its snapshot (serialization failure).
+     * The snapshot must be released after the commit, so that the versions of such pages are still kept
+     */
+    bool commit(Transaction& transaction);
+    /**
+     * @brief Undo the changes of the transaction. After losing a write conflict, it returns once the older writer
+     * released the page, so that running the transaction again doesn't lose the same conflict
+     */
+    void rollback(Transaction& transaction);
+
+    /**
+     * @brief Write the pages buffered by the transaction once they take more than TRANSACTION_MEMORY_BUDGET bytes.
+     * Called between statements
+     */
+    bool limitBufferedPages(Transaction& transaction);
+
+    Snapshot takeSnapshot(const Transaction& transaction);
+    void releaseSnapshot(const Snapshot& snapshot);
+
+    /**
+     * @brief Uncommitted writer of a page other than the transaction, 0 if none. The page must be latched
+     * exclusively, so that no other writer gets it in the meantime
+     *
+     * @param snapshot if given, the writer of the newest version of the page is also returned if it committed
+     * after the snapshot, since changing the page would overwrite its changes (first committer wins)
+     */
+    uint64_t getWriter(const Transaction& transaction, uint64_t fileId, uint64_t pageNumber, const Snapshot* snapshot = nullptr);
+
+    /**
+     * @brief Keep the image of a page before the transaction changes it. Only the first change of a page
+     * by a transaction adds a version. Called with the page latched exclusively, once getWriter returned 0
+     *
+     * @param snapshot snapshot the rows of the page were matched at, if the change depends on them. Commit checks
+     * the page again (see isSerializable)
+     */
+    void addVersion(Transaction& transaction, uint64_t fileId, uint64_t pageNumber, const char image[], const Snapshot* snapshot = nullptr);
+
+    /**
+     * @brief Read a page the transaction may have changed, under a latch of the page
+     */
+    uint32_t readPage(const Transaction& transaction, char BUFFER[], uint64_t fileId, uint64_t pageNumber);
+
+    /**
+     * @brief Keep a changed page in the version of the transaction until it commits. Called with the page
+     * latched exclusively, after addVersion
+     */
+    bool writePage(Transaction& transaction, const char BUFFER[], uint64_t fileId, uint64_t pageNumber);
+
+    /**
+     * @brief Replace a page read under a latch with the version the snapshot sees
+     *
+     * @return true if the page was replaced
+     */
+    bool applyVersions(char PAGE[], uint64_t fileId, uint64_t pageNumber, const Snapshot& snapshot);
+
+    /**
+     * @brief Wait until the writer releases the page if the transaction is older than the writer. Called without latches
+     *
+     * @param restartAfterCommit also fail once the writer committed. Passed for writers getWriter returned
+     * as committed after the snapshot of the statement
+     * @return false if the transaction is younger: its statement has to fail and be run again by retryOnConflict
+     */
+    bool waitForWriter(Transaction& transaction, uint64_t fileId, uint64_t pageNumber, uint64_t writer, bool restartAfterCommit = false);
+
+    void addWrittenChains(Transaction& transaction, uint64_t fileId, const std::vector< uint64_t >& firstPages);
+    void addReleasedChains(Transaction& transaction, uint64_t fileId, const std::vector< uint64_t >& firstPages);
+
+    /**
+     * @brief Run a statement changing rows. If it failed after losing a write conflict, its changes are
+     * undone and it runs again once the older writer released the page
+     *
+     * @param snapshot snapshot of the statement, taken again before it runs again so that it sees the changes it lost to
+     */
+    bool retryOnConflict(Transaction& transaction, const std::function< bool() >& statement, Snapshot* snapshot = nullptr);
+
+    /**
+     * @brief Number of page versions kept
+     */
+    uint64_t getVersionCount();
+};
+
+/**
+ * @brief Read the version of a table page a snapshot sees, under a shared latch of the page.
+ * Pages of temporary files and reads without a snapshot get the current page
+ */
+uint32_t readVisiblePage(char BUFFER[], uint64_t fileId, uint64_t pageNumber, const Snapshot* snapshot);
+
+#endif // MVCC_H
@@ -0,0 +1,485 @@
+#include <string.h>
+#include <memory>
+#include <algorithm>
+#include "page.h"
+#include "../type/type.h"
+#include "../buffers/buffers.h"
+
+// File system calls
+#include <fcntl.h>
+
+/**
+ * @brief Set in the length of a varchar record field when the value lives in overflow pages.
+ * The length is then followed by the 8 byte number of the first overflow page.
+ */
+const uint32_t VARCHAR_OVERFLOW_BIT = (uint32_t)1 << 31;
+
+/**
+ * @brief Overflow file structure:
+ * 1) Page 0 stores total pages (8 bytes) followed by the first free page (8 bytes)
+ * 2) Every other page stores the next page of the chain (8 bytes), bytes used (4 bytes) and data
+ */
+const uint32_t OVERFLOW_PAGE_HEADER_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+
+uint32_t getHeapStart(const char PAGE[]){
+    uint16_t heapStart;
+    memcpy(&heapStart, PAGE + sizeof(uint32_t) + sizeof(uint16_t), sizeof(heapStart));
+    // Zeroed pages are empty
+    if(heapStart == 0){
+        return PAGE_SIZE;
+    }
+    return heapStart;
+}
+
+void setPageHeader(char PAGE[], uint32_t totBytes, uint16_t numSlots, uint32_t heapStart){
+    uint16_t _heapStart = heapStart;
+    memcpy(PAGE, &totBytes, sizeof(totBytes));
+    memcpy(PAGE + sizeof(uint32_t), &numSlots, sizeof(numSlots));
+    memcpy(PAGE + sizeof(uint32_t) + sizeof(uint16_t), &_heapStart, sizeof(_heapStart));
+}
+
+void setSlot(char PAGE[], uint16_t slot, uint16_t offset, uint16_t length){
+    uint32_t slotStart = SLOTTED_PAGE_HEADER_SIZE + slot*SLOT_SIZE;
+    memcpy(PAGE + slotStart, &offset, sizeof(offset));
+    memcpy(PAGE + slotStart + sizeof(offset), &length, sizeof(length));
+}
+
+bool isVariableLength(const std::vector< std::vector< std::string > >& columns){
+    for(int i=0; i<columns.size(); i++){
+        if(getTypeFromString(columns[i][1]) == TYPE::VARCHAR){
+            return true;
+        }
+    }
+    return false;
+}
+
+uint16_t getSlotCount(const char PAGE[]){
+    uint16_t numSlots;
+    memcpy(&numSlots, PAGE + sizeof(uint32_t), sizeof(numSlots));
+    return numSlots;
+}
+
+void getSlot(const char PAGE[], uint16_t slot, uint16_t& offset, uint16_t& length){
+    uint32_t slotStart = SLOTTED_PAGE_HEADER_SIZE + slot*SLOT_SIZE;
+    memcpy(&offset, PAGE + slotStart, sizeof(offset));
+    memcpy(&length, PAGE + slotStart + sizeof(offset), sizeof(length));
+}
+
+uint32_t getSlottedPageFreeSpace(const char PAGE[]){
+    uint32_t totBytes;
+    memcpy(&totBytes, PAGE, sizeof(totBytes));
+    return PAGE_SIZE - SLOTTED_PAGE_HEADER_SIZE - getSlotCount(PAGE)*SLOT_SIZE - totBytes;
+}
+
+void compactSlottedPage(char PAGE[]){
+    char compacted[PAGE_SIZE];
+    memset(compacted, 0, PAGE_SIZE);
+
+    uint32_t totBytes;
+    memcpy(&totBytes, PAGE, sizeof(totBytes));
+    uint16_t numSlots = getSlotCount(PAGE);
+
+    // Trailing empty slots can be dropped
+    while(numSlots > 0){
+        uint16_t offset, length;
+        getSlot(PAGE, numSlots-1, offset, length);
+        if(offset != 0){
+            break;
+        }
+        numSlots--;
+    }
+
+    uint32_t heapStart = PAGE_SIZE;
+    for(uint16_t i=0; i<numSlots; i++){
+        uint16_t offset, length;
+        getSlot(PAGE, i, offset, length);
+        if(offset == 0){
+            setSlot(compacted, i, 0, 0);
+            continue;
+        }
+        heapStart -= length;
+        memcpy(compacted + heapStart, PAGE + offset, length);
+        setSlot(compacted, i, heapStart, length);
+    }
+    setPageHeader(compacted, totBytes, numSlots, heapStart);
+    memcpy(PAGE, compacted, PAGE_SIZE);
+}
+
+int32_t insertIntoSlottedPage(char PAGE[], const char record[], uint32_t length){
+    uint16_t numSlots = getSlotCount(PAGE);
+
+    // Reuse the first empty slot if there is one
+    int32_t slot = -1;
+    for(uint16_t i=0; i<numSlots; i++){
+        uint16_t offset, slotLength;
+        getSlot(PAGE, i, offset, slotLength);
+        if(offset == 0){
+            slot = i;
+            break;
+        }
+    }
+
+    uint32_t required = length + (slot == -1 ? SLOT_SIZE : 0);
+    if(getSlottedPageFreeSpace(PAGE) < required){
+        return -1;
+    }
+
+    uint32_t directoryEnd = SLOTTED_PAGE_HEADER_SIZE + numSlots*SLOT_SIZE;
+    if(getHeapStart(PAGE) - directoryEnd < required){
+        compactSlottedPage(PAGE);
+        numSlots = getSlotCount(PAGE);
+        if(slot >= numSlots){
+            // Compaction dropped the reused slot
+            slot = -1;
+        }
+    }
+
+    if(slot == -1){
+        slot = numSlots++;
+    }
+
+    uint32_t totBytes;
+    memcpy(&totBytes, PAGE, sizeof(totBytes));
+    uint32_t heapStart = getHeapStart(PAGE) - length;
+
+    memcpy(PAGE + heapStart, record, length);
+    setSlot(PAGE, slot, heapStart, length);
+    setPageHeader(PAGE, totBytes + length, numSlots, heapStart);
+
+    return slot;
+}
+
+bool updateSlottedPage(char PAGE[], uint16_t slot, const char record[], uint32_t length){
+    uint16_t offset, oldLength;
+    getSlot(PAGE, slot, offset, oldLength);
+
+    uint32_t totBytes;
+    memcpy(&totBytes, PAGE, sizeof(totBytes));
+
+    if(length <= oldLength){
+        // Shrinking records stay in place. Unused bytes are reclaimed on compaction.
+        memcpy(PAGE + offset, record, length);
+        setSlot(PAGE, slot, offset, length);
+        setPageHeader(PAGE, totBytes - oldLength + length, getSlotCount(PAGE), getHeapStart(PAGE));
+        return true;
+    }
+
+    if(getSlottedPageFreeSpace(PAGE) + oldLength < length){
+        return false;
+    }
+
+    setSlot(PAGE, slot, 0, 0);
+    totBytes -= oldLength;
+    setPageHeader(PAGE, totBytes, getSlotCount(PAGE), getHeapStart(PAGE));
+
+    uint32_t directoryEnd = SLOTTED_PAGE_HEADER_SIZE + getSlotCount(PAGE)*SLOT_SIZE;
+    if(getHeapStart(PAGE) - directoryEnd < length){
+        compactSlottedPage(PAGE);
+    }
+
+    // Compaction may drop the slot if it was the last one
+    uint16_t numSlots = std::max(getSlotCount(PAGE), (uint16_t)(slot + 1));
+    uint32_t heapStart = getHeapStart(PAGE) - length;
+    memcpy(PAGE + heapStart, record, length);
+    setSlot(PAGE, slot, heapStart, length);
+    setPageHeader(PAGE, totBytes + length, numSlots, heapStart);
+
+    return true;
+}
+
+void deleteFromSlottedPage(char PAGE[], uint16_t slot){
+    uint16_t offset, length;
+    getSlot(PAGE, slot, offset, length);
+    if(offset == 0){
+        return;
+    }
+
+    uint32_t totBytes;
+    memcpy(&totBytes, PAGE, sizeof(totBytes));
+    setSlot(PAGE, slot, 0, 0);
+    setPageHeader(PAGE, totBytes - length, getSlotCount(PAGE), getHeapStart(PAGE));
+}
+
+std::vector< std::pair< uint32_t, uint32_t > > getRowsOfPage(const char PAGE[], uint32_t rowSize, bool slotted){
+    std::vector< std::pair< uint32_t, uint32_t > > rows;
+
+    if(!slotted){
+        for(uint32_t j=sizeof(uint32_t); j+rowSize-1<PAGE_SIZE; j+=rowSize){
+            uint64_t currentId;
+            memcpy(&currentId, PAGE + j, sizeof(currentId));
+            if(currentId){
+                rows.push_back(std::make_pair(j, rowSize));
+            }
+        }
+        return rows;
+    }
+
+    uint16_t numSlots = getSlotCount(PAGE);
+    for(uint16_t i=0; i<numSlots; i++){
+        uint16_t offset, length;
+        getSlot(PAGE, i, offset, length);
+        if(offset != 0){
+            rows.push_back(std::make_pair(offset, length));
+        }
+    }
+    return rows;
+}
+
+uint32_t getRowSize(const std::vector< std::vector< std::string > > &columns){
+    uint32_t rowSize = 8; // ID field has 8 bytes
+    for(int i=0;i<columns.size();i++){
+        rowSize += getTypeSize(columns[i][1]);
+    }
+    return rowSize;
+}
+
+std::vector< uint32_t > getColumnOffsets(const char row[], const std::vector< std::vector< std::string > >& columns){
+    std::vector< uint32_t > offsets;
+
+    // Offset of ID
+    uint32_t offset = sizeof(uint64_t);
+    for(int i=0; i<columns.size(); i++){
+        offsets.push_back(offset);
+        offset += getFieldSize(row, columns[i][1], offset);
+    }
+    offsets.push_back(offset);
+
+    return offsets;
+}
+
+/**
+ * @brief Allocate pages for an overflow chain, preferring pages of the free list
+ */
+std::vector< uint64_t > allocateOverflowPages(uint64_t overflowFileId, char METADATA[], uint32_t numPages){
+    std::vector< uint64_t > pages;
+
+    uint64_t totPages, freePage;
+    memcpy(&totPages, METADATA, sizeof(totPages));
+    memcpy(&freePage, METADATA + sizeof(totPages), sizeof(freePage));
+
+    std::unique_ptr<char[]> pageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+
+    while(pages.size() < numPages){
+        if(freePage){
+            pages.push_back(freePage);
+            readPage(pageBuffer.get(), overflowFileId, freePage);
+            memcpy(&freePage, pageBuffer.get(), sizeof(freePage));
+        } else {
+            pages.push_back(++totPages);
+        }
+    }
+
+    memcpy(METADATA, &totPages, sizeof(totPages));
+    memcpy(METADATA + sizeof(totPages), &freePage, sizeof(freePage));
+    return pages;
+}
+
+uint64_t writeOverflowChain(uint64_t fileId, const char data[], uint32_t length){
+    uint64_t overflowFileId = fileId | OVERFLOW_FILE_FLAG;
+
+    std::unique_ptr<char[]> metadataBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    std::unique_ptr<char[]> pageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+
+    // A missing overflow file has no pages
+    if(fileExists(overflowFileId)){
+        readPage(metadataBuffer.get(), overflowFileId, 0);
+    }
+
+    uint32_t pageCapacity = PAGE_SIZE - OVERFLOW_PAGE_HEADER_SIZE;
+    uint32_t numPages = (length + pageCapacity - 1) / pageCapacity;
+    std::vector< uint64_t > pages = allocateOverflowPages(overflowFileId, metadataBuffer.get(), numPages);
+
+    for(uint32_t i=0; i<numPages; i++){
+        uint64_t nextPage = (i + 1 < numPages) ? pages[i+1] : 0;
+        uint32_t bytesInPage = std::min(pageCapacity, length - i*pageCapacity);
+
+        memset(pageBuffer.get(), 0, PAGE_SIZE);
+        memcpy(pageBuffer.get(), &nextPage, sizeof(nextPage));
+        memcpy(pageBuffer.get() + sizeof(nextPage), &bytesInPage, sizeof(bytesInPage));
+        memcpy(pageBuffer.get() + OVERFLOW_PAGE_HEADER_SIZE, data + i*pageCapacity, bytesInPage);
+        writeToPage(pageBuffer.get(), overflowFileId, pages[i], O_CREAT, S_IRUSR|S_IWUSR);
+    }
+
+    writeToPage(metadataBuffer.get(), overflowFileId, 0, O_CREAT, S_IRUSR|S_IWUSR);
+
+    return pages[0];
+}
+
+std::string readOverflowChain(uint64_t fileId, uint64_t firstPage, uint32_t length){
+    uint64_t overflowFileId = fileId | OVERFLOW_FILE_FLAG;
+    std::unique_ptr<char[]> pageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+
+    std::string data;
+    uint64_t currentPage = firstPage;
+    while(currentPage && data.length() < length){
+        if(!readPage(pageBuffer.get(), overflowFileId, currentPage)){
+            break;
+        }
+        uint32_t bytesInPage;
+        memcpy(&currentPage, pageBuffer.get(), sizeof(currentPage));
+        memcpy(&bytesInPage, pageBuffer.get() + sizeof(currentPage), sizeof(bytesInPage));
+        data.append(pageBuffer.get() + OVERFLOW_PAGE_HEADER_SIZE, bytesInPage);
+    }
+    return data;
+}
+
+void freeOverflowChain(uint64_t fileId, uint64_t firstPage){
+    uint64_t overflowFileId = fileId | OVERFLOW_FILE_FLAG;
+    std::unique_ptr<char[]> metadataBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    std::unique_ptr<char[]> pageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+
+    if(!fileExists(overflowFileId) || !readPage(metadataBuffer.get(), overflowFileId, 0)){
+        return;
+    }
+
+    // Find the last page of the chain and link it to the free list
+    uint64_t lastPage = firstPage;
+    while(true){
+        readPage(pageBuffer.get(), overflowFileId, lastPage);
+        uint64_t nextPage;
+        memcpy(&nextPage, pageBuffer.get(), sizeof(nextPage));
+        if(!nextPage){
+            break;
+        }
+        lastPage = nextPage;
+    }
+
+    memcpy(pageBuffer.get(), metadataBuffer.get() + sizeof(uint64_t), sizeof(uint64_t));
+    writeToPage(pageBuffer.get(), overflowFileId, lastPage);
+
+    memcpy(metadataBuffer.get() + sizeof(uint64_t), &firstPage, sizeof(firstPage));
+    writeToPage(metadataBuffer.get(), overflowFileId, 0);
+}
+
+std::string encodeRow(uint64_t fileId, const std::string& row, const std::vector< std::vector< std::string > >& columns){
+    if(!isVariableLength(columns)){
+        return row;
+    }
+
+    std::vector< uint32_t > offsets = getColumnOffsets(row.c_str(), columns);
+    std::string record = row.substr(0, sizeof(uint64_t));
+
+    for(int i=0; i<columns.size(); i++){
+        uint32_t length;
+        memcpy(&length, row.c_str() + offsets[i], sizeof(length));
+
+        if(getTypeFromString(columns[i][1]) != TYPE::VARCHAR || length <= VARCHAR_INLINE_LIMIT){
+            record.append(row, offsets[i], offsets[i+1] - offsets[i]);
+            continue;
+        }
+
+        uint64_t firstPage = writeOverflowChain(fileId, row.c_str() + offsets[i] + sizeof(length), length);
+        length |= VARCHAR_OVERFLOW_BIT;
+        record.append((char *)&length, sizeof(length));
+        record.append((char *)&firstPage, sizeof(firstPage));
+    }
+
+    return record;
+}
+
+std::string decodeRow(uint64_t fileId, const char record[], uint32_t length, const std::vector< std::vector< std::string > >& columns){
+    if(!isVariableLength(columns)){
+        return std::string(record, length);
+    }
+
+    std::string row(record, sizeof(uint64_t));
+    uint32_t offset = sizeof(uint64_t);
+
+    for(int i=0; i<columns.size(); i++){
+        if(getTypeFromString(columns[i][1]) != TYPE::VARCHAR){
+            uint32_t sz = getTypeSize(columns[i][1]);
+            row.append(record + offset, sz);
+            offset += sz;
+            continue;
+        }
+
+        uint32_t valueLength;
+        memcpy(&valueLength, record + offset, sizeof(valueLength));
+        if(!(valueLength & VARCHAR_OVERFLOW_BIT)){
+            row.append(record + offset, sizeof(valueLength) + valueLength);
+            offset += sizeof(valueLength) + valueLength;
+            continue;
+        }
+
+        uint64_t firstPage;
+        memcpy(&firstPage, record + offset + sizeof(valueLength), sizeof(firstPage));
+        valueLength ^= VARCHAR_OVERFLOW_BIT;
+        row.append((char *)&valueLength, sizeof(valueLength));
+        row += readOverflowChain(fileId, firstPage, valueLength);
+        offset += sizeof(valueLength) + sizeof(firstPage);
+    }
+
+    return row;
+}
+
+std::string decodeColumns(uint64_t fileId, const char record[], const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& selected){
+    // Offsets of the fields in the record. Values moved to overflow pages take a length and a page number
+    std::vector< uint32_t > offsets;
+    uint32_t offset = sizeof(uint64_t);
+    for(int i=0; i<columns.size(); i++){
+        offsets.push_back(offset);
+        if(getTypeFromString(columns[i][1]) != TYPE::VARCHAR){
+            offset += getTypeSize(columns[i][1]);
+            continue;
+        }
+        uint32_t valueLength;
+        memcpy(&valueLength, record + offset, sizeof(valueLength));
+        offset += sizeof(valueLength) + ((valueLength & VARCHAR_OVERFLOW_BIT) ? sizeof(uint64_t) : valueLength);
+    }
+
+    std::string row(record, sizeof(uint64_t));
+    for(int i=0; i<selected.size(); i++){
+        uint32_t column = selected[i];
+        if(getTypeFromString(columns[column][1]) != TYPE::VARCHAR){
+            row.append(record + offsets[column], getTypeSize(columns[column][1]));
+            continue;
+        }
+
+        uint32_t valueLength;
+        memcpy(&valueLength, record + offsets[column], sizeof(valueLength));
+        if(!(valueLength & VARCHAR_OVERFLOW_BIT)){
+            row.append(record + offsets[column], sizeof(valueLength) + valueLength);
+            continue;
+        }
+
+        uint64_t firstPage;
+        memcpy(&firstPage, record + offsets[column] + sizeof(valueLength), sizeof(firstPage));
+        valueLength ^= VARCHAR_OVERFLOW_BIT;
+        row.append((char *)&valueLength, sizeof(valueLength));
+        row += readOverflowChain(fileId, firstPage, valueLength);
+    }
+
+    return row;
+}
+
+std::vector< uint64_t > getRowOverflowChains(const char record[], const std::vector< std::vector< std::string > >& columns){
+    std::vector< uint64_t > chains;
+    uint32_t offset = sizeof(uint64_t);
+
+    for(int i=0; i<columns.size(); i++){
+        if(getTypeFromString(columns[i][1]) != TYPE::VARCHAR){
+            offset += getTypeSize(columns[i][1]);
+            continue;
+        }
+
+        uint32_t valueLength;
+        memcpy(&valueLength, record + offset, sizeof(valueLength));
+        if(!(valueLength & VARCHAR_OVERFLOW_BIT)){
+            offset += sizeof(valueLength) + valueLength;
+            continue;
+        }
+
+        uint64_t firstPage;
+        memcpy(&firstPage, record + offset + sizeof(valueLength), sizeof(firstPage));
+        chains.push_back(firstPage);
+        offset += sizeof(valueLength) + sizeof(firstPage);
+    }
+    return chains;
+}
+
+void freeRowOverflow(uint64_t fileId, const char record[], const std::vector< std::vector< std::string > >& columns){
+    std::vector< uint64_t > chains = getRowOverflowChains(record, columns);
+    for(int i=0; i<chains.size(); i++){
+        freeOverflowChain(fileId, chains[i]);
+    }
+}
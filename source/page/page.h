@@ -0,0 +1,105 @@
+#ifndef PAGE_H
+#define PAGE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../properties.h"
+
+/**
+ * @brief Slotted page structure (used by tables and queries having varchar columns):
+ * 1) First 4 bytes store total bytes occupied by records (same as fixed width pages)
+ * 2) Next 2 bytes store the number of slots. Next 2 bytes store the start of the record heap
+ * 3) Slot directory follows. Each slot stores a 2 byte record offset and a 2 byte record length. Offset 0 marks an empty slot
+ * 4) Records are written from the end of the page towards the slot directory
+ * A page filled with zeroes is a valid empty slotted page.
+ */
+const uint32_t SLOTTED_PAGE_HEADER_SIZE = sizeof(uint32_t) + 2*sizeof(uint16_t);
+const uint32_t SLOT_SIZE = 2*sizeof(uint16_t);
+
+/**
+ * @brief Check if rows with these columns need the slotted page structure
+ *
+ * @param columns columns of the table
+ * @return true if at least one column is a varchar
+ * @return false otherwise
+ */
+bool isVariableLength(const std::vector< std::vector< std::string > >& columns);
+
+uint16_t getSlotCount(const char PAGE[]);
+void getSlot(const char PAGE[], uint16_t slot, uint16_t& offset, uint16_t& length);
+
+/**
+ * @brief Get the number of bytes that can still be used for records and slots (after compaction)
+ */
+uint32_t getSlottedPageFreeSpace(const char PAGE[]);
+
+/**
+ * @brief Inserts a record in the page, reusing empty slots and compacting the page when required
+ *
+ * @return int32_t slot of the inserted record. -1 if the record doesn't fit
+ */
+int32_t insertIntoSlottedPage(char PAGE[], const char record[], uint32_t length);
+
+/**
+ * @brief Replaces the record in a slot. The record is moved inside the page if it grows
+ *
+ * @return true if the new record fits in the page
+ * @return false otherwise. The page is not modified in this case
+ */
+bool updateSlottedPage(char PAGE[], uint16_t slot, const char record[], uint32_t length);
+void deleteFromSlottedPage(char PAGE[], uint16_t slot);
+void compactSlottedPage(char PAGE[]);
+
+/**
+ * @brief Get (offset, length) of every non empty row of a page
+ *
+ * @param PAGE page buffer
+ * @param rowSize row size of fixed width pages
+ * @param slotted true if the page uses the slotted structure
+ */
+std::vector< std::pair< uint32_t, uint32_t > > getRowsOfPage(const char PAGE[], uint32_t rowSize, bool slotted);
+
+/**
+ * @brief Get the maximum number of bytes a row occupies in a page (ID included)
+ */
+uint32_t getRowSize(const std::vector< std::vector< std::string > > &columns);
+
+/**
+ * @brief Get offsets of all columns in a decoded row. The last entry is the end of the row
+ */
+std::vector< uint32_t > getColumnOffsets(const char row[], const std::vector< std::vector< std::string > >& columns);
+
+/**
+ * @brief Convert a decoded row into the record stored in pages of a file. varchar values
+ * longer than VARCHAR_INLINE_LIMIT are written to overflow pages of the file.
+ */
+std::string encodeRow(uint64_t fileId, const std::string& row, const std::vector< std::vector< std::string > >& columns);
+
+/**
+ * @brief Convert a record stored in pages of a file into a decoded row, reading overflow pages if required
+ */
+std::string decodeRow(uint64_t fileId, const char record[], uint32_t length, const std::vector< std::vector< std::string > >& columns);
+
+/**
+ * @brief Decode some columns of a record: the ID followed by the selected columns in the given order.
+ * Overflow pages are read only for selected columns
+ */
+std::string decodeColumns(uint64_t fileId, const char record[], const std::vector< std::vector< std::string > >& columns, const std::vector< uint32_t >& selected);
+
+/**
+ * @brief Get the first pages of the overflow chains referenced by a record
+ */
+std::vector< uint64_t > getRowOverflowChains(const char record[], const std::vector< std::vector< std::string > >& columns);
+
+/**
+ * @brief Add an overflow chain of a file to the free list of its overflow pages
+ */
+void freeOverflowChain(uint64_t fileId, uint64_t firstPage);
+
+/**
+ * @brief Release the overflow pages referenced by a record
+ */
+void freeRowOverflow(uint64_t fileId, const char record[], const std::vector< std::vector< std::string > >& columns);
+
+#endif // PAGE_H
@@ -0,0 +1,262 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include "parallel.h"
+#include "../properties.h"
+#include "../database/database.h"
+#include "../temp/temp.h"
+#include "../logger/logger.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+/**
+ * @brief Initial number of tasks a WorkDeque holds. Must be a power of 2
+ */
+const int64_t WORK_DEQUE_CAPACITY = 64;
+
+/**
+ * @brief Worker the thread is (see WorkerPool). Threads outside of the pool are worker 0
+ */
+thread_local uint32_t CURRENT_WORKER = 0;
+
+WorkDeque::WorkDeque(){
+    mArrays.push_back(std::make_unique<Array>(WORK_DEQUE_CAPACITY));
+    mArray = mArrays.back().get();
+}
+
+void WorkDeque::push(Task* task){
+    int64_t bottom = mBottom.load(std::memory_order_relaxed);
+    int64_t top = mTop.load(std::memory_order_acquire);
+    Array* array = mArray.load(std::memory_order_relaxed);
+
+    if(bottom - top >= array->capacity){
+        // Full. Tasks move to an array twice as large
+        mArrays.push_back(std::make_unique<Array>(2*array->capacity));
+        Array* grown = mArrays.back().get();
+        for(int64_t i=top; i<bottom; i++){
+            grown->put(i, array->get(i));
+        }
+        mArray.store(grown, std::memory_order_release);
+        array = grown;
+    }
+
+    array->put(bottom, task);
+    mBottom.store(bottom + 1, std::memory_order_seq_cst);
+}
+
+Task* WorkDeque::pop(){
+    int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+    Array* array = mArray.load(std::memory_order_relaxed);
+    // Claim the bottom task before looking at the top, so that thieves see it is taken
+    mBottom.store(bottom, std::memory_order_seq_cst);
+    int64_t top = mTop.load(std::memory_order_seq_cst);
+
+    if(top > bottom){
+        // Empty
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Task* task = array->get(bottom);
+    if(top == bottom){
+        // Last task. Thieves may be taking it too
+        if(!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)){
+            task = nullptr;
+        }
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+Task* WorkDeque::steal(){
+    int64_t top = mTop.load(std::memory_order_seq_cst);
+    int64_t bottom = mBottom.load(std::memory_order_seq_cst);
+    if(top >= bottom){
+        return nullptr;
+    }
+
+    Array* array = mArray.load(std::memory_order_acquire);
+    Task* task = array->get(top);
+    if(!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)){
+        return nullptr;
+    }
+    return task;
+}
+
+WorkerPool& WorkerPool::getPool(){
+    static WorkerPool pool(PARALLEL_WORKERS ? PARALLEL_WORKERS : std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+uint32_t WorkerPool::getCurrentWorker(){
+    return CURRENT_WORKER;
+}
+
+WorkerPool::WorkerPool(uint32_t workers){
+    // Worker 0 is the thread waiting for the tasks, so one thread fewer is started
+    for(uint32_t i=1; i<workers; i++){
+        mDeques.push_back(std::make_unique<WorkDeque>());
+    }
+    for(uint32_t i=1; i<workers; i++){
+        mThreads.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+
+    if(DEBUG == true){
+        std::cout << "Started worker pool with " << workers << " workers" << std::endl;
+    }
+}
+
+WorkerPool::~WorkerPool(){
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    for(int i=0; i<mThreads.size(); i++){
+        mThreads[i].join();
+    }
+}
+
+void WorkerPool::submit(Task* task){
+    if(CURRENT_WORKER > 0){
+        mDeques[CURRENT_WORKER - 1]->push(task);
+    } else {
+        std::lock_guard<std::mutex> lock(mInjectedMutex);
+        mInjected.push_back(task);
+    }
+    mQueued++;
+
+    if(!mThreads.empty()){
+        // Taking the lock makes sure a thread about to sleep sees the task
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWake.notify_one();
+    }
+}
+
+bool WorkerPool::runQueuedTask(TaskGroup* group){
+    Task* task = nullptr;
+    if(CURRENT_WORKER > 0){
+        task = mDeques[CURRENT_WORKER - 1]->pop();
+        if(task && group && task->group != group){
+            // Newest task of the deque is of another group. Only the worker of the deque pushes, so it goes back where it was
+            mDeques[CURRENT_WORKER - 1]->push(task);
+            task = nullptr;
+        }
+    }
+    if(!task){
+        std::lock_guard<std::mutex> lock(mInjectedMutex);
+        auto it = mInjected.begin();
+        while(group && it != mInjected.end() && (*it)->group != group){
+            it++;
+        }
+        if(it != mInjected.end()){
+            task = *it;
+            mInjected.erase(it);
+        }
+    }
+    // Stolen tasks can't be picked by group
+    for(uint32_t i=0; !task && !group && i<mDeques.size(); i++){
+        // Start with the next worker, so that thieves spread over the deques
+        task = mDeques[(CURRENT_WORKER + i) % mDeques.size()]->steal();
+    }
+    if(!task){
+        return false;
+    }
+    mQueued--;
+
+    if(!task->group->isCancelled()){
+        task->function();
+    }
+    task->group->finishTask();
+    delete task;
+    return true;
+}
+
+void WorkerPool::workerLoop(uint32_t worker){
+    CURRENT_WORKER = worker;
+
+#ifdef __linux__
+    if(PARALLEL_PIN_WORKERS){
+        // Worker 0 (the thread waiting) isn't pinned, so the pool threads take the other hardware threads first
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+
+    while(true){
+        if(runQueuedTask()){
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [&](){ return mStopping || mQueued > 0; });
+        if(mStopping){
+            return;
+        }
+    }
+}
+
+bool WorkerPool::parallelFor(uint64_t count, const std::function< bool(uint64_t task, uint32_t worker) >& task){
+    TaskGroup group(*this);
+    std::atomic<bool> succeeded{true};
+    for(uint64_t i=0; i<count; i++){
+        group.run([&, i](){
+            if(!task(i, CURRENT_WORKER)){
+                succeeded = false;
+                group.cancel();
+            }
+        });
+    }
+    group.wait();
+    return succeeded;
+}
+
+TaskGroup::TaskGroup(WorkerPool& pool) : mPool(pool) {}
+
+TaskGroup::~TaskGroup(){
+    wait();
+}
+
+void TaskGroup::run(std::function< void() > function){
+    mUnfinished++;
+    // Tasks run for the statement submitting them, in its database and writing to its client, whichever thread runs them
+    uint64_t database = Database::getCurrentDatabaseNumber();
+    uint64_t statement = TempFiles::getStatement();
+    std::ostream* output = &Logger::getOutput();
+    mPool.submit(new Task{[function = std::move(function), database, statement, output](){
+        uint64_t previousDatabase = Database::getCurrentDatabaseNumber();
+        uint64_t previousStatement = TempFiles::getStatement();
+        std::ostream* previousOutput = &Logger::getOutput();
+        Database::setCurrentDatabase(database);
+        TempFiles::setStatement(statement);
+        Logger::setOutput(output);
+        function();
+        Database::setCurrentDatabase(previousDatabase);
+        TempFiles::setStatement(previousStatement);
+        Logger::setOutput(previousOutput);
+    }, this});
+}
+
+void TaskGroup::finishTask(){
+    // Decremented under the lock, so that wait can't return (and the group be destroyed) before the notification
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(--mUnfinished == 0){
+        mFinished.notify_all();
+    }
+}
+
+void TaskGroup::wait(){
+    while(mUnfinished > 0){
+        if(mPool.runQueuedTask(this)){
+            continue;
+        }
+        // Tasks of the group are running (or queued) on pool threads
+        std::unique_lock<std::mutex> lock(mMutex);
+        mFinished.wait_for(lock, std::chrono::milliseconds(1), [&](){ return mUnfinished == 0; });
+    }
+    // Wait for finishTask to release the lock before the group can be destroyed
+    std::lock_guard<std::mutex> lock(mMutex);
+}
@@ -0,0 +1,170 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+class TaskGroup;
+
+/**
+ * @brief Task of a TaskGroup, waiting in a queue of the pool until a thread runs it
+ */
+struct Task {
+    std::function< void() > function;
+    TaskGroup* group;
+};
+
+/**
+ * @brief Chase-Lev work stealing deque. Its worker pushes and pops tasks at the bottom (newest first,
+ * while their data is still in cache), other threads steal from the top (oldest first, usually the
+ * largest pieces of work). Only stealing the last task takes a compare and swap. The array grows
+ * when full. Replaced arrays are kept until the deque is destroyed, since thieves may still read them
+ */
+class WorkDeque {
+    struct Array {
+        int64_t capacity;
+        std::unique_ptr< std::atomic<Task*>[] > tasks;
+
+        Array(int64_t size) : capacity(size), tasks(new std::atomic<Task*>[size]()) {}
+        Task* get(int64_t index){ return tasks[index & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t index, Task* task){ tasks[index & (capacity - 1)].store(task, std::memory_order_relaxed); }
+    };
+
+    std::atomic<int64_t> mTop{0};
+    std::atomic<int64_t> mBottom{0};
+    std::atomic<Array*> mArray;
+    std::vector< std::unique_ptr<Array> > mArrays;
+public:
+    WorkDeque();
+
+    /**
+     * @brief Add a task at the bottom. Only called by the worker of the deque
+     */
+    void push(Task* task);
+
+    /**
+     * @brief Take the newest task. Only called by the worker of the deque
+     *
+     * @return Task* nullptr if the deque is empty
+     */
+    Task* pop();
+
+    /**
+     * @brief Take the oldest task. Called by any thread
+     *
+     * @return Task* nullptr if the deque is empty or another thread took the task first
+     */
+    Task* steal();
+};
+
+/**
+ * @brief Threads running the tasks of the process (morsels of table scans, updates and deletes), so that
+ * concurrent work shares PARALLEL_WORKERS threads instead of oversubscribing the machine.
+ * Every pool thread has a WorkDeque. Tasks created by a pool thread go to its own deque, tasks created
+ * by other threads to a shared queue. Threads out of tasks steal from the deques of the others, and threads
+ * waiting for a TaskGroup run queued tasks of that group in the meantime. Workers are numbered for state kept
+ * per worker: pool threads are 1 to getWorkerCount() - 1, threads outside of the pool are worker 0.
+ * Any number of outside threads can wait for groups at once: since they only run tasks of the group they wait
+ * for, worker 0 of a group is always its waiting thread, and two threads never run tasks of a group as the same worker
+ */
+class WorkerPool {
+    std::vector< std::thread > mThreads;
+    // Deque of every pool thread (worker i has deque i - 1)
+    std::vector< std::unique_ptr<WorkDeque> > mDeques;
+
+    // Tasks created by threads outside of the pool
+    std::mutex mInjectedMutex;
+    std::deque< Task* > mInjected;
+
+    // Tasks queued and not taken yet. Idle pool threads sleep until there are some
+    std::atomic<int64_t> mQueued{0};
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    bool mStopping = false;
+
+    WorkerPool(uint32_t workers);
+    void workerLoop(uint32_t worker);
+public:
+    /**
+     * @brief Pool of the process, with PARALLEL_WORKERS workers (one per hardware thread if 0).
+     * Threads are started on the first call
+     */
+    static WorkerPool& getPool();
+
+    /**
+     * @brief Worker the calling thread is (0 outside of the pool)
+     */
+    static uint32_t getCurrentWorker();
+
+    uint32_t getWorkerCount(){ return mThreads.size() + 1; }
+
+    /**
+     * @brief Queue a task. Called by TaskGroup::run
+     */
+    void submit(Task* task);
+
+    /**
+     * @brief Take a queued task and run it on the calling thread. With a group, only a task of that group
+     * is taken (from the shared queue, or the bottom of the deque of the calling pool thread)
+     *
+     * @return false if no task was found
+     */
+    bool runQueuedTask(TaskGroup* group = nullptr);
+
+    /**
+     * @brief Run task(i, worker) for i in [0, count) and return once every task ran. worker is the
+     * worker running the task (see getCurrentWorker). A task returning false cancels the tasks not started yet
+     *
+     * @return false if a task returned false
+     */
+    bool parallelFor(uint64_t count, const std::function< bool(uint64_t task, uint32_t worker) >& task);
+
+    ~WorkerPool();
+};
+
+/**
+ * @brief Tasks waited for together (fork join). Tasks can create more tasks of their group.
+ * The group is waited for when it is destroyed
+ */
+class TaskGroup {
+    WorkerPool& mPool;
+    std::atomic<uint64_t> mUnfinished{0};
+    std::atomic<bool> mCancelled{false};
+    std::mutex mMutex;
+    std::condition_variable mFinished;
+public:
+    TaskGroup(WorkerPool& pool = WorkerPool::getPool());
+
+    /**
+     * @brief Queue a task of the group
+     */
+    void run(std::function< void() > function);
+
+    /**
+     * @brief Return once every task of the group finished. The calling thread runs queued tasks of the group
+     * in the meantime, never tasks of other groups, which may keep state for the worker it is
+     */
+    void wait();
+
+    /**
+     * @brief Skip the tasks of the group that haven't started. Running tasks can check isCancelled to stop early
+     */
+    void cancel(){ mCancelled = true; }
+    bool isCancelled(){ return mCancelled; }
+
+    /**
+     * @brief Called by the pool once a task of the group ran (or was skipped)
+     */
+    void finishTask();
+
+    ~TaskGroup();
+};
+
+#endif // PARALLEL_H
@@ -1,24 +1,41 @@
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <functional>
 #include "parse.h"
 #include "../condition/condition.h"
 #include "../logger/logger.h"
 #include "../database/database.h"
 #include "../table/table.h"
 #include "../table/tableV2.h"
+#include "../context/context.h"
+#include "../lock/lock.h"
+#include "../mvcc/mvcc.h"
 
 void stripString(std::string &s);
 std::vector<std::string> generateTokens(const std::string& command);
 
-void handleInsertIntoTable(const std::vector< std::string >& tokens){
+/**
+ * @brief Run a statement changing rows. In a transaction of its own, it runs again with a new snapshot after
+ * losing a write conflict. In one opened by begin it fails instead, since the earlier statements would be undone too
+ */
+bool runChange(ExecutionContext& context, const std::function< bool() >& change){
+	if(context.autocommit){
+		return TransactionManager::getManager().retryOnConflict(*context.transaction, change, &context.snapshot);
+	}
+	return change();
+}
+
+bool handleInsertIntoTable(ExecutionContext& context, const std::vector< std::string >& tokens){
 
 	if(!Database::isDatabaseChosen()){
 		Logger::logError("No database chosen");
-		return;
+		return false;
 	}
 
 	if(tokens[3] != "values" || tokens[4] != "(" || tokens[tokens.size()-1] != ")"){
 		Logger::logError("Syntax error in insert statement.");
-		return;
+		return false;
 	}
 
 	std::string tableName = tokens[2];
@@ -30,25 +47,26 @@ void handleInsertIntoTable(const std::vector< std::string >& tokens){
 		}
 	}
 
-	TableV2 tab(tableName);
+	TableV2 tab(context, tableName);
 	if(tab == 0){
 		Logger::logError("Table with given name doesn't exist");
-		return;
+		return false;
 	}
 
-	if(!tab.insert(columnValues)){
+	if(!runChange(context, [&](){ return tab.insert(columnValues); })){
 		Logger::logError("Error in inserting into table");
-		return;
+		return false;
 	}
 
 	Logger::logSuccess("Successfully inserted row");
+	return true;
 }
 
-void handleUpdateTable(const std::vector< std::string >& tokens){
-	TableV2 tab(tokens[1]);
+bool handleUpdateTable(ExecutionContext& context, const std::vector< std::string >& tokens){
+	TableV2 tab(context, tokens[1]);
 	if(tab == 0){
 		Logger::logError("Table " + tokens[1] +"doesn't exist");
-		return;
+		return false;
 	}
 
 	std::vector< std::pair< std::string, std::string > > assignments;
@@ -66,7 +84,7 @@ void handleUpdateTable(const std::vector< std::string >& tokens){
 		if(tokens[i] == ","){
 			if(currentTokens.size() != 3){
 				Logger::logError("Syntax error in update statement");
-				return;
+				return false;
 			}
 			assignments.push_back(make_pair(currentTokens[0], currentTokens[2]));
 			currentTokens.clear();
@@ -77,7 +95,7 @@ void handleUpdateTable(const std::vector< std::string >& tokens){
 
 	if(currentTokens.size() != 3){
 		Logger::logError("Syntax error in update statement");
-		return;
+		return false;
 	}
 
 	assignments.push_back(make_pair(currentTokens[0], currentTokens[2]));
@@ -89,7 +107,7 @@ void handleUpdateTable(const std::vector< std::string >& tokens){
 			currentTokens.clear();
 			if(cd.operation == COMPARISON::INVALID){
 				Logger::logError("condition invalid");
-				return;
+				return false;
 			}
 			conditions.push_back(cd);
 		} else {
@@ -99,33 +117,33 @@ void handleUpdateTable(const std::vector< std::string >& tokens){
 
 	if(currentTokens.size()==0){
 		Logger::logError("Syntax error");
-		return;
+		return false;
 	}
 	condition cd = getCondition(currentTokens);
 	if(cd.operation == COMPARISON::INVALID){
 		Logger::logError("Invalid operation");
-		return;
+		return false;
 	}
 	conditions.push_back(cd);
 
-	if(!tab.update(assignments, conditions)){
+	if(!runChange(context, [&](){ return tab.update(assignments, conditions); })){
 		Logger::logError("Error in updating table");
-		return;
+		return false;
 	}
 	Logger::logSuccess("Successfully updated table");
-	return;
+	return true;
 
 }
 
-void handleDeleteRow(const std::vector< std::string >& tokens){
-	TableV2 tab(tokens[2]);
+bool handleDeleteRow(ExecutionContext& context, const std::vector< std::string >& tokens){
+	TableV2 tab(context, tokens[2]);
 	if(tab == 0){
 		Logger::logError("Table does not exist");
-		return;
+		return false;
 	}
 	if(tokens[3] != "where"){
 		Logger::logError("Syntax error: where clause expected");
-		return;
+		return false;
 	}
 	std::vector< condition > conditions;
 	std::vector< std::string > currentTokens;
@@ -134,7 +152,7 @@ void handleDeleteRow(const std::vector< std::string >& tokens){
 			condition cd = getCondition(currentTokens);
 			if(cd.operation == COMPARISON::INVALID){
 				Logger::logError("Syntax error: invalid condition");
-				return;
+				return false;
 			}
 			conditions.push_back(cd);
 			currentTokens.clear();
@@ -144,29 +162,159 @@ void handleDeleteRow(const std::vector< std::string >& tokens){
 	}
 	if(currentTokens.size()==0){
 		Logger::logError("Syntax error: no condition provided");
-		return;
+		return false;
 	}
 	condition cd = getCondition(currentTokens);
 	if(cd.operation == COMPARISON::INVALID){
 		Logger::logError("Invalid condition provided");
-		return;
+		return false;
 	}
 	conditions.push_back(cd);
-	if(!tab.deleteRow(conditions)){
+	if(!runChange(context, [&](){ return tab.deleteRow(conditions); })){
 		Logger::logError("Fatal: Error in deleting rows");
-		return;
+		return false;
 	}
 	Logger::logSuccess("Successfully deleted rows");
-	return;
+	return true;
+}
+
+/**
+ * @brief Roll back the open transaction of a session after one of its statements failed.
+ * Its further statements are ignored until commit or rollback
+ */
+void abortTransaction(Session& session){
+	TransactionManager& transactions = TransactionManager::getManager();
+	if(session.transaction.conflictWriter){
+		Logger::logError("Transaction lost a write conflict with transaction " + std::to_string(session.transaction.conflictWriter) + " and was rolled back");
+	} else {
+		Logger::logError("Transaction was rolled back after a failed statement");
+	}
+	transactions.releaseSnapshot(session.snapshot);
+	transactions.rollback(session.transaction);
+	session.aborted = true;
+}
+
+void handleTransactionStatement(Session& session, const std::vector< std::string >& tokens){
+	TransactionManager& transactions = TransactionManager::getManager();
+	if(tokens[0] == "begin"){
+		if(session.inTransaction){
+			Logger::logError("A transaction is already open");
+			return;
+		}
+		transactions.begin(session.transaction);
+		session.snapshot = transactions.takeSnapshot(session.transaction);
+		session.inTransaction = true;
+		session.aborted = false;
+		Logger::logSuccess("Transaction started");
+		return;
+	}
+
+	if(!session.inTransaction){
+		Logger::logError("No transaction is open");
+		return;
+	}
+	session.inTransaction = false;
+	if(session.aborted){
+		// Rolled back already
+		session.aborted = false;
+		if(tokens[0] == "commit"){
+			Logger::logError("Transaction was rolled back");
+		} else {
+			Logger::logSuccess("Transaction rolled back");
+		}
+		return;
+	}
+
+	if(tokens[0] == "rollback"){
+		transactions.rollback(session.transaction);
+		Logger::logSuccess("Transaction rolled back");
+	} else if(transactions.commit(session.transaction)){
+		Logger::logSuccess("Transaction committed");
+	} else {
+		Logger::logError("Error in committing transaction. It was rolled back");
+	}
+	// Commit checks the changes against versions the snapshot keeps
+	transactions.releaseSnapshot(session.snapshot);
+}
+
+/**
+ * @brief Check if a token of a prepared statement is a parameter ($1, $2 and so on)
+ */
+bool isParameter(const std::string& token){
+	return token.length() >= 2 && token.length() <= 6 && token[0] == '$' && token.find_first_not_of("0123456789", 1) == std::string::npos;
+}
+
+/**
+ * @brief Keep the statement after as under the given name, for execute. $1, $2 and so on stand for values given to execute
+ */
+void handlePrepare(Session& session, const std::vector< std::string >& tokens){
+	PreparedStatement statement;
+	statement.tokens.assign(tokens.begin() + 3, tokens.end());
+	for(int i=0; i<statement.tokens.size(); i++){
+		if(!isParameter(statement.tokens[i])){
+			continue;
+		}
+		uint32_t parameter = std::stoul(statement.tokens[i].substr(1));
+		if(parameter == 0){
+			Logger::logError("Parameters are numbered from $1");
+			return;
+		}
+		statement.parameters = std::max(statement.parameters, parameter);
+	}
+	session.preparedStatements[tokens[1]] = statement;
+	Logger::logSuccess("Statement " + tokens[1] + " prepared with " + std::to_string(statement.parameters) + " parameters");
 }
 
-void processCommand(const std::string& command){
+/**
+ * @brief Replace the tokens of execute <name> ( <value> , ... ) with the tokens of the prepared statement, its parameters
+ * replaced by the values
+ */
+bool bindPreparedStatement(Session& session, std::vector< std::string >& tokens){
+	auto statement = session.preparedStatements.find(tokens[1]);
+	if(statement == session.preparedStatements.end()){
+		Logger::logError("Prepared statement " + tokens[1] + " doesn't exist");
+		return false;
+	}
+
+	std::vector< std::string > values;
+	if(tokens.size() > 2){
+		if(tokens.size() < 4 || tokens[2] != "(" || tokens[tokens.size()-1] != ")"){
+			Logger::logError("Syntax error in execute statement. Values are given as ( value1 , value2 )");
+			return false;
+		}
+		for(int i=3; i<tokens.size()-1; i++){
+			if(tokens[i] != ","){
+				values.push_back(tokens[i]);
+			}
+		}
+	}
+	if(values.size() != statement->second.parameters){
+		Logger::logError("Prepared statement " + tokens[1] + " takes " + std::to_string(statement->second.parameters) + " values");
+		return false;
+	}
+
+	std::vector< std::string > bound = statement->second.tokens;
+	for(int i=0; i<bound.size(); i++){
+		if(isParameter(bound[i])){
+			bound[i] = values[std::stoul(bound[i].substr(1)) - 1];
+		}
+	}
+	tokens = bound;
+	return true;
+}
+
+void processCommand(const std::string& command, Session& session){
+
+	std::ostream& output = Logger::getOutput();
 
 	if(command.size() > 2*PAGE_SIZE){
 		Logger::logError("Query must fit into two pages.");
 		return;
 	}
 
+	// The thread may have run statements of other sessions
+	Database::setCurrentDatabase(session.database);
+
     std::string _command = command;
     stripString(_command);
     std::vector<std::string> tokens = generateTokens(_command);
@@ -179,51 +327,140 @@ void processCommand(const std::string& command){
         std::cout << std::endl;
     }
 
+    if(tokens.size() > 3 && tokens[0] == "prepare" && tokens[2] == "as"){
+        if(DEBUG == true){
+            std::cout << "prepare query observed" << std::endl;
+        }
+        handlePrepare(session, tokens);
+        output << std::endl;
+        return;
+    }
+
+    if(tokens.size() == 2 && tokens[0] == "deallocate"){
+        if(session.preparedStatements.erase(tokens[1])){
+            Logger::logSuccess("Statement " + tokens[1] + " deallocated");
+        } else {
+            Logger::logError("Prepared statement " + tokens[1] + " doesn't exist");
+        }
+        output << std::endl;
+        return;
+    }
+
+    if(tokens.size() > 1 && tokens[0] == "execute"){
+        if(DEBUG == true){
+            std::cout << "execute query observed" << std::endl;
+        }
+        if(!bindPreparedStatement(session, tokens)){
+            output << std::endl;
+            return;
+        }
+    }
+
+    if(tokens.size() && (tokens[0] == "begin" || tokens[0] == "commit" || tokens[0] == "rollback") && (tokens.size() == 1 || (tokens.size() == 2 && tokens[1] == "transaction"))){
+        if(DEBUG == true){
+            std::cout << tokens[0] << " query observed" << std::endl;
+        }
+        handleTransactionStatement(session, tokens);
+        output << std::endl;
+        return;
+    }
+
+    if(session.aborted && !(tokens.size() == 1 && tokens[0] == "exit")){
+        Logger::logError("Transaction was rolled back. Statements are ignored until commit or rollback");
+        output << std::endl;
+        return;
+    }
+
+    // Pages and scratch memory of the statement. Statements outside of a transaction opened by begin are one of their own
+    std::unique_ptr<ExecutionContext> context = std::make_unique<ExecutionContext>();
+    TransactionManager& transactions = TransactionManager::getManager();
+    context->transaction = &session.transaction;
+    context->autocommit = !session.inTransaction;
+    if(context->autocommit){
+        transactions.begin(session.transaction);
+        context->snapshot = transactions.takeSnapshot(session.transaction);
+    } else {
+        context->snapshot = session.snapshot;
+    }
+    bool succeeded = true;
+    LockStats locksBefore = LockManager::getManager().getStats();
+
     if(tokens.size()>2 && tokens[0] == "create" && tokens[1] == "database"){
         if(DEBUG == true){
             std::cout << "create database query observed" << std::endl;
         }
-        Database::createDatabase(tokens);
+        Database::createDatabase(*context, tokens);
     } else if(tokens.size()>1 && tokens[0] == "use"){
 		if(DEBUG == true){
 			std::cout << "use database query observed" << std::endl;
 		}
 		Database::useDatabase(tokens);
+		session.database = Database::getCurrentDatabaseNumber();
 	} else if(tokens.size()>2 && tokens[0] == "create" && tokens[1] == "table"){
 		if(DEBUG == true){
 			std::cout << "create table query observed" << std::endl;
 		}
-		Table::createTable(tokens);
+		Table::createTable(*context, tokens);
 	} else if(tokens.size()>2 && tokens[0] == "insert" && tokens[1] == "into"){
 		if(DEBUG == true){
 			std::cout << "insert into query observed" << std::endl;
 		}
-		handleInsertIntoTable(tokens);
-		// Table::insertIntoTable(tokens);
-	} else if(tokens.size() > 3 && tokens[0] == "select" && tokens[1] == "*" && tokens[2] == "from"){
+		succeeded = handleInsertIntoTable(*context, tokens);
+		// Table::insertIntoTable(*context, tokens);
+	} else if(tokens.size() > 3 && tokens[0] == "select" && std::find(tokens.begin(), tokens.end(), "from") != tokens.end()){
 		if(DEBUG == true){
 			std::cout << "select from query observed" << std::endl;
 		}
-		Table::handleSearchQuery(tokens);
+		Table::handleSearchQuery(*context, tokens);
 	} else if(tokens.size()>3 && tokens[0] == "update" && tokens[2] == "set"){
 		if(DEBUG == true){
 			std::cout << "update query observed" << std::endl;
 		}
-		handleUpdateTable(tokens);
-		// Table::handleUpdateTable(tokens);
+		succeeded = handleUpdateTable(*context, tokens);
+		// Table::handleUpdateTable(*context, tokens);
 	} else if(tokens.size()>4 && tokens[0] == "delete" && tokens[1] == "from"){
 		if(DEBUG == true){
 			std::cout << "delete from query observed" << std::endl;
 		}
-		handleDeleteRow(tokens);
-		// Table::handleDeleteRow(tokens);
+		succeeded = handleDeleteRow(*context, tokens);
+		// Table::handleDeleteRow(*context, tokens);
 
 	} else if(tokens.size() == 1 && tokens[0] == "exit"){
-		std::cout << "Bye!" << std::endl;
-		PROG_RUNNING = false;
+		if(session.inTransaction && !session.aborted){
+			transactions.releaseSnapshot(session.snapshot);
+			transactions.rollback(session.transaction);
+			Logger::logSuccess("Open transaction rolled back");
+		}
+		session.inTransaction = false;
+		session.aborted = false;
+		output << "Bye!" << std::endl;
+		session.closed = true;
+	}
+
+	if(context->autocommit){
+		// Failed statements leave no changes behind
+		if(!succeeded){
+			transactions.rollback(session.transaction);
+		} else if(!transactions.commit(session.transaction)){
+			Logger::logError("Error in committing statement. It was rolled back");
+		}
+		transactions.releaseSnapshot(context->snapshot);
+	} else if(!succeeded || !transactions.limitBufferedPages(session.transaction)){
+		abortTransaction(session);
+	}
+
+	if(DEBUG == true){
+		// Waits of every session while the statement ran
+		LockStats locksAfter = LockManager::getManager().getStats();
+		if(locksAfter.tableWaits > locksBefore.tableWaits || locksAfter.latchWaits > locksBefore.latchWaits){
+			std::cout << "Lock waits: " << locksAfter.tableWaits - locksBefore.tableWaits << " table ("
+				<< (locksAfter.tableWaitNanos - locksBefore.tableWaitNanos)/1000 << " us), "
+				<< locksAfter.latchWaits - locksBefore.latchWaits << " latch ("
+				<< (locksAfter.latchWaitNanos - locksBefore.latchWaitNanos)/1000 << " us)" << std::endl;
+		}
 	}
 	
-	std::cout << std::endl;
+	output << std::endl;
 
 }
 
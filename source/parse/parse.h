@@ -3,7 +3,8 @@
 
 #include <string>
 #include "../properties.h"
+#include "../context/context.h"
 
-void processCommand(const std::string& command);
+void processCommand(const std::string& command, Session& session);
 
 #endif // PARSE_H
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include <iostream>
+#include "properties.h"
+#include "formatter/formatter.h"
+#include "logger/logger.h"
+#include "client/client.h"
+
+/**
+ * @brief Interactive client of the server: penguin_client [socket path]. Reads statements ending with ; like penguin does
+ */
+int main(int argc, char** argv){
+    std::string socketPath = argc > 1 ? argv[1] : SERVER_SOCKET_PATH;
+
+    Client client;
+    if(!client.connect(socketPath)){
+        return 1;
+    }
+    std::cout << Formatter::bold_on << "Penguin DB " << Formatter::off << "Version " << VERSION << ", connected to " << socketPath << "\n" << std::endl;
+
+    while(true){
+        std::cout << Formatter::bold_on << "penguin_db > " << Formatter::off;
+        std::string command;
+        if(!getline(std::cin, command, ';')){
+            // End of input ends the session, rolling back an open transaction
+            command = "exit";
+        }
+
+        std::string output;
+        if(!client.execute(command, output)){
+            std::cout << std::endl;
+            Logger::logError("Connection to the server was closed");
+            return 1;
+        }
+        std::cout << output << std::flush;
+
+        uint64_t start = command.find_first_not_of(" \n\t");
+        uint64_t end = command.find_last_not_of(" \n\t");
+        if(start != std::string::npos && command.substr(start, end - start + 1) == "exit"){
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,184 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
+#include "properties.h"
+#include "logger/logger.h"
+#include "client/client.h"
+
+/**
+ * @brief Load generator for the server: penguin_load [-s socket path] [-c clients] [-n statements per client]
+ * [-r percent of reads] [-d database] [-w workload] [-t table rows]. With the point workload (the default) every
+ * client inserts rows into a table of its database and reads rows back by key (with prepared statements).
+ * With the scan workload a new table is first filled with the given rows, then clients run filtered scans,
+ * projections, group bys and updates over all of it at once, so that statements of several clients share
+ * the worker pool. Then the statements per second and their latencies are printed
+ */
+
+struct LoadResult {
+    std::vector< uint64_t > latencies;
+    uint64_t errors = 0;
+    bool connected = false;
+};
+
+/**
+ * @brief Run a statement, counting it as an error if the server answered with one
+ */
+bool runStatement(Client& client, const std::string& statement, LoadResult& result){
+    std::string output;
+    if(!client.execute(statement, output)){
+        result.errors++;
+        return false;
+    }
+    if(output.find("ERROR") != std::string::npos){
+        result.errors++;
+    }
+    return true;
+}
+
+/**
+ * @brief Statement of the scan workload: a read over the whole table (filter, projection or group by),
+ * or an update of the rows of a key
+ */
+std::string getScanStatement(std::mt19937_64& random, uint32_t readPercent, uint64_t tableRows){
+    uint64_t value = random() % tableRows;
+    if(random() % 100 >= readPercent){
+        return "update loadtab set vv = " + std::to_string(value) + " where kk == " + std::to_string(random() % tableRows);
+    }
+    switch(random() % 3){
+        case 0:
+            return "select count(*) from loadtab where vv < " + std::to_string(value);
+        case 1:
+            return "select kk, vv from loadtab where vv == " + std::to_string(value);
+        default:
+            return "select name, count(*), sum(vv), max(kk) from loadtab group by name";
+    }
+}
+
+void runClient(const std::string& socketPath, const std::string& database, const std::string& workload, uint64_t tableRows,
+    uint32_t client, uint32_t statements, uint32_t readPercent, LoadResult& result){
+    Client connection;
+    if(!connection.connect(socketPath)){
+        return;
+    }
+    result.connected = true;
+    if(!runStatement(connection, "use " + database, result)
+        || !runStatement(connection, "prepare addrow as insert into loadtab values ( $1 , $2 , 'load' )", result)
+        || !runStatement(connection, "prepare getrow as select kk, vv from loadtab where kk == $1", result)){
+        return;
+    }
+
+    std::mt19937_64 random(client);
+    uint64_t inserted = 0;
+    result.latencies.reserve(statements);
+    for(uint32_t i=0; i<statements; i++){
+        std::string statement;
+        if(workload == "scan"){
+            statement = getScanStatement(random, readPercent, tableRows);
+        } else if(inserted && random() % 100 < readPercent){
+            uint64_t key = (uint64_t)client << 32 | (random() % inserted);
+            statement = "execute getrow ( " + std::to_string(key) + " )";
+        } else {
+            uint64_t key = (uint64_t)client << 32 | inserted++;
+            statement = "execute addrow ( " + std::to_string(key) + " , " + std::to_string(i) + " )";
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if(!runStatement(connection, statement, result)){
+            return;
+        }
+        result.latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    runStatement(connection, "exit", result);
+}
+
+int main(int argc, char** argv){
+    std::string socketPath = SERVER_SOCKET_PATH;
+    std::string database = "loaddb";
+    uint32_t clients = 8;
+    uint32_t statements = 1000;
+    uint32_t readPercent = 20;
+    std::string workload = "point";
+    uint64_t tableRows = 20000;
+
+    for(int i=1; i+1<argc; i+=2){
+        std::string option = argv[i];
+        if(option == "-s"){
+            socketPath = argv[i+1];
+        } else if(option == "-c"){
+            clients = std::max(1, atoi(argv[i+1]));
+        } else if(option == "-n"){
+            statements = std::max(1, atoi(argv[i+1]));
+        } else if(option == "-r"){
+            readPercent = std::min(100, std::max(0, atoi(argv[i+1])));
+        } else if(option == "-d"){
+            database = argv[i+1];
+        } else if(option == "-w" && (std::string(argv[i+1]) == "point" || std::string(argv[i+1]) == "scan")){
+            workload = argv[i+1];
+        } else if(option == "-t"){
+            tableRows = std::max(1, atoi(argv[i+1]));
+        } else {
+            Logger::logError("Unknown option " + option + ". Usage: penguin_load [-s socket] [-c clients] [-n statements] [-r read percent] "
+                "[-d database] [-w point|scan] [-t table rows]");
+            return 1;
+        }
+    }
+
+    // The database and table are created unless they exist
+    {
+        Client setup;
+        std::string output;
+        if(!setup.connect(socketPath) || !setup.execute("create database " + database, output) || !setup.execute("use " + database, output)){
+            return 1;
+        }
+        if(output.find("ERROR") != std::string::npos){
+            std::cout << output;
+            return 1;
+        }
+        setup.execute("create table loadtab ( kk int , vv int , name varchar[16] )", output);
+
+        if(workload == "scan" && output.find("ERROR") == std::string::npos){
+            // The table was just created. It is filled before the clients start
+            setup.execute("prepare addrow as insert into loadtab values ( $1 , $2 , 'load' )", output);
+            for(uint64_t i=0; i<tableRows; i++){
+                if(!setup.execute("execute addrow ( " + std::to_string(i) + " , " + std::to_string(i) + " )", output)){
+                    return 1;
+                }
+            }
+        }
+        setup.execute("exit", output);
+    }
+
+    std::vector< LoadResult > results(clients);
+    std::vector< std::thread > threads;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i=0; i<clients; i++){
+        threads.emplace_back(runClient, socketPath, database, workload, tableRows, i, statements, readPercent, std::ref(results[i]));
+    }
+    for(int i=0; i<threads.size(); i++){
+        threads[i].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector< uint64_t > latencies;
+    uint64_t errors = 0;
+    uint32_t connected = 0;
+    for(int i=0; i<results.size(); i++){
+        latencies.insert(latencies.end(), results[i].latencies.begin(), results[i].latencies.end());
+        errors += results[i].errors;
+        connected += results[i].connected;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << connected << " clients ran " << latencies.size() << " statements (" << readPercent << "% reads) in " << seconds << " s: "
+        << (uint64_t)(latencies.size() / seconds) << " statements/s, " << errors << " errors" << std::endl;
+    if(latencies.size()){
+        std::cout << "Latency (us): p50 " << latencies[latencies.size()/2] << ", p99 " << latencies[latencies.size()*99/100]
+            << ", max " << latencies.back() << std::endl;
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,947 @@
+#include <iostream>
+#include <algorithm>
+#include <set>
+#include <map>
+#include "planner.h"
+#include "../expression/expression.h"
+#include "../type/type.h"
+#include "../database/database.h"
+#include "../logger/logger.h"
+#include "../properties.h"
+#include "../stats/stats.h"
+#include "../parallel/parallel.h"
+
+/**
+ * @brief Join orders of up to this many inputs are enumerated exhaustively. Larger queries are ordered greedily
+ */
+const uint32_t JOIN_DP_LIMIT = 10;
+
+/**
+ * @brief Input of a join plan: the first input or a joined table, with its single table conditions
+ */
+struct JoinInput {
+    std::unique_ptr<Operator> input;
+    std::string tableName;
+    std::vector< condition > filters;
+    // Estimated rows after the filters
+    double rows = 0;
+    // Rows before the filters. Stands in for the number of distinct values of a column
+    double tableRows = 0;
+};
+
+/**
+ * @brief Condition with a column of input left on the LHS and a column of input right on the RHS
+ */
+struct JoinPredicate {
+    condition cond;
+    uint32_t left;
+    uint32_t right;
+};
+
+/**
+ * @brief Cheapest left deep plan found for a set of inputs: input last joined to the plan of the set rest
+ */
+struct JoinPlan {
+    bool valid = false;
+    double rows = 0;
+    double cost = 0;
+    uint32_t last = 0;
+    uint64_t rest = 0;
+};
+
+bool validateAlias(const std::string& name){
+    std::set< std::string > keywords = {"join", "where", "on", "as", "and", "group", "order", "limit", "offset"};
+    if(name.empty() || name.length() > 16 || keywords.find(name) != keywords.end()){
+        return false;
+    }
+    if((name[0]<'a' || name[0]>'z') && (name[0]<'A' || name[0]>'Z')){
+        return false;
+    }
+    for(int i=0; i<name.length(); i++){
+        if((name[i]<'0' || name[i]>'9') && (name[i]<'a' || name[i]>'z') && (name[i]<'A' || name[i]>'Z') && name[i] != '_'){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseSelectList(const std::vector< std::string >& tokens, int begin, int end, std::vector< SelectItem >& items){
+    std::vector< std::string > item;
+    for(int i=begin; i<=end; i++){
+        if(i < end && tokens[i] != ","){
+            item.push_back(tokens[i]);
+            continue;
+        }
+
+        if(item.empty()){
+            Logger::logError("Empty item in select list");
+            return false;
+        }
+
+        SelectItem selectItem;
+        if(item.size() == 1 && item[0] == "*"){
+            selectItem.all = true;
+            items.push_back(std::move(selectItem));
+            item.clear();
+            continue;
+        }
+
+        uint32_t length = item.size();
+        if(length > 2 && item[length-2] == "as"){
+            if(!validateAlias(item[length-1])){
+                Logger::logError("Invalid column name "+item[length-1]+". Names must be alphanumeric, start with a letter and be at most 16 characters long");
+                return false;
+            }
+            selectItem.name = item[length-1];
+            length -= 2;
+        }
+
+        // Spaces aren't kept inside brackets or before the brackets of a function, e.g. (a + b) * 2, sum(a)
+        std::string text;
+        for(uint32_t j=0; j<length; j++){
+            if(j && item[j-1] != "(" && item[j] != ")" && !(item[j] == "(" && isAggregateFunction(item[j-1]))){
+                text += " ";
+            }
+            text += item[j];
+        }
+        selectItem.expression = parseExpression(text);
+        if(!selectItem.expression){
+            return false;
+        }
+        if(selectItem.name.empty()){
+            selectItem.name = text;
+        }
+        items.push_back(std::move(selectItem));
+        item.clear();
+    }
+    return true;
+}
+
+std::unique_ptr<ScanOperator> planScan(ExecutionContext& context, uint64_t fileId, const std::string& tableName, ColumnUsage& usage){
+    std::unique_ptr<ScanOperator> scan = std::make_unique<ScanOperator>(fileId, tableName);
+    scan->setSnapshot(&context.snapshot);
+    const std::vector< std::vector< std::string > >& columns = scan->getColumns();
+
+    // Unqualified names can refer to a column of any table
+    auto isUsed = [&](const std::set< std::string >& names, const std::string& column){
+        return names.find(column) != names.end() || names.find(tableName + "." + column) != names.end();
+    };
+
+    std::vector< bool > conditionColumn(columns.size()), outputColumn(columns.size());
+    uint32_t outputBytes = 0;
+    for(uint32_t i=0; i<columns.size(); i++){
+        conditionColumn[i] = isUsed(usage.conditionTokens, columns[i][0]);
+        outputColumn[i] = usage.selectAll || isUsed(usage.outputColumns, columns[i][0]);
+        if(outputColumn[i] && !conditionColumn[i]){
+            outputBytes += getTypeSize(columns[i][1]);
+        }
+    }
+    bool defer = usage.deferOutput && outputBytes >= LATE_MATERIALIZATION_MIN_BYTES;
+
+    std::vector< uint32_t > projection;
+    DeferredColumns deferred = {fileId, tableName, {}};
+    for(uint32_t i=0; i<columns.size(); i++){
+        if(conditionColumn[i] || (outputColumn[i] && !defer)){
+            projection.push_back(i);
+        } else if(outputColumn[i]){
+            deferred.columns.push_back(i);
+        }
+    }
+
+    if(projection.size() != columns.size()){
+        if(DEBUG == true){
+            std::cout << "Scan of " << tableName << " reads " << projection.size() << " of " << columns.size() << " columns. " << deferred.columns.size() << " columns deferred" << std::endl;
+        }
+        scan->setProjection(projection, deferred.columns.size() > 0);
+    }
+    usage.tables.push_back(deferred);
+    return scan;
+}
+
+std::unique_ptr<Operator> planFilter(std::unique_ptr<Operator> input, const std::vector< condition >& conditions, bool preserveOrder){
+    ScanOperator* scan = dynamic_cast<ScanOperator*>(input.get());
+    if(scan && WorkerPool::getPool().getWorkerCount() > 1 && scan->getPageCount() >= PARALLEL_SCAN_MIN_PAGES){
+        input.release();
+        return std::make_unique<ParallelScanOperator>(std::unique_ptr<ScanOperator>(scan), conditions, preserveOrder);
+    }
+    if(conditions.empty()){
+        return input;
+    }
+    return std::make_unique<FilterOperator>(std::move(input), conditions);
+}
+
+/**
+ * @brief Find a column of the rows of a query by name. Unqualified names also match a column of a joined table
+ *
+ * @return int32_t index of the column, -1 if it doesn't exist or is ambiguous
+ */
+int32_t findQueryColumn(Operator& input, const std::string& name){
+    int32_t index = input.findColumn(name);
+    if(index >= 0 || name.find('.') != std::string::npos){
+        return index;
+    }
+    // Unqualified name of a column of a joined table
+    const std::vector< std::vector< std::string > >& columns = input.getColumns();
+    for(int32_t i=0; i<columns.size(); i++){
+        const std::string& column = columns[i][0];
+        if(column.length() > name.length() && column.substr(column.length() - name.length() - 1) == "." + name){
+            if(index >= 0){
+                Logger::logError("Column "+name+" is ambiguous. Qualify it with the table name");
+                return -1;
+            }
+            index = i;
+        }
+    }
+    return index;
+}
+
+std::unique_ptr<Operator> planProjection(ExecutionContext& context, std::unique_ptr<Operator> root, std::vector< SelectItem >& items, const ColumnUsage& usage){
+    std::vector< DeferredColumns > deferred;
+    for(int i=0; i<usage.tables.size(); i++){
+        if(usage.tables[i].columns.size()){
+            deferred.push_back(usage.tables[i]);
+        }
+    }
+    if(deferred.size()){
+        root = std::make_unique<MaterializeOperator>(std::move(root), deferred, &context.snapshot);
+    }
+
+    // * is every column of every table in the order they were written. Columns of joined tables are qualified
+    std::vector< std::unique_ptr<Expression> > expressions;
+    std::vector< std::string > names;
+    for(int i=0; i<items.size(); i++){
+        if(!items[i].all){
+            expressions.push_back(std::move(items[i].expression));
+            names.push_back(items[i].name);
+            continue;
+        }
+        for(int j=0; j<usage.tables.size(); j++){
+            const std::string& tableName = usage.tables[j].tableName;
+            std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(context, usage.tables[j].fileId);
+            for(int k=0; k<columns.size(); k++){
+                std::unique_ptr<Expression> column = std::make_unique<Expression>();
+                column->kind = EXPRESSION::COLUMN;
+                column->name = tableName + "." + columns[k][0];
+                expressions.push_back(std::move(column));
+                names.push_back(usage.tables.size() > 1 ? tableName + "." + columns[k][0] : columns[k][0]);
+            }
+        }
+    }
+
+    Operator& input = *root;
+    auto findColumn = [&](const std::string& name){
+        return findQueryColumn(input, name);
+    };
+
+    bool identity = expressions.size() == input.getColumns().size();
+    for(int i=0; i<expressions.size(); i++){
+        if(!bindExpression(*expressions[i], input.getColumns(), findColumn)){
+            return nullptr;
+        }
+        identity = identity && expressions[i]->kind == EXPRESSION::COLUMN && expressions[i]->column == i && names[i] == input.getColumns()[i][0];
+    }
+
+    if(identity){
+        return root;
+    }
+    return std::make_unique<ProjectOperator>(std::move(root), std::move(expressions), names);
+}
+
+bool parseGroupBy(const std::vector< std::string >& tokens, std::vector< std::string >& groupBy){
+    // group by column, ...
+    if(tokens.size() < 3 || tokens[1] != "by"){
+        Logger::logError("Syntax error in group by clause");
+        return false;
+    }
+    for(int i=2; i<tokens.size(); i+=2){
+        bool separated = i + 1 == tokens.size() || (tokens[i+1] == "," && i + 2 < tokens.size());
+        if(tokens[i] == "," || !separated){
+            Logger::logError("Syntax error in group by clause. Columns are separated by commas");
+            return false;
+        }
+        groupBy.push_back(tokens[i]);
+    }
+    return true;
+}
+
+/**
+ * @brief Collect the aggregate functions of an expression
+ */
+void getAggregates(Expression& expression, std::vector< Expression* >& aggregates){
+    if(expression.kind == EXPRESSION::AGGREGATE){
+        aggregates.push_back(&expression);
+        return;
+    }
+    for(int i=0; i<expression.operands.size(); i++){
+        getAggregates(*expression.operands[i], aggregates);
+    }
+}
+
+/**
+ * @brief Aggregates of every row of a table read from its statistics: counts, and min and max of int and
+ * float columns while their bounds are exact. Columns of the scan are named table.column
+ *
+ * @return std::unique_ptr<Operator> one row with the aggregates. nullptr if an aggregate needs the rows
+ */
+std::unique_ptr<Operator> planStatsAggregation(ExecutionContext& context, Operator& scan, const std::vector< AggregateFunction >& functions, uint64_t fileId){
+    TableStats stats;
+    if(!fileId || !loadTableStats(fileId, stats, &context.snapshot)){
+        return nullptr;
+    }
+    std::vector< std::vector< std::string > > tableColumns = Database::getColumnsOfTable(context, fileId);
+
+    std::vector< std::vector< std::string > > columns;
+    uint64_t id = 1;
+    std::string row(reinterpret_cast<const char*>(&id), sizeof(id));
+    for(int i=0; i<functions.size(); i++){
+        const AggregateFunction& function = functions[i];
+        if(function.function == AGGREGATE::COUNT){
+            // Columns have no NULL values, so count(column) is the row count too
+            columns.push_back({function.name, "int"});
+            row.append(reinterpret_cast<const char*>(&stats.rowCount), sizeof(stats.rowCount));
+            continue;
+        }
+        if(function.function != AGGREGATE::MIN && function.function != AGGREGATE::MAX){
+            return nullptr;
+        }
+
+        const std::vector< std::string >& column = scan.getColumns()[function.column];
+        TYPE type = getTypeFromString(column[1]);
+        std::string name = column[0].substr(column[0].rfind('.') + 1);
+        int32_t index = -1;
+        for(int32_t j=0; j<tableColumns.size(); j++){
+            if(tableColumns[j][0] == name){
+                index = j;
+            }
+        }
+        if(index < 0 || index >= stats.columns.size() || (type != TYPE::INT && type != TYPE::FLOAT)){
+            return nullptr;
+        }
+        const ColumnStats& columnStats = stats.columns[index];
+        // min and max of no rows have no value. The aggregation reports it
+        if(!stats.rowCount || !columnStats.hasBounds || !columnStats.exactBounds){
+            return nullptr;
+        }
+        columns.push_back({function.name, column[1]});
+        row.append(function.function == AGGREGATE::MIN ? columnStats.min : columnStats.max, sizeof(columnStats.min));
+    }
+
+    if(DEBUG == true){
+        std::cout << "Aggregates read from the statistics of table " << fileId << std::endl;
+    }
+    return std::make_unique<ValuesOperator>(columns, std::vector< std::string >{row});
+}
+
+bool isOrderInsensitive(std::vector< SelectItem >& items){
+    std::vector< Expression* > aggregates;
+    for(int i=0; i<items.size(); i++){
+        if(items[i].all){
+            return false;
+        }
+        getAggregates(*items[i].expression, aggregates);
+    }
+    for(int i=0; i<aggregates.size(); i++){
+        if(aggregates[i]->name != "count" && aggregates[i]->name != "min" && aggregates[i]->name != "max"){
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<Operator> planAggregation(ExecutionContext& context, std::unique_ptr<Operator> root, std::vector< SelectItem >& items, const std::vector< std::string >& groupBy, uint64_t fileId){
+    std::vector< Expression* > aggregates;
+    for(int i=0; i<items.size(); i++){
+        if(items[i].all){
+            Logger::logError("* can't be selected with group by or aggregate functions");
+            return nullptr;
+        }
+        getAggregates(*items[i].expression, aggregates);
+    }
+
+    std::vector< uint32_t > groupColumns;
+    for(int i=0; i<groupBy.size(); i++){
+        int32_t index = findQueryColumn(*root, groupBy[i]);
+        if(index < 0){
+            Logger::logError("Column "+groupBy[i]+" doesn't exist");
+            return nullptr;
+        }
+        groupColumns.push_back(index);
+    }
+
+    // Arguments of the aggregates. Columns are read directly, other expressions are evaluated below the aggregation
+    Operator& input = *root;
+    auto findColumn = [&](const std::string& name){
+        return findQueryColumn(input, name);
+    };
+    bool computed = false;
+    std::vector< AggregateFunction > functions;
+    for(int i=0; i<aggregates.size(); i++){
+        Expression& aggregate = *aggregates[i];
+        AggregateFunction function;
+        function.name = "#agg" + std::to_string(i);
+        function.column = -1;
+        if(aggregate.name == "count"){
+            function.function = AGGREGATE::COUNT;
+        } else if(aggregate.name == "sum"){
+            function.function = AGGREGATE::SUM;
+        } else if(aggregate.name == "min"){
+            function.function = AGGREGATE::MIN;
+        } else if(aggregate.name == "max"){
+            function.function = AGGREGATE::MAX;
+        } else {
+            function.function = AGGREGATE::AVG;
+        }
+
+        if(aggregate.operands.size()){
+            Expression& argument = *aggregate.operands[0];
+            if(!bindExpression(argument, input.getColumns(), findColumn)){
+                return nullptr;
+            }
+            TYPE type = getTypeFromString(argument.type);
+            if((function.function == AGGREGATE::SUM || function.function == AGGREGATE::AVG) && type != TYPE::INT && type != TYPE::FLOAT){
+                Logger::logError("Argument of "+aggregate.name+" must be an int or a float");
+                return nullptr;
+            }
+            function.column = argument.column;
+            computed = computed || argument.kind != EXPRESSION::COLUMN;
+        }
+        functions.push_back(function);
+    }
+
+    std::unique_ptr<Operator> values = groupBy.empty() && !computed ? planStatsAggregation(context, *root, functions, fileId) : nullptr;
+    bool fromStats = values != nullptr;
+    if(fromStats){
+        root = std::move(values);
+    } else if(computed){
+        // The group columns followed by the arguments of the aggregates
+        std::vector< std::unique_ptr<Expression> > expressions;
+        std::vector< std::string > names;
+        for(int i=0; i<groupColumns.size(); i++){
+            std::unique_ptr<Expression> column = std::make_unique<Expression>();
+            column->kind = EXPRESSION::COLUMN;
+            column->column = groupColumns[i];
+            column->name = input.getColumns()[groupColumns[i]][0];
+            names.push_back(column->name);
+            expressions.push_back(std::move(column));
+            groupColumns[i] = i;
+        }
+        for(int i=0; i<functions.size(); i++){
+            if(functions[i].function == AGGREGATE::COUNT && aggregates[i]->operands.empty()){
+                continue;
+            }
+            functions[i].column = expressions.size();
+            names.push_back("#arg" + std::to_string(i));
+            expressions.push_back(std::move(aggregates[i]->operands[0]));
+        }
+        root = std::make_unique<ProjectOperator>(std::move(root), std::move(expressions), names);
+    }
+    if(!fromStats){
+        root = std::make_unique<AggregateOperator>(std::move(root), groupColumns, functions);
+    }
+
+    // Aggregates become columns of the groups. Other columns must be group columns
+    for(int i=0; i<aggregates.size(); i++){
+        aggregates[i]->kind = EXPRESSION::COLUMN;
+        aggregates[i]->name = functions[i].name;
+        aggregates[i]->operands.clear();
+    }
+    Operator& groups = *root;
+    auto findGroupColumn = [&](const std::string& name){
+        return findQueryColumn(groups, name);
+    };
+    std::vector< std::unique_ptr<Expression> > expressions;
+    std::vector< std::string > names;
+    bool identity = items.size() == groups.getColumns().size();
+    for(int i=0; i<items.size(); i++){
+        std::vector< std::string > columns;
+        getExpressionColumns(*items[i].expression, columns);
+        for(int j=0; j<columns.size(); j++){
+            if(findGroupColumn(columns[j]) < 0){
+                Logger::logError("Column "+columns[j]+" must be in group by or used in an aggregate function");
+                return nullptr;
+            }
+        }
+        if(!bindExpression(*items[i].expression, groups.getColumns(), findGroupColumn)){
+            return nullptr;
+        }
+        identity = identity && items[i].expression->kind == EXPRESSION::COLUMN && items[i].expression->column == i && items[i].name == groups.getColumns()[i][0];
+        expressions.push_back(std::move(items[i].expression));
+        names.push_back(items[i].name);
+    }
+
+    if(identity){
+        return root;
+    }
+    return std::make_unique<ProjectOperator>(std::move(root), std::move(expressions), names);
+}
+
+/**
+ * @brief Parse a row count of a limit or offset clause
+ */
+bool parseRowCount(const std::string& token, uint64_t& count){
+    if(token.empty() || token.length() > 18 || token.find_first_not_of("0123456789") != std::string::npos){
+        Logger::logError("Invalid row count "+token+". Row counts must be non negative integers");
+        return false;
+    }
+    count = std::stoull(token);
+    return true;
+}
+
+bool parseResultOrder(const std::vector< std::string >& tokens, ResultOrder& order){
+    if(tokens[0] == "limit" || tokens[0] == "offset"){
+        if(tokens.size() != 2){
+            Logger::logError("Syntax error in "+tokens[0]+" clause");
+            return false;
+        }
+        order.hasLimit = true;
+        return parseRowCount(tokens[1], tokens[0] == "limit" ? order.limit : order.offset);
+    }
+
+    // order by column [asc|desc], ...
+    if(tokens.size() < 3 || tokens[1] != "by"){
+        Logger::logError("Syntax error in order by clause");
+        return false;
+    }
+    std::vector< std::string > item;
+    for(int i=2; i<=tokens.size(); i++){
+        if(i < tokens.size() && tokens[i] != ","){
+            item.push_back(tokens[i]);
+            continue;
+        }
+        if(item.empty() || item.size() > 2 || (item.size() == 2 && item[1] != "asc" && item[1] != "desc")){
+            Logger::logError("Syntax error in order by clause. Columns are separated by commas and followed by asc or desc");
+            return false;
+        }
+        order.columns.push_back(item[0]);
+        order.descending.push_back(item.size() == 2 && item[1] == "desc");
+        item.clear();
+    }
+    return true;
+}
+
+bool orderBeforeProjection(const ResultOrder& order, const std::vector< SelectItem >& items){
+    for(int i=0; i<order.columns.size(); i++){
+        for(int j=0; j<items.size(); j++){
+            if(items[j].all || items[j].name != order.columns[i]){
+                continue;
+            }
+            const Expression& expression = *items[j].expression;
+            if(expression.kind != EXPRESSION::COLUMN || expression.name != order.columns[i]){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<Operator> planResultOrder(std::unique_ptr<Operator> root, const ResultOrder& order){
+    // Rows after the offset needed to produce the limit
+    uint64_t rows = order.limit > UINT64_MAX - order.offset ? UINT64_MAX : order.limit + order.offset;
+
+    if(order.columns.size()){
+        std::vector< uint32_t > sortColumns;
+        for(int i=0; i<order.columns.size(); i++){
+            int32_t index = findQueryColumn(*root, order.columns[i]);
+            if(index < 0){
+                Logger::logError("Column "+order.columns[i]+" doesn't exist");
+                return nullptr;
+            }
+            sortColumns.push_back(index);
+        }
+
+        bool sorted = sortColumns.size() == 1 && !order.descending[0] && root->getSortColumn() == (int32_t)sortColumns[0];
+        if(!sorted){
+            std::unique_ptr<SortOperator> sort = std::make_unique<SortOperator>(std::move(root), sortColumns, order.descending);
+            if(rows != UINT64_MAX){
+                sort->setLimit(rows);
+            }
+            root = std::move(sort);
+        } else if(DEBUG == true){
+            std::cout << "Rows are already sorted on " << order.columns[0] << std::endl;
+        }
+    }
+
+    if(order.hasLimit){
+        root = std::make_unique<LimitOperator>(std::move(root), order.limit, order.offset);
+    }
+    return root;
+}
+
+bool parseJoinConditions(const std::vector< std::string >& tokens, int startIndex, std::vector< condition >& conditions){
+    std::vector< std::string > currentCondition;
+
+    for(int i=startIndex;i<tokens.size();i++){
+        if(tokens[i] == "and" || tokens[i] == "&&"){
+            if(currentCondition.size() == 0){
+                Logger::logError("empty condition found");
+                return false;
+            }
+            condition cd = getCondition(currentCondition);
+            currentCondition.clear();
+            if(cd.operation == COMPARISON::INVALID){
+                Logger::logError("Invalid condition provided");
+                return false;
+            }
+            conditions.push_back(cd);
+        } else {
+            currentCondition.push_back(tokens[i]);
+        }
+    }
+
+    if(!currentCondition.size()){
+        Logger::logError("Empty condition provided");
+        return false;
+    }
+    condition cd = getCondition(currentCondition);
+    if(cd.operation == COMPARISON::INVALID){
+        Logger::logError("Invalid condition provided");
+        return false;
+    }
+    conditions.push_back(cd);
+    return true;
+}
+
+/**
+ * @brief Find the input having a column among the first count inputs. Columns of joined tables must be qualified
+ *
+ * @return int32_t index of the input, -1 if no input has the column
+ */
+int32_t findInput(const std::vector< JoinInput >& inputs, uint32_t count, const std::string& name){
+    for(uint32_t i=0; i<count; i++){
+        if(i && name.substr(0, inputs[i].tableName.length()+1) != inputs[i].tableName + "."){
+            continue;
+        }
+        if(inputs[i].input->findColumn(name) >= 0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Name of a column of an input that resolves the same way wherever the input ends up in the plan
+ */
+std::string getQualifiedName(const JoinInput& input, const std::string& name){
+    std::string column = input.input->getColumns()[input.input->findColumn(name)][0];
+    return input.tableName.length() ? input.tableName + "." + column : column;
+}
+
+/**
+ * @brief Estimated fraction of row pairs of the joined inputs and input r satisfying the conditions between them
+ *
+ * @param connected set if there is a condition between them
+ */
+double getJoinSelectivity(const std::vector< JoinInput >& inputs, const std::vector< JoinPredicate >& predicates, const std::vector< bool >& joined, uint32_t r, bool& connected){
+    double selectivity = 1;
+    std::vector< bool > keyed(inputs.size(), false);
+    connected = false;
+
+    for(int i=0; i<predicates.size(); i++){
+        const JoinPredicate& predicate = predicates[i];
+        uint32_t other;
+        if(predicate.left == r && joined[predicate.right]){
+            other = predicate.right;
+        } else if(predicate.right == r && joined[predicate.left]){
+            other = predicate.left;
+        } else {
+            continue;
+        }
+        connected = true;
+
+        if(predicate.cond.operation == COMPARISON::EQUAL && !keyed[other]){
+            // Assumes the key is unique in the smaller table (foreign key joins)
+            selectivity /= std::max(1.0, std::min(inputs[r].tableRows, inputs[other].tableRows));
+            keyed[other] = true;
+        } else {
+            selectivity *= getSelectivity(predicate.cond.operation);
+        }
+    }
+    return selectivity;
+}
+
+std::vector< uint32_t > getDynamicProgrammingOrder(const std::vector< JoinInput >& inputs, const std::vector< JoinPredicate >& predicates){
+    uint32_t n = inputs.size();
+    std::vector< JoinPlan > plans((uint64_t)1 << n);
+    for(uint32_t i=0; i<n; i++){
+        plans[(uint64_t)1 << i] = {true, inputs[i].rows, 0, i, 0};
+    }
+
+    // Subsets are visited after all of their subsets. Ties keep the written order
+    std::vector< bool > joined(n);
+    for(uint64_t mask=1; mask<plans.size(); mask++){
+        if(!plans[mask].valid){
+            continue;
+        }
+        for(uint32_t i=0; i<n; i++){
+            joined[i] = (mask >> i) & 1;
+        }
+        for(uint32_t r=0; r<n; r++){
+            if(joined[r]){
+                continue;
+            }
+            bool connected;
+            double selectivity = getJoinSelectivity(inputs, predicates, joined, r, connected);
+            if(!connected){
+                continue;
+            }
+            double rows = plans[mask].rows * inputs[r].rows * selectivity;
+            double cost = plans[mask].cost + rows;
+            JoinPlan& plan = plans[mask | ((uint64_t)1 << r)];
+            if(!plan.valid || cost < plan.cost){
+                plan = {true, rows, cost, r, mask};
+            }
+        }
+    }
+
+    std::vector< uint32_t > order;
+    for(uint64_t mask=plans.size()-1; mask; mask=plans[mask].rest){
+        order.push_back(plans[mask].last);
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::vector< uint32_t > getGreedyOrder(const std::vector< JoinInput >& inputs, const std::vector< JoinPredicate >& predicates){
+    uint32_t n = inputs.size();
+    std::vector< bool > joined(n, false);
+    std::vector< uint32_t > order;
+
+    // Start from the smallest input and add the input giving the fewest rows
+    uint32_t first = 0;
+    for(uint32_t i=1; i<n; i++){
+        if(inputs[i].rows < inputs[first].rows){
+            first = i;
+        }
+    }
+    order.push_back(first);
+    joined[first] = true;
+    double rows = inputs[first].rows;
+
+    while(order.size() < n){
+        int32_t best = -1;
+        double bestRows = 0;
+        for(uint32_t r=0; r<n; r++){
+            if(joined[r]){
+                continue;
+            }
+            bool connected;
+            double selectivity = getJoinSelectivity(inputs, predicates, joined, r, connected);
+            double joinRows = rows * inputs[r].rows * selectivity;
+            if(connected && (best == -1 || joinRows < bestRows)){
+                best = r;
+                bestRows = joinRows;
+            }
+        }
+        order.push_back(best);
+        joined[best] = true;
+        rows = bestRows;
+    }
+    return order;
+}
+
+std::unique_ptr<Operator> planJoins(ExecutionContext& context, std::unique_ptr<Operator> first, const std::vector< std::vector< std::string > >& clauses, ColumnUsage& usage){
+    std::vector< JoinInput > inputs(1);
+    inputs[0].tableName = first->getTableName();
+    inputs[0].input = std::move(first);
+    std::vector< JoinPredicate > predicates;
+
+    for(int k=0; k<clauses.size(); k++){
+        const std::vector< std::string >& tokens = clauses[k];
+
+        if(DEBUG == true){
+            std::cout << "Join clause tokens: ";
+            for(int i=0;i<tokens.size();i++){
+                std::cout << tokens[i] << " ";
+            }
+            std::cout << std::endl;
+        }
+
+        // join table [as alias] on conditions
+        int onIndex = 2;
+        if(tokens.size() > 2 && tokens[2] == "as"){
+            if(tokens.size() < 4 || !validateAlias(tokens[3])){
+                Logger::logError("Invalid alias. Aliases must be alphanumeric, start with a letter and be at most 16 characters long");
+                return nullptr;
+            }
+            onIndex = 4;
+        }
+
+        if(tokens.size() < onIndex + 2){
+            Logger::logError("Incomplete join query");
+            return nullptr;
+        }
+
+        if(tokens[onIndex] != "on"){
+            Logger::logError("Join columns not provided");
+            return nullptr;
+        }
+
+        std::vector<condition> conditions;
+        if(!parseJoinConditions(tokens, onIndex + 1, conditions)){
+            return nullptr;
+        }
+
+        uint64_t secondaryTableId = Database::getTableId(context, tokens[1]);
+
+        if(!secondaryTableId){
+            Logger::logError("Table "+tokens[1]+" doesn't exist");
+            return nullptr;
+        }
+
+        // Conditions refer to the table by its alias
+        std::string secondaryTableName = onIndex == 4 ? tokens[3] : tokens[1];
+        for(int i=0; i<inputs.size(); i++){
+            // The first input can be a join having columns of the table
+            bool used = inputs[i].tableName == secondaryTableName;
+            const std::vector< std::vector< std::string > >& columns = inputs[i].input->getColumns();
+            for(int j=0; i == 0 && j<columns.size(); j++){
+                used = used || columns[j][0].substr(0, secondaryTableName.length()+1) == secondaryTableName + ".";
+            }
+            if(used){
+                Logger::logError("Table name "+secondaryTableName+" is already used in the query. Give the table another name with as");
+                return nullptr;
+            }
+        }
+
+        uint32_t current = inputs.size();
+        inputs.emplace_back();
+        inputs[current].tableName = secondaryTableName;
+        inputs[current].input = planScan(context, secondaryTableId, secondaryTableName, usage);
+        Operator& secondary = *inputs[current].input;
+
+        // Classifying conditions. Earlier inputs are the primary side
+        bool dependent = false;
+        for(auto u: conditions){
+            if(DEBUG == true){
+                std::cout << "Current Condition: " << u.toString() << std::endl;
+                std::cout << "Secondary Table: " << secondaryTableName << std::endl;
+            }
+
+            bool lhsSecondary = secondary.findColumn(u.columnName) >= 0 && u.columnName.substr(0, secondaryTableName.length()+1) == secondaryTableName + ".";
+            bool rhsSecondary = secondary.findColumn(u.value) >= 0 && u.value.substr(0, secondaryTableName.length()+1) == secondaryTableName + ".";
+            int32_t lhsPrimary = lhsSecondary ? -1 : findInput(inputs, current, u.columnName);
+            int32_t rhsPrimary = rhsSecondary ? -1 : findInput(inputs, current, u.value);
+
+            if(lhsPrimary >= 0 && rhsSecondary){
+                u.columnName = getQualifiedName(inputs[lhsPrimary], u.columnName);
+                u.value = getQualifiedName(inputs[current], u.value);
+                predicates.push_back({u, (uint32_t)lhsPrimary, current});
+                dependent = true;
+            } else if(lhsSecondary && rhsPrimary >= 0){
+                u.invert();
+                u.columnName = getQualifiedName(inputs[rhsPrimary], u.columnName);
+                u.value = getQualifiedName(inputs[current], u.value);
+                predicates.push_back({u, (uint32_t)rhsPrimary, current});
+                dependent = true;
+            } else if(lhsPrimary >= 0 && rhsPrimary < 0){
+                u.columnName = getQualifiedName(inputs[lhsPrimary], u.columnName);
+                inputs[lhsPrimary].filters.push_back(u);
+            } else if(lhsSecondary && !rhsSecondary){
+                u.columnName = getQualifiedName(inputs[current], u.columnName);
+                inputs[current].filters.push_back(u);
+            } else {
+                Logger::logError("Condition in incorrect format. Column name must be on LHS");
+                return nullptr;
+            }
+        }
+
+        if(!dependent){
+            Logger::logError("Dependent join conditions not provided");
+            return nullptr;
+        }
+    }
+
+    // Inputs reading the same table share one scan
+    std::map< uint64_t, std::vector< uint32_t > > tableInputs;
+    for(uint32_t i=0; i<inputs.size(); i++){
+        ScanOperator* scan = dynamic_cast<ScanOperator*>(inputs[i].input.get());
+        if(scan){
+            tableInputs[scan->getFileId()].push_back(i);
+        }
+    }
+    for(auto& table: tableInputs){
+        if(table.second.size() < 2){
+            continue;
+        }
+        // The shared scan reads the columns of every input
+        std::set< uint32_t > columns;
+        bool locator = false;
+        for(uint32_t k=0; k<table.second.size(); k++){
+            ScanOperator* scan = static_cast<ScanOperator*>(inputs[table.second[k]].input.get());
+            columns.insert(scan->getProjection().begin(), scan->getProjection().end());
+            locator = locator || scan->hasLocator();
+        }
+        std::shared_ptr<SharedScan> shared = std::make_shared<SharedScan>(table.first, table.second.size(), std::vector< uint32_t >(columns.begin(), columns.end()), locator, &context.snapshot);
+        for(uint32_t k=0; k<table.second.size(); k++){
+            JoinInput& input = inputs[table.second[k]];
+            input.input = std::make_unique<SharedScanOperator>(shared, k, input.tableName);
+        }
+    }
+
+    // Single table conditions are applied before joining
+    std::vector< uint32_t > columnCounts;
+    for(int i=0; i<inputs.size(); i++){
+        inputs[i].tableRows = inputs[i].input->estimateRows();
+        inputs[i].input = planFilter(std::move(inputs[i].input), inputs[i].filters, !usage.unordered);
+        inputs[i].rows = inputs[i].input->estimateRows();
+        columnCounts.push_back(inputs[i].input->getColumns().size());
+    }
+
+    std::vector< uint32_t > order = inputs.size() <= JOIN_DP_LIMIT ? getDynamicProgrammingOrder(inputs, predicates) : getGreedyOrder(inputs, predicates);
+
+    std::vector< bool > joined(inputs.size(), false);
+    std::unique_ptr<Operator> root = std::move(inputs[order[0]].input);
+    joined[order[0]] = true;
+    double rows = inputs[order[0]].rows;
+
+    for(int k=1; k<order.size(); k++){
+        uint32_t r = order[k];
+        std::vector< condition > conditions;
+        for(int i=0; i<predicates.size(); i++){
+            if(predicates[i].right == r && joined[predicates[i].left]){
+                conditions.push_back(predicates[i].cond);
+            } else if(predicates[i].left == r && joined[predicates[i].right]){
+                condition cd = predicates[i].cond;
+                cd.invert();
+                conditions.push_back(cd);
+            }
+        }
+
+        bool connected;
+        rows *= inputs[r].rows * getJoinSelectivity(inputs, predicates, joined, r, connected);
+        joined[r] = true;
+
+        std::unique_ptr<JoinOperator> join = std::make_unique<JoinOperator>(std::move(root), std::move(inputs[r].input), conditions);
+        join->setEstimatedRows((uint64_t)rows);
+        root = std::move(join);
+    }
+
+    if(DEBUG == true){
+        std::cout << "Join order:";
+        for(int k=0; k<order.size(); k++){
+            std::cout << " " << (inputs[order[k]].tableName.length() ? inputs[order[k]].tableName : "(input)") << " (" << (uint64_t)inputs[order[k]].rows << " rows)";
+        }
+        std::cout << ". Estimated result rows: " << (uint64_t)rows << std::endl;
+    }
+
+    // Columns are produced in plan order. Put them back in the written order
+    std::vector< uint32_t > planOffsets(inputs.size());
+    uint32_t offset = 0;
+    for(int k=0; k<order.size(); k++){
+        planOffsets[order[k]] = offset;
+        offset += columnCounts[order[k]];
+    }
+    std::vector< uint32_t > projection;
+    bool reordered = false;
+    for(int i=0; i<inputs.size(); i++){
+        for(uint32_t j=0; j<columnCounts[i]; j++){
+            reordered = reordered || planOffsets[i] + j != projection.size();
+            projection.push_back(planOffsets[i] + j);
+        }
+    }
+    if(reordered){
+        root = std::make_unique<ProjectOperator>(std::move(root), projection);
+    }
+
+    return root;
+}
@@ -0,0 +1,151 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <set>
+#include "../executor/executor.h"
+#include "../expression/expression.h"
+#include "../context/context.h"
+
+/**
+ * @brief Check a name given to a table with as. Aliases are alphanumeric, start with a letter and are at most 16 characters long
+ */
+bool validateAlias(const std::string& name);
+
+/**
+ * @brief Item of a select list: * (every column of the query) or an expression with the name it is printed with
+ */
+struct SelectItem {
+    bool all = false;
+    std::unique_ptr<Expression> expression;
+    std::string name;
+};
+
+/**
+ * @brief Parse the select list of a query (tokens between select and from). Items are separated
+ * by commas and can be named with as, e.g. select a.x, a.y * 2 as twice from a
+ *
+ * @return false on syntax errors
+ */
+bool parseSelectList(const std::vector< std::string >& tokens, int begin, int end, std::vector< SelectItem >& items);
+
+/**
+ * @brief Columns a select query uses, to read only those (projection push down)
+ */
+struct ColumnUsage {
+    // Tokens of the where and join clauses. Columns named by one are used by conditions
+    std::set< std::string > conditionTokens;
+    // Columns used by the select list
+    std::set< std::string > outputColumns;
+    bool selectAll = false;
+    // Read columns only used by the select list after filters and joins (late materialization)
+    bool deferOutput = false;
+    // The result doesn't depend on the order of the rows, so parallel scans needn't keep it
+    bool unordered = false;
+    // Tables of the query in the order they were written, with their deferred columns. Filled by planScan
+    std::vector< DeferredColumns > tables;
+};
+
+/**
+ * @brief Scan of a table of a select query producing only the columns the conditions and
+ * the select list use. Columns only used by the select list are deferred (see ColumnUsage::deferOutput)
+ *
+ * @param tableName name (or alias) of the table in the query
+ */
+std::unique_ptr<ScanOperator> planScan(ExecutionContext& context, uint64_t fileId, const std::string& tableName, ColumnUsage& usage);
+
+/**
+ * @brief Apply conditions to the rows of an input. Scans of tables with at least PARALLEL_SCAN_MIN_PAGES
+ * pages are run by the worker pool (ParallelScanOperator) when it has more than one worker, even without
+ * conditions. Other inputs are filtered by a FilterOperator
+ *
+ * @param conditions conditions on the columns of the input. The input is returned as it is if empty and not parallel
+ * @param preserveOrder rows are produced in the order of the input
+ */
+std::unique_ptr<Operator> planFilter(std::unique_ptr<Operator> input, const std::vector< condition >& conditions, bool preserveOrder);
+
+/**
+ * @brief Produce the select list from the rows of the query: read deferred columns
+ * (MaterializeOperator) and evaluate the expressions (ProjectOperator)
+ *
+ * @return std::unique_ptr<Operator> nullptr if a column doesn't exist or can't be used by an expression
+ */
+std::unique_ptr<Operator> planProjection(ExecutionContext& context, std::unique_ptr<Operator> root, std::vector< SelectItem >& items, const ColumnUsage& usage);
+
+/**
+ * @brief Parse a group by clause (group by x, ...)
+ *
+ * @return false on syntax errors
+ */
+bool parseGroupBy(const std::vector< std::string >& tokens, std::vector< std::string >& groupBy);
+
+/**
+ * @brief Whether the aggregates of one group don't depend on the order the rows are read in (count, min and max).
+ * Sums of floats round differently in another order
+ */
+bool isOrderInsensitive(std::vector< SelectItem >& items);
+
+/**
+ * @brief Produce the select list of a query with group by or aggregate functions: group the rows
+ * (AggregateOperator) and evaluate the expressions on the groups. Arguments of aggregates that
+ * aren't columns are evaluated before the rows are grouped
+ *
+ * @param groupBy group columns. Empty to aggregate every row into one group
+ * @param fileId table root scans when it reads every row of it, 0 otherwise. Aggregates of every
+ * row (count(*), min and max) are then read from the table statistics when they allow it
+ * @return std::unique_ptr<Operator> nullptr if a column doesn't exist, isn't a group column outside an aggregate or can't be used by a function
+ */
+std::unique_ptr<Operator> planAggregation(ExecutionContext& context, std::unique_ptr<Operator> root, std::vector< SelectItem >& items, const std::vector< std::string >& groupBy, uint64_t fileId = 0);
+
+/**
+ * @brief Order by, limit and offset clauses of a select query
+ */
+struct ResultOrder {
+    std::vector< std::string > columns;
+    std::vector< bool > descending;
+    // Set by a limit or an offset clause. Without a limit every row after the offset is produced
+    bool hasLimit = false;
+    uint64_t limit = UINT64_MAX;
+    uint64_t offset = 0;
+};
+
+/**
+ * @brief Parse an order by clause (order by x [asc|desc], ...), a limit clause (limit n) or an offset clause (offset n)
+ *
+ * @return false on syntax errors
+ */
+bool parseResultOrder(const std::vector< std::string >& tokens, ResultOrder& order);
+
+/**
+ * @brief Whether the rows can be ordered before the select list is produced, i.e. no order by
+ * column is a name given by the select list. Rows are then sorted and limited before deferred
+ * columns are read and expressions are evaluated. Called before planProjection
+ */
+bool orderBeforeProjection(const ResultOrder& order, const std::vector< SelectItem >& items);
+
+/**
+ * @brief Sort and limit the rows of a select query. Sorts with a limit keep only the first rows (top-N).
+ * Rows already produced in order (e.g. by a sort-merge join) aren't sorted again
+ *
+ * @return std::unique_ptr<Operator> nullptr if an order by column doesn't exist
+ */
+std::unique_ptr<Operator> planResultOrder(std::unique_ptr<Operator> root, const ResultOrder& order);
+
+/**
+ * @brief Plan consecutive join clauses of a select query together. Conditions on a single
+ * table are applied to its scan. The join order is picked by estimated cost (sum of the
+ * estimated rows of every join), enumerating left deep orders with dynamic programming for
+ * up to JOIN_DP_LIMIT inputs and greedily for more. Joins get the estimated rows of their
+ * inputs, so the hash table is built on the smaller one.
+ * Inputs reading the same table (self-joins, told apart by aliases) share one scan of it.
+ *
+ * @param first input the clauses join to (the table of the query, possibly filtered or joined)
+ * @param clauses tokens of every join clause, starting with "join"
+ * @param usage columns the query uses. Joined tables are scanned with planScan
+ * @return std::unique_ptr<Operator> root of the plan. Columns are in the order the tables were written. nullptr on error
+ */
+std::unique_ptr<Operator> planJoins(ExecutionContext& context, std::unique_ptr<Operator> first, const std::vector< std::vector< std::string > >& clauses, ColumnUsage& usage);
+
+#endif // PLANNER_H
@@ -8,6 +8,10 @@ extern bool PROG_RUNNING;
 
 const Version VERSION(2,0,0,Version::VersionType::DEV);
 const bool DEBUG = true;
+/**
+ * @brief Operators exchange batches of column vectors instead of single rows when set
+ */
+const bool VECTORIZED_EXECUTION = true;
 const std::string DATABASE_DIRECTORY = "/Users/harshmotwani/RDBMS/penguin_db/databases/";
 const std::string QUERY_DIRECTORY = "/Users/harshmotwani/RDBMS/penguin_db/queries/";
 
@@ -18,5 +22,109 @@ const uint32_t LOG_MAX_PAGES = 32;
  * Queries start at ID (1<<LOG_MAX_TABLES) and go until (1<<(LOG_MAX_TABLES+1)) - 1
  */
 const uint32_t LOG_MAX_TABLES = 31; // Maximum number of tables or query pages
+/**
+ * @brief Overflow pages of a table or query with ID x are stored in the file with ID (x | OVERFLOW_FILE_FLAG)
+ */
+const uint64_t OVERFLOW_FILE_FLAG = (uint64_t)1 << (LOG_MAX_TABLES + 1);
+/**
+ * @brief Files of a database (its tables, their overflow files and its table metadata file) carry the number the
+ * process gave the database (see Database) in the bits of their IDs from DATABASE_ID_SHIFT on, so that sessions
+ * using different databases don't share file IDs. Temporary files carry none
+ */
+const uint32_t DATABASE_ID_SHIFT = LOG_MAX_TABLES + 2;
+/**
+ * @brief Databases a process can use, counting number 0 (no database chosen)
+ */
+const uint32_t MAX_DATABASES = 1024;
+/**
+ * @brief varchar values longer than this are moved to overflow pages. Must be at least 8 bytes
+ */
+const uint32_t VARCHAR_INLINE_LIMIT = 256;
+/**
+ * @brief Bytes of build rows a hash join keeps in memory. Larger build inputs are partitioned to spill files
+ */
+const uint64_t JOIN_MEMORY_BUDGET = (uint64_t)64 << 20;
+/**
+ * @brief Hash joins push a Bloom filter on the build keys into the scan of the probe input when set
+ */
+const bool JOIN_BLOOM_FILTERS = true;
+/**
+ * @brief Bytes of rows a scan shared by both sides of a self-join keeps for the side reading behind
+ */
+const uint64_t SHARED_SCAN_MEMORY_BUDGET = (uint64_t)64 << 20;
+/**
+ * @brief Bytes of rows a sort keeps in memory. Larger inputs are sorted in runs written to spill files
+ */
+const uint64_t SORT_MEMORY_BUDGET = (uint64_t)64 << 20;
+/**
+ * @brief Sorted runs merged at once. More runs are merged in groups into longer runs first
+ */
+const uint32_t SORT_MERGE_FAN_IN = 64;
+/**
+ * @brief Bytes of groups (keys and aggregate states) an aggregation keeps in memory. Rows of further groups are spilled
+ */
+const uint64_t AGGREGATE_MEMORY_BUDGET = (uint64_t)64 << 20;
+/**
+ * @brief Groups every worker of a parallel aggregation pre-aggregates in a table of its own (small enough
+ * to stay in cache) before moving them to partitions merged once the input is consumed
+ */
+const uint32_t PREAGGREGATE_GROUPS = 1 << 13;
+/**
+ * @brief Scans read only the columns conditions use when set. Other columns of the select list are read by
+ * row locator for the rows left after filters and joins
+ */
+const bool LATE_MATERIALIZATION = true;
+/**
+ * @brief Columns of a table are read by row locator only if they take at least this many bytes in a row.
+ * Narrower columns are cheaper to carry through filters and joins than to look up
+ */
+const uint32_t LATE_MATERIALIZATION_MIN_BYTES = 64;
+/**
+ * @brief Bytes of table pages cached while reading columns by row locator
+ */
+const uint64_t MATERIALIZE_MEMORY_BUDGET = (uint64_t)16 << 20;
+/**
+ * @brief Bytes of query and spill file pages kept in memory. The largest files are written to the session directory past it
+ */
+const uint64_t TEMP_MEMORY_BUDGET = (uint64_t)32 << 20;
+
+/**
+ * @brief Workers of the task scheduler (see WorkerPool), counting the thread waiting for the tasks.
+ * 0 uses one per hardware thread
+ */
+const uint32_t PARALLEL_WORKERS = 0;
+/**
+ * @brief Pin every thread of the worker pool to its own hardware thread (Linux only)
+ */
+const bool PARALLEL_PIN_WORKERS = false;
+/**
+ * @brief Pages of a table in a morsel, the unit of work handed to a worker
+ */
+const uint32_t MORSEL_PAGES = 16;
+/**
+ * @brief Tables with fewer pages are scanned, updated and deleted from by one thread
+ */
+const uint32_t PARALLEL_SCAN_MIN_PAGES = 64;
+/**
+ * @brief Attempts a thread makes to take a page latch held by another before it parks (see PageLatch)
+ */
+const uint32_t LATCH_SPINS = 64;
+/**
+ * @brief Bytes of changed table pages a transaction keeps in memory until it commits. Past it, they are
+ * written to their files at the end of the statement
+ */
+const uint64_t TRANSACTION_MEMORY_BUDGET = (uint64_t)64 << 20;
+/**
+ * @brief Bytes of rows in a batch of concurrent inserts into a table (see InsertBatches). Larger rows are inserted on their own
+ */
+const uint64_t INSERT_BATCH_BYTES = (uint64_t)64 << 10;
+/**
+ * @brief Unix domain socket the server listens on (penguin --server) unless another path is given
+ */
+const std::string SERVER_SOCKET_PATH = "/Users/harshmotwani/RDBMS/penguin_db/penguin.sock";
+/**
+ * @brief Threads of the server running statements while idle (see Server). 0 uses one per hardware thread
+ */
+const uint32_t SERVER_WORKERS = 0;
 
 #endif // PROPERTIES_H
\ No newline at end of file
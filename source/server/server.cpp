@@ -0,0 +1,417 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <filesystem>
+#include <algorithm>
+#include <string.h>
+#include "server.h"
+#include "../properties.h"
+#include "../logger/logger.h"
+#include "../parse/parse.h"
+#include "../temp/temp.h"
+
+#ifdef __linux__
+// Socket and event calls
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+/**
+ * @brief Events the event loop takes from epoll at once
+ */
+const int SERVER_EVENTS = 64;
+
+Server::Server(const std::string& socketPath) : mSocketPath(socketPath) {}
+
+#ifdef __linux__
+
+bool Server::listen(){
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if(mSocketPath.length() >= sizeof(address.sun_path)){
+        Logger::logError("Socket path " + mSocketPath + " is too long");
+        return false;
+    }
+    strcpy(address.sun_path, mSocketPath.c_str());
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(mSocketPath).parent_path(), error);
+
+    // A socket file left by a server that is no longer running is replaced
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(probe >= 0 && connect(probe, (sockaddr*)&address, sizeof(address)) == 0){
+        ::close(probe);
+        Logger::logError("A server is already listening on " + mSocketPath);
+        return false;
+    }
+    if(probe >= 0){
+        ::close(probe);
+    }
+    unlink(mSocketPath.c_str());
+
+    mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(mListenFd < 0 || bind(mListenFd, (sockaddr*)&address, sizeof(address)) < 0 || ::listen(mListenFd, SOMAXCONN) < 0){
+        Logger::logError("Unable to listen on " + mSocketPath + ": " + strerror(errno));
+        return false;
+    }
+
+    // Signals are read from a descriptor instead of interrupting a thread. Threads started from now on block them too
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    mSignalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(mSignalFd < 0 || mEpollFd < 0 || mEventFd < 0){
+        Logger::logError("Unable to create the event loop: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    int fds[3] = {mListenFd, mEventFd, mSignalFd};
+    for(int i=0; i<3; i++){
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fds[i];
+        if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fds[i], &event) < 0){
+            Logger::logError("Unable to create the event loop: " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+    return true;
+}
+
+void Server::accept(){
+    while(true){
+        int fd = accept4(mListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                Logger::logError("Unable to accept a connection: " + std::string(strerror(errno)));
+            }
+            return;
+        }
+
+        std::unique_ptr<Connection> connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->events = EPOLLIN | EPOLLRDHUP;
+        epoll_event event = {};
+        event.events = connection->events;
+        event.data.fd = fd;
+        if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0){
+            Logger::logError("Unable to watch a connection: " + std::string(strerror(errno)));
+            ::close(fd);
+            continue;
+        }
+        mConnections[fd] = std::move(connection);
+
+        if(DEBUG == true){
+            std::cout << "Client connected on descriptor " << fd << " (" << mConnections.size() << " connections)" << std::endl;
+        }
+    }
+}
+
+bool Server::receive(Connection& connection){
+    char buffer[PAGE_SIZE];
+    while(true){
+        ssize_t bytesRead = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if(bytesRead > 0){
+            connection.input.append(buffer, bytesRead);
+            continue;
+        }
+        if(bytesRead < 0 && errno == EINTR){
+            continue;
+        }
+        return bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+void Server::advance(Connection& connection){
+    send(connection);
+
+    uint64_t end = connection.input.find(';');
+    // Statements run one at a time per connection, once the output of the one before is taken by the client
+    if(!connection.running && connection.output.empty() && !connection.session.closed){
+        if(end != std::string::npos && !connection.gone && PROG_RUNNING){
+            std::string statement = connection.input.substr(0, end);
+            connection.input.erase(0, end + 1);
+            submit(connection, statement);
+        } else if(end == std::string::npos && connection.input.size() > 2*PAGE_SIZE){
+            // A statement that can't fit. The client is sent the error and disconnected
+            std::ostringstream error;
+            Logger::setOutput(&error);
+            Logger::logError("Query must fit into two pages.");
+            Logger::setOutput(nullptr);
+            connection.output = error.str() + '\0';
+            connection.input.clear();
+            connection.hungUp = true;
+        } else if(connection.hungUp || connection.gone || !PROG_RUNNING){
+            // Rolls back the open transaction of the session
+            submit(connection, "exit");
+        }
+    }
+
+    if(!connection.running && connection.session.closed && (connection.output.empty() || !PROG_RUNNING)){
+        close(connection);
+        return;
+    }
+    updateEvents(connection);
+}
+
+void Server::send(Connection& connection){
+    if(connection.gone){
+        connection.output.clear();
+        connection.outputSent = 0;
+        return;
+    }
+
+    while(connection.outputSent < connection.output.size()){
+        ssize_t written = ::send(connection.fd, connection.output.c_str() + connection.outputSent, connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+        if(written < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                // Nobody reads the output anymore
+                connection.gone = true;
+                connection.output.clear();
+                connection.outputSent = 0;
+            }
+            return;
+        }
+        connection.outputSent += written;
+    }
+    connection.output.clear();
+    connection.outputSent = 0;
+}
+
+void Server::updateEvents(Connection& connection){
+    uint32_t events = 0;
+    if(!connection.gone){
+        // Input is read while no statement is waiting in it, so that clients sending faster than they read are held back
+        if(!connection.hungUp && connection.input.find(';') == std::string::npos){
+            events |= EPOLLIN | EPOLLRDHUP;
+        }
+        if(!connection.output.empty()){
+            events |= EPOLLOUT;
+        }
+    }
+    if(events == connection.events){
+        return;
+    }
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = connection.fd;
+    if(events == 0){
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, connection.fd, &event);
+    } else if(connection.events == 0){
+        epoll_ctl(mEpollFd, EPOLL_CTL_ADD, connection.fd, &event);
+    } else {
+        epoll_ctl(mEpollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+    connection.events = events;
+}
+
+void Server::close(Connection& connection){
+    int fd = connection.fd;
+    if(connection.events){
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    ::close(fd);
+    mConnections.erase(fd);
+
+    if(DEBUG == true){
+        std::cout << "Client on descriptor " << fd << " disconnected (" << mConnections.size() << " connections)" << std::endl;
+    }
+}
+
+void Server::submit(Connection& connection, const std::string& statement){
+    connection.running = true;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mJobs.push_back(Job{&connection, statement, ""});
+    if(mJobs.size() > mIdleWorkers){
+        // Every worker is busy. Their statements may wait for this one (to commit), so it gets a thread of its own
+        mWorkers++;
+        std::thread(&Server::workerLoop, this).detach();
+    } else {
+        mWake.notify_one();
+    }
+}
+
+void Server::workerLoop(){
+    std::unique_lock<std::mutex> lock(mMutex);
+    while(true){
+        mIdleWorkers++;
+        mWake.wait(lock, [&](){ return mStopping || !mJobs.empty(); });
+        mIdleWorkers--;
+        if(mJobs.empty()){
+            break;
+        }
+        Job job = std::move(mJobs.front());
+        mJobs.pop_front();
+        lock.unlock();
+
+        std::ostringstream output;
+        Logger::setOutput(&output);
+        TempFiles::beginStatement();
+        processCommand(job.statement, job.connection->session);
+        // Query results and spill files don't outlive the statement
+        TempFiles::endStatement();
+        Logger::setOutput(nullptr);
+        job.output = output.str();
+
+        lock.lock();
+        mFinished.push_back(std::move(job));
+        uint64_t finished = 1;
+        if(write(mEventFd, &finished, sizeof(finished)) < 0 && DEBUG == true){
+            std::cout << "Unable to wake up the event loop: " << strerror(errno) << std::endl;
+        }
+        if(mWorkers > mMinWorkers && mJobs.empty()){
+            // Added while every worker was busy
+            break;
+        }
+    }
+    mWorkers--;
+    mStopped.notify_all();
+}
+
+void Server::collectFinished(){
+    uint64_t finished;
+    while(read(mEventFd, &finished, sizeof(finished)) < 0 && errno == EINTR);
+
+    std::deque< Job > jobs;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        jobs.swap(mFinished);
+    }
+    for(int i=0; i<jobs.size(); i++){
+        Connection& connection = *jobs[i].connection;
+        connection.running = false;
+        if(!connection.gone){
+            connection.output += jobs[i].output + '\0';
+        }
+        advance(connection);
+    }
+}
+
+void Server::shutdown(){
+    ::close(mListenFd);
+    unlink(mSocketPath.c_str());
+
+    // Statements running finish and the open transactions of the connections are rolled back
+    std::vector< int > fds;
+    for(auto connection = mConnections.begin(); connection != mConnections.end(); connection++){
+        fds.push_back(connection->first);
+    }
+    for(int i=0; i<fds.size(); i++){
+        auto connection = mConnections.find(fds[i]);
+        if(connection != mConnections.end()){
+            connection->second->hungUp = true;
+            advance(*connection->second);
+        }
+    }
+    while(!mConnections.empty()){
+        epoll_event events[SERVER_EVENTS];
+        int count = epoll_wait(mEpollFd, events, SERVER_EVENTS, -1);
+        for(int i=0; i<count; i++){
+            if(events[i].data.fd == mEventFd){
+                collectFinished();
+            } else if(events[i].data.fd == mSignalFd){
+                signalfd_siginfo signal;
+                while(read(mSignalFd, &signal, sizeof(signal)) > 0);
+            }
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mStopping = true;
+    mWake.notify_all();
+    mStopped.wait(lock, [&](){ return mWorkers == 0; });
+    lock.unlock();
+
+    ::close(mEventFd);
+    ::close(mSignalFd);
+    ::close(mEpollFd);
+    Logger::logSuccess("Server stopped");
+}
+
+bool Server::run(){
+    if(!listen()){
+        return false;
+    }
+
+    mMinWorkers = SERVER_WORKERS ? SERVER_WORKERS : std::max(1u, std::thread::hardware_concurrency());
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(uint32_t i=0; i<mMinWorkers; i++){
+            mWorkers++;
+            std::thread(&Server::workerLoop, this).detach();
+        }
+    }
+    Logger::logSuccess("Listening on " + mSocketPath + " (" + std::to_string(mMinWorkers) + " statement workers)");
+
+    epoll_event events[SERVER_EVENTS];
+    while(PROG_RUNNING){
+        int count = epoll_wait(mEpollFd, events, SERVER_EVENTS, -1);
+        if(count < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            Logger::logError("Event loop failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        for(int i=0; i<count; i++){
+            int fd = events[i].data.fd;
+            if(fd == mListenFd){
+                accept();
+                continue;
+            }
+            if(fd == mEventFd){
+                collectFinished();
+                continue;
+            }
+            if(fd == mSignalFd){
+                signalfd_siginfo signal;
+                while(read(mSignalFd, &signal, sizeof(signal)) > 0);
+                PROG_RUNNING = false;
+                continue;
+            }
+
+            // Connections closed by an earlier event of this round are skipped
+            auto found = mConnections.find(fd);
+            if(found == mConnections.end()){
+                continue;
+            }
+            Connection& connection = *found->second;
+            // Statements sent before hanging up still run
+            if((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && !receive(connection)){
+                connection.hungUp = true;
+            }
+            advance(connection);
+        }
+    }
+
+    shutdown();
+    return true;
+}
+
+#else
+
+bool Server::run(){
+    Logger::logError("Server mode uses epoll and is only available on Linux");
+    return false;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <map>
+#include <deque>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "../context/context.h"
+
+/**
+ * @brief Server mode: clients of the machine connect to a Unix domain socket and send statements ending with ;
+ * like at the prompt. The output of every statement is sent back followed by a '\0' byte.
+ * One thread runs an epoll event loop accepting connections and moving their bytes. Statements run on
+ * a pool of statement workers, so that a slow statement doesn't hold up the other clients. Every
+ * connection has a session of its own (current database, open transaction, prepared statements), and runs
+ * one statement at a time in the order sent. Statements of all the connections share the tables, locks and
+ * transactions of the process. The pool starts SERVER_WORKERS threads and adds one whenever a statement
+ * arrives while all of them are busy, since statements can wait for locks held by transactions of
+ * connections whose next statement hasn't run yet. Threads past SERVER_WORKERS stop once idle.
+ */
+class Server {
+    struct Connection {
+        int fd;
+        Session session;
+        // Bytes received and not run yet
+        std::string input;
+        // Bytes of output not sent yet, from outputSent on
+        std::string output;
+        uint64_t outputSent = 0;
+        // A statement of the connection is queued or running on a worker
+        bool running = false;
+        // The client sent all it will send. Statements left run, then the connection ends
+        bool hungUp = false;
+        // The socket is closed on the other end. Output is dropped
+        bool gone = false;
+        // Events the event loop waits for on the socket
+        uint32_t events = 0;
+    };
+
+    struct Job {
+        Connection* connection;
+        std::string statement;
+        std::string output;
+    };
+
+    std::string mSocketPath;
+    int mListenFd = -1;
+    int mEpollFd = -1;
+    // Written by workers when a statement finished, waking up the event loop
+    int mEventFd = -1;
+    // Reports SIGINT and SIGTERM to the event loop
+    int mSignalFd = -1;
+    std::map< int, std::unique_ptr<Connection> > mConnections;
+
+    // Statement workers, their queued and finished statements
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mStopped;
+    std::deque< Job > mJobs;
+    std::deque< Job > mFinished;
+    uint32_t mMinWorkers = 1;
+    uint32_t mWorkers = 0;
+    uint32_t mIdleWorkers = 0;
+    bool mStopping = false;
+
+    bool listen();
+    void accept();
+    /**
+     * @brief Read what the client sent
+     *
+     * @return false if the client hung up
+     */
+    bool receive(Connection& connection);
+    /**
+     * @brief Queue the next statement of the connection if none is running, send its output and close it once done with it.
+     * The connection may be gone after the call
+     */
+    void advance(Connection& connection);
+    /**
+     * @brief Write output of the connection until the socket is full
+     */
+    void send(Connection& connection);
+    void updateEvents(Connection& connection);
+    void close(Connection& connection);
+    /**
+     * @brief Hand the output of finished statements to their connections
+     */
+    void collectFinished();
+    void submit(Connection& connection, const std::string& statement);
+    void workerLoop();
+    void shutdown();
+public:
+    Server(const std::string& socketPath);
+
+    /**
+     * @brief Serve clients until the process is interrupted (SIGINT or SIGTERM)
+     *
+     * @return false if the socket couldn't be listened on
+     */
+    bool run();
+};
+
+#endif // SERVER_H
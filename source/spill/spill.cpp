@@ -0,0 +1,49 @@
+#include <string.h>
+#include <memory>
+#include "spill.h"
+#include "../buffers/buffers.h"
+#include "../logger/logger.h"
+#include "../temp/temp.h"
+
+// File system calls
+#include <fcntl.h>
+
+uint64_t createSpillFile(const std::vector< std::vector< std::string > >& columns){
+    uint64_t fileId = TempFiles::createFileId();
+
+    // Same metadata as saveTableWithId. Column names aren't validated since they can be qualified
+    std::string tableString = std::to_string(fileId) + " spill";
+    for(int i=0; i<columns.size(); i++){
+        tableString += " " + columns[i][0] + " " + columns[i][1] + "$";
+    }
+    tableString += "<";
+
+    std::unique_ptr<char[]> pageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    memset(pageBuffer.get(), 0, PAGE_SIZE + 1);
+
+    uint64_t totBytes = 0;
+    uint64_t totPages = 1;
+    uint64_t nextId = 1;
+    memcpy(pageBuffer.get(), &totBytes, sizeof(totBytes));
+    memcpy(pageBuffer.get() + sizeof(totBytes), &totPages, sizeof(totPages));
+    memcpy(pageBuffer.get() + sizeof(totBytes) + sizeof(totPages), &nextId, sizeof(nextId));
+    strncpy(pageBuffer.get() + sizeof(totBytes) + sizeof(totPages) + sizeof(nextId), tableString.c_str(), PAGE_SIZE - 3*sizeof(uint64_t));
+
+    if(!writeToPage(pageBuffer.get(), fileId, 0, O_CREAT | O_TRUNC, S_IRUSR|S_IWUSR)){
+        Logger::logError("Unable to create spill file");
+        return 0;
+    }
+
+    memset(pageBuffer.get(), 0, PAGE_SIZE);
+    if(!writeToPage(pageBuffer.get(), fileId, 1)){
+        Logger::logError("Unable to create spill file");
+        deleteFile(fileId);
+        return 0;
+    }
+
+    return fileId;
+}
+
+void deleteSpillFile(uint64_t fileId){
+    deleteFile(fileId);
+}
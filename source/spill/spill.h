@@ -0,0 +1,22 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Create a query file holding temporary rows of an operator (spill file).
+ * The columns are stored in the metadata page like the columns of a table, so the file
+ * can be filled with a ResultAppender and read with a ScanOperator.
+ *
+ * @return uint64_t ID of the file. 0 on failure
+ */
+uint64_t createSpillFile(const std::vector< std::vector< std::string > >& columns);
+
+/**
+ * @brief Remove a spill file and its overflow pages
+ */
+void deleteSpillFile(uint64_t fileId);
+
+#endif // SPILL_H
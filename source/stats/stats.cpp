@@ -0,0 +1,128 @@
+#include <string.h>
+#include <memory>
+#include "stats.h"
+#include "../type/type.h"
+#include "../page/page.h"
+#include "../buffers/buffers.h"
+
+/**
+ * @brief Marks metadata pages holding statistics. Tables created before statistics were kept have zeros there
+ */
+const uint32_t STATS_MAGIC = 0x53544154;
+
+const uint8_t STATS_BOUNDS = 1;
+const uint8_t STATS_EXACT_BOUNDS = 2;
+const uint8_t STATS_NULL_FREE = 4;
+
+/**
+ * @brief Layout from the end of the page: magic, row count, column count, then one entry
+ * (flags, min, max) per column before them
+ */
+const uint32_t STATS_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+const uint32_t COLUMN_STATS_SIZE = 1 + 2*sizeof(uint64_t);
+
+uint32_t getStatsSize(uint32_t columnCount){
+    return STATS_HEADER_SIZE + columnCount*COLUMN_STATS_SIZE;
+}
+
+TableStats createTableStats(uint32_t columnCount){
+    TableStats stats;
+    stats.columns.resize(columnCount);
+    return stats;
+}
+
+bool readTableStats(const char metadata[], TableStats& stats){
+    const char* header = metadata + PAGE_SIZE - STATS_HEADER_SIZE;
+    uint32_t magic, columnCount;
+    memcpy(&magic, header, sizeof(magic));
+    memcpy(&stats.rowCount, header + sizeof(magic), sizeof(stats.rowCount));
+    memcpy(&columnCount, header + sizeof(magic) + sizeof(stats.rowCount), sizeof(columnCount));
+    if(magic != STATS_MAGIC || getStatsSize(columnCount) > PAGE_SIZE){
+        return false;
+    }
+
+    stats.columns.assign(columnCount, ColumnStats());
+    const char* entry = metadata + PAGE_SIZE - getStatsSize(columnCount);
+    for(uint32_t i=0; i<columnCount; i++, entry += COLUMN_STATS_SIZE){
+        ColumnStats& column = stats.columns[i];
+        uint8_t flags = entry[0];
+        column.hasBounds = flags & STATS_BOUNDS;
+        column.exactBounds = flags & STATS_EXACT_BOUNDS;
+        column.nullFree = flags & STATS_NULL_FREE;
+        memcpy(column.min, entry + 1, sizeof(column.min));
+        memcpy(column.max, entry + 1 + sizeof(column.min), sizeof(column.max));
+    }
+    return true;
+}
+
+void writeTableStats(char metadata[], const TableStats& stats){
+    char* header = metadata + PAGE_SIZE - STATS_HEADER_SIZE;
+    uint32_t columnCount = stats.columns.size();
+    memcpy(header, &STATS_MAGIC, sizeof(STATS_MAGIC));
+    memcpy(header + sizeof(STATS_MAGIC), &stats.rowCount, sizeof(stats.rowCount));
+    memcpy(header + sizeof(STATS_MAGIC) + sizeof(stats.rowCount), &columnCount, sizeof(columnCount));
+
+    char* entry = metadata + PAGE_SIZE - getStatsSize(columnCount);
+    for(uint32_t i=0; i<columnCount; i++, entry += COLUMN_STATS_SIZE){
+        const ColumnStats& column = stats.columns[i];
+        entry[0] = (column.hasBounds ? STATS_BOUNDS : 0) | (column.exactBounds ? STATS_EXACT_BOUNDS : 0) | (column.nullFree ? STATS_NULL_FREE : 0);
+        memcpy(entry + 1, column.min, sizeof(column.min));
+        memcpy(entry + 1 + sizeof(column.min), column.max, sizeof(column.max));
+    }
+}
+
+bool loadTableStats(uint64_t fileId, TableStats& stats, const Snapshot* snapshot){
+    std::unique_ptr<char[]> metadataBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    if(!readVisiblePage(metadataBuffer.get(), fileId, 0, snapshot)){
+        return false;
+    }
+    return readTableStats(metadataBuffer.get(), stats);
+}
+
+/**
+ * @brief Widen bounds of int64_t or double values
+ */
+template<typename T>
+void widenBounds(ColumnStats& stats, const char value[]){
+    T current, min, max;
+    memcpy(&current, value, sizeof(current));
+    memcpy(&min, stats.min, sizeof(min));
+    memcpy(&max, stats.max, sizeof(max));
+    if(!stats.hasBounds || current < min){
+        memcpy(stats.min, &current, sizeof(current));
+    }
+    if(!stats.hasBounds || current > max){
+        memcpy(stats.max, &current, sizeof(current));
+    }
+    stats.hasBounds = true;
+}
+
+void addValueToStats(ColumnStats& stats, const char value[], const std::string& type){
+    TYPE kind = getTypeFromString(type);
+    if(kind == TYPE::INT){
+        widenBounds<int64_t>(stats, value);
+    } else if(kind == TYPE::FLOAT){
+        widenBounds<double>(stats, value);
+    }
+}
+
+void addRowToStats(TableStats& stats, const char row[], const std::vector< std::vector< std::string > >& columns){
+    std::vector< uint32_t > offsets = getColumnOffsets(row, columns);
+    for(int i=0; i<columns.size() && i<stats.columns.size(); i++){
+        addValueToStats(stats.columns[i], row + offsets[i], columns[i][1]);
+    }
+    stats.rowCount++;
+}
+
+void removeRowsFromStats(TableStats& stats, uint64_t rows){
+    stats.rowCount = rows > stats.rowCount ? 0 : stats.rowCount - rows;
+    for(int i=0; i<stats.columns.size(); i++){
+        ColumnStats& column = stats.columns[i];
+        if(stats.rowCount == 0){
+            // Nothing is left to bound
+            column = ColumnStats();
+        } else if(rows){
+            column.exactBounds = false;
+        }
+    }
+}
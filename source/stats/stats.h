@@ -0,0 +1,78 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../mvcc/mvcc.h"
+
+/**
+ * @brief Statistics of a column. Bounds are kept for int and float columns
+ */
+struct ColumnStats {
+    // Some row has a value, so min and max are set
+    bool hasBounds = false;
+    // No row with the min or max value was deleted or updated since they were set
+    bool exactBounds = true;
+    // Columns have no NULL values
+    bool nullFree = true;
+    // int64_t or double by the type of the column
+    char min[sizeof(uint64_t)] = {};
+    char max[sizeof(uint64_t)] = {};
+};
+
+/**
+ * @brief Statistics of a table, stored at the end of its metadata page (page 0) and updated
+ * on every insert, update and delete. Deletes and updates can't shrink min and max without
+ * reading the table, so afterwards the bounds still hold every value but may be loose
+ */
+struct TableStats {
+    uint64_t rowCount = 0;
+    std::vector< ColumnStats > columns;
+};
+
+/**
+ * @brief Bytes of the statistics of a table with this many columns
+ */
+uint32_t getStatsSize(uint32_t columnCount);
+
+/**
+ * @brief Statistics of an empty table
+ */
+TableStats createTableStats(uint32_t columnCount);
+
+/**
+ * @brief Read the statistics from a metadata page
+ *
+ * @return false if the table has none (created before statistics were kept)
+ */
+bool readTableStats(const char metadata[], TableStats& stats);
+
+/**
+ * @brief Write the statistics to the end of a metadata page
+ */
+void writeTableStats(char metadata[], const TableStats& stats);
+
+/**
+ * @brief Read the statistics of a table file as a snapshot sees them
+ *
+ * @return false if the table has none or page 0 can't be read
+ */
+bool loadTableStats(uint64_t fileId, TableStats& stats, const Snapshot* snapshot);
+
+/**
+ * @brief Widen the bounds of a column to hold a value in the decoded row format
+ */
+void addValueToStats(ColumnStats& stats, const char value[], const std::string& type);
+
+/**
+ * @brief Count an inserted row (decoded, see getColumnOffsets)
+ */
+void addRowToStats(TableStats& stats, const char row[], const std::vector< std::vector< std::string > >& columns);
+
+/**
+ * @brief Count deleted rows. The bounds of every column may become loose
+ */
+void removeRowsFromStats(TableStats& stats, uint64_t rows);
+
+#endif // STATS_H
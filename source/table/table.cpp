@@ -1,4 +1,5 @@
 #include <utility>
+#include <algorithm>
 #include <filesystem>
 #include <string.h>
 #include <set>
@@ -9,7 +10,14 @@
 #include "../logger/logger.h"
 #include "../type/type.h"
 #include "../buffers/buffers.h"
+#include "../context/context.h"
 #include "../formatter/formatter.h"
+#include "../page/page.h"
+#include "../executor/executor.h"
+#include "../planner/planner.h"
+#include "../temp/temp.h"
+#include "../stats/stats.h"
+#include "../lock/lock.h"
 #include <stdlib.h>
 
 // File system calls
@@ -22,30 +30,17 @@ uint64_t universalCounter = 0;
 inline bool validateTableName(const std::string& name);
 std::pair<bool, std::string> validateAndProcessColumns(std::vector< std::vector< std::string > >& columns, bool lengthCheck = true);
 bool validateColumnName(const std::string& name);
-bool saveTableWithId(uint64_t tableId, const std::string& tableString);
+bool saveTableWithId(ExecutionContext& context, uint64_t tableId, const std::string& tableString);
 
-uint64_t handleWhere(uint64_t tableId, const std::vector< std::string >& tokens);
-uint64_t handleWhereFromConditions(uint64_t tableId, const std::vector< condition >& conditions, bool primary = true);
+std::unique_ptr<Operator> handleWhere(std::unique_ptr<Operator> child, const std::vector< std::string >& tokens, bool preserveOrder);
 
-uint64_t handleJoin(uint64_t primaryTableId, const std::vector< std::string >& tokens);
-
-bool saveTableWithName(const std::string& tableName, const std::string &tableString);
-uint32_t getRowSize(const std::vector< std::vector< std::string > > &columns);
+bool saveTableWithName(ExecutionContext& context, const std::string& tableName, const std::string &tableString);
 std::vector< std::string > getColumnValues(const std::vector<std::string>& tokens, int startIndex, int endIndex);
 bool verifyInsertedColumns(const std::vector< std::string >& values, const std::vector< std::vector< std::string > >& columns);
-uint32_t loadRowBytes(const std::vector< std::vector< std::string > >& columns, const std::vector< std::string >& columnValues);
-bool saveRow(uint64_t tableId, uint32_t rowSize, char* BUFFER = WORKBUFFER_A);
-int verifyConditions(const char rowBuffer[], const std::vector< std::vector< std::string > >& columns,const std::vector<condition>& conditions, uint32_t rowSize);
-void printQuery(uint64_t fileId, bool atLeastOneMatch);
+uint32_t loadRowBytes(ExecutionContext& context, const std::vector< std::vector< std::string > >& columns, const std::vector< std::string >& columnValues);
+bool saveRow(ExecutionContext& context, uint64_t tableId, uint32_t rowSize, char* BUFFER, bool slotted = false);
 bool updateRow(char BUFFER[], const std::vector< condition >& assignments, const std::vector< std::vector< std::string > >& columns);
-void consolidate(uint64_t fileId, uint32_t rowSize);
-
-uint64_t handleSelect(const std::vector<std::string>& tokens);
-
-std::string getQueryString(uint64_t queryFileId){
-    universalCounter++;
-    return "query"+std::to_string((queryFileId)%1000000000);
-}
+void consolidate(ExecutionContext& context, uint64_t fileId, uint32_t rowSize);
 
 std::string comparisonToString(COMPARISON comp){
     switch(comp){
@@ -79,7 +74,7 @@ std::string condition::toString(){
     return str;
 }
 
-void Table::createTable(const std::vector<std::string>& tokens){
+void Table::createTable(ExecutionContext& context, const std::vector<std::string>& tokens){
     std::string tableName = tokens[2];
 
     if(!Database::isDatabaseChosen()){
@@ -93,7 +88,12 @@ void Table::createTable(const std::vector<std::string>& tokens){
         return;
     }
 
-    if(Database::getTableId(tableName)){
+    // Tables are created one at a time, so that two sessions can't take the same name or ID
+    TableLocks locks;
+    locks.add(Database::getCatalogId(), LOCK_MODE::EXCLUSIVE);
+    locks.lock();
+
+    if(Database::getTableId(context, tableName)){
         Logger::logError("Table with given name already exists");
         return;
     }
@@ -145,8 +145,9 @@ void Table::createTable(const std::vector<std::string>& tokens){
         std::cout << "Row size: " << rowSize << std::endl;
     }
     
-    // First 4 bytes of page represent total used bytes of page
-    if(rowSize + 4 > PAGE_SIZE){
+    // First 4 bytes of page represent total used bytes of page. Slotted pages also need a header and a slot.
+    uint32_t pageOverhead = isVariableLength(columns) ? SLOTTED_PAGE_HEADER_SIZE + SLOT_SIZE : sizeof(uint32_t);
+    if(rowSize + pageOverhead > PAGE_SIZE){
         Logger::logError("Every row must fit inside a single page. Change the page size if you want to process larger rows.");
         return;
     }
@@ -157,7 +158,14 @@ void Table::createTable(const std::vector<std::string>& tokens){
      * 
      */
     tableString = tableName + tableString;
-    if(!saveTableWithName(tableName, tableString)){
+
+    // The metadata page holds the counters, the ID and table string and the statistics
+    uint32_t metadataSize = 3*sizeof(uint64_t) + std::to_string(UINT32_MAX).length() + 1 + tableString.length() + 1;
+    if(metadataSize + getStatsSize(columns.size()) > PAGE_SIZE){
+        Logger::logError("Too many columns. The table information must fit inside a single page.");
+        return;
+    }
+    if(!saveTableWithName(context, tableName, tableString)){
         Logger::logError("Unable to write table info");
         return;
     }
@@ -165,7 +173,7 @@ void Table::createTable(const std::vector<std::string>& tokens){
     return;
 }
 
-void Table::insertIntoTable(const std::vector<std::string>& tokens){
+void Table::insertIntoTable(ExecutionContext& context, const std::vector<std::string>& tokens){
     std::string tableName = tokens[2];
     
     if(!Database::isDatabaseChosen()){
@@ -173,7 +181,7 @@ void Table::insertIntoTable(const std::vector<std::string>& tokens){
         return;
     }
 
-    if(!Database::getTableId(tableName)){
+    if(!Database::getTableId(context, tableName)){
         Logger::logError("The specified table doesn't exist");
         return;
     }
@@ -188,7 +196,7 @@ void Table::insertIntoTable(const std::vector<std::string>& tokens){
         return;
     }
 
-    const std::vector< std::vector< std::string > >& columns = Database::getColumnsOfTable(tableName);
+    const std::vector< std::vector< std::string > >& columns = Database::getColumnsOfTable(context, tableName);
     std::vector< std::string > columnValues = getColumnValues(tokens, 4, tokens.size()-1);
 
     if(columns.size() != columnValues.size()){
@@ -201,15 +209,15 @@ void Table::insertIntoTable(const std::vector<std::string>& tokens){
         return;
     }
 
-    uint64_t tableId = Database::getTableId(tableName);
-    // Load into WORKBUFFER_A
-    uint32_t rowSize = loadRowBytes(columns, columnValues);
+    uint64_t tableId = Database::getTableId(context, tableName);
+    // Load into the work buffer A of the context
+    uint32_t rowSize = loadRowBytes(context, columns, columnValues);
     if(rowSize == 0 || tableId == 0){
         Logger::logError("Error in loading row info into buffer");
         return;
     }
 
-    bool saveInfo = saveRow(tableId, rowSize);
+    bool saveInfo = saveRow(context, tableId, rowSize, context.workBufferA);
 
     if(saveInfo){
         Logger::logError("Error in saving row info to table");
@@ -220,43 +228,69 @@ void Table::insertIntoTable(const std::vector<std::string>& tokens){
 
 }
 
-void Table::handleSearchQuery(const std::vector<std::string>& tokens){
-    std::string tableName = tokens[3];
+void Table::handleSearchQuery(ExecutionContext& context, const std::vector<std::string>& tokens){
+    // select <select list> from table
+    int fromIndex = std::find(tokens.begin(), tokens.end(), "from") - tokens.begin();
+    if(fromIndex + 1 >= tokens.size()){
+        Logger::logError("Table name not provided");
+        return;
+    }
+    std::string tableName = tokens[fromIndex + 1];
 
     if(!Database::isDatabaseChosen()){
         Logger::logError("Databse not selected");
         return;
     }
 
-    uint64_t currentFileId = Database::getTableId(tableName);
+    uint64_t currentFileId = Database::getTableId(context, tableName);
+
+    if(!currentFileId){
+        Logger::logError("Table does not exist");
+        return;
+    }
 
     if(DEBUG == true){
-        readPage(CURRENT_TABLE_PAGE_BUFFER_A, currentFileId, 1);
-        uint32_t rowSize = getRowSize(Database::getColumnsOfTable(currentFileId));
+        readPage(context.tablePage, currentFileId, 1);
+        std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(context, currentFileId);
+        std::vector< std::pair< uint32_t, uint32_t > > rows = getRowsOfPage(context.tablePage, getRowSize(columns), isVariableLength(columns));
         std::cout << "IDs of table: " << std::endl;
-        for(int j=4; j<PAGE_SIZE; j+=rowSize){
+        for(int j=0; j<rows.size(); j++){
             uint64_t currentId;
-            memcpy(&currentId, CURRENT_TABLE_PAGE_BUFFER_A + j, sizeof(uint64_t));
-            if(currentId){
-                std::cout << currentId << " " << j << std::endl;
-            }
+            memcpy(&currentId, context.tablePage + rows[j].first, sizeof(uint64_t));
+            std::cout << currentId << " " << rows[j].first << std::endl;
         }
     }
 
-    if(!currentFileId){
-        Logger::logError("Table does not exist");
+    std::vector< SelectItem > items;
+    if(!parseSelectList(tokens, 1, fromIndex, items)){
         return;
     }
 
+    // select ... from table [as alias]. Conditions refer to the table by its alias
+    std::string queryName = tableName;
+    int subQueryStart = fromIndex + 2;
+    if(tokens.size() > subQueryStart && tokens[subQueryStart] == "as"){
+        if(tokens.size() < subQueryStart + 2 || !validateAlias(tokens[subQueryStart + 1])){
+            Logger::logError("Invalid alias. Aliases must be alphanumeric, start with a letter and be at most 16 characters long");
+            return;
+        }
+        queryName = tokens[subQueryStart + 1];
+        subQueryStart += 2;
+    }
+
     std::set< std::string > mainKeywords = {
         "join",
-        "where"
+        "where",
+        "group",
+        "order",
+        "limit",
+        "offset"
     };
 
     std::vector< std::vector< std::string > > subQueries;
     std::vector< std::string > currentSubQuery;
 
-    for(int i=4; i < tokens.size(); i++){
+    for(int i=subQueryStart; i < tokens.size(); i++){
         if(mainKeywords.find(tokens[i]) != mainKeywords.end()){
             if(currentSubQuery.size()){
                 subQueries.push_back(currentSubQuery);
@@ -271,369 +305,132 @@ void Table::handleSearchQuery(const std::vector<std::string>& tokens){
         currentSubQuery.clear();
     }
 
+    // Reads see the snapshot of the statement, so writers of the tables aren't blocked. Intention locks
+    // keep the tables from being replaced while the query runs
+    TableLocks locks;
+    locks.add(currentFileId, LOCK_MODE::INTENTION_SHARED);
     for(int i=0; i<subQueries.size(); i++){
-        if(subQueries[i][0] == "where"){
-            currentFileId = handleWhere(currentFileId, subQueries[i]);
-            if(DEBUG == true){
-                std::cout << "Table ID of where result: " << currentFileId << std::endl;
-            }
-            if(!currentFileId){
-                return;
-            }
-        } else if(subQueries[i][0] == "join") {
-            currentFileId = handleJoin(currentFileId, subQueries[i]);
-            if(DEBUG == true){
-                std::cout << "Table ID of join result: " << currentFileId << std::endl;
-            }
-            if(!currentFileId){
-                return;
-            }
+        uint64_t joinedFileId = subQueries[i][0] == "join" && subQueries[i].size() > 1 ? Database::getTableId(context, subQueries[i][1]) : 0;
+        if(joinedFileId){
+            locks.add(joinedFileId, LOCK_MODE::INTENTION_SHARED);
         }
     }
+    locks.lock();
 
-    // For now, we don't care about atLeastOneMatched. That efficiency requirement can be added later
-    printQuery(currentFileId, true);
-}
-
-uint64_t handleJoin(uint64_t primaryTableId, const std::vector< std::string >& tokens){
-    if(DEBUG == true){
-        std::cout << "Join clause tokens: ";
-        for(int i=0;i<tokens.size();i++){
-            std::cout << tokens[i] << " ";
+    // Scans read the columns used by conditions. Other columns of the select list are read for the resulting rows
+    ColumnUsage usage;
+    for(int i=0; i<subQueries.size(); i++){
+        usage.conditionTokens.insert(subQueries[i].begin(), subQueries[i].end());
+    }
+    for(int i=0; i<items.size(); i++){
+        if(items[i].all){
+            usage.selectAll = true;
+            continue;
         }
-        std::cout << std::endl;
+        std::vector< std::string > names;
+        getExpressionColumns(*items[i].expression, names);
+        usage.outputColumns.insert(names.begin(), names.end());
     }
-
-    if(tokens.size() < 4){
-        Logger::logError("Incomplete join query");
-        return 0;
+    // Groups are formed from every column the select list uses, so nothing is deferred
+    bool aggregating = false, grouping = false;
+    for(int i=0; i<items.size(); i++){
+        aggregating = aggregating || (!items[i].all && hasAggregate(*items[i].expression));
     }
-
-    if(tokens[2] != "on"){
-        Logger::logError("Join columns not provided");
-        return 0;
+    for(int i=0; i<subQueries.size(); i++){
+        grouping = grouping || subQueries[i][0] == "group";
     }
+    aggregating = aggregating || grouping;
+    usage.deferOutput = LATE_MATERIALIZATION && subQueries.size() > 0 && !aggregating;
+    // One group of count, min and max aggregates comes out the same from rows in any order
+    usage.unordered = aggregating && !grouping && isOrderInsensitive(items);
 
-    std::vector<condition> conditions;
-    std::vector< std::string > currentCondition;
+    // Rows flow from the scan through one operator per sub query
+    std::unique_ptr<Operator> root = planScan(context, currentFileId, queryName, usage);
 
-    for(int i=3;i<tokens.size();i++){
-        if(tokens[i] == "and" || tokens[i] == "&&"){
-            if(currentCondition.size() == 0){
-                Logger::logError("empty condition found");
-                return 0;
+    // Group by, order by, limit and offset clauses come last and apply to the rows of the query
+    ResultOrder order;
+    std::vector< std::string > groupBy;
+    bool grouped = false;
+    for(int i=0; i<subQueries.size(); i++){
+        if(subQueries[i][0] == "order" || subQueries[i][0] == "limit" || subQueries[i][0] == "offset"){
+            if(!parseResultOrder(subQueries[i], order)){
+                return;
             }
-            condition cd = getCondition(currentCondition);
-            currentCondition.clear();
-            if(cd.operation == COMPARISON::INVALID){
-                Logger::logError("Invalid condition provided");
-                return 0;
+            continue;
+        }
+        if(subQueries[i][0] == "group"){
+            if(grouped || order.columns.size() || order.hasLimit){
+                Logger::logError("A query has one group by clause, which comes before order by, limit and offset clauses");
+                return;
             }
-            conditions.push_back(cd);
-        } else {
-            currentCondition.push_back(tokens[i]);
+            if(!parseGroupBy(subQueries[i], groupBy)){
+                return;
+            }
+            grouped = true;
+            continue;
         }
-    }
-
-    if(!currentCondition.size()){
-        Logger::logError("Empty condition provided");
-        return 0;
-    }
-    condition cd = getCondition(currentCondition);
-    if(cd.operation == COMPARISON::INVALID){
-        Logger::logError("Invalid condition provided");
-        return 0;
-    }
-    conditions.push_back(cd);
-
-    // Parse conditions
-    
-    // Conditions where LHS and RHS are columns of the two tables
-    std::vector<condition> dependentConditions;
-    // Conditions where only LHS column is on the left
-    std::vector<condition> primaryOnlyConditions;
-    // Conditions where only RHS column is on the left
-    std::vector<condition> secondaryOnlyConditions;
-
-    std::string primaryTableName = Database::getTableName(primaryTableId);
-    std::string secondaryTableName = tokens[1];
-
-    if(primaryTableName == secondaryTableName) {
-        Logger::logError("Same table joins currently not supported");
-        return 0;
-    }
-
-    // Classifying conditions
-    for(auto u: conditions){
-        if(DEBUG == true){
-            std::cout << "Current Condition: " << u.toString() << std::endl;
-            std::cout << "Primary Table: " << primaryTableName << std::endl;
-            std::cout << "Secondary Table: " << secondaryTableName << std::endl;
+        if(grouped || order.columns.size() || order.hasLimit){
+            Logger::logError("Group by, order by, limit and offset clauses must come after join and where clauses");
+            return;
         }
 
-        if(u.columnName.length() > primaryTableName.length()+1 && u.columnName.substr(0,primaryTableName.length()) == primaryTableName){
-            if(u.value.length() > secondaryTableName.length()+1 && u.value.substr(0,secondaryTableName.length()) == secondaryTableName){
-                dependentConditions.push_back(u);
-                dependentConditions[dependentConditions.size() - 1].columnName = dependentConditions[dependentConditions.size() - 1].columnName.substr(primaryTableName.length()+1);
-                dependentConditions[dependentConditions.size() - 1].value = dependentConditions[dependentConditions.size() - 1].value.substr(secondaryTableName.length()+1);
-            } else {
-                primaryOnlyConditions.push_back(u);
-                primaryOnlyConditions[primaryOnlyConditions.size() - 1].columnName = primaryOnlyConditions[primaryOnlyConditions.size() - 1].columnName.substr(primaryTableName.length() + 1);
+        if(subQueries[i][0] == "where"){
+            root = handleWhere(std::move(root), subQueries[i], !usage.unordered);
+            if(!root){
+                return;
             }
-        } else if(u.columnName.length() > secondaryTableName.length()+1 && u.columnName.substr(0,secondaryTableName.length()) == secondaryTableName){
-            if(u.value.length() > primaryTableName.length()+1 && u.value.substr(0,primaryTableName.length()) == primaryTableName){
-                u.invert();
-                dependentConditions.push_back(u);
-                dependentConditions[dependentConditions.size() - 1].columnName = dependentConditions[dependentConditions.size() - 1].columnName.substr(primaryTableName.length()+1);
-                dependentConditions[dependentConditions.size() - 1].value = dependentConditions[dependentConditions.size() - 1].value.substr(secondaryTableName.length()+1);
-            } else {
-                secondaryOnlyConditions.push_back(u);
-                secondaryOnlyConditions[secondaryOnlyConditions.size() - 1].columnName = secondaryOnlyConditions[secondaryOnlyConditions.size() - 1].columnName.substr(secondaryTableName.length() + 1);
+        } else if(subQueries[i][0] == "join") {
+            // Consecutive join clauses are ordered together
+            std::vector< std::vector< std::string > > joinClauses;
+            for(; i<subQueries.size() && subQueries[i][0] == "join"; i++){
+                joinClauses.push_back(subQueries[i]);
+            }
+            i--;
+            root = planJoins(context, std::move(root), joinClauses, usage);
+            if(!root){
+                return;
             }
-        } else {
-            Logger::logError("Condition in incorrect format. Column name must be on LHS");
-            return 0;
         }
     }
 
-    if(DEBUG == true){
-        std::cout << "Primary Only Conditions:" << std::endl;
-        for(int i=0;i<primaryOnlyConditions.size();i++){
-            std::cout << primaryOnlyConditions[i].toString() << std::endl;
-        }
+    // Scans of the whole table are run by the worker pool too
+    root = planFilter(std::move(root), {}, !usage.unordered);
 
-        std::cout << "Secondary Only Conditions:" << std::endl;
-        for(int i=0;i<secondaryOnlyConditions.size();i++){
-            std::cout << secondaryOnlyConditions[i].toString() << std::endl;
-        }
-
-        std::cout << "Dependent Conditions:" << std::endl;
-        for(int i=0;i<dependentConditions.size();i++){
-            std::cout << dependentConditions[i].toString() << std::endl;
+    // Rows are ordered and limited before deferred columns are read and expressions are evaluated when possible.
+    // Groups are ordered once they are produced
+    bool orderFirst = !aggregating && orderBeforeProjection(order, items);
+    if(orderFirst){
+        root = planResultOrder(std::move(root), order);
+        if(!root){
+            return;
         }
     }
 
-    if(dependentConditions.size() == 0){
-        Logger::logError("Dependent join conditions not provided");
-        return 0;
-    }
-
-    uint64_t secondaryTableId = Database::getTableId(secondaryTableName);
-
-    if(!secondaryTableId){
-        Logger::logError("Table "+secondaryTableName+" doesn't exist");
-        return 0;
-    }
-
-    std::vector< std::vector< std::string > > primaryTableColumns = Database::getColumnsOfTable(primaryTableId);
-    std::vector< std::vector< std::string > > secondaryTableColumns = Database::getColumnsOfTable(secondaryTableId);
-
-    // Getting columns of resulting table
-    std::vector< std::vector< std::string > > finalColumns;
-    for(auto u: primaryTableColumns){
-        finalColumns.push_back(u);
-        finalColumns[finalColumns.size() - 1][0] = primaryTableName+"."+finalColumns[finalColumns.size() - 1][0];
-    }
-
-    for(auto u: secondaryTableColumns){
-        finalColumns.push_back(u);
-        finalColumns[finalColumns.size() - 1][0] = secondaryTableName+"."+finalColumns[finalColumns.size() - 1][0];
-    }
-
-    if(DEBUG == true){
-        std::cout << "Final Columns: ";
-        for(auto u: finalColumns){
-            std::cout << u[0] << " ";
+    if(aggregating){
+        // Without where and join clauses the scan reads every row of the table
+        bool wholeTable = true;
+        for(int i=0; i<subQueries.size(); i++){
+            wholeTable = wholeTable && subQueries[i][0] != "where" && subQueries[i][0] != "join";
         }
-        std::cout << std::endl;
-    }
-
-    uint32_t primaryRowSize = getRowSize(primaryTableColumns);
-    uint32_t secondaryRowSize = getRowSize(secondaryTableColumns);
-
-    if(primaryRowSize + secondaryRowSize - sizeof(uint64_t) + sizeof(uint32_t) > PAGE_SIZE){
-        Logger::logError("Overflow in join query");
-        return 0;
-    }
-    
-    ++universalCounter;
-    uint64_t queryFileId = ( ( universalCounter % ((uint64_t)1 << LOG_MAX_TABLES) ) + ( (uint64_t)1 << LOG_MAX_TABLES) );
-    
-    // Maximum name length is 16
-    std::string queryTableName = getQueryString(queryFileId);
-
-    // Table string for query table
-    std::string queryTableString = std::to_string(queryFileId) + " " + queryTableName + validateAndProcessColumns(finalColumns, false).second;
-    saveTableWithId(queryFileId, queryTableString);
-
-    uint64_t filteredPrimaryTableId = handleWhereFromConditions(primaryTableId, primaryOnlyConditions);
-    uint64_t filteredSecondaryTableId = handleWhereFromConditions(secondaryTableId, secondaryOnlyConditions);
-
-    if(DEBUG == true){
-        std::cout << "Filtered Primary Table ID: " << filteredPrimaryTableId << std::endl;
-        std::cout << "Filtered Secondary Table ID: " << filteredSecondaryTableId << std::endl;
-    }
-
-    if(!filteredPrimaryTableId || !filteredPrimaryTableId){
-        Logger::logError("Error in joining. Were the right column names used?");
-        return 0;
-    }
-
-    readPage(TABLE_METADATA_PAGE_BUFFER_A, filteredPrimaryTableId, 0);
-    uint64_t totPages;
-    memcpy(&totPages, TABLE_METADATA_PAGE_BUFFER_A + sizeof(uint64_t), sizeof(uint64_t));
-
-    readPage(TABLE_METADATA_PAGE_BUFFER_B, filteredSecondaryTableId, 0);
-    uint64_t totSecondaryPages;
-    memcpy(&totSecondaryPages, TABLE_METADATA_PAGE_BUFFER_B + sizeof(uint64_t), sizeof(uint64_t));
-
-    if(DEBUG == true){
-        std::cout << "Tot primary pages: " << totPages << std::endl;
-        std::cout << "Tot secondary pages: " << totSecondaryPages << std::endl;
-    }
-
-    std::map<std::string, uint32_t> primaryOffsets;
-    std::map<std::string, std::string> primaryTypes;
-    std::map<std::string, uint32_t> primarySizes;
-
-    uint32_t offset = 8;
-    for(int i=0; i<primaryTableColumns.size(); i++){
-        primaryTypes[primaryTableColumns[i][0]] = primaryTableColumns[i][1];
-        primaryOffsets[primaryTableColumns[i][0]] = offset;
-        uint32_t sz = getTypeSize(primaryTableColumns[i][1]);
-        primarySizes[primaryTableColumns[i][0]] = sz;
-
-        offset += sz;
-    }
-
-    for(int i=1; i<=totPages; i++){
-        readPage(CURRENT_TABLE_PAGE_BUFFER_A, filteredPrimaryTableId, i);
-
-        for(int j=sizeof(uint32_t); j+primaryRowSize-1<PAGE_SIZE; j+=primaryRowSize){
-            uint64_t currentId;
-            memcpy(&currentId, CURRENT_TABLE_PAGE_BUFFER_A+j, sizeof(currentId));
-            if(currentId != 0){
-                // Non empty row
-                memcpy(WORKBUFFER_A, CURRENT_TABLE_PAGE_BUFFER_A+j, primaryRowSize);
-                
-                std::vector< condition > secondaryFilterConditions;
-                for(auto u:dependentConditions){
-                    std::string primaryColumn = u.columnName;
-                    if(primaryOffsets.find(primaryColumn) == primaryOffsets.end()){
-                        Logger::logError("Column "+primaryColumn+" doesn't exist");
-                        return 0;
-                    }
-                    
-                    uint32_t offset = primaryOffsets[primaryColumn];
-                    std::string type = primaryTypes[primaryColumn];
-                    uint32_t sz = primarySizes[primaryColumn];
-                    std::string lVal = getValueFromBytes(WORKBUFFER_A, type, offset, offset+sz);
-
-                    condition rightCondition = u;
-                    rightCondition.columnName = lVal;
-                    rightCondition.invert();
-                    secondaryFilterConditions.push_back(rightCondition);
-                }
-
-                for(int k=1; k<=totSecondaryPages; k++){
-                    readPage(CURRENT_TABLE_PAGE_BUFFER_B, filteredSecondaryTableId, k);
-                    for(int w=sizeof(uint32_t); w+secondaryRowSize-1<PAGE_SIZE; w+=secondaryRowSize){
-                        uint64_t currentSecondaryId;
-                        memcpy(&currentSecondaryId, CURRENT_TABLE_PAGE_BUFFER_B+w, sizeof(uint64_t));
-                        if(currentSecondaryId){
-                            // Non-empty row
-                            memset(WORKBUFFER_B, 0, PAGE_SIZE);
-                            memcpy(WORKBUFFER_B, CURRENT_TABLE_PAGE_BUFFER_B+w, secondaryRowSize);
-                            int check = verifyConditions(WORKBUFFER_B, secondaryTableColumns, secondaryFilterConditions, secondaryRowSize);
-                            if(check==1){
-                                memcpy(WORKBUFFER_C,WORKBUFFER_A,primaryRowSize);
-                                memcpy(WORKBUFFER_C+primaryRowSize,WORKBUFFER_B+sizeof(uint64_t),secondaryRowSize-sizeof(uint64_t));
-                                memset(WORKBUFFER_C,0,sizeof(uint64_t));
-                                saveRow(queryFileId,primaryRowSize+secondaryRowSize-sizeof(uint64_t),WORKBUFFER_C);
-                            } else if(check==-1) {
-                                Logger::logError("Error in checking conditions");
-                                return 0;
-                            }
-                        }
-                    }
-                }
-
-            }
-        }
-    }
-
-    return queryFileId;
-
-}
-
-uint64_t handleWhereFromConditions(uint64_t tableId, const std::vector< condition >& conditions, bool primary){
-
-    char *METADATA_BUFFER, *TABLE_BUFFER;
-    if(primary){
-        METADATA_BUFFER = TABLE_METADATA_PAGE_BUFFER_A;
-        TABLE_BUFFER = CURRENT_TABLE_PAGE_BUFFER_A;
+        root = planAggregation(context, std::move(root), items, groupBy, wholeTable ? currentFileId : 0);
     } else {
-        METADATA_BUFFER = TABLE_METADATA_PAGE_BUFFER_B;
-        TABLE_BUFFER = CURRENT_TABLE_PAGE_BUFFER_B;
+        root = planProjection(context, std::move(root), items, usage);
     }
-
-    std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(tableId);
-    uint32_t rowSize = getRowSize(columns);
-
-    universalCounter++;
-    uint64_t queryFileId = ( ( universalCounter % ((uint64_t)1 << LOG_MAX_TABLES) ) + ( (uint64_t)1 << LOG_MAX_TABLES) );
-    
-    // Maximum name length is 16
-    std::string queryTableName = getQueryString(queryFileId);
-
-    // Table string for query table
-    std::string queryTableString = std::to_string(queryFileId) + " " + queryTableName + validateAndProcessColumns(columns).second;
-    saveTableWithId(queryFileId, queryTableString);
-
-    memset(WORKBUFFER_B, 0, PAGE_SIZE);
-    readPage(METADATA_BUFFER, tableId, 0);
-    uint64_t totPages;
-    memcpy(&totPages, METADATA_BUFFER + sizeof(uint64_t), sizeof(totPages));
-    bool atLeastOneMatch = false;
-
-    for(uint64_t i=1; i<=totPages; i++){
-        readPage(TABLE_BUFFER, tableId, i);
-
-        for(uint32_t j=4; j+rowSize-1<PAGE_SIZE; j+=rowSize){
-            uint64_t currentId;
-            memcpy(&currentId, TABLE_BUFFER+j, sizeof(currentId));
-
-            if(currentId != 0){
-                // Non empty row
-                memcpy(WORKBUFFER_A, TABLE_BUFFER+j, rowSize);
-                int check = verifyConditions(WORKBUFFER_A, columns, conditions, rowSize);
-
-                if(check == 1){
-                    
-                    atLeastOneMatch = true;
-                    memcpy(WORKBUFFER_C, WORKBUFFER_A, rowSize);
-                    
-                    // ID will be set by saveRow
-                    memset(WORKBUFFER_C, 0, sizeof(currentId));
-                    saveRow(queryFileId, rowSize, WORKBUFFER_C);
-
-                } else if(check == -1){
-                    Logger::logError("Comparisons not in correct format");
-                    return 0;
-                }
-            }
-        }
+    if(!root){
+        return;
     }
 
-    if(DEBUG == true){
-        std::cout << "At least one match: " << atLeastOneMatch << std::endl;
+    if(!orderFirst){
+        root = planResultOrder(std::move(root), order);
+        if(!root){
+            return;
+        }
     }
 
-    return queryFileId;
-
+    printQuery(*root);
 }
 
-uint64_t handleWhere(uint64_t tableId, const std::vector< std::string >& tokens){
+std::unique_ptr<Operator> handleWhere(std::unique_ptr<Operator> child, const std::vector< std::string >& tokens, bool preserveOrder){
     
     if(DEBUG == true){
         std::cout << "Where clause tokens: ";
@@ -651,13 +448,13 @@ uint64_t handleWhere(uint64_t tableId, const std::vector< std::string >& tokens)
         if(tokens[i] == "and" || tokens[i] == "&&"){
             if(currentCondition.size() == 0){
                 Logger::logError("empty condition found");
-                return 0;
+                return nullptr;
             }
             condition cd = getCondition(currentCondition);
             currentCondition.clear();
             if(cd.operation == COMPARISON::INVALID){
                 Logger::logError("Invalid condition provided");
-                return 0;
+                return nullptr;
             }
             conditions.push_back(cd);
         } else {
@@ -666,20 +463,20 @@ uint64_t handleWhere(uint64_t tableId, const std::vector< std::string >& tokens)
     }
     if(!currentCondition.size()){
         Logger::logError("Empty condition provided");
-        return 0;
+        return nullptr;
     }
     condition cd = getCondition(currentCondition);
     if(cd.operation == COMPARISON::INVALID){
         Logger::logError("Invalid condition provided");
-        return 0;
+        return nullptr;
     }
     conditions.push_back(cd);
 
-    return handleWhereFromConditions(tableId, conditions);
+    return planFilter(std::move(child), conditions, preserveOrder);
 
 }
 
-void Table::handleUpdateTable(const std::vector<std::string>& tokens){
+void Table::handleUpdateTable(ExecutionContext& context, const std::vector<std::string>& tokens){
     if(!Database::isDatabaseChosen()){
         Logger::logError("Database is not selected");
         return;
@@ -688,7 +485,7 @@ void Table::handleUpdateTable(const std::vector<std::string>& tokens){
     std::string tableName = tokens[1];
     uint64_t tableId;
 
-    if(!(tableId = Database::getTableId(tableName))){
+    if(!(tableId = Database::getTableId(context, tableName))){
         Logger::logError("Table with given name does not exist");
         return;
     }
@@ -759,31 +556,31 @@ void Table::handleUpdateTable(const std::vector<std::string>& tokens){
         currentCondition.clear();
     }
 
-    std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(tableName);
+    std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(context, tableName);
     uint32_t rowSize = getRowSize(columns);
     
-    readPage(TABLE_METADATA_PAGE_BUFFER_A, tableId, 0);
+    readPage(context.metadataPage, tableId, 0);
     uint64_t totalPages;
-    memcpy(&totalPages, TABLE_METADATA_PAGE_BUFFER_A + sizeof(totalPages), sizeof(totalPages));
+    memcpy(&totalPages, context.metadataPage + sizeof(totalPages), sizeof(totalPages));
 
     for(uint64_t i=1; i<=totalPages; i++){
-        readPage(CURRENT_TABLE_PAGE_BUFFER_A, tableId, i);
+        readPage(context.tablePage, tableId, i);
         bool pageChanged = false;
 
         for(uint32_t j = 4; j + rowSize - 1 < PAGE_SIZE; j+=rowSize){
             uint64_t currentId;
-            memcpy(&currentId, CURRENT_TABLE_PAGE_BUFFER_A+j, sizeof(currentId));
+            memcpy(&currentId, context.tablePage+j, sizeof(currentId));
             if(currentId != 0){
-                memset(WORKBUFFER_A, 0 , PAGE_SIZE);
-                memcpy(WORKBUFFER_A, CURRENT_TABLE_PAGE_BUFFER_A + j, rowSize);
-                int check = verifyConditions(WORKBUFFER_A, columns, conditions, rowSize);
+                memset(context.workBufferA, 0 , PAGE_SIZE);
+                memcpy(context.workBufferA, context.tablePage + j, rowSize);
+                int check = verifyConditions(context.workBufferA, columns, conditions, rowSize);
                 if(check == 1){
                     //Update row
-                    if(!updateRow(WORKBUFFER_A, assignments, columns)){
+                    if(!updateRow(context.workBufferA, assignments, columns)){
                         Logger::logError("Column name not found or value type mismatch");
                         return;
                     }
-                    memcpy(CURRENT_TABLE_PAGE_BUFFER_A + j, WORKBUFFER_A, rowSize);
+                    memcpy(context.tablePage + j, context.workBufferA, rowSize);
                     pageChanged = true;
                 } else if(check == -1) {
                     Logger::logError("Comparisons not in correct format");
@@ -793,7 +590,7 @@ void Table::handleUpdateTable(const std::vector<std::string>& tokens){
         }
 
         if(pageChanged){
-            if(!writeToPage(CURRENT_TABLE_PAGE_BUFFER_A, tableId, i)){
+            if(!writeToPage(context.tablePage, tableId, i)){
                 Logger::logError("Error in writing changes to disk");
                 return;
             }
@@ -802,14 +599,14 @@ void Table::handleUpdateTable(const std::vector<std::string>& tokens){
     Logger::logSuccess("Successfully updated table");
 }
 
-void Table::handleDeleteRow(const std::vector<std::string>& tokens){
+void Table::handleDeleteRow(ExecutionContext& context, const std::vector<std::string>& tokens){
     if(!Database::isDatabaseChosen()){
         Logger::logError("No database chosen");
         return;
     }
     std::string tableName = tokens[2];
     uint64_t tableId;
-    if((tableId = Database::getTableId(tableName)) == 0){
+    if((tableId = Database::getTableId(context, tableName)) == 0){
         Logger::logError("Table with name "+tableName +" does not exist");
         return;
     }
@@ -845,30 +642,30 @@ void Table::handleDeleteRow(const std::vector<std::string>& tokens){
     conditions.push_back(cd);
     currentCondition.clear();
 
-    std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(tableName);
+    std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(context, tableName);
     uint32_t rowSize = getRowSize(columns);
 
-    readPage(TABLE_METADATA_PAGE_BUFFER_A, tableId, 0);
+    readPage(context.metadataPage, tableId, 0);
     uint64_t totBytes, totalPages;
-    memcpy(&totBytes, TABLE_METADATA_PAGE_BUFFER_A, sizeof(totBytes));
-    memcpy(&totalPages, TABLE_METADATA_PAGE_BUFFER_A + sizeof(totBytes), sizeof(totalPages));
+    memcpy(&totBytes, context.metadataPage, sizeof(totBytes));
+    memcpy(&totalPages, context.metadataPage + sizeof(totBytes), sizeof(totalPages));
 
     for(uint64_t i=1; i<=totalPages; i++){
-        readPage(CURRENT_TABLE_PAGE_BUFFER_A, tableId, i);
+        readPage(context.tablePage, tableId, i);
         bool pageChanged = false;
 
         for(uint32_t j=4; j+rowSize-1<PAGE_SIZE; j+=rowSize){
             uint64_t currentId;
-            memcpy(&currentId, CURRENT_TABLE_PAGE_BUFFER_A+j, sizeof(currentId));
+            memcpy(&currentId, context.tablePage+j, sizeof(currentId));
             if(currentId != 0){
                 // Row not empty
-                memset(WORKBUFFER_A, 0, PAGE_SIZE);
-                memcpy(WORKBUFFER_A, CURRENT_TABLE_PAGE_BUFFER_A+j, rowSize);
-                int check = verifyConditions(WORKBUFFER_A, columns, conditions, rowSize);
+                memset(context.workBufferA, 0, PAGE_SIZE);
+                memcpy(context.workBufferA, context.tablePage+j, rowSize);
+                int check = verifyConditions(context.workBufferA, columns, conditions, rowSize);
                 if(check == 1){
                     //Delete row
-                    memset(WORKBUFFER_A,0,rowSize);
-                    memcpy(CURRENT_TABLE_PAGE_BUFFER_A+j,WORKBUFFER_A,rowSize);
+                    memset(context.workBufferA,0,rowSize);
+                    memcpy(context.tablePage+j,context.workBufferA,rowSize);
                     totBytes -= rowSize;
                     pageChanged = true;
                 } else if(check == -1) {
@@ -879,26 +676,26 @@ void Table::handleDeleteRow(const std::vector<std::string>& tokens){
         }
 
         if(pageChanged){
-            if(!writeToPage(CURRENT_TABLE_PAGE_BUFFER_A, tableId, i)){
+            if(!writeToPage(context.tablePage, tableId, i)){
                 Logger::logError("Error in writing changes to disk");
                 return;
             }
         }
     }
     
-    memcpy(TABLE_METADATA_PAGE_BUFFER_A, &totBytes, sizeof(totBytes));
+    memcpy(context.metadataPage, &totBytes, sizeof(totBytes));
 
-    if(!writeToPage(TABLE_METADATA_PAGE_BUFFER_A, tableId, 0)){
+    if(!writeToPage(context.metadataPage, tableId, 0)){
         Logger::logError("Error in writing back updated metadata");
         return;
     }
 
-    consolidate(tableId, rowSize);
+    consolidate(context, tableId, rowSize);
 
     if(DEBUG == true){
-        readPage(TABLE_METADATA_PAGE_BUFFER_A, tableId, 0);
+        readPage(context.metadataPage, tableId, 0);
         uint64_t totBytesEnd;
-        memcpy(&totBytesEnd, TABLE_METADATA_PAGE_BUFFER_A, sizeof(totBytesEnd));
+        memcpy(&totBytesEnd, context.metadataPage, sizeof(totBytesEnd));
         std::cout << "Tot bytes after delete: " << totBytesEnd << std::endl;
     }
 
@@ -937,100 +734,15 @@ bool updateRow(char BUFFER[], const std::vector< condition >& assignments, const
     return true;
 }
 
-int verifyConditions(const char rowBuffer[], const std::vector< std::vector< std::string > >& columns,const std::vector<condition>& conditions, uint32_t rowSize){
-
-    std::map<std::string, uint32_t> offsets;
-    std::map<std::string, std::string> types;
-    std::map<std::string, uint32_t> sizes;
-
-    uint32_t offset = 8;
-    for(int i=0; i<columns.size(); i++){
-        types[columns[i][0]] = columns[i][1];
-        offsets[columns[i][0]] = offset;
-        uint32_t sz = getTypeSize(columns[i][1]);
-        sizes[columns[i][0]] = sz;
-
-        offset += sz;
-    }
-
-    for(int i=0; i<conditions.size(); i++){
-        if(offsets.find(conditions[i].columnName) == offsets.end()){
-            return -1;
-        }
-        std::string lVal;
-        uint32_t offset = offsets[conditions[i].columnName];
-        std::string type = types[conditions[i].columnName];
-        uint32_t sz = sizes[conditions[i].columnName];
-
-        lVal = getValueFromBytes(rowBuffer, type, offset, offset + sz);
-
-        COMPARISON compResult = getCompResult(lVal ,conditions[i].value, type);
-        if(compResult == COMPARISON::INVALID){
-            return -1;
-        }
-
-        if(!isComparisonValid(conditions[i].operation, compResult)){
-            return 0;
-        }
-    }
-    return 1;
-}
-
-void printQuery(uint64_t fileId, bool atLeastOneMatch){
-
-    std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(fileId);
-    uint32_t rowSize = getRowSize(columns);
-
-    std::cout << Formatter::bold_on;
-    for(int i=0; i < columns.size(); i++){
-        std::cout << std::setw(20) << columns[i][0];
-    }
-    std::cout << Formatter::off << '\n';
-
-    if(!atLeastOneMatch){
-        return;
-    }
-
-    memset(WORKBUFFER_C, 0, PAGE_SIZE);
-    readPage(TABLE_METADATA_PAGE_BUFFER_A, fileId, 0);
-    uint64_t totPages;
-    memcpy(&totPages, TABLE_METADATA_PAGE_BUFFER_A + sizeof(uint64_t), sizeof(totPages));
-
-    uint32_t bytesRead;
-
-    for(uint64_t currentPage = 1; currentPage <= totPages; currentPage++){
-        if((bytesRead = readPage(WORKBUFFER_C, fileId, currentPage)) == 0){
-            Logger::logError("Error in reading from query page");
-            return;
-        }
-
-        for(int i=sizeof(uint32_t); i<bytesRead; i+=rowSize){
-            uint64_t currentId;
-            memcpy(&currentId, WORKBUFFER_C+i, 8);
-            if(currentId){
-                // Row not empty. Process row
-                uint32_t offset = 8;
-                for(int j=0; j<columns.size();j++){
-                    uint32_t sz = getTypeSize(columns[j][1]);
-                    std::string printVal = getValueFromBytes(WORKBUFFER_C, columns[j][1], i + offset, i + offset + sz);
-                    offset += sz;
-                    std::cout << std::setw(20) << printVal ;
-                }
-                std::cout << '\n';
-            }
-        }
-    }
-}
-
-uint32_t loadRowBytes(const std::vector< std::vector< std::string > >& columns, const std::vector< std::string >& columnValues){
-    memset(WORKBUFFER_A, 0, PAGE_SIZE);
+uint32_t loadRowBytes(ExecutionContext& context, const std::vector< std::vector< std::string > >& columns, const std::vector< std::string >& columnValues){
+    memset(context.workBufferA, 0, PAGE_SIZE);
 
     // First 8 bytes are reserved for nextId
     uint32_t ptr = sizeof(uint64_t);
 
     for(int i=0; i<columnValues.size(); i++){
         std::string bytes = getBytesFromValue(columnValues[i], columns[i][1]);
-        memcpy(WORKBUFFER_A + ptr, bytes.c_str(), bytes.length());
+        memcpy(context.workBufferA + ptr, bytes.c_str(), bytes.length());
         ptr+=bytes.length();
 
         if(DEBUG == true){
@@ -1049,61 +761,73 @@ uint32_t loadRowBytes(const std::vector< std::vector< std::string > >& columns,
     return rowSize;
 }
 
-bool saveRow(uint64_t tableId, uint32_t rowSize, char* BUFFER){
+/**
+ * @brief Appends a row to a table. For slotted tables, rowSize is the length of the encoded record in BUFFER
+ */
+bool saveRow(ExecutionContext& context, uint64_t tableId, uint32_t rowSize, char* BUFFER, bool slotted){
     std::string dbName = Database::getCurrentDatabase();
     
-    readPage(TABLE_METADATA_PAGE_BUFFER_C, tableId, 0);
+    readPage(context.writeMetadataPage, tableId, 0);
 
     uint64_t totBytes, totPages, nextId;
-    memcpy(&totBytes, TABLE_METADATA_PAGE_BUFFER_C, sizeof(totBytes));
-    memcpy(&totPages, TABLE_METADATA_PAGE_BUFFER_C + sizeof(totBytes), sizeof(totPages));
-    memcpy(&nextId, TABLE_METADATA_PAGE_BUFFER_C + sizeof(totBytes) + sizeof(totPages), sizeof(nextId));
+    memcpy(&totBytes, context.writeMetadataPage, sizeof(totBytes));
+    memcpy(&totPages, context.writeMetadataPage + sizeof(totBytes), sizeof(totPages));
+    memcpy(&nextId, context.writeMetadataPage + sizeof(totBytes) + sizeof(totPages), sizeof(nextId));
 
     // Add ID to loaded row
     memcpy(BUFFER, &nextId, sizeof(nextId));
 
     // Read last page
-    readPage(CURRENT_TABLE_PAGE_BUFFER_C, tableId, totPages);
+    readPage(context.writeTablePage, tableId, totPages);
 
     uint32_t totPageBytes;
-    memcpy(&totPageBytes, CURRENT_TABLE_PAGE_BUFFER_C, sizeof(totPageBytes));
+    memcpy(&totPageBytes, context.writeTablePage, sizeof(totPageBytes));
 
     if(DEBUG == true){
         std::cout << "Tot Bytes: " << totBytes << " Tot Pages: " << totPages << " Next ID: " << nextId << std::endl;
     }
 
-    if(totPageBytes + rowSize + sizeof(totPageBytes) > PAGE_SIZE){
+    if(slotted){
+        if(insertIntoSlottedPage(context.writeTablePage, BUFFER, rowSize) == -1){
+            // We need a new page
+            memset(context.writeTablePage, 0, PAGE_SIZE);
+            insertIntoSlottedPage(context.writeTablePage, BUFFER, rowSize);
+            totPages++;
+        }
+        nextId++;
+        totBytes += rowSize;
+    } else if(totPageBytes + rowSize + sizeof(totPageBytes) > PAGE_SIZE){
         // We need a new page
         totPageBytes = rowSize;
-        memset(CURRENT_TABLE_PAGE_BUFFER_C, 0, PAGE_SIZE);
-        memcpy(CURRENT_TABLE_PAGE_BUFFER_C, &totPageBytes, sizeof(totPageBytes));
-        memcpy(CURRENT_TABLE_PAGE_BUFFER_C + sizeof(totPageBytes), BUFFER, rowSize);
+        memset(context.writeTablePage, 0, PAGE_SIZE);
+        memcpy(context.writeTablePage, &totPageBytes, sizeof(totPageBytes));
+        memcpy(context.writeTablePage + sizeof(totPageBytes), BUFFER, rowSize);
         totPages++;
         nextId++;
         totBytes += rowSize;
     } else {
         for(int i=sizeof(totPageBytes); i + rowSize - 1<PAGE_SIZE; i+=rowSize){
             uint64_t currentId;
-            memcpy(&currentId, CURRENT_TABLE_PAGE_BUFFER_C+i, sizeof(currentId));
+            memcpy(&currentId, context.writeTablePage+i, sizeof(currentId));
             if(currentId == 0){
                 //Empty position
-                memcpy(CURRENT_TABLE_PAGE_BUFFER_C + i, BUFFER, rowSize);
+                memcpy(context.writeTablePage + i, BUFFER, rowSize);
                 totPageBytes += rowSize;
                 nextId++;
                 totBytes += rowSize;
-                memcpy(CURRENT_TABLE_PAGE_BUFFER_C, &totPageBytes, sizeof(totPageBytes));
+                memcpy(context.writeTablePage, &totPageBytes, sizeof(totPageBytes));
                 break;
             }
         }
     }
 
-    writeToPage(CURRENT_TABLE_PAGE_BUFFER_C, tableId, totPages);
+    writeToPage(context.writeTablePage, tableId, totPages);
 
-    memcpy(TABLE_METADATA_PAGE_BUFFER_C, &totBytes, sizeof(totBytes));
-    memcpy(TABLE_METADATA_PAGE_BUFFER_C + sizeof(totBytes), &totPages, sizeof(totPages));
-    memcpy(TABLE_METADATA_PAGE_BUFFER_C + sizeof(totBytes) + sizeof(totPages), &nextId, sizeof(nextId));
+    memcpy(context.writeMetadataPage, &totBytes, sizeof(totBytes));
+    memcpy(context.writeMetadataPage + sizeof(totBytes), &totPages, sizeof(totPages));
+    memcpy(context.writeMetadataPage + sizeof(totBytes) + sizeof(totPages), &nextId, sizeof(nextId));
 
-    writeToPage(TABLE_METADATA_PAGE_BUFFER_C, tableId, 0);
+    writeToPage(context.writeMetadataPage, tableId, 0);
 
     std::cout << "Tot Bytes in table: " << totBytes << std::endl;
     std::cout << "Tot Pages in Table: " << totPages << std::endl;
@@ -1202,14 +926,6 @@ between 2 and 16 characters (inclusive). Also, the first character cannot be a n
     return std::make_pair(true, tableString+'<');
 }
 
-uint32_t getRowSize(const std::vector< std::vector< std::string > > &columns){
-    uint32_t rowSize = 8; // ID field has 8 bytes
-    for(int i=0;i<columns.size();i++){
-        rowSize += getTypeSize(columns[i][1]);
-    }
-    return rowSize;
-}
-
 bool validateColumnName(const std::string& name){
     if(name.length()<2 || name.length()>16)
         return false;
@@ -1234,39 +950,44 @@ bool validateColumnName(const std::string& name){
  * 2) First 8 bytes stores total number of bytes occupied. Second 8 bytes stores total number of pages allocated so far. Third 8 bytes store next unique ID
  * 2) The rest of the pages store data
  */
-bool saveTableWithId(uint64_t tableId, const std::string& tableString){
+bool saveTableWithId(ExecutionContext& context, uint64_t tableId, const std::string& tableString){
     
-    memset(WORKBUFFER_A,0,PAGE_SIZE+1);
+    memset(context.workBufferA,0,PAGE_SIZE+1);
     uint64_t totBytes = 0;
     uint64_t totPages = 1;
     uint64_t nextId = 1;
 
-    memcpy(WORKBUFFER_A, &totBytes, sizeof(totBytes));
-    memcpy(WORKBUFFER_A + sizeof(totBytes), &totPages, sizeof(totPages));
-    memcpy(WORKBUFFER_A + sizeof(totBytes) + sizeof(totPages), &nextId, sizeof(nextId));
-    strcpy(WORKBUFFER_A + sizeof(totBytes) + sizeof(totPages) + sizeof(nextId), tableString.c_str());
+    memcpy(context.workBufferA, &totBytes, sizeof(totBytes));
+    memcpy(context.workBufferA + sizeof(totBytes), &totPages, sizeof(totPages));
+    memcpy(context.workBufferA + sizeof(totBytes) + sizeof(totPages), &nextId, sizeof(nextId));
+    strcpy(context.workBufferA + sizeof(totBytes) + sizeof(totPages) + sizeof(nextId), tableString.c_str());
+    // Every column ends with $
+    writeTableStats(context.workBufferA, createTableStats(std::count(tableString.begin(), tableString.end(), '$')));
 
-    if(!writeToPage(WORKBUFFER_A, tableId, 0, O_CREAT, S_IRUSR|S_IWUSR)){
+    if(!writeToPage(context.workBufferA, tableId, 0, O_CREAT, S_IRUSR|S_IWUSR)){
         return false;
     }
 
-    memset(WORKBUFFER_A,0,PAGE_SIZE);
-    if(!writeToPage(WORKBUFFER_A, tableId, 1)){
+    memset(context.workBufferA,0,PAGE_SIZE);
+    if(!writeToPage(context.workBufferA, tableId, 1)){
         return false;
     }
 
-    Logger::logSuccess("Successfully created table with ID: "+ std::to_string(tableId));
+    Logger::logSuccess("Successfully created table with ID: "+ std::to_string(Database::getLocalId(tableId)));
 
     return true;
 }
 
-bool saveTableWithName(const std::string& tableName, const std::string &tableString){
+bool saveTableWithName(ExecutionContext& context, const std::string& tableName, const std::string &tableString){
 
     std::string currentDatabase = Database::getCurrentDatabase();
+    uint64_t catalogId = Database::getCatalogId();
 
-    memset(WORKBUFFER_A, 0, PAGE_SIZE);
+    memset(context.workBufferA, 0, PAGE_SIZE);
+    // Sessions looking up tables read the pages being written. The first page is latched while the others are
+    PageLatchGuard latch(catalogId, 0, true);
     //Read table metadata file of database
-    if(!readPage(WORKBUFFER_A, 0, 0)){
+    if(!readPage(context.workBufferA, catalogId, 0)){
         return false;
     }
 
@@ -1278,8 +999,8 @@ bool saveTableWithName(const std::string& tableName, const std::string &tableStr
      */
 
     uint64_t currentTableId, totMetadataPages;
-    memcpy(&currentTableId, WORKBUFFER_A, sizeof(currentTableId));
-    memcpy(&totMetadataPages, WORKBUFFER_A + sizeof(currentTableId), sizeof(totMetadataPages));
+    memcpy(&currentTableId, context.workBufferA, sizeof(currentTableId));
+    memcpy(&totMetadataPages, context.workBufferA + sizeof(currentTableId), sizeof(totMetadataPages));
 
     std::string _tableString = std::to_string(currentTableId) + " " + tableString;
     std::string _tableNameIdString = std::to_string(currentTableId) + " " + tableName + "<";
@@ -1296,19 +1017,23 @@ bool saveTableWithName(const std::string& tableName, const std::string &tableStr
         return false;
     }
 
-    memset(WORKBUFFER_B, 0, PAGE_SIZE);
+    memset(context.workBufferB, 0, PAGE_SIZE);
 
+    // The page of the new table stays latched until its files are written, so that sessions finding it can read them
+    std::unique_ptr<PageLatchGuard> pageLatch;
     bool written = false;
     while(true){
-        if(!readPage(WORKBUFFER_B, 0, totMetadataPages)){
+        pageLatch.reset();
+        pageLatch = std::make_unique<PageLatchGuard>(catalogId, totMetadataPages, true);
+        if(!readPage(context.workBufferB, catalogId, totMetadataPages)){
             return false;
         }
 
         for(int i=0; i<PAGE_SIZE - ((int)_tableNameIdString.length() - 1); i++){
-            if(WORKBUFFER_B[i] == (char)0){
-                strcpy(WORKBUFFER_B + i, _tableNameIdString.c_str());
+            if(context.workBufferB[i] == (char)0){
+                strcpy(context.workBufferB + i, _tableNameIdString.c_str());
                 if(DEBUG == true){
-                    std::cout << "copied at index: " << i << " " << WORKBUFFER_B[i] << std::endl;
+                    std::cout << "copied at index: " << i << " " << context.workBufferB[i] << std::endl;
                 }
                 written = true;
                 break;
@@ -1318,200 +1043,83 @@ bool saveTableWithName(const std::string& tableName, const std::string &tableStr
             break;
         }
         totMetadataPages++;
-        memset(WORKBUFFER_B, 0, PAGE_SIZE);
+        memset(context.workBufferB, 0, PAGE_SIZE);
     }
 
     if(DEBUG == true){
         std::cout << "Page being written to " << totMetadataPages << std::endl;
     }
 
-    if(!writeToPage(WORKBUFFER_B, 0, totMetadataPages)){
+    if(!writeToPage(context.workBufferB, catalogId, totMetadataPages)){
         return false;
     }
 
     uint64_t nextTableId = currentTableId+1;
-    memcpy(WORKBUFFER_A, &nextTableId, sizeof(nextTableId));
-    memcpy(WORKBUFFER_A + sizeof(nextTableId), &totMetadataPages, sizeof(totMetadataPages));
+    memcpy(context.workBufferA, &nextTableId, sizeof(nextTableId));
+    memcpy(context.workBufferA + sizeof(nextTableId), &totMetadataPages, sizeof(totMetadataPages));
 
-    if(!writeToPage(WORKBUFFER_A, 0, 0)){
+    if(!writeToPage(context.workBufferA, catalogId, 0)){
         return false;
     }
 
-    return saveTableWithId(currentTableId, _tableString);
+    return saveTableWithId(context, catalogId | currentTableId, _tableString);
 
 }
 
-void consolidate(uint64_t fileId, uint32_t rowSize){
-    if(fileId == 0 || fileId >= ((uint64_t)1<<LOG_MAX_TABLES)){
+void consolidate(ExecutionContext& context, uint64_t fileId, uint32_t rowSize){
+    uint64_t localId = Database::getLocalId(fileId);
+    if(localId == 0 || localId >= ((uint64_t)1<<LOG_MAX_TABLES)){
         return;
     }
 
-    if(!readPage(TABLE_METADATA_PAGE_BUFFER_A, fileId, 0)){
+    if(!readPage(context.metadataPage, fileId, 0)){
         return;
     }
     uint64_t totBytes, totPages;
-    memcpy(&totBytes, TABLE_METADATA_PAGE_BUFFER_A, sizeof(totBytes));
-    memcpy(&totPages, TABLE_METADATA_PAGE_BUFFER_A + sizeof(totBytes), sizeof(totPages));
+    memcpy(&totBytes, context.metadataPage, sizeof(totBytes));
+    memcpy(&totPages, context.metadataPage + sizeof(totBytes), sizeof(totPages));
     if(totPages <= 2 || totPages*PAGE_SIZE <= 2*totBytes){
         //Consolidate only if relatively large number of pages
         return;
     }
 
-    memset(WORKBUFFER_A, 0, PAGE_SIZE);
+    memset(context.workBufferA, 0, PAGE_SIZE);
     uint64_t p1 = 1;
     uint32_t ptr = sizeof(uint32_t);
     for(int i=1;i<=totPages;i++){
-        readPage(CURRENT_TABLE_PAGE_BUFFER_A, fileId, i);
+        readPage(context.tablePage, fileId, i);
         for(uint32_t j=4; j+rowSize-1 < PAGE_SIZE; j+=rowSize){
             uint64_t currentId;
-            memcpy(&currentId, CURRENT_TABLE_PAGE_BUFFER_A+j, sizeof(currentId));
+            memcpy(&currentId, context.tablePage+j, sizeof(currentId));
             if(currentId){
                 //non empty
-                memcpy(WORKBUFFER_A+ptr, CURRENT_TABLE_PAGE_BUFFER_A+j, rowSize);
+                memcpy(context.workBufferA+ptr, context.tablePage+j, rowSize);
                 ptr+=rowSize;
                 if(ptr + rowSize - 1 >=PAGE_SIZE){
                     uint32_t totBytesOccupied = (ptr-sizeof(uint32_t));
-                    memcpy(WORKBUFFER_A, &totBytesOccupied, sizeof(totBytesOccupied));
+                    memcpy(context.workBufferA, &totBytesOccupied, sizeof(totBytesOccupied));
 
-                    writeToPage(WORKBUFFER_A, fileId, p1);
+                    writeToPage(context.workBufferA, fileId, p1);
                     p1++;
                     ptr = sizeof(uint32_t);
-                    memset(WORKBUFFER_A, 0, PAGE_SIZE);
+                    memset(context.workBufferA, 0, PAGE_SIZE);
                 }
             }
         }
     }
     if(ptr > sizeof(uint32_t) || p1==1){
         uint32_t totBytesOccupied = (ptr-sizeof(totBytesOccupied));
-        memcpy(WORKBUFFER_A, &totBytesOccupied, sizeof(totBytesOccupied));
-        writeToPage(WORKBUFFER_A, fileId, p1);
+        memcpy(context.workBufferA, &totBytesOccupied, sizeof(totBytesOccupied));
+        writeToPage(context.workBufferA, fileId, p1);
         p1++;
-        memset(WORKBUFFER_A, 0, PAGE_SIZE);
+        memset(context.workBufferA, 0, PAGE_SIZE);
     }
     // p1 is the first unused page after consolidation
     if(p1>1){
         p1--;
     }
-    memcpy(TABLE_METADATA_PAGE_BUFFER_A + sizeof(totBytes), &p1, sizeof(p1));
-    writeToPage(TABLE_METADATA_PAGE_BUFFER_A, fileId, 0);
+    memcpy(context.metadataPage + sizeof(totBytes), &p1, sizeof(p1));
+    writeToPage(context.metadataPage, fileId, 0);
     // One page for metadata
     truncateFile(fileId, p1+1);
 }
-
-/**
- * @deprecated
- */
-uint64_t handleSelect(const std::vector<std::string>& tokens){
-    std::string tableName = tokens[3];
-
-    std::vector< std::vector< std::string > > columns = Database::getColumnsOfTable(tableName);
-    uint32_t rowSize = getRowSize(columns);
-
-    std::string dbName = Database::getCurrentDatabase();
-
-    std::vector<condition> conditions;
-
-    if(tokens.size()>4){
-
-        /**
-         * @todo Handle Join Later. Do it in a scalable manner.
-         * @todo Add support for 'as' keyword
-         */
-        
-        if(tokens[4] == "where"){
-            std::vector< std::string > currentCondition;
-            for(int i=5; i<tokens.size(); i++){
-                if(tokens[i] == "and" || tokens[i] == "&&"){
-                    if(currentCondition.size() == 0){
-                        Logger::logError("empty condition found");
-                        return 0;
-                    }
-                    condition cd = getCondition(currentCondition);
-                    currentCondition.clear();
-                    if(cd.operation == COMPARISON::INVALID){
-                        Logger::logError("Invalid condition provided");
-                        return 0;
-                    }
-                    conditions.push_back(cd);
-                } else {
-                    currentCondition.push_back(tokens[i]);
-                }
-            }
-            if(!currentCondition.size()){
-                Logger::logError("Empty condition provided");
-                return 0;
-            }
-            condition cd = getCondition(currentCondition);
-            if(cd.operation == COMPARISON::INVALID){
-                Logger::logError("Invalid condition provided");
-                return 0;
-            }
-            conditions.push_back(cd);
-        } else {
-            Logger::logError("Only where clause supported now");
-            return 0;
-        }
-    }
-
-    universalCounter++;
-    uint64_t queryFileId = ( ( universalCounter % ((uint64_t)1 << LOG_MAX_TABLES) ) + ( (uint64_t)1 << LOG_MAX_TABLES) );
-
-    // Maximum name length is 16
-    std::string queryTableName = getQueryString(queryFileId);
-
-    // Table string for query table
-    std::string queryTableString = std::to_string(queryFileId) + " " + queryTableName + validateAndProcessColumns(columns).second;
-    saveTableWithId(queryFileId, queryTableString);
-
-    memset(WORKBUFFER_B, 0, PAGE_SIZE);
-
-    uint64_t tableId = Database::getTableId(tableName);
-
-    readPage(TABLE_METADATA_PAGE_BUFFER_A, tableId, 0);
-    uint64_t totPages;
-    memcpy(&totPages, TABLE_METADATA_PAGE_BUFFER_A + sizeof(uint64_t), sizeof(totPages));
-
-    bool atLeastOneMatch = false;
-
-
-    for(uint64_t i=1; i<=totPages; i++){
-        memset(CURRENT_TABLE_PAGE_BUFFER_A, 0, PAGE_SIZE);
-        readPage(CURRENT_TABLE_PAGE_BUFFER_A, tableId, i);
-
-        for(uint32_t j=sizeof(uint32_t); j+rowSize-1<PAGE_SIZE; j+=rowSize){
-            uint64_t currentId;
-            memcpy(&currentId, CURRENT_TABLE_PAGE_BUFFER_A+j, sizeof(currentId));
-
-            if(DEBUG == true){
-                std::cout << "CURRENT ID: " << currentId << " " << j << std::endl;
-            }
-
-            if(currentId != 0){
-
-                // Non empty row
-                memcpy(WORKBUFFER_A, CURRENT_TABLE_PAGE_BUFFER_A+j, rowSize);
-                int check = verifyConditions(WORKBUFFER_A, columns, conditions, rowSize);
-
-                if(check == 1){
-
-                    atLeastOneMatch = true;
-                    memcpy(WORKBUFFER_C, WORKBUFFER_A, rowSize);
-                    
-                    // ID will be set by saveRow
-                    memset(WORKBUFFER_C, 0, sizeof(currentId));
-                    saveRow(queryFileId, rowSize, WORKBUFFER_C);
-
-                } else if(check == -1){
-                    Logger::logError("Comparisons not in correct format");
-                    return 0;
-                }
-            }
-        }
-    }
-
-    if(DEBUG == true){
-        std::cout << "At least one match: " << atLeastOneMatch << std::endl;
-    }
-
-    return queryFileId;
-}
\ No newline at end of file
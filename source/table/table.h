@@ -8,6 +8,7 @@
 #include "../condition/condition.h"
 #include "../database/database.h"
 #include "../properties.h"
+#include "../context/context.h"
 
 // enum class COMPARISON {
 //     EQUAL,
@@ -30,13 +31,13 @@
 
 class Table {
 public:
-    static void createTable(const std::vector<std::string>& tokens);
-    static void insertIntoTable(const std::vector<std::string>& tokens);
+    static void createTable(ExecutionContext& context, const std::vector<std::string>& tokens);
+    static void insertIntoTable(ExecutionContext& context, const std::vector<std::string>& tokens);
 
-    static void handleSearchQuery(const std::vector<std::string>& tokens);
+    static void handleSearchQuery(ExecutionContext& context, const std::vector<std::string>& tokens);
     
-    static void handleUpdateTable(const std::vector<std::string>& tokens);
-    static void handleDeleteRow(const std::vector<std::string>& tokens);
+    static void handleUpdateTable(ExecutionContext& context, const std::vector<std::string>& tokens);
+    static void handleDeleteRow(ExecutionContext& context, const std::vector<std::string>& tokens);
 };
 
 #endif // TABLE_H
\ No newline at end of file
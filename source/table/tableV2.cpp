@@ -1,6 +1,12 @@
 #include "tableV2.h"
+#include "../ingest/ingest.h"
 #include "../buffers/buffers.h"
+#include "../context/context.h"
 #include "../type/type.h"
+#include "../page/page.h"
+#include "../parallel/parallel.h"
+#include "../lock/lock.h"
+#include "../mvcc/mvcc.h"
 #include <stdlib.h>
 #include <utility>
 #include <string>
@@ -12,15 +18,18 @@ bool TableV2::operator==(int x){
     return (mId == x);
 }
 
-TableV2::TableV2(std::string tableName){
+TableV2::TableV2(ExecutionContext& context, std::string tableName){
     mName = tableName;
-    mId = Database::getTableId(tableName);
+    mId = Database::getTableId(context, tableName);
+    metadataBuffer = context.metadataPage;
+    currentPageBuffer = context.tablePage;
+    mTransaction = context.transaction;
+    mSnapshot = &context.snapshot;
+    mAutocommit = context.autocommit;
 
     if(mId){
-        metadataBuffer = (char *)calloc(PAGE_SIZE+1, sizeof(char));
-        currentPageBuffer = (char *)calloc(PAGE_SIZE+1, sizeof(char));
 
-        readPage(metadataBuffer, mId, 0);
+        readVisiblePage(metadataBuffer, mId, 0, mSnapshot);
         memcpy(&mTotBytes, metadataBuffer, sizeof(mTotBytes));
         memcpy(&mTotPages, metadataBuffer + sizeof(mTotBytes), sizeof(mTotPages));
         memcpy(&mNextId, metadataBuffer + sizeof(mTotBytes) + sizeof(mTotPages), sizeof(mNextId));
@@ -66,7 +75,10 @@ TableV2::TableV2(std::string tableName){
                 mRowSize = 8;
                 for(int i=0; i<mColumns.size();i++){
                     mRowSize += getTypeSize(columns[i][1]);
+                    mColumnIndex[mColumns[i][0]] = i;
                 }
+                mSlotted = isVariableLength(mColumns);
+                mHasStats = readTableStats(metadataBuffer, mStats) && mStats.columns.size() == mColumns.size();
 
                 break;
             } else if(metadataBuffer[i] == ' '){
@@ -84,16 +96,9 @@ TableV2::TableV2(std::string tableName){
     }
 }
 
-TableV2::~TableV2(){
-    if(mId != 0){
-        free(metadataBuffer);
-        free(currentPageBuffer);
-    }
-}
-
 bool TableV2::loadPage(uint64_t pageIndex){
     mCurrentPage = pageIndex;
-    return readPage(currentPageBuffer, mId, pageIndex);
+    return readVisiblePage(currentPageBuffer, mId, pageIndex, mSnapshot);
 }
 
 bool TableV2::loadLastPage(){
@@ -102,7 +107,7 @@ bool TableV2::loadLastPage(){
     }
     
     mCurrentPage = mTotPages;
-    return readPage(currentPageBuffer, mId, mTotPages);
+    return TransactionManager::getManager().readPage(*mTransaction, currentPageBuffer, mId, mTotPages);
 }
 
 bool TableV2::loadFirstPage(){
@@ -111,7 +116,7 @@ bool TableV2::loadFirstPage(){
     }
 
     mCurrentPage = 1;
-    return readPage(currentPageBuffer, mId, 1);
+    return TransactionManager::getManager().readPage(*mTransaction, currentPageBuffer, mId, 1);
 }
 
 bool TableV2::loadNextPage(){
@@ -123,18 +128,282 @@ bool TableV2::loadNextPage(){
         memset(currentPageBuffer, 0, PAGE_SIZE);
         return true;
     }
-    if(readPage(currentPageBuffer, mId, mTotPages)){
+    if(TransactionManager::getManager().readPage(*mTransaction, currentPageBuffer, mId, mTotPages)){
         return true;
     }
     return false;
 }
 
-bool TableV2::insert(const std::vector< std::string >& tokens){
+
+bool TableV2::matchesConditions(const char row[], const std::vector< condition >& conditions){
+    std::vector< uint32_t > offsets = getColumnOffsets(row, mColumns);
+
+    for(int k=0;k<conditions.size();k++){
+        uint32_t index = mColumnIndex.at(conditions[k].columnName);
+        std::string type = mColumns[index][1];
+        std::string lVal = getValueFromBytes(row, type, offsets[index], offsets[index+1]);
+
+        COMPARISON compResult = getCompResult(lVal, conditions[k].value, type);
+        if(!isComparisonValid(conditions[k].operation, compResult)){
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string TableV2::applyAssignments(const std::string& row, const std::vector< std::pair< std::string, std::string > >& assignments){
+    std::vector< uint32_t > offsets = getColumnOffsets(row.c_str(), mColumns);
+    std::vector< std::string > values(mColumns.size());
+
+    for(int k=0; k<assignments.size(); k++){
+        uint32_t index = mColumnIndex.at(assignments[k].first);
+        values[index] = getBytesFromValue(assignments[k].second, mColumns[index][1]);
+    }
+
+    // Rebuild the row since varchar columns may change in length
+    std::string updatedRow = row.substr(0, sizeof(uint64_t));
+    for(int i=0; i<mColumns.size(); i++){
+        if(values[i].length()){
+            updatedRow += values[i];
+        } else {
+            updatedRow.append(row, offsets[i], offsets[i+1] - offsets[i]);
+        }
+    }
+    return updatedRow;
+}
+
+bool TableV2::appendRecord(const std::string& record, uint64_t& writer){
+    // The metadata page is latched by the caller, so no other session appends at the same time.
+    // Updates and deletes of other sessions may be changing the last page
+    TransactionManager& manager = TransactionManager::getManager();
+    PageLatchGuard latch(mId, mTotPages, true);
+    writer = manager.getWriter(*mTransaction, mId, mTotPages);
+    if(writer){
+        return true;
+    }
     if(!loadLastPage()){
         return false;
     }
-    uint32_t totBytesInPage;
-    memcpy(&totBytesInPage, currentPageBuffer, sizeof(totBytesInPage));
+    manager.addVersion(*mTransaction, mId, mCurrentPage, currentPageBuffer);
+
+    // A new page is only read by others once the transaction committed the metadata counting it
+    std::unique_ptr<PageLatchGuard> newPageLatch;
+    auto addPage = [&](){
+        newPageLatch = std::make_unique<PageLatchGuard>(mId, mTotPages + 1, true);
+        loadNextPage();
+        manager.addVersion(*mTransaction, mId, mCurrentPage, currentPageBuffer);
+        mTotPages++;
+    };
+
+    if(mSlotted){
+        if(insertIntoSlottedPage(currentPageBuffer, record.c_str(), record.length()) == -1){
+            // Last page is full. We need a new page.
+            addPage();
+            insertIntoSlottedPage(currentPageBuffer, record.c_str(), record.length());
+        }
+        mTotBytes += record.length();
+    } else {
+        uint32_t totBytesInPage;
+        memcpy(&totBytesInPage, currentPageBuffer, sizeof(totBytesInPage));
+
+        if(sizeof(uint32_t) + totBytesInPage + mRowSize > PAGE_SIZE){
+            // Last page is full. We need a new page.
+            addPage();
+            totBytesInPage = 0;
+        }
+
+        for(int i=sizeof(totBytesInPage); i<PAGE_SIZE; i+=mRowSize){
+            uint64_t currentRowId;
+            memcpy(&currentRowId, currentPageBuffer + i, sizeof(currentRowId));
+            if(!currentRowId){
+                // empty row found
+
+                totBytesInPage += mRowSize;
+                memcpy(currentPageBuffer + i, record.c_str(), record.length());
+                memcpy(currentPageBuffer, &totBytesInPage, sizeof(totBytesInPage));
+                mTotBytes += mRowSize;
+                break;
+            }
+        }
+    }
+
+    if(!manager.writePage(*mTransaction, currentPageBuffer, mId, mCurrentPage)){
+        if(DEBUG == true){
+            std::cout << "Unable to write to table" << std::endl;    
+        }
+        return false;
+    }
+    return true;
+}
+
+bool TableV2::saveMetadata(){
+    // The metadata page is latched by the caller. Readers keep seeing the counters and statistics
+    // of their snapshot until the transaction commits
+    TransactionManager& manager = TransactionManager::getManager();
+    std::unique_ptr<char[]> pageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+    if(!readPage(pageBuffer.get(), mId, 0)){
+        return false;
+    }
+    manager.addVersion(*mTransaction, mId, 0, pageBuffer.get());
+
+    memcpy(metadataBuffer, &mTotBytes, sizeof(mTotBytes));
+    memcpy(metadataBuffer + sizeof(mTotBytes), &mTotPages, sizeof(mTotPages));
+    memcpy(metadataBuffer + sizeof(mTotBytes) + sizeof(mTotPages), &mNextId, sizeof(mNextId));
+    if(mHasStats){
+        writeTableStats(metadataBuffer, mStats);
+    }
+
+    return manager.writePage(*mTransaction, metadataBuffer, mId, 0);
+}
+
+bool TableV2::loadMetadata(){
+    if(!TransactionManager::getManager().readPage(*mTransaction, metadataBuffer, mId, 0)){
+        return false;
+    }
+    memcpy(&mTotBytes, metadataBuffer, sizeof(mTotBytes));
+    memcpy(&mTotPages, metadataBuffer + sizeof(mTotBytes), sizeof(mTotPages));
+    memcpy(&mNextId, metadataBuffer + sizeof(mTotBytes) + sizeof(mTotPages), sizeof(mNextId));
+    mHasStats = readTableStats(metadataBuffer, mStats) && mStats.columns.size() == mColumns.size();
+    return true;
+}
+
+bool TableV2::latchMetadata(std::unique_ptr<PageLatchGuard>& latch){
+    TransactionManager& manager = TransactionManager::getManager();
+    while(true){
+        latch = std::make_unique<PageLatchGuard>(mId, 0, true);
+        uint64_t writer = manager.getWriter(*mTransaction, mId, 0);
+        if(!writer){
+            return loadMetadata();
+        }
+        latch.reset();
+        if(!manager.waitForWriter(*mTransaction, mId, 0, writer)){
+            return false;
+        }
+    }
+}
+
+bool TableV2::forEachPage(const std::function< bool(char PAGE[], uint64_t pageNumber, uint32_t worker) >& work){
+    WorkerPool& pool = WorkerPool::getPool();
+    TransactionManager& manager = TransactionManager::getManager();
+    bool parallel = mTotPages >= PARALLEL_SCAN_MIN_PAGES && pool.getWorkerCount() > 1;
+    uint64_t morselPages = parallel ? MORSEL_PAGES : std::max(mTotPages, (uint64_t)1);
+    uint64_t morsels = (mTotPages + morselPages - 1) / morselPages;
+    // Set once a worker found the statement has to run again (see TransactionManager::waitForWriter), so the others stop
+    std::atomic<bool> lost(false);
+
+    auto runMorsel = [&](uint64_t morsel, uint32_t worker){
+        std::unique_ptr<char[]> pageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+        std::unique_ptr<char[]> imageBuffer = std::make_unique<char[]>(PAGE_SIZE + 1);
+        uint64_t lastPage = std::min(mTotPages, (morsel + 1)*morselPages);
+        for(uint64_t i = morsel*morselPages + 1; i <= lastPage && !lost; i++){
+            while(true){
+                uint64_t writer;
+                bool committed = false;
+                {
+                    PageLatchGuard latch(mId, i, true);
+                    writer = manager.getWriter(*mTransaction, mId, i);
+                    if(!writer){
+                        manager.readPage(*mTransaction, pageBuffer.get(), mId, i);
+                        memcpy(imageBuffer.get(), pageBuffer.get(), PAGE_SIZE);
+                        manager.applyVersions(pageBuffer.get(), mId, i, *mSnapshot);
+                        if(!work(pageBuffer.get(), i, worker)){
+                            break;
+                        }
+                        // Rows matched at the snapshot may have been changed by a writer committed since
+                        writer = manager.getWriter(*mTransaction, mId, i, mSnapshot);
+                        if(!writer){
+                            manager.addVersion(*mTransaction, mId, i, imageBuffer.get(), mSnapshot);
+                            if(!manager.writePage(*mTransaction, pageBuffer.get(), mId, i)){
+                                if(DEBUG == true){
+                                    std::cout << "Error in writing to page" << std::endl;
+                                }
+                                return false;
+                            }
+                            break;
+                        }
+                        committed = true;
+                    }
+                }
+                // The page is run once the writer released it, and matched again at the snapshot
+                if(!manager.waitForWriter(*mTransaction, mId, i, writer, committed)){
+                    lost = true;
+                    return false;
+                }
+            }
+        }
+        return !lost;
+    };
+    if(parallel){
+        return pool.parallelFor(morsels, runMorsel);
+    }
+    for(uint64_t i=0; i<morsels; i++){
+        if(!runMorsel(i, 0)){
+            return false;
+        }
+    }
+    return true;
+}
+
+void TableV2::prepareStats(){
+    if(mHasStats || mId == 0){
+        return;
+    }
+
+    // The statistics go after the table string, which ends with <
+    uint32_t statsStart = PAGE_SIZE - getStatsSize(mColumns.size());
+    const char* tableStringEnd = (const char*)memchr(metadataBuffer + 3*sizeof(uint64_t), '<', PAGE_SIZE - 3*sizeof(uint64_t));
+    if(!tableStringEnd || tableStringEnd - metadataBuffer >= statsStart){
+        return;
+    }
+    for(uint32_t i=statsStart; i<PAGE_SIZE; i++){
+        if(metadataBuffer[i]){
+            return;
+        }
+    }
+
+    TransactionManager& manager = TransactionManager::getManager();
+    mStats = createTableStats(mColumns.size());
+    for(uint64_t i=1; i <= mTotPages; i++){
+        // The statistics are saved for every session. Rows changed since the snapshot would be missed,
+        // so they are left to a later change then
+        if(manager.getWriter(*mTransaction, mId, i, mSnapshot) || !loadPage(i)){
+            return;
+        }
+        std::vector< std::pair< uint32_t, uint32_t > > rows = getRowsOfPage(currentPageBuffer, mRowSize, mSlotted);
+        for(int j=0; j<rows.size(); j++){
+            if(mSlotted){
+                std::string row = decodeRow(mId, currentPageBuffer + rows[j].first, rows[j].second, mColumns);
+                addRowToStats(mStats, row.c_str(), mColumns);
+            } else {
+                addRowToStats(mStats, currentPageBuffer + rows[j].first, mColumns);
+            }
+        }
+    }
+    mHasStats = true;
+
+    if(DEBUG == true){
+        std::cout << "Collected statistics of table " << mName << ". Rows: " << mStats.rowCount << std::endl;
+    }
+}
+
+bool TableV2::prepareChange(){
+    std::unique_ptr<PageLatchGuard> metadataLatch;
+    if(!latchMetadata(metadataLatch)){
+        return false;
+    }
+    if(mHasStats){
+        return true;
+    }
+
+    // Statistics collected now are saved, since the metadata is read again once the rows changed
+    prepareStats();
+    return !mHasStats || saveMetadata();
+}
+
+bool TableV2::insert(const std::vector< std::string >& tokens){
+    if(mId == 0){
+        return false;
+    }
 
     // validate insert info
     if(tokens.size() != mColumns.size()){
@@ -144,13 +413,12 @@ bool TableV2::insert(const std::vector< std::string >& tokens){
         return false;
     }
 
-    std::string rowBytes;
+    TableLocks locks;
+    locks.add(mId, LOCK_MODE::INTENTION_EXCLUSIVE);
+    locks.lock();
 
-    char idBytes[sizeof(uint64_t)];
-    memcpy(idBytes, &mNextId, sizeof(uint64_t));
-    for(int i=0; i < sizeof(uint64_t); i++){
-        rowBytes += idBytes[i];
-    }
+    // The ID is set once the metadata page is latched
+    std::string rowBytes(sizeof(uint64_t), '\0');
 
     for(int i=0; i<tokens.size(); i++){
         if(!matchType(tokens[i], mColumns[i][1])){
@@ -162,41 +430,75 @@ bool TableV2::insert(const std::vector< std::string >& tokens){
         rowBytes += getBytesFromValue(tokens[i], mColumns[i][1]);
     }
 
-    if(rowBytes.length() != mRowSize){
+    if(!mSlotted && rowBytes.length() != mRowSize){
         if(DEBUG == true){
             std::cout << "row size doesn't match" << std::endl;
         }
         return false;
     }
 
-    if(sizeof(uint32_t) + totBytesInPage + mRowSize > PAGE_SIZE){
-        // Last page is full. We need a new page.
-        loadNextPage();
-        totBytesInPage = 0;
-        mTotPages++;
+    TransactionManager& manager = TransactionManager::getManager();
+    std::string record;
+    {
+        PageLatchGuard overflowLatch(mId | OVERFLOW_FILE_FLAG, 0, true);
+        record = encodeRow(mId, rowBytes, mColumns);
+    }
+    // Chains of rows of a failed batch are freed when the statement rolls back
+    manager.addWrittenChains(*mTransaction, mId, getRowOverflowChains(record.c_str(), mColumns));
+
+    std::vector< std::string > records(1, record);
+    std::vector< std::string > rows(1, rowBytes);
+    auto appendAlone = [&](){
+        return appendRecords(records, rows);
+    };
+
+    // Rows of a transaction opened by begin have to roll back with it, so they aren't appended with other sessions' rows
+    if(mAutocommit && InsertBatches::fits(record, rowBytes)){
+        return InsertBatches::getManager().insert(mId, record, rowBytes, appendAlone, [&](std::vector< std::string >& batchRecords, const std::vector< std::string >& batchRows){
+            return appendBatch(batchRecords, batchRows);
+        });
     }
+    return appendAlone();
+}
 
-    for(int i=sizeof(totBytesInPage); i<PAGE_SIZE; i+=mRowSize){
-        uint64_t currentRowId;
-        memcpy(&currentRowId, currentPageBuffer + i, sizeof(currentRowId));
-        if(!currentRowId){
-            // empty row found
+bool TableV2::appendRecords(std::vector< std::string >& records, const std::vector< std::string >& rows){
+    TransactionManager& manager = TransactionManager::getManager();
 
-            totBytesInPage += mRowSize;
-            memcpy(currentPageBuffer + i, rowBytes.c_str(), rowBytes.length());
-            memcpy(currentPageBuffer, &totBytesInPage, sizeof(totBytesInPage));
-            mNextId++;
-            mTotBytes += mRowSize;
-            break;
+    // Inserts of a table take turns on its metadata page, which holds the next ID and the last page
+    std::unique_ptr<PageLatchGuard> metadataLatch;
+    if(!latchMetadata(metadataLatch)){
+        return false;
+    }
+    prepareStats();
+    for(int i=0; i<records.size(); i++){
+        while(true){
+            memcpy(&records[i][0], &mNextId, sizeof(mNextId));
+
+            uint64_t writer;
+            if(!appendRecord(records[i], writer)){
+                return false;
+            }
+            if(!writer){
+                break;
+            }
+            // The counters of the records appended so far are kept in the metadata page while waiting
+            if(i && !saveMetadata()){
+                return false;
+            }
+            metadataLatch.reset();
+            if(!manager.waitForWriter(*mTransaction, mId, mTotPages, writer) || !latchMetadata(metadataLatch)){
+                return false;
+            }
+            prepareStats();
+        }
+        mNextId++;
+        if(mHasStats){
+            addRowToStats(mStats, rows[i].c_str(), mColumns);
         }
     }
 
     // Update Metadata
-    memcpy(metadataBuffer, &mTotBytes, sizeof(mTotBytes));
-    memcpy(metadataBuffer + sizeof(mTotBytes), &mTotPages, sizeof(mTotPages));
-    memcpy(metadataBuffer + sizeof(mTotBytes) + sizeof(mTotPages), &mNextId, sizeof(mNextId));
-
-    if(!writeToPage(currentPageBuffer, mId, mCurrentPage) || !writeToPage(metadataBuffer, mId, 0)){
+    if(!saveMetadata()){
         if(DEBUG == true){
             std::cout << "Unable to write to table" << std::endl;    
         }
@@ -206,26 +508,30 @@ bool TableV2::insert(const std::vector< std::string >& tokens){
     return true;
 }
 
-bool TableV2::update(std::vector< std::pair< std::string, std::string > >& assignments, std::vector< condition >& conditions){
-    std::map< std::string, uint32_t > offsets;
-    std::map< std::string, uint32_t > sizes;
-    std::map< std::string, std::string > types;
-    
-    // Offset of ID
-    uint32_t currentOffset = sizeof(uint64_t);
+bool TableV2::appendBatch(std::vector< std::string >& records, const std::vector< std::string >& rows){
+    TransactionManager& manager = TransactionManager::getManager();
+    Transaction* statementTransaction = mTransaction;
+    Transaction batchTransaction;
+    manager.begin(batchTransaction);
+    mTransaction = &batchTransaction;
+
+    bool appended = manager.retryOnConflict(batchTransaction, [&](){ return appendRecords(records, rows); });
+    mTransaction = statementTransaction;
+    if(!appended){
+        manager.rollback(batchTransaction);
+        return false;
+    }
+    return manager.commit(batchTransaction);
+}
 
+bool TableV2::update(std::vector< std::pair< std::string, std::string > >& assignments, std::vector< condition >& conditions){
     for(int i=0;i<mColumns.size();i++){
-        uint32_t sz = getTypeSize(mColumns[i][1]);
-        if(sz == 0){
+        if(getTypeSize(mColumns[i][1]) == 0){
             if(DEBUG == true){
                 std::cout << "Size is zero" << std::endl;
             }
             return false;
         }
-        offsets[mColumns[i][0]] = currentOffset;
-        sizes[mColumns[i][0]] = sz;
-        types[mColumns[i][0]] = mColumns[i][1];
-        currentOffset += sz;
     }
 
     std::sort(assignments.begin(), assignments.end());
@@ -233,8 +539,8 @@ bool TableV2::update(std::vector< std::pair< std::string, std::string > >& assig
     // validating assignments
     for(int i=0; i<assignments.size(); i++){
         // If column does not exist or type is incorrect or multiple values are assigned
-        if(offsets.find(assignments[i].first) == offsets.end()
-            || !matchType(assignments[i].second, types[assignments[i].first])
+        if(mColumnIndex.find(assignments[i].first) == mColumnIndex.end()
+            || !matchType(assignments[i].second, mColumns[mColumnIndex[assignments[i].first]][1])
             || (i>0 && assignments[i].first == assignments[i-1].first)
         ){
             if(DEBUG == true){
@@ -246,8 +552,8 @@ bool TableV2::update(std::vector< std::pair< std::string, std::string > >& assig
 
     // validating conditions
     for(int i=0; i<conditions.size(); i++){
-        if(offsets.find(conditions[i].columnName) == offsets.end()
-             || !matchType(conditions[i].value, types[conditions[i].columnName])
+        if(mColumnIndex.find(conditions[i].columnName) == mColumnIndex.end()
+             || !matchType(conditions[i].value, mColumns[mColumnIndex[conditions[i].columnName]][1])
              || conditions[i].operation == COMPARISON::INVALID
         ){
             if(DEBUG == true){
@@ -257,64 +563,127 @@ bool TableV2::update(std::vector< std::pair< std::string, std::string > >& assig
         }
     }
 
-    for(int i=1; i <= mTotPages; i++){
-        loadPage(i);
+    TableLocks locks;
+    locks.add(mId, LOCK_MODE::INTENTION_EXCLUSIVE);
+    locks.lock();
+
+    if(!prepareChange()){
+        return false;
+    }
+
+    // Records that outgrew their page, with the page they were on. They are appended after the scan.
+    TransactionManager& manager = TransactionManager::getManager();
+    uint32_t workers = WorkerPool::getPool().getWorkerCount();
+    std::vector< std::vector< std::pair< uint64_t, std::string > > > workerMovedRecords(workers);
+    std::vector< uint64_t > workerUpdatedRows(workers, 0);
+    std::vector< int64_t > workerBytes(workers, 0);
 
+    bool written = forEachPage([&](char PAGE[], uint64_t pageNumber, uint32_t worker){
         bool atLeastOneMatched = false;
 
-        for(int j=sizeof(uint32_t); j+mRowSize-1<PAGE_SIZE; j+=mRowSize){
-            uint64_t currentRowId;
-            memcpy(&currentRowId, currentPageBuffer + j, sizeof(currentRowId));
-
-            if(currentRowId){
-                // non empty row
-                std::unique_ptr<char[]> rowBuffer = std::make_unique<char[]>(mRowSize + 1);
-                memcpy(rowBuffer.get(), currentPageBuffer + j, mRowSize);
-
-                bool matched = true;
-
-                // verify conditions
-                for(int k=0;k<conditions.size();k++){
-                    std::string cName = conditions[k].columnName;
-                    std::string val = conditions[k].value;
-                    COMPARISON comp = conditions[k].operation;
-                    
-                    uint32_t offset = offsets[cName];
-                    uint32_t sz = sizes[cName];
-                    std::string lVal = getValueFromBytes(rowBuffer.get(), types[cName], offset, offset+sz);
-
-                    COMPARISON compResult = getCompResult(lVal, val, types[cName]);
-                    if(!isComparisonValid(comp, compResult)){
-                        matched = false;
-                        break;
-                    }
+        if(mSlotted){
+            // Growing records may compact the page, which drops trailing empty slots. Their entries can then hold records
+            for(uint16_t slot=0; slot<getSlotCount(PAGE); slot++){
+                uint16_t offset, length;
+                getSlot(PAGE, slot, offset, length);
+                if(offset == 0){
+                    continue;
                 }
 
-                if(matched){
-                    atLeastOneMatched = true;
-
-                    // If the row satisfies conditions
-                    for(int k=0; k<assignments.size(); k++){
-                        std::string cName = assignments[k].first;
-                        std::string bytes = getBytesFromValue(assignments[k].second, types[cName]);
-                        uint32_t offset = offsets[cName];
-                        uint32_t sz = sizes[cName];
-                        
-                        memcpy(rowBuffer.get() + offset, bytes.c_str(), sz);
-                    }
-                    memcpy(currentPageBuffer + j, rowBuffer.get(), mRowSize);
+                std::string row = decodeRow(mId, PAGE + offset, length, mColumns);
+                if(!matchesConditions(row.c_str(), conditions)){
+                    continue;
+                }
+                atLeastOneMatched = true;
+                workerUpdatedRows[worker]++;
+
+                // Older snapshots may still read the replaced values, so their chains are freed later
+                manager.addReleasedChains(*mTransaction, mId, getRowOverflowChains(PAGE + offset, mColumns));
+                std::string record;
+                {
+                    PageLatchGuard overflowLatch(mId | OVERFLOW_FILE_FLAG, 0, true);
+                    record = encodeRow(mId, applyAssignments(row, assignments), mColumns);
                 }
+                manager.addWrittenChains(*mTransaction, mId, getRowOverflowChains(record.c_str(), mColumns));
+
+                workerBytes[worker] -= length;
+                if(updateSlottedPage(PAGE, slot, record.c_str(), record.length())){
+                    workerBytes[worker] += record.length();
+                } else {
+                    deleteFromSlottedPage(PAGE, slot);
+                    workerMovedRecords[worker].push_back({pageNumber, record});
+                }
+            }
+        } else {
+            std::vector< std::pair< uint32_t, uint32_t > > rows = getRowsOfPage(PAGE, mRowSize, false);
+            for(int j=0; j<rows.size(); j++){
+                char* row = PAGE + rows[j].first;
 
+                // If the row satisfies conditions
+                if(matchesConditions(row, conditions)){
+                    atLeastOneMatched = true;
+                    workerUpdatedRows[worker]++;
+                    std::string updatedRow = applyAssignments(std::string(row, mRowSize), assignments);
+                    memcpy(row, updatedRow.c_str(), mRowSize);
+                }
             }
         }
-        if(atLeastOneMatched){
-            if(!writeToPage(currentPageBuffer, mId, mCurrentPage)){
-                if(DEBUG == true){
-                    std::cout << "Error in writing to page" << std::endl;
-                }
+        return atLeastOneMatched;
+    });
+    if(!written){
+        return false;
+    }
+
+    // Moved records are appended in the order of their pages, as a serial scan would
+    std::vector< std::pair< uint64_t, std::string > > movedRecords;
+    uint64_t updatedRows = 0;
+    int64_t changedBytes = 0;
+    for(uint32_t i=0; i<workers; i++){
+        movedRecords.insert(movedRecords.end(), workerMovedRecords[i].begin(), workerMovedRecords[i].end());
+        updatedRows += workerUpdatedRows[i];
+        changedBytes += workerBytes[i];
+    }
+    std::stable_sort(movedRecords.begin(), movedRecords.end(), [](const std::pair< uint64_t, std::string >& lRecord, const std::pair< uint64_t, std::string >& rRecord){
+        return lRecord.first < rRecord.first;
+    });
+
+    // Other sessions may have inserted since the scan started, so the counters are read again before they change
+    std::unique_ptr<PageLatchGuard> metadataLatch;
+    while(true){
+        if(!latchMetadata(metadataLatch)){
+            return false;
+        }
+        mTotBytes += changedBytes;
+
+        // Only the first record can find the last page changed by another writer. The next ones go
+        // to the same page or to new ones, so nothing was appended when it does
+        uint64_t writer = 0;
+        for(int i=0; i<movedRecords.size() && !writer; i++){
+            if(!appendRecord(movedRecords[i].second, writer)){
                 return false;
             }
         }
+        if(!writer){
+            break;
+        }
+        metadataLatch.reset();
+        if(!manager.waitForWriter(*mTransaction, mId, mTotPages, writer)){
+            return false;
+        }
+    }
+
+    // Assigned values widen the bounds. The replaced ones may have been the min or max
+    if(mHasStats && updatedRows){
+        for(int i=0; i<assignments.size(); i++){
+            uint32_t index = mColumnIndex[assignments[i].first];
+            std::string value = getBytesFromValue(assignments[i].second, mColumns[index][1]);
+            addValueToStats(mStats.columns[index], value.c_str(), mColumns[index][1]);
+            mStats.columns[index].exactBounds = false;
+        }
+    }
+
+    if(mSlotted || (mHasStats && updatedRows)){
+        return saveMetadata();
     }
 
     return true;
@@ -322,31 +691,19 @@ bool TableV2::update(std::vector< std::pair< std::string, std::string > >& assig
 }
 
 bool TableV2::deleteRow(const std::vector< condition >& conditions){
-    std::map< std::string, uint32_t > offsets;
-    std::map< std::string, uint32_t > sizes;
-    std::map< std::string, std::string > types;
-    
-    // Offset of ID
-    uint32_t currentOffset = sizeof(uint64_t);
-
     for(int i=0;i<mColumns.size();i++){
-        uint32_t sz = getTypeSize(mColumns[i][1]);
-        if(sz == 0){
+        if(getTypeSize(mColumns[i][1]) == 0){
             if(DEBUG == true){
                 std::cout << "Size is zero" << std::endl;
             }
             return false;
         }
-        offsets[mColumns[i][0]] = currentOffset;
-        sizes[mColumns[i][0]] = sz;
-        types[mColumns[i][0]] = mColumns[i][1];
-        currentOffset += sz;
     }
 
     // validating conditions
     for(int i=0; i<conditions.size(); i++){
-        if(offsets.find(conditions[i].columnName) == offsets.end()
-             || !matchType(conditions[i].value, types[conditions[i].columnName])
+        if(mColumnIndex.find(conditions[i].columnName) == mColumnIndex.end()
+             || !matchType(conditions[i].value, mColumns[mColumnIndex[conditions[i].columnName]][1])
              || conditions[i].operation == COMPARISON::INVALID
         ){
             if(DEBUG == true){
@@ -356,61 +713,77 @@ bool TableV2::deleteRow(const std::vector< condition >& conditions){
         }
     }
 
-    for(int i=1; i <= mTotPages; i++){
-        loadPage(i);
+    TableLocks locks;
+    locks.add(mId, LOCK_MODE::INTENTION_EXCLUSIVE);
+    locks.lock();
 
+    if(!prepareChange()){
+        return false;
+    }
+
+    uint32_t workers = WorkerPool::getPool().getWorkerCount();
+    std::vector< uint64_t > workerDeletedRows(workers, 0);
+    std::vector< uint64_t > workerBytes(workers, 0);
+
+    bool written = forEachPage([&](char PAGE[], uint64_t pageNumber, uint32_t worker){
         bool atLeastOneMatched = false;
 
-        for(int j=sizeof(uint32_t); j+mRowSize-1<PAGE_SIZE; j+=mRowSize){
-            uint64_t currentRowId;
-            memcpy(&currentRowId, currentPageBuffer + j, sizeof(currentRowId));
-
-            if(currentRowId){
-
-                // non empty row
-                std::unique_ptr<char[]> rowBuffer = std::make_unique<char[]>(mRowSize + 1);
-                memcpy(rowBuffer.get(), currentPageBuffer + j, mRowSize);
-
-                bool matched = true;
-
-                // verify conditions
-                for(int k=0;k<conditions.size();k++){
-                    std::string cName = conditions[k].columnName;
-                    std::string val = conditions[k].value;
-                    COMPARISON comp = conditions[k].operation;
-                    
-                    uint32_t offset = offsets[cName];
-                    uint32_t sz = sizes[cName];
-                    std::string lVal = getValueFromBytes(rowBuffer.get(), types[cName], offset, offset+sz);
-
-                    COMPARISON compResult = getCompResult(lVal, val, types[cName]);
-                    if(!isComparisonValid(comp, compResult)){
-                        matched = false;
-                        break;
-                    }
+        if(mSlotted){
+            uint16_t numSlots = getSlotCount(PAGE);
+            for(uint16_t slot=0; slot<numSlots; slot++){
+                uint16_t offset, length;
+                getSlot(PAGE, slot, offset, length);
+                if(offset == 0){
+                    continue;
                 }
 
+                std::string row = decodeRow(mId, PAGE + offset, length, mColumns);
+
                 // If matched clear row
-                if(matched){
+                if(matchesConditions(row.c_str(), conditions)){
                     atLeastOneMatched = true;
-                    memset(currentPageBuffer + j, 0, mRowSize);
-                    mTotBytes -= mRowSize;
+                    // Older snapshots may still read the row, so its chains are freed later
+                    TransactionManager::getManager().addReleasedChains(*mTransaction, mId, getRowOverflowChains(PAGE + offset, mColumns));
+                    deleteFromSlottedPage(PAGE, slot);
+                    workerBytes[worker] += length;
+                    workerDeletedRows[worker]++;
                 }
-
             }
-        }
-        if(atLeastOneMatched){
-            if(!writeToPage(currentPageBuffer, mId, mCurrentPage)){
-                if(DEBUG == true){
-                    std::cout << "Error in writing to page" << std::endl;
+        } else {
+            std::vector< std::pair< uint32_t, uint32_t > > rows = getRowsOfPage(PAGE, mRowSize, false);
+            for(int j=0; j<rows.size(); j++){
+                // If matched clear row
+                if(matchesConditions(PAGE + rows[j].first, conditions)){
+                    atLeastOneMatched = true;
+                    memset(PAGE + rows[j].first, 0, mRowSize);
+                    workerBytes[worker] += mRowSize;
+                    workerDeletedRows[worker]++;
                 }
-                return false;
             }
         }
+        return atLeastOneMatched;
+    });
+
+    if(!written){
+        return false;
     }
 
-    memcpy(metadataBuffer, &mTotBytes, sizeof(mTotBytes));
-    writeToPage(metadataBuffer, mId, 0);
+    // Other sessions may have inserted since the scan started
+    std::unique_ptr<PageLatchGuard> metadataLatch;
+    if(!latchMetadata(metadataLatch)){
+        return false;
+    }
+
+    uint64_t deletedRows = 0;
+    for(uint32_t i=0; i<workers; i++){
+        deletedRows += workerDeletedRows[i];
+        mTotBytes -= workerBytes[i];
+    }
+
+    if(mHasStats){
+        removeRowsFromStats(mStats, deletedRows);
+    }
+    saveMetadata();
 
     return true;
-}
\ No newline at end of file
+}
@@ -1,8 +1,14 @@
 #include <string>
 #include <memory>
+#include <map>
+#include <functional>
 #include "../database/database.h"
+#include "../context/context.h"
 #include "../properties.h"
 #include "../condition/condition.h"
+#include "../stats/stats.h"
+#include "../lock/lock.h"
+#include "../mvcc/mvcc.h"
 
 
 class TableV2 {
@@ -13,14 +19,86 @@ class TableV2 {
     uint64_t mNextId = 1;
     uint64_t mCurrentPage = 0;
     std::vector< std::vector< std::string > > mColumns;
+    std::map< std::string, uint32_t > mColumnIndex;
     uint32_t mRowSize = 0;
+    // Tables with varchar columns use slotted pages
+    bool mSlotted = false;
+    TableStats mStats;
+    bool mHasStats = false;
+    // Transaction of the statement and the snapshot its updates and deletes match rows at
+    Transaction* mTransaction;
+    const Snapshot* mSnapshot;
+    // Set unless the statement runs in a transaction opened by begin. Its inserts are appended in batches (see InsertBatches)
+    bool mAutocommit;
+
+    bool matchesConditions(const char row[], const std::vector< condition >& conditions);
+    std::string applyAssignments(const std::string& row, const std::vector< std::pair< std::string, std::string > >& assignments);
+
+    /**
+     * @brief Appends an encoded record to the last page, allocating a new page if required
+     *
+     * @param writer set to the uncommitted writer of the last page if another transaction changed it.
+     * Nothing is appended then
+     */
+    bool appendRecord(const std::string& record, uint64_t& writer);
+
+    /**
+     * @brief Append encoded records with the next IDs of the table and add their rows to the statistics
+     *
+     * @return false if a page couldn't be written or the transaction lost a write conflict
+     */
+    bool appendRecords(std::vector< std::string >& records, const std::vector< std::string >& rows);
+
+    /**
+     * @brief Append a batch of records of concurrent inserts in a transaction of its own and commit it
+     */
+    bool appendBatch(std::vector< std::string >& records, const std::vector< std::string >& rows);
+    bool saveMetadata();
+
+    /**
+     * @brief Latch the metadata page exclusively once no other uncommitted writer changed it, and read it again
+     *
+     * @return false if it couldn't be read or the transaction lost a write conflict
+     */
+    bool latchMetadata(std::unique_ptr<PageLatchGuard>& latch);
+
+    /**
+     * @brief Read the counters and statistics of the metadata page again, since other sessions may
+     * have changed them. Called with the metadata page latched exclusively
+     */
+    bool loadMetadata();
+
+    /**
+     * @brief Run work(page, page number, worker) on every page of the table and write the pages it changed.
+     * Tables with at least PARALLEL_SCAN_MIN_PAGES pages are split in morsels of MORSEL_PAGES pages run by
+     * the worker pool, every worker with a page buffer of its own. Otherwise worker is 0. Every page is
+     * latched exclusively while it is read and written, and pages changed by other uncommitted writers
+     * are run once they released them. work gets the page as the snapshot of the statement sees it. It can't
+     * change a page committed by another writer after the snapshot (see TransactionManager::getWriter)
+     *
+     * @param work returns true if it changed the page
+     * @return false if a changed page couldn't be written or the transaction lost a write conflict
+     */
+    bool forEachPage(const std::function< bool(char PAGE[], uint64_t pageNumber, uint32_t worker) >& work);
+
+    /**
+     * @brief Make sure the statistics are loaded before rows change. Tables created before statistics
+     * were kept get them by reading every row once, if the metadata page has room for them
+     */
+    void prepareStats();
+
+    /**
+     * @brief Load the metadata and statistics before an update or a delete scans the table
+     */
+    bool prepareChange();
 public:
+    // Pages of the context of the statement
     char* metadataBuffer;
     char* currentPageBuffer;
 
     bool operator==(int x);
 
-    TableV2(std::string tableName);
+    TableV2(ExecutionContext& context, std::string tableName);
 
     bool loadPage(uint64_t pageIndex);
     bool loadFirstPage();
@@ -56,6 +134,4 @@ public:
     bool deleteRow(const std::vector< condition >& conditions);
 
     inline uint64_t getId(){ return mId; };
-
-    ~TableV2();
 };
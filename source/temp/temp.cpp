@@ -0,0 +1,314 @@
+#include <string.h>
+#include <iostream>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "temp.h"
+#include "../buffers/buffers.h"
+#include "../properties.h"
+#include "../logger/logger.h"
+
+// File system and process calls
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+extern uint64_t universalCounter;
+
+/**
+ * @brief Pages of a temporary file kept in memory. Pages never written are null and read as zeros
+ */
+struct TempFile {
+    std::vector< std::unique_ptr<char[]> > pages;
+    uint64_t bytes = 0;
+};
+
+std::string SESSION_DIRECTORY;
+
+// Held while the files below are looked at or changed. Statements of several clients create temporary files at once
+std::mutex TEMP_FILES_MUTEX;
+// Temporary files (without the overflow flag) of the running statements, with the statement that created each
+std::map< uint64_t, uint64_t > STATEMENT_TEMP_FILES;
+std::map< uint64_t, TempFile > IN_MEMORY_TEMP_FILES;
+std::set< uint64_t > ON_DISK_TEMP_FILES;
+uint64_t TEMP_MEMORY_USED = 0;
+
+std::atomic<uint64_t> STATEMENT_COUNTER(0);
+// Statement the thread runs (or runs a task of)
+thread_local uint64_t CURRENT_STATEMENT = 0;
+
+const std::string SESSION_PREFIX = "session_";
+
+/**
+ * @brief Remove query and spill files left in the data directory of every database by versions
+ * that stored them there, and session directories of processes that are no longer running
+ */
+void sweepTempFiles(){
+    std::error_code error;
+    uint32_t removed = 0;
+
+    for(const auto& entry : std::filesystem::directory_iterator(QUERY_DIRECTORY, error)){
+        std::string name = entry.path().filename().string();
+        if(!entry.is_directory(error) || name.rfind(SESSION_PREFIX, 0) != 0){
+            continue;
+        }
+        pid_t pid = atoi(name.c_str() + SESSION_PREFIX.length());
+        if(pid <= 0 || pid == getpid() || kill(pid, 0) == 0 || errno != ESRCH){
+            continue;
+        }
+        removed += std::filesystem::remove_all(entry.path(), error);
+    }
+
+    for(const auto& database : std::filesystem::directory_iterator(DATABASE_DIRECTORY, error)){
+        if(!database.is_directory(error)){
+            continue;
+        }
+        for(const auto& entry : std::filesystem::directory_iterator(database.path() / "data", error)){
+            std::string name = entry.path().filename().string();
+            bool temporary = false;
+            if(name.rfind("query__", 0) == 0){
+                temporary = true;
+            } else if(name.rfind("overflow__", 0) == 0){
+                temporary = TempFiles::isTempFile(std::stoull(name.substr(10)));
+            }
+            if(temporary && std::filesystem::remove(entry.path(), error)){
+                removed++;
+            }
+        }
+    }
+
+    if(DEBUG == true && removed > 0){
+        std::cout << "Removed " << removed << " temporary files of previous sessions" << std::endl;
+    }
+}
+
+void TempFiles::init(){
+    SESSION_DIRECTORY = QUERY_DIRECTORY + SESSION_PREFIX + std::to_string(getpid()) + "/";
+
+    std::error_code error;
+    std::filesystem::create_directories(SESSION_DIRECTORY, error);
+    if(error){
+        Logger::logError("Unable to create session directory "+SESSION_DIRECTORY);
+    }
+
+    sweepTempFiles();
+}
+
+void TempFiles::shutdown(){
+    std::vector< uint64_t > fileIds;
+    {
+        std::lock_guard<std::mutex> lock(TEMP_FILES_MUTEX);
+        for(auto file = STATEMENT_TEMP_FILES.begin(); file != STATEMENT_TEMP_FILES.end(); file++){
+            fileIds.push_back(file->first);
+        }
+    }
+    for(int i=0; i<fileIds.size(); i++){
+        deleteFile(fileIds[i]);
+    }
+
+    std::error_code error;
+    std::filesystem::remove_all(SESSION_DIRECTORY, error);
+}
+
+uint64_t TempFiles::createFileId(){
+    std::lock_guard<std::mutex> lock(TEMP_FILES_MUTEX);
+    uint64_t fileId;
+    do {
+        universalCounter++;
+        fileId = ( ( universalCounter % ((uint64_t)1 << LOG_MAX_TABLES) ) + ( (uint64_t)1 << LOG_MAX_TABLES) );
+    } while(STATEMENT_TEMP_FILES.count(fileId));
+    STATEMENT_TEMP_FILES[fileId] = CURRENT_STATEMENT;
+    return fileId;
+}
+
+bool TempFiles::isTempFile(uint64_t fileId){
+    // Files of databases carry the number of the database above the overflow flag
+    return (fileId & ~OVERFLOW_FILE_FLAG) >= ((uint64_t)1 << LOG_MAX_TABLES) && fileId < ((uint64_t)1 << DATABASE_ID_SHIFT);
+}
+
+std::string TempFiles::getFilePath(uint64_t fileId){
+    if(fileId & OVERFLOW_FILE_FLAG){
+        return SESSION_DIRECTORY + "overflow__" + std::to_string(fileId ^ OVERFLOW_FILE_FLAG);
+    }
+    return SESSION_DIRECTORY + "query__" + std::to_string(fileId);
+}
+
+bool TempFiles::isInMemory(uint64_t fileId){
+    std::lock_guard<std::mutex> lock(TEMP_FILES_MUTEX);
+    return IN_MEMORY_TEMP_FILES.find(fileId) != IN_MEMORY_TEMP_FILES.end();
+}
+
+bool TempFiles::readPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber, uint32_t& totRead){
+    std::lock_guard<std::mutex> lock(TEMP_FILES_MUTEX);
+    auto file = IN_MEMORY_TEMP_FILES.find(fileId);
+    if(file == IN_MEMORY_TEMP_FILES.end()){
+        return false;
+    }
+    totRead = 0;
+    if(pageNumber >= file->second.pages.size()){
+        return true;
+    }
+
+    const std::unique_ptr<char[]>& page = file->second.pages[pageNumber];
+    if(page){
+        memcpy(BUFFER, page.get(), PAGE_SIZE);
+    } else {
+        memset(BUFFER, 0, PAGE_SIZE);
+    }
+    totRead = PAGE_SIZE;
+    return true;
+}
+
+/**
+ * @brief Write a temporary file kept in memory to the session directory
+ */
+bool moveToDisk(uint64_t fileId){
+    auto file = IN_MEMORY_TEMP_FILES.find(fileId);
+
+    int fd = open(TempFiles::getFilePath(fileId).c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR|S_IWUSR);
+    if(fd < 0){
+        Logger::logError("Unable to write temporary file "+std::to_string(fileId)+" to disk");
+        return false;
+    }
+
+    std::unique_ptr<char[]> zeros = std::make_unique<char[]>(PAGE_SIZE);
+    memset(zeros.get(), 0, PAGE_SIZE);
+    bool written = true;
+    for(uint64_t i=0; i<file->second.pages.size() && written; i++){
+        char* page = file->second.pages[i] ? file->second.pages[i].get() : zeros.get();
+        written = pwrite(fd, page, PAGE_SIZE, i*PAGE_SIZE) == PAGE_SIZE;
+    }
+    close(fd);
+
+    if(!written){
+        Logger::logError("Unable to write temporary file "+std::to_string(fileId)+" to disk");
+        unlink(TempFiles::getFilePath(fileId).c_str());
+        return false;
+    }
+
+    if(DEBUG == true){
+        std::cout << "Moved temporary file " << fileId << " (" << file->second.bytes << " bytes) to disk" << std::endl;
+    }
+
+    TEMP_MEMORY_USED -= file->second.bytes;
+    IN_MEMORY_TEMP_FILES.erase(file);
+    ON_DISK_TEMP_FILES.insert(fileId);
+    return true;
+}
+
+/**
+ * @brief Move the largest temporary files to disk until the memory used fits TEMP_MEMORY_BUDGET
+ */
+void enforceBudget(){
+    while(TEMP_MEMORY_USED > TEMP_MEMORY_BUDGET){
+        auto largest = IN_MEMORY_TEMP_FILES.begin();
+        for(auto file = IN_MEMORY_TEMP_FILES.begin(); file != IN_MEMORY_TEMP_FILES.end(); file++){
+            if(file->second.bytes > largest->second.bytes){
+                largest = file;
+            }
+        }
+        if(largest == IN_MEMORY_TEMP_FILES.end() || !moveToDisk(largest->first)){
+            // Keep the pages in memory rather than losing them
+            return;
+        }
+    }
+}
+
+bool TempFiles::writePage(const char BUFFER[], uint64_t fileId, uint64_t pageNumber, bool create, bool truncate){
+    std::lock_guard<std::mutex> lock(TEMP_FILES_MUTEX);
+    auto file = IN_MEMORY_TEMP_FILES.find(fileId);
+    if(file == IN_MEMORY_TEMP_FILES.end()){
+        if(!create || ON_DISK_TEMP_FILES.count(fileId)){
+            return false;
+        }
+        file = IN_MEMORY_TEMP_FILES.emplace(fileId, TempFile()).first;
+    }
+
+    if(truncate){
+        TEMP_MEMORY_USED -= file->second.bytes;
+        file->second.pages.clear();
+        file->second.bytes = 0;
+    }
+
+    std::vector< std::unique_ptr<char[]> >& pages = file->second.pages;
+    if(pageNumber >= pages.size()){
+        pages.resize(pageNumber + 1);
+    }
+    if(!pages[pageNumber]){
+        pages[pageNumber] = std::make_unique<char[]>(PAGE_SIZE);
+        file->second.bytes += PAGE_SIZE;
+        TEMP_MEMORY_USED += PAGE_SIZE;
+    }
+    memcpy(pages[pageNumber].get(), BUFFER, PAGE_SIZE);
+
+    enforceBudget();
+    return true;
+}
+
+bool TempFiles::truncate(uint64_t fileId, uint64_t numPages){
+    std::lock_guard<std::mutex> lock(TEMP_FILES_MUTEX);
+    auto file = IN_MEMORY_TEMP_FILES.find(fileId);
+    if(file == IN_MEMORY_TEMP_FILES.end()){
+        return false;
+    }
+
+    std::vector< std::unique_ptr<char[]> >& pages = file->second.pages;
+    for(uint64_t i=numPages; i<pages.size(); i++){
+        if(pages[i]){
+            file->second.bytes -= PAGE_SIZE;
+            TEMP_MEMORY_USED -= PAGE_SIZE;
+        }
+    }
+    if(numPages < pages.size()){
+        pages.resize(numPages);
+    }
+    return true;
+}
+
+void TempFiles::forget(uint64_t fileId){
+    std::lock_guard<std::mutex> lock(TEMP_FILES_MUTEX);
+    auto file = IN_MEMORY_TEMP_FILES.find(fileId);
+    if(file != IN_MEMORY_TEMP_FILES.end()){
+        TEMP_MEMORY_USED -= file->second.bytes;
+        IN_MEMORY_TEMP_FILES.erase(file);
+    }
+    ON_DISK_TEMP_FILES.erase(fileId);
+    STATEMENT_TEMP_FILES.erase(fileId);
+}
+
+void TempFiles::beginStatement(){
+    CURRENT_STATEMENT = ++STATEMENT_COUNTER;
+}
+
+uint64_t TempFiles::getStatement(){
+    return CURRENT_STATEMENT;
+}
+
+void TempFiles::setStatement(uint64_t statement){
+    CURRENT_STATEMENT = statement;
+}
+
+void TempFiles::endStatement(){
+    std::vector< uint64_t > fileIds;
+    {
+        std::lock_guard<std::mutex> lock(TEMP_FILES_MUTEX);
+        for(auto file = STATEMENT_TEMP_FILES.begin(); file != STATEMENT_TEMP_FILES.end(); file++){
+            if(file->second == CURRENT_STATEMENT){
+                fileIds.push_back(file->first);
+            }
+        }
+    }
+
+    if(DEBUG == true && !fileIds.empty()){
+        std::cout << "Deleting " << fileIds.size() << " temporary files of the statement" << std::endl;
+    }
+
+    for(int i=0; i<fileIds.size(); i++){
+        deleteFile(fileIds[i]);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef TEMP_H
+#define TEMP_H
+
+#include <string>
+#include <cstdint>
+
+/**
+ * @brief Temporary files of this session (spill files and query results), using query file IDs.
+ * Their pages are kept in memory up to TEMP_MEMORY_BUDGET bytes. Past it, the largest ones are
+ * written to the session directory (QUERY_DIRECTORY/session_<pid>/). Temporary files still alive
+ * when the statement creating them ends are deleted. Statements of several clients can run at once.
+ * Directories of sessions that ended without cleaning up are removed at startup.
+ */
+class TempFiles {
+public:
+    /**
+     * @brief Create the session directory and remove temporary files of sessions that are no longer running
+     */
+    static void init();
+
+    /**
+     * @brief Remove the temporary files and the directory of this session
+     */
+    static void shutdown();
+
+    /**
+     * @brief Allocate the ID of a new temporary file. The file is deleted when the statement of the thread ends
+     */
+    static uint64_t createFileId();
+
+    /**
+     * @brief Check if the ID belongs to a temporary file or to the overflow file of one
+     */
+    static bool isTempFile(uint64_t fileId);
+
+    /**
+     * @brief Path of a temporary file written to disk
+     */
+    static std::string getFilePath(uint64_t fileId);
+
+    static bool isInMemory(uint64_t fileId);
+
+    /**
+     * @brief Read a page of a temporary file kept in memory
+     *
+     * @param totRead bytes read. 0 if the page is past the end of the file
+     * @return false if the file is on disk (or doesn't exist) and has to be read there
+     */
+    static bool readPage(char BUFFER[], uint64_t fileId, uint64_t pageNumber, uint32_t& totRead);
+
+    /**
+     * @brief Write a page of a temporary file kept in memory. Files are created in memory when create is set
+     *
+     * @return true if the page was written in memory
+     * @return false if the file is on disk (or doesn't exist) and has to be written there
+     */
+    static bool writePage(const char BUFFER[], uint64_t fileId, uint64_t pageNumber, bool create, bool truncate);
+
+    /**
+     * @return false if the file is on disk (or doesn't exist) and has to be truncated there
+     */
+    static bool truncate(uint64_t fileId, uint64_t numPages);
+
+    /**
+     * @brief Release the memory of a temporary file. Files on disk are unlinked by the caller (see deleteFile)
+     */
+    static void forget(uint64_t fileId);
+
+    /**
+     * @brief Start a statement on the thread. Temporary files created by the thread from now on belong to it
+     */
+    static void beginStatement();
+
+    /**
+     * @brief Statement of the thread, so that tasks it hands to other threads create files for it (see setStatement)
+     */
+    static uint64_t getStatement();
+
+    static void setStatement(uint64_t statement);
+
+    /**
+     * @brief Delete every temporary file of the statement of the thread that is still alive
+     */
+    static void endStatement();
+};
+
+#endif // TEMP_H
@@ -2,8 +2,9 @@
 #include <iostream>
 #include <algorithm>
 #include "type.h"
+#include "../properties.h"
 
-bool verifyStringType(const std::string& type);
+bool verifyStringType(const std::string& type, uint32_t prefixLength);
 
 TYPE getTypeFromString(const std::string type){
     if(type == "int"){
@@ -13,10 +14,15 @@ TYPE getTypeFromString(const std::string type){
     } else if(type == "char"){
         return TYPE::CHAR;
     } else if(type.size()>6 && type.substr(0,6)=="string"){
-        if(!verifyStringType(type)){
+        if(!verifyStringType(type, 6)){
             return TYPE::UNSUPPORTED;
         }
         return TYPE::STRING;
+    } else if(type.size()>7 && type.substr(0,7)=="varchar"){
+        if(!verifyStringType(type, 7)){
+            return TYPE::UNSUPPORTED;
+        }
+        return TYPE::VARCHAR;
     } else {
         return TYPE::UNSUPPORTED;
     }
@@ -26,7 +32,13 @@ uint32_t getStringLength(const std::string& type){
     
     std::string lengthString = "";
 
-    for(int i=7;i < std::min((int)type.size()-1, 20); i++){
+    // Length starts after the opening bracket of string[N] and varchar[N]
+    size_t lengthStart = type.find('[');
+    if(lengthStart == std::string::npos){
+        return 0;
+    }
+
+    for(int i=lengthStart+1;i < std::min((int)type.size()-1, (int)lengthStart+14); i++){
         if(type[i]<'0' || type[i]>'9'){
             return 0;
         }
@@ -37,7 +49,7 @@ uint32_t getStringLength(const std::string& type){
      * @brief Currently only supporting strings with length < 1e9
      * 
      */
-    if(lengthString.length()>9) {
+    if(lengthString.length()>9 || lengthString.length()==0) {
         return 0;
     }
 
@@ -59,6 +71,12 @@ uint32_t getTypeSize(const std::string& type){
             return 1;
         case TYPE::STRING:
             return getStringLength(type);
+        case TYPE::VARCHAR:
+            /**
+             * @brief Maximum bytes occupied inside a page. Longer values are replaced by
+             * a reference to their overflow pages (see page.h)
+             */
+            return sizeof(uint32_t) + std::min(getStringLength(type), VARCHAR_INLINE_LIMIT);
         case TYPE::UNSUPPORTED:
             return 0;
         default:
@@ -66,8 +84,18 @@ uint32_t getTypeSize(const std::string& type){
     }
 }
 
-bool verifyStringType(const std::string& type){
-    if(type[6]!='[' || type[type.size()-1]!=']'){
+uint32_t getFieldSize(const char buffer[], const std::string& type, uint32_t start){
+    if(getTypeFromString(type) != TYPE::VARCHAR){
+        return getTypeSize(type);
+    }
+    // varchar values are stored as 4 byte length followed by the characters
+    uint32_t length;
+    memcpy(&length, buffer + start, sizeof(length));
+    return sizeof(length) + length;
+}
+
+bool verifyStringType(const std::string& type, uint32_t prefixLength){
+    if(type[prefixLength]!='[' || type[type.size()-1]!=']'){
         return false;
     }
     
@@ -117,7 +145,8 @@ bool matchType(const std::string& value, const std::string& type){
                 return false;
             }
         case TYPE::STRING:
-            if(value[0] != '\'' || value[value.size()-1] != '\''){
+        case TYPE::VARCHAR:
+            if(value.size() < 2 || value[0] != '\'' || value[value.size()-1] != '\''){
                 return false;
             }
             maxLen = getStringLength(type);
@@ -133,7 +162,7 @@ bool matchType(const std::string& value, const std::string& type){
 std::string getBytesFromValue(const std::string& value, const std::string& type){
     TYPE _type = getTypeFromString(type);
     std::string finalBytes, padding;
-    uint32_t maxLen, reqPadding;
+    uint32_t maxLen, reqPadding, length;
     int64_t intVal;
     double db;
     switch(_type){
@@ -168,6 +197,12 @@ std::string getBytesFromValue(const std::string& value, const std::string& type)
             }
             finalBytes = padding + finalBytes;
             return finalBytes;
+        case TYPE::VARCHAR:
+            length = value.size()-2;
+            char lengthBytes[sizeof(uint32_t)];
+            memcpy(lengthBytes, &length, sizeof(length));
+            finalBytes = std::string(lengthBytes, sizeof(length)) + value.substr(1,length);
+            return finalBytes;
         default:
             return "";
     }
@@ -177,6 +212,7 @@ std::string getValueFromBytes(const char buffer[], const std::string& type, int
     TYPE _type = getTypeFromString(type);
 
     int64_t intValue;
+    uint32_t length;
     std::string returnValue;
     double db;
     switch(_type){
@@ -200,6 +236,12 @@ std::string getValueFromBytes(const char buffer[], const std::string& type, int
             }
             returnValue += '\'';
             return returnValue;
+        case TYPE::VARCHAR:
+            memcpy(&length, buffer + start, sizeof(length));
+            returnValue += '\'';
+            returnValue.append(buffer + start + sizeof(length), length);
+            returnValue += '\'';
+            return returnValue;
         default:
             return "";
     }
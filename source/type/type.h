@@ -1,18 +1,21 @@
 #ifndef TYPE_H
 #define TYPE_H
 #include <string>
+#include <cstdint>
 
 enum class TYPE {
     INT,
     FLOAT,
     CHAR,
     STRING,
+    VARCHAR,
     UNSUPPORTED
 };
 
 TYPE getTypeFromString(const std::string type);
 uint32_t getStringLength(const std::string& type);
 uint32_t getTypeSize(const std::string& type);
+uint32_t getFieldSize(const char buffer[], const std::string& type, uint32_t start);
 bool matchType(const std::string& value, const std::string& type);
 std::string getBytesFromValue(const std::string& value, const std::string& type);
 std::string getValueFromBytes(const char buffer[], const std::string& type, int start, int end);
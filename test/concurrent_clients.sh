@@ -0,0 +1,36 @@
+#!/bin/bash
+# Concurrent clients against a server built with ThreadSanitizer (make tsan_test).
+# usage: test/concurrent_clients.sh <server binary> <penguin_load binary>
+# Clients run parallel scans, group bys and updates over one table at once, then point inserts and reads.
+# Fails if a client got an error or ThreadSanitizer reported anything. Scans only run on the worker pool
+# with more than one worker (PARALLEL_WORKERS, or a machine with more than one hardware thread)
+
+SERVER=${1:-./penguin_tsan}
+LOAD=${2:-./penguin_load}
+DIR=$(mktemp -d)
+SOCKET=$DIR/penguin.sock
+
+TSAN_OPTIONS="log_path=$DIR/tsan" $SERVER --server $SOCKET > $DIR/server.log 2>&1 &
+SERVER_PID=$!
+for i in $(seq 1 50); do
+    [ -S $SOCKET ] && break
+    sleep 0.2
+done
+
+FAILED=0
+$LOAD -s $SOCKET -d tsanscan -w scan -t 12000 -c 4 -n 30 -r 70 || FAILED=1
+$LOAD -s $SOCKET -d tsanpoint -c 8 -n 200 -r 50 || FAILED=1
+
+kill -TERM $SERVER_PID
+wait $SERVER_PID
+
+if ls $DIR/tsan.* > /dev/null 2>&1; then
+    cat $DIR/tsan.*
+    FAILED=1
+fi
+if [ $FAILED -ne 0 ]; then
+    echo "Concurrent clients test failed. Server output is in $DIR/server.log"
+    exit 1
+fi
+echo "Concurrent clients test passed"
+rm -rf $DIR
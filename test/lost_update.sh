@@ -0,0 +1,72 @@
+#!/bin/bash
+# Two sessions updating the same row (make lost_update_test).
+# usage: test/lost_update.sh <server binary> <penguin_client binary>
+# Session A opens a transaction and reads id 1. Session B changes it and commits. A then updates the rows
+# it read. Under snapshot isolation A must not overwrite the change of B it never saw: its update or its
+# commit fails and B's value stays
+
+SERVER=${1:-./penguin}
+CLIENT=${2:-./penguin_client}
+DIR=$(mktemp -d)
+SOCKET=$DIR/penguin.sock
+
+$SERVER --server $SOCKET > $DIR/server.log 2>&1 &
+SERVER_PID=$!
+for i in $(seq 1 50); do
+    [ -S $SOCKET ] && break
+    sleep 0.2
+done
+
+# Statements of a session go through a fifo, so that the sessions take turns
+mkfifo $DIR/a $DIR/b
+$CLIENT $SOCKET < $DIR/a > $DIR/a.out 2>&1 &
+CLIENT_A=$!
+$CLIENT $SOCKET < $DIR/b > $DIR/b.out 2>&1 &
+CLIENT_B=$!
+exec 3> $DIR/a 4> $DIR/b
+
+# Send a statement and wait for its output (the prompt of the next statement)
+run(){
+    local fd=$1 output=$2 statement=$3
+    local prompts=$(grep -a -o "penguin_db >" $output | wc -l)
+    echo "$statement;" >&$fd
+    for i in $(seq 1 100); do
+        [ $(grep -a -o "penguin_db >" $output | wc -l) -gt $prompts ] && return
+        sleep 0.1
+    done
+    echo "No answer to $statement"
+}
+
+run 4 $DIR/b.out "create database lostupdate"
+run 4 $DIR/b.out "use lostupdate"
+run 4 $DIR/b.out "create table acct ( id int , bal int )"
+run 4 $DIR/b.out "delete from acct where id > 0"
+run 4 $DIR/b.out "insert into acct values ( 1 , 100 )"
+run 4 $DIR/b.out "insert into acct values ( 2 , 100 )"
+
+run 3 $DIR/a.out "use lostupdate"
+run 3 $DIR/a.out "begin"
+run 3 $DIR/a.out "select id, bal from acct where id == 1"
+run 4 $DIR/b.out "update acct set bal = 50 where id == 1"
+run 3 $DIR/a.out "update acct set bal = 1 where bal == 100"
+run 3 $DIR/a.out "commit"
+echo "exit;" >&3
+wait $CLIENT_A
+
+run 4 $DIR/b.out "select id, bal from acct where id == 1"
+echo "exit;" >&4
+wait $CLIENT_B
+exec 3>&- 4>&-
+
+kill -TERM $SERVER_PID
+wait $SERVER_PID
+
+# The last select of B shows the row of id 1 with its value
+if grep -a -q "ERROR" $DIR/a.out && grep -a -E "^\s+1\s+50\s*$" $DIR/b.out > /dev/null; then
+    echo "Lost update test passed"
+    rm -rf $DIR
+    exit 0
+fi
+cat $DIR/a.out $DIR/b.out
+echo "Lost update test failed. Server output is in $DIR/server.log"
+exit 1